@@ -1,6 +1,7 @@
 #ifndef LINTDB_SEARCH_OPTIONS_H
 #define LINTDB_SEARCH_OPTIONS_H
 
+#include <algorithm>
 #include <cstddef>
 #include <string>
 #include <vector>
@@ -34,9 +35,44 @@ struct SearchOptions {
     size_t nearest_tokens_to_fetch =
             100; /// the number of nearest tokens to fetch in XTR.
     std::string colbert_field = "colbert";
+    bool prune_candidates =
+            true; /// skip candidates whose centroid scores can't make it into
+                  /// the top num_second_pass. This doesn't change results.
+    bool accumulate_centroid_scores =
+            false; /// score candidates term-at-a-time from the posting lists
+                   /// instead of reading each candidate's codes. Only probed
+                   /// centroids count towards the first pass score.
+    size_t centroids_per_token =
+            0; /// when > 0, keep only this many centroid scores per query
+               /// token. Other centroids score the lowest score we kept.
+               /// Saves memory and time with many centroids. When 0, the
+               /// coarse quantizer picks: every centroid for flat
+               /// quantizers, ef_search for HNSW.
+    size_t search_batch_size =
+            64; /// the number of queries search_batch() scores against the
+                /// centroids together. Larger batches share more work but
+                /// hold more centroid scores in memory.
 
     SearchOptions() : expected_id(-1){};
 };
+
+/**
+ * the number of centroid scores to calculate per query token.
+ *
+ * default_centroids is the coarse quantizer's choice, used when
+ * centroids_per_token isn't set. At least k_top_centroids are calculated.
+ */
+inline size_t centroids_to_calculate(
+        const SearchOptions& opts,
+        const size_t num_centroids,
+        const size_t default_centroids) {
+    if (opts.centroids_per_token == 0) {
+        return std::min(
+                std::max(default_centroids, opts.k_top_centroids),
+                num_centroids);
+    }
+    return std::min(opts.centroids_per_token, num_centroids);
+}
 } // namespace lintdb
 
 #endif
\ No newline at end of file
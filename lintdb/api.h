@@ -9,6 +9,9 @@ typedef int64_t idx_t;
 // the codes used to save the centroid for each token vector.
 // each code is treated as an index, which is defined above.
 typedef idx_t code_t;
+// the centroid code of each ColBERT token as it's kept with the document.
+// 32 bits covers any number of centroids we train.
+typedef uint32_t colbert_code_t;
 typedef uint8_t residual_t; // the residual codes saved for each token vector.
 
 typedef uint16_t float16;
@@ -5,7 +5,12 @@
 #include <rocksdb/filter_policy.h>
 #include <rocksdb/slice_transform.h>
 #include <rocksdb/table.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 #include "lintdb/constants.h"
+#include "lintdb/invlists/PostingBlocks.h"
+#include "lintdb/invlists/Tombstones.h"
 
 namespace lintdb {
 namespace {
@@ -22,23 +27,119 @@ rocksdb::ColumnFamilyOptions create_index_table_options() {
 
     return index_options;
 };
+
+rocksdb::ColumnFamilyOptions create_postings_table_options() {
+    // block lists share the index's key prefix, and are updated with merge
+    // operands.
+    rocksdb::ColumnFamilyOptions postings_options =
+            create_index_table_options();
+    postings_options.merge_operator =
+            std::make_shared<PostingListMergeOperator>();
+
+    return postings_options;
+}
 } // namespace
-inline std::vector<rocksdb::ColumnFamilyDescriptor> create_column_families() {
+/**
+ * create_column_families describes every column family of an index. With
+ * tombstones, compaction drops the keys of deleted documents.
+ */
+inline std::vector<rocksdb::ColumnFamilyDescriptor> create_column_families(
+        std::shared_ptr<const Tombstones> tombstones = nullptr) {
+    auto index_options = create_index_table_options();
+    rocksdb::ColumnFamilyOptions codes_options;
+    rocksdb::ColumnFamilyOptions residuals_options;
+    rocksdb::ColumnFamilyOptions mapping_options;
+    rocksdb::ColumnFamilyOptions doc_options;
+    auto postings_options = create_postings_table_options();
+    if (tombstones) {
+        auto filter = std::make_shared<TombstoneFilterFactory>(tombstones);
+        for (auto options :
+             {&index_options,
+              &codes_options,
+              &residuals_options,
+              &mapping_options,
+              &doc_options}) {
+            options->compaction_filter_factory = filter;
+        }
+        postings_options.compaction_filter_factory =
+                std::make_shared<TombstoneFilterFactory>(tombstones, true);
+    }
+
     return {rocksdb::ColumnFamilyDescriptor(
                     rocksdb::kDefaultColumnFamilyName,
                     rocksdb::ColumnFamilyOptions()),
-            rocksdb::ColumnFamilyDescriptor(
-                    kIndexColumnFamily, create_index_table_options()),
+            rocksdb::ColumnFamilyDescriptor(kIndexColumnFamily, index_options),
             rocksdb::ColumnFamilyDescriptor(
                     kForwardColumnFamily, rocksdb::ColumnFamilyOptions()),
+            rocksdb::ColumnFamilyDescriptor(kCodesColumnFamily, codes_options),
             rocksdb::ColumnFamilyDescriptor(
-                    kCodesColumnFamily, rocksdb::ColumnFamilyOptions()),
+                    kResidualsColumnFamily, residuals_options),
             rocksdb::ColumnFamilyDescriptor(
-                    kResidualsColumnFamily, rocksdb::ColumnFamilyOptions()),
+                    kMappingColumnFamily, mapping_options),
+            rocksdb::ColumnFamilyDescriptor(kDocColumnFamily, doc_options),
             rocksdb::ColumnFamilyDescriptor(
-                    kMappingColumnFamily, rocksdb::ColumnFamilyOptions()),
+                    kPostingsColumnFamily, postings_options),
             rocksdb::ColumnFamilyDescriptor(
-                    kDocColumnFamily, rocksdb::ColumnFamilyOptions())};
+                    kTombstoneColumnFamily, rocksdb::ColumnFamilyOptions())};
+}
+
+/**
+ * open_read_only opens the column families of an index without writing to
+ * it.
+ *
+ * Indexes written by older versions don't have every column family, and a
+ * read only open can't create them. Missing families are read through the
+ * default family, which we never write to, so they read as empty. These
+ * handles are the DB's own default handle and must not be destroyed.
+ */
+inline rocksdb::Status open_read_only(
+        const rocksdb::Options& options,
+        const std::string& path,
+        const std::vector<rocksdb::ColumnFamilyDescriptor>& cfs,
+        std::vector<rocksdb::ColumnFamilyHandle*>* handles,
+        rocksdb::DB** db) {
+    std::vector<std::string> existing;
+    rocksdb::Status s =
+            rocksdb::DB::ListColumnFamilies(options, path, &existing);
+    if (!s.ok()) {
+        return s;
+    }
+
+    std::vector<rocksdb::ColumnFamilyDescriptor> present;
+    std::vector<int> positions;
+    for (const auto& cf : cfs) {
+        if (std::find(existing.begin(), existing.end(), cf.name) ==
+            existing.end()) {
+            positions.push_back(-1);
+            continue;
+        }
+        positions.push_back(present.size());
+        present.push_back(cf);
+    }
+
+    std::vector<rocksdb::ColumnFamilyHandle*> opened;
+    s = rocksdb::DB::OpenForReadOnly(options, path, present, &opened, db);
+    if (!s.ok()) {
+        return s;
+    }
+    handles->clear();
+    for (int position : positions) {
+        handles->push_back(
+                position < 0 ? (*db)->DefaultColumnFamily()
+                             : opened[position]);
+    }
+    return s;
+}
+
+/// destroys the handles of an index, skipping the DB's default handle.
+inline void destroy_column_families(
+        rocksdb::DB* db,
+        const std::vector<rocksdb::ColumnFamilyHandle*>& handles) {
+    for (auto cf : handles) {
+        if (cf != db->DefaultColumnFamily()) {
+            db->DestroyColumnFamilyHandle(cf);
+        }
+    }
 }
 
 } // namespace lintdb
@@ -13,6 +13,8 @@ static const string kResidualsColumnFamily = "residuals";
 static const string kForwardColumnFamily = "forward";
 static const string kMappingColumnFamily = "mapping";
 static const string kDocColumnFamily = "doc";
+static const string kPostingsColumnFamily = "postings";
+static const string kTombstoneColumnFamily = "tombstones";
 
 typedef idx_t column_index_t;
 static const column_index_t kIndexColumnIndex = 1;
@@ -21,6 +23,8 @@ static const column_index_t kCodesColumnIndex = 3;
 static const column_index_t kResidualsColumnIndex = 4;
 static const column_index_t kMappingColumnIndex = 5;
 static const column_index_t kDocColumnIndex = 6;
+static const column_index_t kPostingsColumnIndex = 7;
+static const column_index_t kTombstoneColumnIndex = 8;
 
 // default tenant is used in testing.
 static const uint64_t kDefaultTenant = 0;
@@ -6,6 +6,7 @@
 #include <rocksdb/db.h>
 #include <rocksdb/slice_transform.h>
 #include <rocksdb/table.h>
+#include <rocksdb/write_batch.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <algorithm>
@@ -15,18 +16,30 @@
 #include <gsl/span>
 #include <iostream>
 #include <limits>
+#include <map>
+#include <numeric>
 #include <string>
+#include <tuple>
 #include <vector>
 #include "lintdb/api.h"
 #include "lintdb/assert.h"
 #include "lintdb/cf.h"
+#include "lintdb/invlists/BulkIndexWriter.h"
+#include "lintdb/invlists/CachedInvertedList.h"
+#include "lintdb/invlists/KeyBuilder.h"
 #include "lintdb/invlists/RocksdbForwardIndex.h"
 #include "lintdb/invlists/RocksdbInvertedList.h"
+#include "lintdb/invlists/Segment.h"
+#include "lintdb/invlists/SegmentInvertedList.h"
+#include "lintdb/invlists/Tombstones.h"
 #include "lintdb/quantizers/io.h"
 #include "lintdb/quantizers/Quantizer.h"
+#include "lintdb/query/KnnNearestCentroids.h"
 #include "lintdb/query/QueryExecutor.h"
 #include "lintdb/schema/DataTypes.h"
+#include "lintdb/schema/DocEncoder.h"
 #include "lintdb/schema/FieldMapper.h"
+#include "lintdb/schema/IngestionPipeline.h"
 #include "lintdb/scoring/Scorer.h"
 #include "lintdb/util.h"
 #include "lintdb/version.h"
@@ -36,8 +49,112 @@ namespace lintdb {
 
 // env var to set the number of threads for processing.
 const char* PROCESSING_THREADS = "LINTDB_NUM_THREADS";
+// k-means doesn't use more embeddings than this per centroid.
+const size_t kTrainingEmbeddingsPerCentroid = 256;
+// upgrade_postings writes its changes in batches of this many keys.
+const size_t kUpgradeBatchSize = 10000;
+
+namespace {
+/// only tensor fields that are indexed or use colbert have quantizers.
+bool is_trainable(const Field& field) {
+    auto has_type = [&](FieldType type) {
+        return std::find(
+                       field.field_types.begin(),
+                       field.field_types.end(),
+                       type) != field.field_types.end();
+    };
+    return (field.data_type == DataType::TENSOR ||
+            field.data_type == DataType::QUANTIZED_TENSOR) &&
+            (has_type(FieldType::Indexed) || has_type(FieldType::Colbert));
+}
+
+/// the column families that have a key for every document, or its tombstone.
+/// Their keys are the document's forward index id.
+const column_index_t kDocumentColumns[] = {
+        kMappingColumnIndex,
+        kDocColumnIndex,
+        kTombstoneColumnIndex};
+
+/**
+ * check_disjoint_documents throws if a document, or its tombstone, is in
+ * more than one of the indexes.
+ *
+ * Every index's document keys are sorted, so they're walked together in one
+ * k-way merge. Only keys are read, and nothing is kept but the iterators.
+ */
+void check_disjoint_documents(
+        const std::vector<std::pair<
+                rocksdb::DB*,
+                const std::vector<rocksdb::ColumnFamilyHandle*>*>>& indexes) {
+    struct Cursor {
+        std::unique_ptr<rocksdb::Iterator> it;
+        size_t index;
+    };
+    rocksdb::ReadOptions ro;
+    // a single pass shouldn't evict the blocks searches use.
+    ro.fill_cache = false;
+
+    std::vector<Cursor> cursors;
+    for (size_t i = 0; i < indexes.size(); i++) {
+        auto [db, cfs] = indexes[i];
+        for (const auto column : kDocumentColumns) {
+            // missing column families of old indexes share the default
+            // handle.
+            if ((*cfs)[column] == db->DefaultColumnFamily()) {
+                continue;
+            }
+            std::unique_ptr<rocksdb::Iterator> it(
+                    db->NewIterator(ro, (*cfs)[column]));
+            it->SeekToFirst();
+            LINTDB_THROW_IF_NOT_FMT(
+                    it->status().ok(), "%s", it->status().ToString().c_str());
+            if (it->Valid()) {
+                cursors.push_back({std::move(it), i});
+            }
+        }
+    }
 
-IndexIVF::IndexIVF(const std::string& path, bool read_only)
+    // a min heap on the cursors' keys.
+    auto greater = [&](size_t a, size_t b) {
+        return cursors[a].it->key().compare(cursors[b].it->key()) > 0;
+    };
+    std::vector<size_t> heap(cursors.size());
+    std::iota(heap.begin(), heap.end(), 0);
+    std::make_heap(heap.begin(), heap.end(), greater);
+
+    std::string last_key;
+    size_t last_index = 0;
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        Cursor& cursor = cursors[heap.back()];
+        const auto key = cursor.it->key();
+        if (key.compare(rocksdb::Slice(last_key)) == 0) {
+            // an index has the same key in each of its document columns.
+            LINTDB_THROW_IF_NOT_FMT(
+                    cursor.index == last_index,
+                    "document %lld of tenant %llu is in more than one index",
+                    (long long)ForwardIndexKey(last_key).doc_id(),
+                    (unsigned long long)ForwardIndexKey(last_key).tenant());
+        } else {
+            last_key.assign(key.data(), key.size());
+            last_index = cursor.index;
+        }
+
+        cursor.it->Next();
+        if (cursor.it->Valid()) {
+            std::push_heap(heap.begin(), heap.end(), greater);
+        } else {
+            LINTDB_THROW_IF_NOT_FMT(
+                    cursor.it->status().ok(),
+                    "%s",
+                    cursor.it->status().ToString().c_str());
+            heap.pop_back();
+        }
+    }
+}
+} // namespace
+
+IndexIVF::IndexIVF(const std::string& path, bool read_only, bool use_segment)
         : read_only(read_only), path(path) {
     // check that path exists as a directory
     if (!std::filesystem::is_directory(path)) {
@@ -53,7 +170,13 @@ IndexIVF::IndexIVF(const std::string& path, bool read_only)
     Json::Value field_mapper_root = loadJson(path + "/" + "_field_mapper.json");
     this->field_mapper = FieldMapper::fromJson(field_mapper_root);
 
-    initialize_inverted_list(config.lintdb_version);
+    if (use_segment) {
+        LINTDB_THROW_IF_NOT_MSG(
+                read_only, "segments can only be opened read only");
+        initialize_segment();
+    } else {
+        initialize_inverted_list(config.lintdb_version);
+    }
     load_retrieval(path, config);
 }
 
@@ -100,9 +223,13 @@ void IndexIVF::initialize_retrieval() {
             field.data_type != DataType::QUANTIZED_TENSOR) {
             continue;
         }
-        std::shared_ptr<FaissCoarseQuantizer> cq =
-                std::make_shared<FaissCoarseQuantizer>(
-                        field.parameters.dimensions);
+        CoarseQuantizerConfig cqc{
+                field.parameters.dimensions,
+                field.parameters.hnsw_m,
+                field.parameters.ef_search,
+                field.parameters.clustering};
+        std::shared_ptr<ICoarseQuantizer> cq = create_coarse_quantizer(
+                field.parameters.coarse_quantizer, cqc);
         this->coarse_quantizer_map[field.name] = std::move(cq);
     }
 
@@ -134,8 +261,16 @@ void IndexIVF::load_retrieval(
         }
         std::string cqp =
                 existing_path + "/" + field.name + "_coarse_quantizer";
-        std::shared_ptr<FaissCoarseQuantizer> cq =
-                FaissCoarseQuantizer::deserialize(cqp, config.lintdb_version);
+        CoarseQuantizerConfig cqc{
+                field.parameters.dimensions,
+                field.parameters.hnsw_m,
+                field.parameters.ef_search,
+                field.parameters.clustering};
+        std::shared_ptr<ICoarseQuantizer> cq = load_coarse_quantizer(
+                cqp,
+                field.parameters.coarse_quantizer,
+                cqc,
+                config.lintdb_version);
         this->coarse_quantizer_map[field.name] = std::move(cq);
     }
 
@@ -162,7 +297,8 @@ void IndexIVF::initialize_inverted_list(const Version& version) {
     options.create_if_missing = true;
     options.create_missing_column_families = true;
 
-    auto cfs = create_column_families();
+    this->tombstones = std::make_shared<Tombstones>();
+    auto cfs = create_column_families(tombstones);
 
     rocksdb::DB* ptr;
     rocksdb::Status s;
@@ -170,7 +306,7 @@ void IndexIVF::initialize_inverted_list(const Version& version) {
         s = rocksdb::DB::Open(
                 options, path, cfs, &(this->column_families), &ptr);
     } else {
-        s = rocksdb::DB::OpenForReadOnly(
+        s = open_read_only(
                 options, path, cfs, &(this->column_families), &ptr);
     }
     if (!s.ok()) {
@@ -180,6 +316,8 @@ void IndexIVF::initialize_inverted_list(const Version& version) {
     assert(s.ok());
 
     this->db = std::shared_ptr<rocksdb::DB>(ptr);
+    tombstones->load(db.get(), column_families[kTombstoneColumnIndex]);
+
     auto index_writer =
             std::make_unique<IndexWriter>(db, column_families, version);
     this->document_processor = std::make_shared<DocumentProcessor>(
@@ -187,131 +325,155 @@ void IndexIVF::initialize_inverted_list(const Version& version) {
             this->quantizer_map,
             this->coarse_quantizer_map,
             this->field_mapper,
-            std::move(index_writer));
+            std::move(index_writer),
+            this->config.posting_format);
 
     this->index_ = std::make_shared<RocksdbForwardIndex>(
             this->db, this->column_families, version);
     this->inverted_list_ = std::make_shared<RocksdbInvertedList>(
-            this->db, this->column_families, version);
+            this->db,
+            this->column_families,
+            version,
+            this->config.posting_format);
+}
+
+void IndexIVF::initialize_segment() {
+    std::string segment_path = path + "/" + kSegmentDirectory;
+    if (!std::filesystem::is_directory(segment_path)) {
+        throw LintDBException("Segment does not exist: " + segment_path);
+    }
+    auto segment = std::make_shared<const Segment>(segment_path);
+
+    // there's no database and no document processor. Writes will throw.
+    this->index_ = std::make_shared<SegmentForwardIndex>(segment);
+    this->inverted_list_ = std::make_shared<SegmentInvertedList>(segment);
 }
 
 void IndexIVF::train(const std::vector<Document>& docs) {
     for (const auto& field : schema.fields) {
         // only train fields that are tensors and require indexing.
-        if ((field.data_type == DataType::TENSOR ||
-             field.data_type == DataType::QUANTIZED_TENSOR) &&
-            (std::find(
-                     field.field_types.begin(),
-                     field.field_types.end(),
-                     FieldType::Indexed) != field.field_types.end() ||
-             std::find(
-                     field.field_types.begin(),
-                     field.field_types.end(),
-                     FieldType::Colbert) != field.field_types.end())) {
-            LOG(INFO) << "training field: " << field.name;
-
-            LINTDB_THROW_IF_NOT(field.parameters.num_centroids != 0);
-
-            // we've already initialized untrained quantizers in the
-            // constructor.
-            std::shared_ptr<ICoarseQuantizer> cq =
-                    this->coarse_quantizer_map[field.name];
-
-            // pull out the embeddings from the documents.
-            std::vector<float> embeddings;
-            size_t num_embeddings = 0;
-            for (auto doc : docs) {
-                FieldValue* fv;
-                for (auto& doc_fields : doc.fields) {
-                    if (doc_fields.name == field.name) {
-                        fv = &doc_fields;
-                        break;
-                    }
-                }
-                if (fv == nullptr) {
-                    continue;
-                }
-
-                auto field_value = *fv;
-                LINTDB_THROW_IF_NOT(
-                        field_value.data_type == DataType::TENSOR ||
-                        field_value.data_type == DataType::QUANTIZED_TENSOR);
-                auto tensor = std::get<Tensor>(field_value.value);
+        if (is_trainable(field)) {
+            DocumentEmbeddingSource source(docs, field.name);
+            train_field(field, source, TrainingOptions());
+        }
+    }
 
-                LINTDB_THROW_IF_NOT(
-                        tensor.size() % field.parameters.dimensions == 0);
-                LINTDB_THROW_IF_NOT(tensor.size() > 0);
+    this->save();
 
-                num_embeddings += tensor.size() / field.parameters.dimensions;
-                embeddings.insert(
-                        embeddings.end(), tensor.begin(), tensor.end());
-            }
+    LOG(INFO) << "done training";
+}
 
-            cq->train(
-                    num_embeddings,
-                    embeddings.data(),
-                    field.parameters.num_centroids,
-                    field.parameters.num_iterations);
-
-            if (field.parameters.quantization != QuantizerType::NONE) {
-                // randomly sample embeddings to train the quantizer on.
-                // we'll use the coarse quantizer to assign the embeddings to
-                // centroids.
-                if (num_embeddings > 1e5) {
-                    std::vector<size_t> sampled_ids = subsample(
-                            num_embeddings, std::sqrt(num_embeddings));
-                    num_embeddings = sampled_ids.size();
-
-                    std::vector<float> sampled_embeddings(
-                            num_embeddings * field.parameters.dimensions, 0);
-                    size_t count = 0;
-                    for (const auto& idx : sampled_ids) {
-                        for (size_t i = 0; i < field.parameters.dimensions;
-                             i++) {
-                            sampled_embeddings
-                                    [count * field.parameters.dimensions +
-                                     i] = embeddings
-                                            [idx * field.parameters.dimensions +
-                                             i];
-                        }
-                        count++;
-                    }
-                    embeddings = sampled_embeddings;
-                }
+void IndexIVF::train_field(
+        const std::string& field,
+        EmbeddingSource& source,
+        const TrainingOptions& options) {
+    auto it = std::find_if(
+            schema.fields.begin(), schema.fields.end(), [&](const Field& f) {
+                return f.name == field;
+            });
+    LINTDB_THROW_IF_NOT_FMT(
+            it != schema.fields.end(),
+            "field %s is not in the schema",
+            field.c_str());
+    LINTDB_THROW_IF_NOT_FMT(
+            is_trainable(*it),
+            "field %s is not an indexed tensor field",
+            field.c_str());
+    train_field(*it, source, options);
 
-                QuantizerConfig qc = {
-                        field.parameters.nbits,
-                        field.parameters.dimensions,
-                        field.parameters.num_subquantizers};
-                std::unique_ptr<Quantizer> quantizer =
-                        create_quantizer(field.parameters.quantization, qc);
+    this->save();
+}
 
-                LOG(INFO) << "Training quantizer for field: " << field.name;
-                std::vector<idx_t> assign(num_embeddings, 0);
+void IndexIVF::train_field(
+        const Field& field,
+        EmbeddingSource& source,
+        const TrainingOptions& options) {
+    LOG(INFO) << "training field: " << field.name;
+
+    LINTDB_THROW_IF_NOT(field.parameters.num_centroids != 0);
+    LINTDB_THROW_IF_NOT(options.chunk_size > 0);
+    const size_t dim = field.parameters.dimensions;
+    LINTDB_THROW_IF_NOT_FMT(
+            source.dimensions() == 0 || source.dimensions() == dim,
+            "embeddings have %zu dimensions, but field %s has %zu",
+            source.dimensions(),
+            field.name.c_str(),
+            dim);
+
+    size_t max_embeddings = options.max_embeddings;
+    if (max_embeddings == 0) {
+        max_embeddings =
+                kTrainingEmbeddingsPerCentroid * field.parameters.num_centroids;
+    }
+    const bool train_quantizer =
+            field.parameters.quantization != QuantizerType::NONE;
+    // one sample serves both k-means and the quantizer.
+    size_t capacity = max_embeddings;
+    if (train_quantizer) {
+        capacity = std::max(capacity, options.max_quantizer_embeddings);
+    }
 
-                cq->assign(num_embeddings, embeddings.data(), assign.data());
+    ReservoirSampler sampler(dim, capacity, options.seed);
+    gsl::span<const float> chunk;
+    while (source.next(chunk)) {
+        LINTDB_THROW_IF_NOT(chunk.size() > 0);
+        sampler.add(chunk);
+    }
+    LOG(INFO) << "sampled " << sampler.size() << " of "
+              << sampler.num_seen() << " embeddings";
+
+    // we've already initialized untrained quantizers in the constructor.
+    std::shared_ptr<ICoarseQuantizer> cq =
+            this->coarse_quantizer_map[field.name];
+
+    // returns up to max embeddings of the sample. The subset is only copied
+    // when it's smaller than the sample.
+    std::vector<float> subset;
+    auto sample = [&](size_t max) -> gsl::span<const float> {
+        if (sampler.size() <= max) {
+            return sampler.embeddings();
+        }
+        subset = sampler.subsample(max);
+        return subset;
+    };
 
-                std::vector<float> residuals(
-                        num_embeddings * field.parameters.dimensions, 0);
-                cq->compute_residual_n(
-                        num_embeddings,
-                        embeddings.data(),
-                        residuals.data(),
-                        assign.data());
+    gsl::span<const float> embeddings = sample(max_embeddings);
+    cq->train(
+            embeddings.size() / dim,
+            embeddings.data(),
+            field.parameters.num_centroids,
+            field.parameters.num_iterations);
 
-                quantizer->train(
-                        num_embeddings,
-                        residuals.data(),
-                        field.parameters.dimensions);
+    if (!train_quantizer) {
+        return;
+    }
 
-                this->quantizer_map[field.name] = std::move(quantizer);
-            }
-        }
+    LOG(INFO) << "Training quantizer for field: " << field.name;
+    embeddings = sample(options.max_quantizer_embeddings);
+    const size_t num_embeddings = embeddings.size() / dim;
+
+    // residuals are computed in chunks, in parallel.
+    std::vector<float> residuals(num_embeddings * dim, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (size_t start = 0; start < num_embeddings;
+         start += options.chunk_size) {
+        const size_t n = std::min(options.chunk_size, num_embeddings - start);
+        const float* x = embeddings.data() + start * dim;
+        std::vector<idx_t> assign(n, 0);
+        cq->assign(n, x, assign.data());
+        cq->compute_residual_n(
+                n, x, residuals.data() + start * dim, assign.data());
     }
 
-    this->save();
+    QuantizerConfig qc = {
+            field.parameters.nbits,
+            field.parameters.dimensions,
+            field.parameters.num_subquantizers};
+    std::unique_ptr<Quantizer> quantizer =
+            create_quantizer(field.parameters.quantization, qc);
+    quantizer->train(num_embeddings, residuals.data(), dim);
 
-    LOG(INFO) << "done training";
+    this->quantizer_map[field.name] = std::move(quantizer);
 }
 
 void IndexIVF::save() {
@@ -351,11 +513,6 @@ void IndexIVF::save() {
     this->write_metadata();
 }
 
-void IndexIVF::flush() {
-    rocksdb::FlushOptions fo;
-    this->db->Flush(fo, column_families);
-}
-
 /**
  * Implementation note:
  *
@@ -385,7 +542,8 @@ std::vector<SearchResult> IndexIVF::search(
             this->inverted_list_,
             fm,
             coarse_quantizer_map,
-            quantizer_map);
+            quantizer_map,
+            tombstones ? tombstones->get(tenant) : nullptr);
 
     ColBERTScorer ranker(context);
     QueryExecutor executor(ranker);
@@ -404,6 +562,124 @@ std::vector<SearchResult> IndexIVF::search(
         }
     }
 
+    return build_search_results(tenant, results);
+}
+
+std::vector<std::vector<SearchResult>> IndexIVF::search_batch(
+        const uint64_t tenant,
+        const std::vector<Query>& queries,
+        const size_t k,
+        const SearchOptions& opts) const {
+    LINTDB_THROW_IF_NOT(opts.search_batch_size > 0);
+    std::vector<std::vector<SearchResult>> search_results(queries.size());
+    // every query sees the same deleted documents.
+    auto deleted = tombstones ? tombstones->get(tenant) : nullptr;
+
+    for (size_t start = 0; start < queries.size();
+         start += opts.search_batch_size) {
+        size_t end = std::min(start + opts.search_batch_size, queries.size());
+
+        // group each query's vectors by field. Like search(), a query uses
+        // the first vector it has for a field.
+        std::unordered_map<
+                std::string,
+                std::vector<std::pair<size_t, const FieldValue*>>>
+                field_vectors;
+        for (size_t i = start; i < end; i++) {
+            std::vector<const FieldValue*> values;
+            queries[i].root->collect_vectors(values);
+
+            std::unordered_set<std::string> seen_fields;
+            for (const auto* value : values) {
+                if (seen_fields.insert(value->name).second) {
+                    field_vectors[value->name].emplace_back(i, value);
+                }
+            }
+        }
+
+        std::vector<std::unordered_map<
+                std::string,
+                std::shared_ptr<KnnNearestCentroids>>>
+                nearest_centroids(end - start);
+        std::unordered_map<std::string, size_t> prefix_counts;
+        for (const auto& [field, vectors] : field_vectors) {
+            auto coarse_quantizer = coarse_quantizer_map.at(field);
+            size_t num_centroids = coarse_quantizer->num_centroids();
+
+            std::vector<std::vector<float>> tensors;
+            std::vector<size_t> num_tokens;
+            for (const auto& [query_idx, value] : vectors) {
+                gsl::span<const float> tensor = value->tensor();
+                tensors.emplace_back(tensor.begin(), tensor.end());
+                num_tokens.push_back(value->num_tensors);
+            }
+            auto knns = KnnNearestCentroids::calculate_batch(
+                    tensors,
+                    num_tokens,
+                    coarse_quantizer,
+                    centroids_to_calculate(
+                            opts,
+                            num_centroids,
+                            coarse_quantizer->default_search_k()));
+
+            uint8_t field_id = field_mapper->getFieldID(field);
+            size_t max_centroids = std::min(opts.k_top_centroids, num_centroids);
+            for (size_t j = 0; j < vectors.size(); j++) {
+                nearest_centroids[vectors[j].first - start][field] = knns[j];
+
+                auto top_centroids =
+                        knns[j]->get_top_centroids(max_centroids, opts.n_probe);
+                for (const auto& centroid : top_centroids) {
+                    prefix_counts[create_index_prefix(
+                            tenant,
+                            field_id,
+                            DataType::QUANTIZED_TENSOR,
+                            centroid.second)]++;
+                }
+            }
+        }
+
+        // posting lists probed by more than one query are read once.
+        std::vector<std::string> shared_prefixes;
+        for (const auto& [prefix, count] : prefix_counts) {
+            if (count > 1) {
+                shared_prefixes.push_back(prefix);
+            }
+        }
+        auto cached_list = std::make_shared<CachedInvertedList>(inverted_list_);
+        cached_list->prefetch(shared_prefixes);
+        VLOG(10) << "sharing " << shared_prefixes.size() << " of "
+                 << prefix_counts.size() << " posting lists";
+
+#pragma omp parallel for schedule(dynamic)
+        for (int i = start; i < end; i++) {
+            QueryContext context(
+                    tenant,
+                    opts.colbert_field,
+                    cached_list,
+                    field_mapper,
+                    coarse_quantizer_map,
+                    quantizer_map,
+                    deleted);
+            for (const auto& [field, knn] : nearest_centroids[i - start]) {
+                context.setNearestCentroids(field, knn);
+            }
+
+            ColBERTScorer ranker(context);
+            QueryExecutor executor(ranker);
+            std::vector<ScoredDocument> results =
+                    executor.execute(context, queries[i], k, opts);
+
+            search_results[i] = build_search_results(tenant, results);
+        }
+    }
+
+    return search_results;
+}
+
+std::vector<SearchResult> IndexIVF::build_search_results(
+        const uint64_t tenant,
+        const std::vector<ScoredDocument>& results) const {
     bool should_get_metadata = false;
     for (const auto& field : schema.fields) {
         if (std::find(
@@ -479,71 +755,431 @@ void IndexIVF::set_coarse_quantizer(
 }
 
 void IndexIVF::add(const uint64_t tenant, const std::vector<Document>& docs) {
-#pragma omp parallel for
+    LINTDB_THROW_IF_NOT_MSG(
+            document_processor, "can not add documents to a segment");
+    std::vector<idx_t> ids;
+    for (const auto& doc : docs) {
+        ids.push_back(doc.id);
+    }
+    revive(tenant, ids);
+
+    IngestionPipeline& pipeline = get_pipeline();
+    pipeline.submit(tenant, gsl::span<const Document>(docs));
+    pipeline.flush();
+}
+
+void IndexIVF::submit(const uint64_t tenant, std::vector<Document>&& docs) {
+    LINTDB_THROW_IF_NOT_MSG(
+            document_processor, "can not add documents to a segment");
+    std::vector<idx_t> ids;
     for (const auto& doc : docs) {
-        add_single(tenant, doc);
+        ids.push_back(doc.id);
     }
+    revive(tenant, ids);
+
+    get_pipeline().submit(tenant, std::move(docs));
+}
+
+void IndexIVF::flush() {
+    if (!db) {
+        return;
+    }
+    IngestionPipeline* started;
+    {
+        std::lock_guard<std::mutex> lock(pipeline_mutex);
+        started = pipeline.get();
+    }
+    if (started) {
+        started->flush();
+    }
+    rocksdb::FlushOptions fo;
+    this->db->Flush(fo, column_families);
+}
+
+void IndexIVF::compact() {
+    LINTDB_THROW_IF_NOT_MSG(
+            db, "Segments are read only. Can not compact documents.");
+    // the filters only drop what was deleted before compaction started.
+    auto deleted = tombstones->get_all();
+    flush();
+
+    rocksdb::CompactRangeOptions options;
+    // the bottommost level is rewritten too, so no deleted key survives.
+    options.bottommost_level_compaction =
+            rocksdb::BottommostLevelCompaction::kForce;
+    for (size_t i = 1; i < column_families.size(); i++) {
+        if (i == kTombstoneColumnIndex) {
+            continue;
+        }
+        auto status =
+                db->CompactRange(options, column_families[i], nullptr, nullptr);
+        LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+    }
+
+    for (const auto& [tenant, docs] : deleted) {
+        tombstones->erase(
+                db.get(),
+                column_families[kTombstoneColumnIndex],
+                tenant,
+                docs->doc_ids());
+    }
+}
+
+IngestionPipeline& IndexIVF::get_pipeline() {
+    std::lock_guard<std::mutex> lock(pipeline_mutex);
+    if (!pipeline) {
+        pipeline = std::make_unique<IngestionPipeline>(
+                *document_processor, ingestion_options);
+    }
+    return *pipeline;
+}
+
+void IndexIVF::add_bulk(
+        const uint64_t tenant,
+        const std::vector<Document>& docs) {
+    LINTDB_THROW_IF_NOT_MSG(
+            document_processor, "can not add documents to a segment");
+    std::vector<idx_t> ids;
+    for (const auto& doc : docs) {
+        ids.push_back(doc.id);
+    }
+    revive(tenant, ids);
+
+    auto writer = std::make_unique<BulkIndexWriter>(
+            db, column_families, path + "/" + kBulkDirectory);
+    // the processor owns the writer, and outlives our use of it.
+    BulkIndexWriter* bulk_writer = writer.get();
+    DocumentProcessor processor(
+            this->schema,
+            this->quantizer_map,
+            this->coarse_quantizer_map,
+            this->field_mapper,
+            std::move(writer),
+            this->config.posting_format);
+
+    {
+        IngestionPipeline pipeline(processor, ingestion_options);
+        pipeline.submit(tenant, gsl::span<const Document>(docs));
+        pipeline.flush();
+    }
+    bulk_writer->finish();
 }
 
 void IndexIVF::add_single(const uint64_t tenant, const Document& doc) {
+    LINTDB_THROW_IF_NOT_MSG(
+            document_processor, "can not add documents to a segment");
+    revive(tenant, {doc.id});
     this->document_processor->processDocument(tenant, doc);
 }
 
 void IndexIVF::remove(const uint64_t tenant, const std::vector<idx_t>& ids) {
+    LINTDB_THROW_IF_NOT_MSG(
+            db, "Segments are read only. Can not remove documents.");
+    tombstones->add(
+            db.get(), column_families[kTombstoneColumnIndex], tenant, ids);
+}
+
+void IndexIVF::purge(const uint64_t tenant, const std::vector<idx_t>& ids) {
     for (const auto& field : schema.fields) {
         uint8_t field_id = field_mapper->getFieldID(field.name);
         inverted_list_->remove(
                 tenant, ids, field_id, field.data_type, field.field_types);
-        index_->remove(tenant, ids);
     }
+    // the forward index removes the mappings, so it goes after every field
+    // has read them.
+    index_->remove(tenant, ids);
+}
+
+void IndexIVF::revive(const uint64_t tenant, const std::vector<idx_t>& ids) {
+    std::vector<idx_t> deleted = tombstones->find(tenant, ids);
+    if (deleted.empty()) {
+        return;
+    }
+    // the old data goes first, so it can't mix with the new document's.
+    purge(tenant, deleted);
+    tombstones->erase(
+            db.get(), column_families[kTombstoneColumnIndex], tenant, deleted);
+}
+
+void IndexIVF::upgrade_postings() {
+    LINTDB_THROW_IF_NOT_MSG(
+            db, "Segments are read only. Can not upgrade postings.");
+    flush();
+
+    std::unordered_map<uint8_t, const Field*> fields;
+    for (const auto& field : schema.fields) {
+        const bool indexed =
+                std::find(
+                        field.field_types.begin(),
+                        field.field_types.end(),
+                        FieldType::Indexed) != field.field_types.end();
+        if (indexed && is_trainable(field)) {
+            fields[field_mapper->getFieldID(field.name)] = &field;
+        }
+    }
+    if (fields.empty()) {
+        return;
+    }
+
+    // the centroids of each document's old postings, keyed by tenant, field,
+    // and doc id.
+    std::map<std::tuple<uint64_t, uint8_t, idx_t>, std::vector<idx_t>> docs;
+    rocksdb::ReadOptions ro;
+    auto cf = column_families[kIndexColumnIndex];
+    std::unique_ptr<rocksdb::Iterator> it(db->NewIterator(ro, cf));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        std::string key = it->key().ToString();
+        const size_t type_offset = sizeof(uint64_t) + sizeof(uint8_t);
+        if (key.size() <= type_offset ||
+            DataType(uint8_t(key[type_offset])) !=
+                    DataType::QUANTIZED_TENSOR ||
+            fields.count(uint8_t(key[sizeof(uint64_t)])) == 0) {
+            continue;
+        }
+        std::string value = it->value().ToString();
+        if (value.empty()) {
+            continue;
+        }
+        // token payloads always have token ids. old postings have none.
+        std::vector<idx_t> token_ids;
+        DocEncoder::decode_inverted_data(value, &token_ids);
+        if (!token_ids.empty()) {
+            continue;
+        }
+        InvertedIndexKey parsed(key);
+        docs[{parsed.tenant(), parsed.field(), parsed.doc_id()}].push_back(
+                std::get<idx_t>(parsed.field_value()));
+    }
+    LINTDB_THROW_IF_NOT_FMT(
+            it->status().ok(), "%s", it->status().ToString().c_str());
+    it.reset();
+
+    rocksdb::WriteBatch batch;
+    auto write = [&]() {
+        rocksdb::WriteOptions wo;
+        auto status = db->Write(wo, &batch);
+        LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+        batch.Clear();
+    };
+    for (const auto& [doc, centroids] : docs) {
+        const auto& [tenant, field_id, doc_id] = doc;
+        const Field& field = *fields.at(field_id);
+        auto& quantizer = quantizer_map.at(field.name);
+        auto& coarse_quantizer = coarse_quantizer_map.at(field.name);
+        const size_t dim = field.parameters.dimensions;
+        const size_t code_size = quantizer->code_size();
+
+        // every old posting holds the same codes, so one is enough.
+        std::string value;
+        auto status = db->Get(
+                ro,
+                cf,
+                create_index_id(
+                        tenant,
+                        field_id,
+                        DataType::QUANTIZED_TENSOR,
+                        centroids.front(),
+                        doc_id),
+                &value);
+        LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+        auto codes = std::get<QuantizedTensor>(
+                DocEncoder::decode_inverted_data(value));
+        const size_t num_tokens = codes.size() / code_size;
+        std::vector<float> tokens(num_tokens * dim);
+        quantizer->sa_decode(num_tokens, codes.data(), tokens.data());
+
+        std::vector<float> centroid_embeddings(centroids.size() * dim);
+        for (size_t i = 0; i < centroids.size(); i++) {
+            coarse_quantizer->reconstruct(
+                    centroids[i], centroid_embeddings.data() + i * dim);
+        }
+
+        ProcessedData data;
+        data.tenant = tenant;
+        data.field = field_id;
+        data.doc_id = doc_id;
+        data.centroid_ids.resize(num_tokens);
+        for (size_t t = 0; t < num_tokens; t++) {
+            // coarse quantizers score centroids by inner product.
+            float best = std::numeric_limits<float>::lowest();
+            for (size_t i = 0; i < centroids.size(); i++) {
+                const float score = std::inner_product(
+                        tokens.begin() + t * dim,
+                        tokens.begin() + (t + 1) * dim,
+                        centroid_embeddings.begin() + i * dim,
+                        0.0f);
+                if (score > best) {
+                    best = score;
+                    data.centroid_ids[t] = centroids[i];
+                }
+            }
+        }
+        data.value = FieldValue(field.name, std::move(codes), num_tokens);
+
+        for (const auto& posting :
+             DocEncoder::encode_inverted_data(data, code_size)) {
+            batch.Put(cf, posting.key, posting.value);
+        }
+        // centroids that kept none of the document's tokens lose their
+        // posting.
+        for (const auto centroid : centroids) {
+            if (std::find(
+                        data.centroid_ids.begin(),
+                        data.centroid_ids.end(),
+                        centroid) == data.centroid_ids.end()) {
+                batch.Delete(
+                        cf,
+                        create_index_id(
+                                tenant,
+                                field_id,
+                                DataType::QUANTIZED_TENSOR,
+                                centroid,
+                                doc_id));
+            }
+        }
+        if (size_t(batch.Count()) >= kUpgradeBatchSize) {
+            write();
+        }
+    }
+    write();
+}
+
+void IndexIVF::drop_tenant(const uint64_t tenant) {
+    LINTDB_THROW_IF_NOT_MSG(
+            db, "Segments are read only. Can not drop tenants.");
+    LINTDB_THROW_IF_NOT_MSG(
+            tenant < std::numeric_limits<uint64_t>::max(),
+            "the last tenant id can not be dropped");
+
+    // every key starts with the tenant, so the tenant is one key range.
+    KeyBuilder begin_kb;
+    std::string begin = begin_kb.add(tenant).build();
+    KeyBuilder end_kb;
+    std::string end = end_kb.add(tenant + 1).build();
+
+    rocksdb::WriteBatch batch;
+    for (size_t i = 1; i < column_families.size(); i++) {
+        // ignore the default cf at position 0 since we don't use it.
+        auto status = batch.DeleteRange(
+                column_families[i],
+                rocksdb::Slice(begin),
+                rocksdb::Slice(end));
+        LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+    }
+    rocksdb::WriteOptions wo;
+    auto status = db->Write(wo, &batch);
+    LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+    tombstones->drop_tenant(tenant);
 }
 
 void IndexIVF::update(
         const uint64_t tenant,
         const std::vector<Document>& docs) {
     std::vector<idx_t> ids;
-    for (auto doc : docs) {
+    for (const auto& doc : docs) {
         ids.push_back(doc.id);
     }
-    remove(tenant, ids);
+    LINTDB_THROW_IF_NOT_MSG(
+            db, "Segments are read only. Can not update documents.");
+    // the old versions are replaced right away, so they don't need
+    // tombstones.
+    purge(tenant, ids);
+    tombstones->erase(
+            db.get(), column_families[kTombstoneColumnIndex], tenant, ids);
     add(tenant, docs);
 }
 
 void IndexIVF::merge(const std::string& path) {
-    Configuration incoming_config = read_metadata(path);
-
-    LINTDB_THROW_IF_NOT(this->config == incoming_config);
-
-    rocksdb::Options options;
-    options.create_if_missing = false;
-    options.create_missing_column_families = true;
+    merge(std::vector<std::string>{path});
+}
 
-    auto cfs = create_column_families();
-    std::vector<rocksdb::ColumnFamilyHandle*> other_cfs;
+void IndexIVF::merge(const std::vector<std::string>& paths) {
+    LINTDB_THROW_IF_NOT_MSG(db, "can not merge into a segment");
 
-    rocksdb::DB* ptr;
-    rocksdb::Status s =
-            rocksdb::DB::OpenForReadOnly(options, path, cfs, &other_cfs, &ptr);
-    assert(s.ok());
+    struct Source {
+        std::unique_ptr<rocksdb::DB> db;
+        std::vector<rocksdb::ColumnFamilyHandle*> cfs;
+    };
+    std::vector<Source> sources;
+    for (const auto& other_path : paths) {
+        Configuration incoming_config = read_metadata(other_path);
+        LINTDB_THROW_IF_NOT_MSG(
+                this->config == incoming_config,
+                "only indexes with the same version and posting format can "
+                "be merged");
+
+        rocksdb::Options options;
+        options.create_if_missing = false;
+        options.create_missing_column_families = true;
+
+        auto cfs = create_column_families();
+        Source source;
+        rocksdb::DB* ptr;
+        rocksdb::Status s =
+                open_read_only(options, other_path, cfs, &source.cfs, &ptr);
+        if (!s.ok()) {
+            LOG(ERROR) << s.ToString();
+            throw LintDBException(
+                    "Could not open database at path: " + other_path);
+        }
+        source.db = std::unique_ptr<rocksdb::DB>(ptr);
+        sources.push_back(std::move(source));
+    }
 
-    inverted_list_->merge(ptr, other_cfs);
-    index_->merge(ptr, other_cfs);
+    // a document's keys can't be combined safely across indexes: values
+    // would be taken from one index and postings from both, and a tombstone
+    // in one index would hide the document of another. Each document must
+    // be in only one of the indexes.
+    std::vector<std::pair<
+            rocksdb::DB*,
+            const std::vector<rocksdb::ColumnFamilyHandle*>*>>
+            indexes = {{db.get(), &column_families}};
+    for (auto& source : sources) {
+        indexes.emplace_back(source.db.get(), &source.cfs);
+    }
+    check_disjoint_documents(indexes);
+
+    {
+        // every index is written into one set of SST files, so keys of
+        // different documents that share a posting list are combined before
+        // they're ingested.
+        BulkIndexWriter writer(
+                db, column_families, path + "/" + kBulkDirectory);
+        for (auto& source : sources) {
+            inverted_list_->merge(source.db.get(), source.cfs, writer);
+            index_->merge(source.db.get(), source.cfs, writer);
+        }
+        writer.finish();
+    }
+    // the other indices' tombstones were merged too.
+    tombstones->load(db.get(), column_families[kTombstoneColumnIndex]);
 
-    for (auto cf : other_cfs) {
-        db->DestroyColumnFamilyHandle(cf);
+    for (auto& source : sources) {
+        destroy_column_families(source.db.get(), source.cfs);
     }
 }
 
 void IndexIVF::close() {
-    for (auto& cf : column_families) {
-        db->DestroyColumnFamilyHandle(cf);
+    if (!db) {
+        return;
     }
+    pipeline.reset();
+    destroy_column_families(db.get(), column_families);
     auto status = db->Close();
     assert(status.ok());
 
     column_families.clear();
 }
 
+void IndexIVF::export_segment() {
+    LINTDB_THROW_IF_NOT_MSG(db, "the index is already a segment");
+    write_segment(
+            db.get(),
+            column_families,
+            path + "/" + kSegmentDirectory,
+            tombstones.get());
+}
+
 void IndexIVF::write_metadata() {
     std::string out_path = path + "/" + METADATA_FILENAME;
     std::ofstream out(out_path);
@@ -551,6 +1187,8 @@ void IndexIVF::write_metadata() {
     Json::Value metadata;
 
     metadata["lintdb_version"] = Json::String(LINTDB_VERSION_STRING);
+    metadata["posting_format"] =
+            Json::Int(static_cast<int>(this->config.posting_format));
 
     Json::StyledWriter writer;
     out << writer.write(metadata);
@@ -558,7 +1196,6 @@ void IndexIVF::write_metadata() {
 }
 
 Configuration IndexIVF::read_metadata(const std::string& p) {
-    this->path = p;
     std::string in_path = p + "/" + METADATA_FILENAME;
     std::ifstream in(in_path);
     if (!in) {
@@ -573,6 +1210,10 @@ Configuration IndexIVF::read_metadata(const std::string& p) {
 
     std::string version = metadata.get("lintdb_version", "0.0.0").asString();
     config.lintdb_version = Version(version);
+    // indexes written before block posting lists only have per-document keys.
+    Json::Value posting_format = metadata.get(
+            "posting_format", static_cast<int>(PostingFormat::KEYS));
+    config.posting_format = static_cast<PostingFormat>(posting_format.asInt());
 
     return config;
 }
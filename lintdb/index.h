@@ -3,6 +3,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -12,12 +13,16 @@
 #include "lintdb/exception.h"
 #include "lintdb/invlists/IndexWriter.h"
 #include "lintdb/invlists/InvertedList.h"
+#include "lintdb/invlists/PostingBlocks.h"
 #include "lintdb/quantizers/CoarseQuantizer.h"
+#include "lintdb/quantizers/EmbeddingSource.h"
 #include "lintdb/query/Query.h"
 #include "lintdb/schema/DocProcessor.h"
 #include "lintdb/schema/Document.h"
 #include "lintdb/schema/FieldMapper.h"
+#include "lintdb/schema/IngestionPipeline.h"
 #include "lintdb/schema/Schema.h"
+#include "lintdb/scoring/ScoredDocument.h"
 #include "lintdb/SearchOptions.h"
 #include "lintdb/SearchResult.h"
 #include "lintdb/version.h"
@@ -30,6 +35,7 @@ class ColumnFamilyHandle;
 } // namespace rocksdb
 
 namespace lintdb {
+class Tombstones;
 
 static const std::string METADATA_FILENAME = "_lintdb_metadata.json";
 
@@ -41,14 +47,28 @@ struct Configuration {
     Version lintdb_version =
             LINTDB_VERSION; /// the current version of the index. Used
                             /// internally for feature compatibility.
+    PostingFormat posting_format =
+            PostingFormat::BLOCKS; /// how ColBERT posting lists are stored.
+                                   /// Indexes without a stored format use
+                                   /// KEYS.
 
     inline bool operator==(const Configuration& other) const {
-        return lintdb_version == other.lintdb_version;
+        return lintdb_version == other.lintdb_version &&
+                posting_format == other.posting_format;
     }
 
     Configuration() = default;
 };
 
+struct TrainingOptions {
+    size_t max_embeddings =
+            0; /// embeddings sampled for k-means. 0 samples 256 per centroid.
+    size_t max_quantizer_embeddings =
+            100000; /// embeddings the residual quantizer is trained on.
+    size_t chunk_size = 8192; /// embeddings per parallel residual chunk.
+    unsigned int seed = 1234; /// seeds the samples.
+};
+
 /**
  * IndexIVF is a multi vector index with an inverted file structure.
  *
@@ -60,11 +80,22 @@ struct Configuration {
 struct IndexIVF {
     Configuration config;
     bool read_only; /// whether to open the index in read-only mode.
+    IngestionOptions ingestion_options; /// the threads and queues `add`
+                                        /// encodes with. Read when the
+                                        /// first document is added.
 
     friend struct Collection; // our Collection wants access to the index.
 
-    /// load an existing index.
-    IndexIVF(const std::string& path, bool read_only = false);
+    /**
+     * load an existing index.
+     *
+     * @param use_segment serve the index from the segment written by
+     * `export_segment` instead of RocksDB. Requires read_only.
+     */
+    IndexIVF(
+            const std::string& path,
+            bool read_only = false,
+            bool use_segment = false);
 
     IndexIVF(
             const std::string& path,
@@ -89,6 +120,20 @@ struct IndexIVF {
      */
     void train(const std::vector<Document>& docs);
 
+    /**
+     * train_field trains one field from a stream of embeddings, e.g. a .npy
+     * file with `NpyEmbeddingSource`.
+     *
+     * The source is read once. A fixed size sample is kept with reservoir
+     * sampling, so memory doesn't depend on the size of the corpus. k-means
+     * runs on the sample, and the residual quantizer is trained on a subset
+     * of it.
+     */
+    void train_field(
+            const std::string& field,
+            EmbeddingSource& source,
+            const TrainingOptions& options = TrainingOptions());
+
     void set_quantizer(
             const std::string& field,
             std::shared_ptr<Quantizer> quantizer);
@@ -111,15 +156,59 @@ struct IndexIVF {
             const size_t k,
             const SearchOptions& opts = SearchOptions()) const;
 
+    /**
+     * search_batch finds the nearest neighbors for many queries at once.
+     *
+     * Centroid scores are computed for a batch of queries with one search of
+     * the coarse quantizer, posting lists probed by more than one query are
+     * read once, and queries are executed in parallel.
+     *
+     * @param tenant the tenant the documents belong to.
+     * @param queries the queries to search.
+     * @param k the top k results to return per query.
+     * @param opts any search options to use during searching.
+     * @return results for each query, in the same order as queries.
+     */
+    std::vector<std::vector<SearchResult>> search_batch(
+            const uint64_t tenant,
+            const std::vector<Query>& queries,
+            const size_t k,
+            const SearchOptions& opts = SearchOptions()) const;
+
     /**
      * Add will add a block of embeddings to the index.
      *
+     * Documents are encoded and written by the index's `IngestionPipeline`,
+     * which is started on the first add and shared by later ones. add
+     * submits the documents and waits for them with `flush`.
+     *
      * @param tenant the tenant to assign the document to.
      * @param docs a vector of EmbeddingPassages. This includes embeddings and
      * ids.
      */
     void add(const uint64_t tenant, const std::vector<Document>& docs);
 
+    /**
+     * submit queues documents to be added, and returns without waiting for
+     * them to be written. Errors are thrown by the next `flush` or `add`.
+     */
+    void submit(const uint64_t tenant, std::vector<Document>&& docs);
+
+    /**
+     * flush waits for every document that was added or submitted before the
+     * call to be written, then flushes the database to disk.
+     */
+    void flush();
+
+    /**
+     * add_bulk loads documents with SST ingestion instead of write batches.
+     *
+     * Documents are encoded and sorted on disk, and become visible together
+     * when the call returns. This is much faster for initial builds, but
+     * needs temporary disk space about the size of the encoded documents.
+     */
+    void add_bulk(const uint64_t tenant, const std::vector<Document>& docs);
+
     /**
      * Add a single document.
      */
@@ -128,11 +217,46 @@ struct IndexIVF {
     /**
      * Remove deletes documents from the index by id.
      *
+     * Deletes are logical: each document gets a tombstone, searches skip it,
+     * and compaction drops its data later. Adding a document with the same id
+     * brings it back. `compact` clears the tombstones of purged documents.
+     *
      * void remove(const std::vector<int64_t>& ids) works if SWIG complains
      * about idx_t.
      */
     void remove(const uint64_t tenant, const std::vector<idx_t>& ids);
 
+    /**
+     * compact drops the data of removed documents, then clears their
+     * tombstones.
+     *
+     * Every column family is compacted down to the bottommost level, so
+     * this rewrites the whole index. Documents removed while it runs keep
+     * their tombstones. It shouldn't run concurrently with adds or removes
+     * of the documents that are being compacted.
+     */
+    void compact();
+
+    /**
+     * upgrade_postings rewrites the postings of indexed tensor fields that
+     * were written before postings held only their centroid's tokens.
+     *
+     * Old postings hold every code of the document and don't record which
+     * tokens belong to their centroid. Each token is decoded and assigned to
+     * the nearest centroid the document has a posting for. Quantization
+     * error can move a token that sat near the boundary of two centroids.
+     * Like compact, it shouldn't run concurrently with writes.
+     */
+    void upgrade_postings();
+
+    /**
+     * drop_tenant deletes every document of a tenant.
+     *
+     * Each column family gets one range deletion, so the cost doesn't depend
+     * on the number of documents. Disk space is reclaimed by compaction.
+     */
+    void drop_tenant(const uint64_t tenant);
+
     /**
      * Update is a convenience function for remove and add.
      */
@@ -149,6 +273,18 @@ struct IndexIVF {
      */
     void merge(const std::string& path);
 
+    /**
+     * Merge many indices in one pass.
+     *
+     * Every index is copied into one set of SST files, which are ingested
+     * together when all of them have been read.
+     *
+     * A document, or its tombstone, can only be in one of the indexes.
+     * Merging throws before anything is written if a tenant's doc id is in
+     * more than one.
+     */
+    void merge(const std::vector<std::string>& paths);
+
     /**
      * Index should be able to resume from a previous state.
      * Any quantization and compression will be saved within the Index's path.
@@ -159,9 +295,21 @@ struct IndexIVF {
 
     void close();
 
+    /**
+     * export_segment writes the index to an immutable, memory mapped segment
+     * in the index's directory. Reopen the index with use_segment to search
+     * it. Documents added after the export aren't in the segment until it's
+     * exported again.
+     */
+    void export_segment();
+
     ~IndexIVF() {
+        // pending documents are written before the column families close.
+        pipeline.reset();
         for (auto& cf : column_families) {
-            if (cf) {
+            // missing column families of old indexes share the default
+            // handle, which the DB owns.
+            if (cf && cf != db->DefaultColumnFamily()) {
                 auto status = db->DestroyColumnFamilyHandle(cf);
                 assert(status.ok());
             }
@@ -180,27 +328,46 @@ struct IndexIVF {
     std::unordered_map<std::string, std::shared_ptr<Quantizer>> quantizer_map;
 
     std::shared_ptr<DocumentProcessor> document_processor;
+    // encodes and writes added documents. Started by the first add.
+    std::unique_ptr<IngestionPipeline> pipeline;
+    std::mutex pipeline_mutex;
     // Note: invertedList and ForwardIndex are becoming read-only classes for
     // retrieval. writing is done through the index writer. Merging/Removing
     // will likely move to the writer as well.
     std::shared_ptr<InvertedList> inverted_list_;
     std::shared_ptr<ForwardIndex> index_;
+    // deleted documents. Null for segments.
+    std::shared_ptr<Tombstones> tombstones;
+
+    // returns the pipeline, starting it if this is the first add.
+    IngestionPipeline& get_pipeline();
+
+    // helper to look up stored fields and build the results of a search.
+    std::vector<SearchResult> build_search_results(
+            const uint64_t tenant,
+            const std::vector<ScoredDocument>& results) const;
+
+    // helper to train a field without saving the index.
+    void train_field(
+            const Field& field,
+            EmbeddingSource& source,
+            const TrainingOptions& options);
+
+    // helper to delete the data of documents right away.
+    void purge(const uint64_t tenant, const std::vector<idx_t>& ids);
+    // helper to clear the tombstones of documents that are added again.
+    void revive(const uint64_t tenant, const std::vector<idx_t>& ids);
 
     // helper to initialize the inverted list.
     void initialize_inverted_list(const Version& version);
+    // helper to serve the inverted list from an exported segment.
+    void initialize_segment();
     // helper to initialize the encoder, quantizer, and retrievers. These are
     // all inter-related.
     void initialize_retrieval();
     // instead of initializing, load from disk.
     void load_retrieval(const std::string& path, const Configuration& config);
 
-    /**
-     * Flush data to disk.
-     *
-     * Note: currently not used. We may want to expose this in the future.
-     */
-    void flush();
-
     /**
      * Write_metadata (and read) are helper methods to persist metadata
      * attributes.
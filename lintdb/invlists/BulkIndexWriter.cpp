@@ -0,0 +1,405 @@
+#include "lintdb/invlists/BulkIndexWriter.h"
+#include <glog/logging.h>
+#include <rocksdb/merge_operator.h>
+#include <rocksdb/sst_file_writer.h>
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <queue>
+#include "lintdb/assert.h"
+
+namespace lintdb {
+namespace {
+void write_string(std::ofstream& out, const std::string& data) {
+    uint32_t size = data.size();
+    out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    out.write(data.data(), data.size());
+}
+
+bool read_string(std::ifstream& in, std::string& data) {
+    uint32_t size;
+    if (!in.read(reinterpret_cast<char*>(&size), sizeof(size))) {
+        return false;
+    }
+    data.resize(size);
+    return bool(in.read(&data[0], size));
+}
+
+/// SortedRun yields the unique, sorted keys of one spilled or in-memory run.
+class SortedRun {
+   public:
+    virtual bool is_valid() const = 0;
+    virtual const std::string& key() const = 0;
+    virtual const std::string& value() const = 0;
+    virtual void next() = 0;
+
+    virtual ~SortedRun() = default;
+};
+
+class FileRun : public SortedRun {
+   public:
+    explicit FileRun(const std::string& path) : in(path, std::ios::binary) {
+        LINTDB_THROW_IF_NOT_MSG(in.is_open(), "could not read bulk run");
+        next();
+    }
+
+    bool is_valid() const override {
+        return valid;
+    }
+    const std::string& key() const override {
+        return key_;
+    }
+    const std::string& value() const override {
+        return value_;
+    }
+    void next() override {
+        valid = read_string(in, key_) && read_string(in, value_);
+    }
+
+   private:
+    std::ifstream in;
+    std::string key_;
+    std::string value_;
+    bool valid = false;
+};
+
+class IteratorRun : public SortedRun {
+   public:
+    explicit IteratorRun(rocksdb::Iterator* it) : it(it) {
+        it->SeekToFirst();
+        load();
+    }
+
+    bool is_valid() const override {
+        return it->Valid();
+    }
+    const std::string& key() const override {
+        return key_;
+    }
+    const std::string& value() const override {
+        return value_;
+    }
+    void next() override {
+        it->Next();
+        load();
+    }
+
+   private:
+    void load() {
+        if (it->Valid()) {
+            key_.assign(it->key().data(), it->key().size());
+            value_.assign(it->value().data(), it->value().size());
+        }
+    }
+
+    rocksdb::Iterator* it;
+    std::string key_;
+    std::string value_;
+};
+
+class MemoryRun : public SortedRun {
+   public:
+    explicit MemoryRun(std::vector<PostingData>&& data)
+            : data(std::move(data)) {}
+
+    bool is_valid() const override {
+        return pos < data.size();
+    }
+    const std::string& key() const override {
+        return data[pos].key;
+    }
+    const std::string& value() const override {
+        return data[pos].value;
+    }
+    void next() override {
+        pos++;
+    }
+
+   private:
+    std::vector<PostingData> data;
+    size_t pos = 0;
+};
+} // namespace
+
+BulkIndexWriter::BulkIndexWriter(
+        std::shared_ptr<rocksdb::DB> db,
+        std::vector<rocksdb::ColumnFamilyHandle*>& column_families,
+        const std::string& dir,
+        size_t buffer_size)
+        : db(db),
+          column_families(column_families),
+          dir(dir),
+          buffer_size(buffer_size),
+          buffers(column_families.size()) {
+    for (auto cf : column_families) {
+        merge_operators.push_back(db->GetOptions(cf).merge_operator);
+    }
+    std::filesystem::create_directories(dir);
+}
+
+BulkIndexWriter::~BulkIndexWriter() {
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+}
+
+void BulkIndexWriter::write(const BatchPostingData& batch_posting_data) {
+    FullBuffers full;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto add_all = [&](column_index_t column_index,
+                           const std::vector<PostingData>& postings) {
+            for (const auto& posting : postings) {
+                add(column_index, posting);
+            }
+        };
+        add_all(kIndexColumnIndex, batch_posting_data.inverted);
+        add_all(kPostingsColumnIndex, batch_posting_data.posting_blocks);
+        add_all(kMappingColumnIndex, batch_posting_data.inverted_mapping);
+        add_all(kDocColumnIndex, batch_posting_data.forward);
+        add_all(kCodesColumnIndex, batch_posting_data.context);
+        add_all(kResidualsColumnIndex, batch_posting_data.residuals);
+        take_full(full);
+    }
+
+    // full buffers are spilled without the lock.
+    for (auto& [column_index, data] : full) {
+        spill(column_index, data);
+    }
+}
+
+void BulkIndexWriter::put(
+        column_index_t column_index,
+        const std::string& key,
+        const std::string& value) {
+    FullBuffers full;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        add(column_index, PostingData{key, value});
+        take_full(full);
+    }
+    for (auto& [full_index, data] : full) {
+        spill(full_index, data);
+    }
+}
+
+void BulkIndexWriter::add_sorted(
+        column_index_t column_index,
+        std::unique_ptr<rocksdb::Iterator> it) {
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers[column_index].sources.push_back(std::move(it));
+}
+
+void BulkIndexWriter::take_full(FullBuffers& full) {
+    for (column_index_t i = 0; i < buffers.size(); i++) {
+        if (buffers[i].size >= buffer_size) {
+            full.emplace_back(i, std::move(buffers[i].data));
+            buffers[i].data.clear();
+            buffers[i].size = 0;
+        }
+    }
+}
+
+void BulkIndexWriter::add(
+        column_index_t column_index,
+        const PostingData& posting) {
+    auto& buffer = buffers[column_index];
+    buffer.data.push_back(posting);
+    buffer.size += posting.key.size() + posting.value.size();
+}
+
+std::string BulkIndexWriter::combine(
+        column_index_t column_index,
+        const std::string& key,
+        const std::vector<std::string>& values) const {
+    if (values.size() == 1) {
+        return values[0];
+    }
+    const auto& merge_operator = merge_operators[column_index];
+    if (!merge_operator) {
+        return values.back();
+    }
+
+    std::deque<rocksdb::Slice> operands(values.begin(), values.end());
+    std::string combined;
+    bool ok = merge_operator->PartialMergeMulti(
+            rocksdb::Slice(key), operands, &combined, nullptr);
+    LINTDB_THROW_IF_NOT_MSG(ok, "bulk writes could not combine merge operands");
+    return combined;
+}
+
+std::vector<PostingData> BulkIndexWriter::sort_and_combine(
+        column_index_t column_index,
+        std::vector<PostingData>& data) const {
+    // a stable sort keeps equal keys in the order they were written.
+    std::stable_sort(
+            data.begin(),
+            data.end(),
+            [](const PostingData& a, const PostingData& b) {
+                return a.key < b.key;
+            });
+
+    std::vector<PostingData> unique;
+    std::vector<std::string> values;
+    for (size_t i = 0; i < data.size();) {
+        size_t j = i;
+        values.clear();
+        for (; j < data.size() && data[j].key == data[i].key; j++) {
+            values.push_back(std::move(data[j].value));
+        }
+        std::string value = combine(column_index, data[i].key, values);
+        unique.push_back(PostingData{std::move(data[i].key), std::move(value)});
+        i = j;
+    }
+    data.clear();
+    return unique;
+}
+
+std::string BulkIndexWriter::next_path(const std::string& extension) {
+    return dir + "/" + std::to_string(num_files++) + extension;
+}
+
+void BulkIndexWriter::spill(
+        column_index_t column_index,
+        std::vector<PostingData>& data) {
+    std::string path = next_path(".run");
+    std::ofstream out(path, std::ios::binary);
+    LINTDB_THROW_IF_NOT_MSG(out.is_open(), "could not write bulk run");
+
+    for (const auto& posting : sort_and_combine(column_index, data)) {
+        write_string(out, posting.key);
+        write_string(out, posting.value);
+    }
+    LINTDB_THROW_IF_NOT_MSG(out.good(), "could not write bulk run");
+
+    std::lock_guard<std::mutex> lock(mutex);
+    buffers[column_index].runs.push_back(path);
+}
+
+std::vector<std::string> BulkIndexWriter::write_sst_files(
+        column_index_t column_index) {
+    auto& buffer = buffers[column_index];
+    std::vector<std::unique_ptr<SortedRun>> runs;
+    for (const auto& it : buffer.sources) {
+        runs.push_back(std::make_unique<IteratorRun>(it.get()));
+    }
+    for (const auto& path : buffer.runs) {
+        runs.push_back(std::make_unique<FileRun>(path));
+    }
+    // whatever is still buffered is sorted in memory. It was written last,
+    // so it's the last run.
+    if (!buffer.data.empty()) {
+        runs.push_back(std::make_unique<MemoryRun>(
+                sort_and_combine(column_index, buffer.data)));
+    }
+
+    auto cf = column_families[column_index];
+    rocksdb::Options options = db->GetOptions(cf);
+    const bool is_merge = merge_operators[column_index] != nullptr;
+
+    std::vector<std::string> files;
+    std::unique_ptr<rocksdb::SstFileWriter> writer;
+    auto finish_file = [&]() {
+        if (writer) {
+            auto status = writer->Finish();
+            LINTDB_THROW_IF_NOT_FMT(
+                    status.ok(), "%s", status.ToString().c_str());
+            writer.reset();
+        }
+    };
+
+    // a k-way merge of the runs. Ties pop in run order, which is the order
+    // the values were written.
+    using Entry = std::pair<std::string, size_t>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<>> heap;
+    for (size_t i = 0; i < runs.size(); i++) {
+        if (runs[i]->is_valid()) {
+            heap.emplace(runs[i]->key(), i);
+        }
+    }
+
+    std::vector<std::string> values;
+    while (!heap.empty()) {
+        std::string key = heap.top().first;
+        values.clear();
+        while (!heap.empty() && heap.top().first == key) {
+            size_t i = heap.top().second;
+            heap.pop();
+            values.push_back(runs[i]->value());
+            runs[i]->next();
+            if (runs[i]->is_valid()) {
+                heap.emplace(runs[i]->key(), i);
+            }
+        }
+        std::string value = combine(column_index, key, values);
+
+        if (writer && writer->FileSize() >= kBulkSstFileSize) {
+            finish_file();
+        }
+        if (!writer) {
+            files.push_back(next_path(".sst"));
+            writer = std::make_unique<rocksdb::SstFileWriter>(
+                    rocksdb::EnvOptions(), options, cf);
+            auto status = writer->Open(files.back());
+            LINTDB_THROW_IF_NOT_FMT(
+                    status.ok(), "%s", status.ToString().c_str());
+        }
+
+        // merge operands stay operands, so they apply on top of any value
+        // that's already in the database.
+        auto status = is_merge
+                ? writer->Merge(rocksdb::Slice(key), rocksdb::Slice(value))
+                : writer->Put(rocksdb::Slice(key), rocksdb::Slice(value));
+        LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+    }
+    finish_file();
+
+    return files;
+}
+
+void BulkIndexWriter::finish() {
+    std::vector<std::vector<std::string>> files(buffers.size());
+    // exceptions can't leave the parallel loop. We rethrow the first one.
+    std::vector<std::exception_ptr> errors(buffers.size());
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < buffers.size(); i++) {
+        try {
+            files[i] = write_sst_files(i);
+        } catch (...) {
+            errors[i] = std::current_exception();
+        }
+        // the sources aren't needed once their keys are written.
+        buffers[i].sources.clear();
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::vector<rocksdb::IngestExternalFileArg> args;
+    for (column_index_t i = 0; i < buffers.size(); i++) {
+        if (files[i].empty()) {
+            continue;
+        }
+        rocksdb::IngestExternalFileArg arg;
+        arg.column_family = column_families[i];
+        arg.external_files = std::move(files[i]);
+        arg.options.move_files = true;
+        args.push_back(std::move(arg));
+    }
+    if (args.empty()) {
+        return;
+    }
+
+    LOG(INFO) << "ingesting bulk writes into " << args.size()
+              << " column families";
+    // every column family is ingested at once, so a failure leaves none of
+    // the documents behind.
+    auto status = db->IngestExternalFiles(args);
+    LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+}
+
+} // namespace lintdb
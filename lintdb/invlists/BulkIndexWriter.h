@@ -0,0 +1,113 @@
+#pragma once
+
+#include <rocksdb/db.h>
+#include <rocksdb/merge_operator.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "lintdb/constants.h"
+#include "lintdb/invlists/IndexWriter.h"
+#include "lintdb/invlists/PostingData.h"
+
+namespace lintdb {
+/// bulk writes are staged in this directory of the index path.
+static const std::string kBulkDirectory = "_bulk";
+/// bytes buffered per column family before the buffer is spilled to disk.
+static const size_t kBulkBufferSize = 64 * 1024 * 1024;
+/// ingested SST files are split at this size.
+static const size_t kBulkSstFileSize = 256 * 1024 * 1024;
+
+/**
+ * BulkIndexWriter loads documents with SST ingestion instead of write
+ * batches, so initial builds skip the WAL, the memtables, and compaction.
+ *
+ * Writes are buffered per column family. Full buffers are sorted and spilled
+ * to run files under dir. `finish` merges each column family's runs into SST
+ * files and ingests all of them at once. Nothing is visible in the database
+ * until then.
+ *
+ * Sorted sources, like another index's column families, are merged in as
+ * they are read and never spilled.
+ *
+ * Values with the same key are combined with the column family's merge
+ * operator when it has one. Otherwise the last value wins. Sources count as
+ * written before anything else.
+ */
+class BulkIndexWriter : public IIndexWriter {
+   public:
+    BulkIndexWriter(
+            std::shared_ptr<rocksdb::DB> db,
+            std::vector<rocksdb::ColumnFamilyHandle*>& column_families,
+            const std::string& dir,
+            size_t buffer_size = kBulkBufferSize);
+
+    /// removes any run and SST files that are left in dir.
+    ~BulkIndexWriter() override;
+
+    void write(const BatchPostingData& batch_posting_data) override;
+
+    /// put writes one value. Keys can be written in any order.
+    void put(
+            column_index_t column_index,
+            const std::string& key,
+            const std::string& value);
+
+    /**
+     * add_sorted adds every key of an iterator to a column family. The
+     * iterator must stay valid until `finish` returns.
+     */
+    void add_sorted(
+            column_index_t column_index,
+            std::unique_ptr<rocksdb::Iterator> it);
+
+    /**
+     * finish ingests everything that was written. Column families are
+     * written to SST files in parallel. Call it once, after the last write.
+     */
+    void finish();
+
+   private:
+    struct Buffer {
+        std::vector<PostingData> data;
+        size_t size = 0;
+        std::vector<std::string> runs; /// spilled run files, in order.
+        std::vector<std::unique_ptr<rocksdb::Iterator>> sources;
+    };
+    using FullBuffers =
+            std::vector<std::pair<column_index_t, std::vector<PostingData>>>;
+
+    void add(column_index_t column_index, const PostingData& posting);
+    /// moves full buffers into full. Called with the lock held.
+    void take_full(FullBuffers& full);
+    /// sorts data and writes it to a new run file of the column family.
+    void spill(column_index_t column_index, std::vector<PostingData>& data);
+    /// sorts data by key and combines the values of equal keys. data is
+    /// consumed.
+    std::vector<PostingData> sort_and_combine(
+            column_index_t column_index,
+            std::vector<PostingData>& data) const;
+    /// merges the runs of a column family into SST files.
+    std::vector<std::string> write_sst_files(column_index_t column_index);
+    /// combines the values of one key, in the order they were written.
+    std::string combine(
+            column_index_t column_index,
+            const std::string& key,
+            const std::vector<std::string>& values) const;
+
+    std::string next_path(const std::string& extension);
+
+    std::shared_ptr<rocksdb::DB> db;
+    std::vector<rocksdb::ColumnFamilyHandle*>& column_families;
+    std::string dir;
+    size_t buffer_size;
+    /// null for column families without a merge operator.
+    std::vector<std::shared_ptr<rocksdb::MergeOperator>> merge_operators;
+
+    std::mutex mutex;
+    std::vector<Buffer> buffers;
+    std::atomic<size_t> num_files{0};
+};
+
+} // namespace lintdb
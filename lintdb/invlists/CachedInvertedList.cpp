@@ -0,0 +1,139 @@
+#include "lintdb/invlists/CachedInvertedList.h"
+#include <algorithm>
+
+namespace lintdb {
+
+namespace {
+/// iterates over a posting list held in memory.
+struct MemoryIterator : public Iterator {
+    using Postings = std::vector<std::pair<InvertedIndexKey, std::string>>;
+
+    explicit MemoryIterator(std::shared_ptr<const Postings> postings)
+            : postings(std::move(postings)) {}
+
+    bool is_valid() override {
+        return pos < postings->size();
+    }
+
+    void next() override {
+        pos++;
+    }
+
+    void advance_to(const idx_t doc_id) override {
+        auto it = std::lower_bound(
+                postings->begin() + pos,
+                postings->end(),
+                doc_id,
+                [](const Postings::value_type& entry, const idx_t id) {
+                    return entry.first.doc_id() < id;
+                });
+        pos = it - postings->begin();
+    }
+
+    InvertedIndexKey get_key() const override {
+        return (*postings)[pos].first;
+    }
+
+    std::string get_value() const override {
+        return (*postings)[pos].second;
+    }
+
+   private:
+    std::shared_ptr<const Postings> postings;
+    size_t pos = 0;
+};
+} // namespace
+
+CachedInvertedList::CachedInvertedList(std::shared_ptr<InvertedList> inner)
+        : inner_(std::move(inner)) {}
+
+void CachedInvertedList::prefetch(const std::vector<std::string>& prefixes) {
+    std::vector<std::shared_ptr<Postings>> loaded(prefixes.size());
+
+#pragma omp parallel for
+    for (int i = 0; i < prefixes.size(); i++) {
+        auto postings = std::make_shared<Postings>();
+        for (auto it = inner_->get_iterator(prefixes[i]); it->is_valid();
+             it->next()) {
+            postings->emplace_back(it->get_key(), it->get_value());
+        }
+        loaded[i] = std::move(postings);
+    }
+
+    for (size_t i = 0; i < prefixes.size(); i++) {
+        cache_[prefixes[i]] = std::move(loaded[i]);
+    }
+}
+
+void CachedInvertedList::remove(
+        const uint64_t tenant,
+        std::vector<idx_t> ids,
+        const uint8_t field,
+        const DataType data_type,
+        const std::vector<FieldType> field_types) {
+    cache_.clear();
+    inner_->remove(tenant, std::move(ids), field, data_type, field_types);
+}
+
+void CachedInvertedList::merge(
+        rocksdb::DB* db,
+        std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+        BulkIndexWriter& writer) {
+    cache_.clear();
+    inner_->merge(db, cfs, writer);
+}
+
+std::vector<idx_t> CachedInvertedList::get_mapping(
+        const uint64_t tenant,
+        idx_t id) const {
+    return inner_->get_mapping(tenant, id);
+}
+
+std::unique_ptr<Iterator> CachedInvertedList::get_iterator(
+        const std::string& prefix) const {
+    auto cached = cache_.find(prefix);
+    if (cached != cache_.end()) {
+        return std::make_unique<MemoryIterator>(cached->second);
+    }
+    return inner_->get_iterator(prefix);
+}
+
+std::unique_ptr<ContextIterator> CachedInvertedList::get_context_iterator(
+        const uint64_t tenant,
+        const uint8_t field_id) const {
+    return inner_->get_context_iterator(tenant, field_id);
+}
+
+void CachedInvertedList::get_contexts(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        std::vector<std::string>& values) const {
+    inner_->get_contexts(tenant, field_id, doc_ids, values);
+}
+
+void CachedInvertedList::get_residuals(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        std::vector<std::string>& values) const {
+    inner_->get_residuals(tenant, field_id, doc_ids, values);
+}
+
+void CachedInvertedList::visit_contexts(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        const ValueVisitor& visit) const {
+    inner_->visit_contexts(tenant, field_id, doc_ids, visit);
+}
+
+void CachedInvertedList::visit_residuals(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        const ValueVisitor& visit) const {
+    inner_->visit_residuals(tenant, field_id, doc_ids, visit);
+}
+
+} // namespace lintdb
@@ -0,0 +1,87 @@
+#ifndef LINTDB_CACHEDINVERTEDLIST_H
+#define LINTDB_CACHEDINVERTEDLIST_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "lintdb/invlists/InvertedList.h"
+#include "lintdb/invlists/Iterator.h"
+#include "lintdb/invlists/KeyBuilder.h"
+
+namespace lintdb {
+
+/**
+ * CachedInvertedList reads selected posting lists into memory once and serves
+ * them to any number of readers.
+ *
+ * Batched search uses this so that posting lists shared by many queries are
+ * read from the database once. Everything else is passed to the wrapped
+ * inverted list.
+ */
+struct CachedInvertedList : public InvertedList {
+    explicit CachedInvertedList(std::shared_ptr<InvertedList> inner);
+
+    /**
+     * prefetch reads the posting lists for each prefix into memory.
+     *
+     * This isn't thread safe, but reading from the cache afterwards is.
+     */
+    void prefetch(const std::vector<std::string>& prefixes);
+
+    void remove(
+            const uint64_t tenant,
+            std::vector<idx_t> ids,
+            const uint8_t field,
+            const DataType data_type,
+            const std::vector<FieldType> field_types) override;
+    void merge(
+            rocksdb::DB* db,
+            std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+            BulkIndexWriter& writer) override;
+
+    std::vector<idx_t> get_mapping(const uint64_t tenant, idx_t id)
+            const override;
+
+    [[nodiscard]] std::unique_ptr<Iterator> get_iterator(
+            const std::string& prefix) const override;
+
+    std::unique_ptr<ContextIterator> get_context_iterator(
+            const uint64_t tenant,
+            const uint8_t field_id) const override;
+
+    void get_contexts(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            std::vector<std::string>& values) const override;
+
+    void get_residuals(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            std::vector<std::string>& values) const override;
+
+    void visit_contexts(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            const ValueVisitor& visit) const override;
+
+    void visit_residuals(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            const ValueVisitor& visit) const override;
+
+   private:
+    using Postings = std::vector<std::pair<InvertedIndexKey, std::string>>;
+
+    std::shared_ptr<InvertedList> inner_;
+    std::unordered_map<std::string, std::shared_ptr<const Postings>> cache_;
+};
+
+} // namespace lintdb
+
+#endif // LINTDB_CACHEDINVERTEDLIST_H
@@ -8,6 +8,10 @@
 #include "lintdb/invlists/KeyBuilder.h"
 
 namespace lintdb {
+/**
+ * ContextIterator walks the context of a field in doc id order. The default
+ * implementation reads RocksDB. Subclasses can read other storage.
+ */
 class ContextIterator {
    public:
     ContextIterator(
@@ -15,7 +19,7 @@ class ContextIterator {
             rocksdb::ColumnFamilyHandle* column_family,
             const uint64_t tenant,
             const uint8_t field)
-            : tenant(tenant), field(field) {
+            : has_read_key(false), tenant(tenant), field(field) {
         if (!column_family) {
             throw std::runtime_error("Column family not found");
         }
@@ -31,7 +35,7 @@ class ContextIterator {
         it->Seek(this->prefix);
     }
 
-    bool is_valid() {
+    virtual bool is_valid() {
         if (!has_read_key) {
             bool is_valid = it->Valid();
             if (!is_valid) {
@@ -50,7 +54,20 @@ class ContextIterator {
         return true;
     }
 
-    void advance(const idx_t doc_id) {
+    virtual void advance(const idx_t doc_id) {
+        // avoid re-seeking when we are already positioned on the document.
+        if (is_valid() && current_key.doc_id() == doc_id) {
+            return;
+        }
+        // candidates usually arrive in doc id order. If the next key already
+        // reaches doc_id, it's where a seek would land, and Next() is much
+        // cheaper than a Seek().
+        if (is_valid() && current_key.doc_id() < doc_id) {
+            next();
+            if (!is_valid() || current_key.doc_id() >= doc_id) {
+                return;
+            }
+        }
         KeyBuilder kb;
 
         std::string expected_key =
@@ -59,22 +76,28 @@ class ContextIterator {
         has_read_key = false;
     }
 
-    void next() {
+    virtual void next() {
         it->Next();
         has_read_key = false;
     }
 
-    ContextKey get_key() const {
+    virtual ContextKey get_key() const {
         return current_key;
     }
 
-    std::string get_value() const {
+    virtual std::string get_value() const {
         return it->value().ToString();
     }
 
+    virtual ~ContextIterator() = default;
+
     std::unique_ptr<rocksdb::Iterator> it;
 
    protected:
+    /// for subclasses that don't read RocksDB. `it` is left empty.
+    ContextIterator(const uint64_t tenant, const uint8_t field)
+            : has_read_key(false), tenant(tenant), field(field) {}
+
     lintdb::column_index_t cf;
     string prefix;
     string end_key;
@@ -29,6 +29,14 @@ void IndexWriter::write(const BatchPostingData& batch_posting_data) {
                 rocksdb::Slice(posting.value));
     }
 
+    // block encoded posting lists are updated with merge operands.
+    for (const auto& posting : batch_posting_data.posting_blocks) {
+        batch.Merge(
+                column_families[kPostingsColumnIndex],
+                rocksdb::Slice(posting.key),
+                rocksdb::Slice(posting.value));
+    }
+
     // write all mappings
     for (const auto& posting : batch_posting_data.inverted_mapping) {
         batch.Put(
@@ -38,10 +46,12 @@ void IndexWriter::write(const BatchPostingData& batch_posting_data) {
     }
 
     // write all document data
-    batch.Put(
-            column_families[kDocColumnIndex],
-            rocksdb::Slice(batch_posting_data.forward.key),
-            rocksdb::Slice(batch_posting_data.forward.value));
+    for (const auto& posting : batch_posting_data.forward) {
+        batch.Put(
+                column_families[kDocColumnIndex],
+                rocksdb::Slice(posting.key),
+                rocksdb::Slice(posting.value));
+    }
 
     // write all context data
     for (const auto& posting : batch_posting_data.context) {
@@ -51,6 +61,14 @@ void IndexWriter::write(const BatchPostingData& batch_posting_data) {
                 rocksdb::Slice(posting.value));
     }
 
+    // write all residuals
+    for (const auto& posting : batch_posting_data.residuals) {
+        batch.Put(
+                column_families[kResidualsColumnIndex],
+                rocksdb::Slice(posting.key),
+                rocksdb::Slice(posting.value));
+    }
+
     auto status = db->Write(rocksdb::WriteOptions(), &batch);
     assert(status.ok());
 
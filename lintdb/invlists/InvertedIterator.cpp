@@ -2,7 +2,9 @@
 #include <glog/logging.h>
 #include <rocksdb/slice.h>
 #include <rocksdb/utilities/transaction.h>
+#include <algorithm>
 #include <memory>
+#include "lintdb/assert.h"
 #include "lintdb/constants.h"
 #include "lintdb/invlists/ContextIterator.h"
 
@@ -19,4 +21,88 @@ lintdb::RocksDBIterator::RocksDBIterator(
     this->it = std::unique_ptr<rocksdb::Iterator>(
             db->NewIterator(options, column_family));
     it->Seek(this->prefix);
-}
\ No newline at end of file
+}
+lintdb::BlockPostingIterator::BlockPostingIterator(
+        std::shared_ptr<rocksdb::DB> db,
+        rocksdb::ColumnFamilyHandle* column_family,
+        const std::string& prefix)
+        : Iterator(), prefix(prefix), pos(0) {
+    // tenant (8 bytes), field (1 byte), data type (1 byte), centroid (8 bytes)
+    LINTDB_THROW_IF_NOT(prefix.size() == 10 + sizeof(idx_t));
+    tenant = load_bigendian<uint64_t>(prefix.data());
+    field = load_bigendian<uint8_t>(prefix.data() + 8);
+    centroid = load_bigendian<idx_t>(prefix.data() + 10);
+
+    this->it = std::unique_ptr<rocksdb::Iterator>(
+            db->NewIterator(rocksdb::ReadOptions(), column_family));
+    it->Seek(this->prefix);
+    load_key();
+}
+
+void lintdb::BlockPostingIterator::load_key() {
+    doc_ids.clear();
+    pos = 0;
+    for (; it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        // the reader points into the iterator's value, which stays valid
+        // until the iterator moves.
+        reader = PostingBlockReader(it->value().data(), it->value().size());
+        if (reader.has_block()) {
+            reader.read_block(doc_ids);
+            return;
+        }
+    }
+}
+
+void lintdb::BlockPostingIterator::next() {
+    pos++;
+    if (pos < doc_ids.size()) {
+        return;
+    }
+    if (reader.has_block()) {
+        doc_ids.clear();
+        pos = 0;
+        reader.read_block(doc_ids);
+        return;
+    }
+    it->Next();
+    load_key();
+}
+
+void lintdb::BlockPostingIterator::advance_to(const idx_t doc_id) {
+    if (!is_valid() || doc_ids[pos] >= doc_id) {
+        return;
+    }
+
+    // every doc id under a key shares the key's range, so a key that ends in
+    // an earlier range can be skipped with a seek.
+    if ((doc_ids.back() >> kPostingRangeBits) <
+        (doc_id >> kPostingRangeBits)) {
+        it->Seek(create_posting_block_key(tenant, field, centroid, doc_id));
+        load_key();
+    }
+
+    while (is_valid() && doc_ids.back() < doc_id) {
+        while (reader.has_block() && reader.last_doc_id() < doc_id) {
+            reader.skip_block();
+        }
+        if (reader.has_block()) {
+            doc_ids.clear();
+            pos = 0;
+            reader.read_block(doc_ids);
+            break;
+        }
+        it->Next();
+        load_key();
+    }
+
+    if (is_valid()) {
+        pos = std::lower_bound(doc_ids.begin() + pos, doc_ids.end(), doc_id) -
+                doc_ids.begin();
+    }
+}
+
+lintdb::InvertedIndexKey lintdb::BlockPostingIterator::get_key() const {
+    SupportedTypes value = centroid;
+    return InvertedIndexKey(
+            tenant, field, DataType::QUANTIZED_TENSOR, value, doc_ids[pos]);
+}
@@ -13,6 +13,7 @@
 #include "lintdb/invlists/InvertedList.h"
 #include "lintdb/invlists/Iterator.h"
 #include "lintdb/invlists/KeyBuilder.h"
+#include "lintdb/invlists/PostingBlocks.h"
 #include "lintdb/version.h"
 
 namespace lintdb {
@@ -48,6 +49,17 @@ struct RocksDBIterator : public lintdb::Iterator {
         has_read_key = false;
     }
 
+    /// seeks to tenant::field::type::value::doc_id within our prefix.
+    void advance_to(const idx_t doc_id) override {
+        if (is_valid() && current_key.doc_id() >= doc_id) {
+            return;
+        }
+        KeyBuilder kb;
+        std::string target = kb.add(prefix).add(doc_id).build();
+        it->Seek(rocksdb::Slice(target));
+        has_read_key = false;
+    }
+
     InvertedIndexKey get_key() const override {
         return current_key;
     }
@@ -68,4 +80,48 @@ struct RocksDBIterator : public lintdb::Iterator {
     bool has_read_key;
 };
 
+/**
+ * BlockPostingIterator iterates the block encoded posting lists of one
+ * centroid. The prefix is tenant::field::QUANTIZED_TENSOR::centroid.
+ *
+ * Only one block is decoded at a time. advance_to skips blocks by their last
+ * doc id, and seeks past whole keys that end before the target.
+ */
+struct BlockPostingIterator : public lintdb::Iterator {
+    BlockPostingIterator(
+            std::shared_ptr<rocksdb::DB> db,
+            rocksdb::ColumnFamilyHandle* column_family,
+            const std::string& prefix);
+
+    bool is_valid() override {
+        return pos < doc_ids.size();
+    }
+
+    void next() override;
+
+    void advance_to(const idx_t doc_id) override;
+
+    InvertedIndexKey get_key() const override;
+
+    /// block lists don't store values.
+    string get_value() const override {
+        return "";
+    }
+
+   private:
+    /// decodes the first block of the current key, moving forward until a key
+    /// within our prefix has one.
+    void load_key();
+
+    std::unique_ptr<rocksdb::Iterator> it;
+    string prefix;
+    uint64_t tenant;
+    uint8_t field;
+    idx_t centroid;
+
+    PostingBlockReader reader;
+    std::vector<idx_t> doc_ids; /// the decoded block.
+    size_t pos;
+};
+
 } // namespace lintdb
\ No newline at end of file
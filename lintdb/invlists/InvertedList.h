@@ -2,7 +2,10 @@
 #define LINTDB_INVLISTS_INVERTED_LIST_H
 
 #include <stddef.h>
+#include <functional>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 #include "lintdb/api.h"
 #include "lintdb/constants.h"
@@ -13,6 +16,14 @@
 #include "lintdb/schema/Schema.h"
 
 namespace lintdb {
+class BulkIndexWriter;
+
+/**
+ * ValueVisitor receives the value of the i-th requested document. The view is
+ * only valid during the call, and is empty when the document has no value.
+ */
+using ValueVisitor = std::function<void(size_t i, std::string_view value)>;
+
 /**
  * InvertedList manages the storage of centroid -> codes mappping.
  *
@@ -29,9 +40,14 @@ struct InvertedList {
             const uint8_t field,
             const DataType data_type,
             const std::vector<FieldType> field_types) = 0;
+    /**
+     * merge adds another index's postings to writer. They're in the index
+     * once the writer is finished.
+     */
     virtual void merge(
             rocksdb::DB* db,
-            std::vector<rocksdb::ColumnFamilyHandle*>& cfs) = 0;
+            std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+            BulkIndexWriter& writer) = 0;
 
     virtual std::unique_ptr<Iterator> get_iterator(
             const std::string& prefix) const = 0;
@@ -40,6 +56,59 @@ struct InvertedList {
             const uint64_t tenant,
             const uint8_t field_id) const = 0;
 
+    /**
+     * get_contexts reads the context of many documents in one batch.
+     *
+     * doc_ids should be sorted. values[i] is left empty when doc_ids[i] has
+     * no context.
+     */
+    virtual void get_contexts(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            std::vector<std::string>& values) const = 0;
+
+    /**
+     * get_residuals reads the packed ColBERT residuals of many documents.
+     *
+     * Indexes written before residuals were split from the codes keep them
+     * in the context, and have no residuals here.
+     */
+    virtual void get_residuals(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            std::vector<std::string>& values) const = 0;
+
+    /**
+     * visit_contexts is get_contexts without copying the values out of
+     * storage. visit is called once per document, in order.
+     */
+    virtual void visit_contexts(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            const ValueVisitor& visit) const {
+        std::vector<std::string> values;
+        get_contexts(tenant, field_id, doc_ids, values);
+        for (size_t i = 0; i < values.size(); i++) {
+            visit(i, values[i]);
+        }
+    }
+
+    /// visit_residuals is get_residuals without copying the values.
+    virtual void visit_residuals(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            const ValueVisitor& visit) const {
+        std::vector<std::string> values;
+        get_residuals(tenant, field_id, doc_ids, values);
+        for (size_t i = 0; i < values.size(); i++) {
+            visit(i, values[i]);
+        }
+    }
+
     virtual std::vector<idx_t> get_mapping(const uint64_t tenant, idx_t id)
             const = 0;
 
@@ -56,9 +125,11 @@ struct ForwardIndex {
 
     virtual void remove(const uint64_t tenant, std::vector<idx_t> ids) = 0;
 
+    /// merge adds another index's stored fields to writer.
     virtual void merge(
             rocksdb::DB* db,
-            std::vector<rocksdb::ColumnFamilyHandle*>& cfs) = 0;
+            std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+            BulkIndexWriter& writer) = 0;
 
     virtual std::unique_ptr<ForwardIndexIterator> get_iterator(
             const uint64_t tenant,
@@ -9,6 +9,19 @@ struct Iterator {
     virtual bool is_valid() = 0;
     virtual void next() = 0;
 
+    /**
+     * advance_to moves the iterator to the first key with a doc id greater
+     * than or equal to doc_id. The iterator never moves backwards.
+     *
+     * The default implementation steps through keys one at a time. Iterators
+     * backed by sorted storage should override this with a seek.
+     */
+    virtual void advance_to(const idx_t doc_id) {
+        while (is_valid() && get_key().doc_id() < doc_id) {
+            next();
+        }
+    }
+
     virtual InvertedIndexKey get_key() const = 0;
     virtual std::string get_value() const = 0;
 
@@ -0,0 +1,282 @@
+#include "lintdb/invlists/PostingBlocks.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include "lintdb/assert.h"
+
+namespace lintdb {
+namespace {
+// header: count (uint8_t), bit width (uint8_t), first doc id, last doc id.
+const size_t kHeaderSize = 2 + 2 * sizeof(idx_t);
+// deltas up to this width fit in one unaligned 64 bit read. Wider deltas are
+// stored as raw 64 bit values.
+const uint8_t kMaxPackedWidth = 57;
+// packed blocks are padded so the last delta can be read with a full 64 bit
+// load.
+const size_t kPackedPadding = 7;
+
+uint8_t bit_width(uint64_t value) {
+    uint8_t width = 0;
+    while (value > 0) {
+        width++;
+        value >>= 1;
+    }
+    return width;
+}
+
+size_t packed_size(size_t count, uint8_t width) {
+    if (count <= 1) {
+        return 0;
+    }
+    if (width > kMaxPackedWidth) {
+        return (count - 1) * sizeof(uint64_t);
+    }
+    return ((count - 1) * width + 7) / 8 + kPackedPadding;
+}
+
+// bits are packed least significant first. We read and write through
+// uint64_t, so the format assumes a little endian host.
+void pack_deltas(
+        const idx_t* doc_ids,
+        size_t count,
+        uint8_t width,
+        char* out) {
+    if (width > kMaxPackedWidth) {
+        for (size_t i = 1; i < count; i++) {
+            uint64_t delta = doc_ids[i] - doc_ids[i - 1];
+            memcpy(out + (i - 1) * sizeof(delta), &delta, sizeof(delta));
+        }
+        return;
+    }
+    for (size_t i = 1; i < count; i++) {
+        uint64_t delta = doc_ids[i] - doc_ids[i - 1];
+        size_t bit = (i - 1) * width;
+        uint64_t word;
+        memcpy(&word, out + (bit >> 3), sizeof(word));
+        word |= delta << (bit & 7);
+        memcpy(out + (bit >> 3), &word, sizeof(word));
+    }
+}
+
+void unpack_deltas(
+        const char* packed,
+        size_t count,
+        uint8_t width,
+        idx_t* out) {
+    const size_t num_deltas = count - 1;
+    if (width > kMaxPackedWidth) {
+        memcpy(out + 1, packed, num_deltas * sizeof(idx_t));
+    } else {
+        const uint64_t mask = (uint64_t(1) << width) - 1;
+        // every delta is independent, so unpacking vectorizes. Only the
+        // prefix sum below is serial.
+#pragma omp simd
+        for (size_t i = 0; i < num_deltas; i++) {
+            size_t bit = i * width;
+            uint64_t word;
+            memcpy(&word, packed + (bit >> 3), sizeof(word));
+            out[i + 1] = idx_t((word >> (bit & 7)) & mask);
+        }
+    }
+    for (size_t i = 1; i < count; i++) {
+        out[i] += out[i - 1];
+    }
+}
+
+void decode_operand(
+        const rocksdb::Slice& operand,
+        std::vector<idx_t>& added,
+        std::vector<idx_t>& removed) {
+    uint32_t num_added, num_removed;
+    LINTDB_THROW_IF_NOT_MSG(
+            operand.size() >= 2 * sizeof(uint32_t),
+            "posting operand is truncated");
+    memcpy(&num_added, operand.data(), sizeof(num_added));
+    memcpy(&num_removed,
+           operand.data() + sizeof(num_added),
+           sizeof(num_removed));
+    LINTDB_THROW_IF_NOT_MSG(
+            operand.size() ==
+                    2 * sizeof(uint32_t) +
+                            (size_t(num_added) + num_removed) * sizeof(idx_t),
+            "posting operand is truncated");
+
+    const char* ptr = operand.data() + 2 * sizeof(uint32_t);
+    added.resize(num_added);
+    memcpy(added.data(), ptr, num_added * sizeof(idx_t));
+    removed.resize(num_removed);
+    memcpy(removed.data(),
+           ptr + num_added * sizeof(idx_t),
+           num_removed * sizeof(idx_t));
+}
+
+// fold_operands combines operands in order. The last operation on a doc id
+// wins.
+template <typename Operands>
+void fold_operands(
+        const Operands& operands,
+        std::vector<idx_t>& added,
+        std::vector<idx_t>& removed) {
+    std::unordered_map<idx_t, bool> is_added;
+    for (const auto& operand : operands) {
+        decode_operand(operand, added, removed);
+        for (const auto id : removed) {
+            is_added[id] = false;
+        }
+        for (const auto id : added) {
+            is_added[id] = true;
+        }
+    }
+
+    added.clear();
+    removed.clear();
+    for (const auto& [id, add] : is_added) {
+        (add ? added : removed).push_back(id);
+    }
+}
+} // namespace
+
+void encode_posting_blocks(
+        const std::vector<idx_t>& doc_ids,
+        std::string& out) {
+    for (size_t start = 0; start < doc_ids.size(); start += kPostingBlockSize) {
+        const size_t count =
+                std::min(kPostingBlockSize, doc_ids.size() - start);
+        const idx_t* block = doc_ids.data() + start;
+
+        uint64_t max_delta = 0;
+        for (size_t i = 1; i < count; i++) {
+            max_delta = std::max(max_delta, uint64_t(block[i] - block[i - 1]));
+        }
+        uint8_t width = bit_width(max_delta);
+
+        size_t offset = out.size();
+        out.resize(offset + kHeaderSize + packed_size(count, width), 0);
+        char* ptr = &out[offset];
+        ptr[0] = char(uint8_t(count - 1));
+        ptr[1] = char(width);
+        memcpy(ptr + 2, &block[0], sizeof(idx_t));
+        memcpy(ptr + 2 + sizeof(idx_t), &block[count - 1], sizeof(idx_t));
+        pack_deltas(block, count, width, ptr + kHeaderSize);
+    }
+}
+
+void decode_posting_blocks(
+        const char* data,
+        size_t size,
+        std::vector<idx_t>& doc_ids) {
+    PostingBlockReader reader(data, size);
+    while (reader.has_block()) {
+        reader.read_block(doc_ids);
+    }
+}
+
+PostingBlockReader::PostingBlockReader(const char* data, size_t size)
+        : data_(data), size_(size), pos_(0) {}
+
+idx_t PostingBlockReader::first_doc_id() const {
+    idx_t doc_id;
+    memcpy(&doc_id, data_ + pos_ + 2, sizeof(doc_id));
+    return doc_id;
+}
+
+idx_t PostingBlockReader::last_doc_id() const {
+    idx_t doc_id;
+    memcpy(&doc_id, data_ + pos_ + 2 + sizeof(idx_t), sizeof(doc_id));
+    return doc_id;
+}
+
+void PostingBlockReader::skip_block() {
+    size_t count = size_t(uint8_t(data_[pos_])) + 1;
+    uint8_t width = uint8_t(data_[pos_ + 1]);
+    pos_ += kHeaderSize + packed_size(count, width);
+}
+
+void PostingBlockReader::read_block(std::vector<idx_t>& doc_ids) {
+    LINTDB_THROW_IF_NOT_MSG(
+            pos_ + kHeaderSize <= size_, "posting block is truncated");
+    size_t count = size_t(uint8_t(data_[pos_])) + 1;
+    uint8_t width = uint8_t(data_[pos_ + 1]);
+    LINTDB_THROW_IF_NOT_MSG(
+            pos_ + kHeaderSize + packed_size(count, width) <= size_,
+            "posting block is truncated");
+
+    size_t offset = doc_ids.size();
+    doc_ids.resize(offset + count);
+    doc_ids[offset] = first_doc_id();
+    if (count > 1) {
+        unpack_deltas(
+                data_ + pos_ + kHeaderSize,
+                count,
+                width,
+                doc_ids.data() + offset);
+    }
+    pos_ += kHeaderSize + packed_size(count, width);
+}
+
+std::string encode_posting_operand(
+        const std::vector<idx_t>& added,
+        const std::vector<idx_t>& removed) {
+    uint32_t num_added = added.size();
+    uint32_t num_removed = removed.size();
+
+    std::string operand(
+            2 * sizeof(uint32_t) +
+                    (added.size() + removed.size()) * sizeof(idx_t),
+            0);
+    char* ptr = &operand[0];
+    memcpy(ptr, &num_added, sizeof(num_added));
+    memcpy(ptr + sizeof(num_added), &num_removed, sizeof(num_removed));
+    ptr += 2 * sizeof(uint32_t);
+    memcpy(ptr, added.data(), added.size() * sizeof(idx_t));
+    memcpy(ptr + added.size() * sizeof(idx_t),
+           removed.data(),
+           removed.size() * sizeof(idx_t));
+    return operand;
+}
+
+bool PostingListMergeOperator::FullMergeV2(
+        const MergeOperationInput& merge_in,
+        MergeOperationOutput* merge_out) const {
+    std::vector<idx_t> added, removed;
+    fold_operands(merge_in.operand_list, added, removed);
+
+    std::vector<idx_t> doc_ids;
+    if (merge_in.existing_value != nullptr) {
+        decode_posting_blocks(
+                merge_in.existing_value->data(),
+                merge_in.existing_value->size(),
+                doc_ids);
+    }
+
+    std::sort(removed.begin(), removed.end());
+    doc_ids.erase(
+            std::remove_if(
+                    doc_ids.begin(),
+                    doc_ids.end(),
+                    [&](idx_t id) {
+                        return std::binary_search(
+                                removed.begin(), removed.end(), id);
+                    }),
+            doc_ids.end());
+    doc_ids.insert(doc_ids.end(), added.begin(), added.end());
+    std::sort(doc_ids.begin(), doc_ids.end());
+    doc_ids.erase(std::unique(doc_ids.begin(), doc_ids.end()), doc_ids.end());
+
+    merge_out->new_value.clear();
+    encode_posting_blocks(doc_ids, merge_out->new_value);
+    return true;
+}
+
+bool PostingListMergeOperator::PartialMergeMulti(
+        const rocksdb::Slice& key,
+        const std::deque<rocksdb::Slice>& operand_list,
+        std::string* new_value,
+        rocksdb::Logger* logger) const {
+    std::vector<idx_t> added, removed;
+    fold_operands(operand_list, added, removed);
+    *new_value = encode_posting_operand(added, removed);
+    return true;
+}
+
+} // namespace lintdb
@@ -0,0 +1,125 @@
+#ifndef LINTDB_INVLISTS_POSTING_BLOCKS_H
+#define LINTDB_INVLISTS_POSTING_BLOCKS_H
+
+#include <rocksdb/merge_operator.h>
+#include <rocksdb/slice.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include "lintdb/api.h"
+#include "lintdb/invlists/KeyBuilder.h"
+#include "lintdb/schema/DataTypes.h"
+
+namespace lintdb {
+/**
+ * PostingFormat is how an index stores the posting lists of ColBERT fields.
+ *
+ * KEYS stores one key per (centroid, document). BLOCKS stores each centroid's
+ * documents as block-encoded lists in the postings column family.
+ */
+enum class PostingFormat {
+    KEYS = 0,
+    BLOCKS = 1,
+};
+
+/// number of doc ids in a full block.
+static const size_t kPostingBlockSize = 128;
+/// each block list key covers 2^kPostingRangeBits doc ids, which bounds how
+/// much a merge rewrites.
+static const size_t kPostingRangeBits = 20;
+
+/**
+ * Block lists share their prefix with the per-document posting keys, so
+ * `create_index_prefix(tenant, field, QUANTIZED_TENSOR, centroid)` finds
+ * them.
+ */
+inline std::string create_posting_block_key(
+        uint64_t tenant,
+        uint8_t field,
+        idx_t centroid,
+        idx_t doc_id) {
+    KeyBuilder kb;
+    kb.add(tenant)
+            .add(field)
+            .add(DataType::QUANTIZED_TENSOR)
+            .add(centroid)
+            .add(idx_t(doc_id >> kPostingRangeBits));
+    return kb.build();
+}
+
+/**
+ * encode_posting_blocks appends sorted, unique doc ids to out as blocks of
+ * up to kPostingBlockSize ids.
+ *
+ * Each block is a header (count, bit width, first and last doc id) followed
+ * by the bit-packed deltas between consecutive ids.
+ */
+void encode_posting_blocks(
+        const std::vector<idx_t>& doc_ids,
+        std::string& out);
+
+/// decode_posting_blocks appends every doc id in data to doc_ids.
+void decode_posting_blocks(
+        const char* data,
+        size_t size,
+        std::vector<idx_t>& doc_ids);
+
+/**
+ * PostingBlockReader walks the blocks of one encoded value. Blocks can be
+ * skipped by their last doc id without decoding them.
+ */
+class PostingBlockReader {
+   public:
+    PostingBlockReader() = default;
+    PostingBlockReader(const char* data, size_t size);
+
+    bool has_block() const {
+        return pos_ < size_;
+    }
+    idx_t first_doc_id() const;
+    idx_t last_doc_id() const;
+    void skip_block();
+    /// decodes the current block into doc_ids and moves to the next one.
+    void read_block(std::vector<idx_t>& doc_ids);
+
+   private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+};
+
+/**
+ * Posting list updates are merge operands, so adding a document doesn't read
+ * the list first. An operand holds doc ids to add and doc ids to remove. The
+ * two sets never overlap.
+ */
+std::string encode_posting_operand(
+        const std::vector<idx_t>& added,
+        const std::vector<idx_t>& removed);
+
+/**
+ * PostingListMergeOperator applies add and remove operands to a block
+ * encoded posting list.
+ */
+class PostingListMergeOperator : public rocksdb::MergeOperator {
+   public:
+    bool FullMergeV2(
+            const MergeOperationInput& merge_in,
+            MergeOperationOutput* merge_out) const override;
+
+    bool PartialMergeMulti(
+            const rocksdb::Slice& key,
+            const std::deque<rocksdb::Slice>& operand_list,
+            std::string* new_value,
+            rocksdb::Logger* logger) const override;
+
+    const char* Name() const override {
+        return "lintdb.PostingListMergeOperator";
+    }
+};
+
+} // namespace lintdb
+
+#endif // LINTDB_INVLISTS_POSTING_BLOCKS_H
@@ -11,8 +11,13 @@ struct PostingData {
 
 struct BatchPostingData {
     std::vector<PostingData> inverted;
-    PostingData forward; /// A single document has one entry in forward index
+    /// each document has one entry in the forward index.
+    std::vector<PostingData> forward;
     std::vector<PostingData> context;
+    /// ColBERT residuals, stored apart from the codes in context.
+    std::vector<PostingData> residuals;
     std::vector<PostingData> inverted_mapping;
+    /// merge operands for block encoded posting lists.
+    std::vector<PostingData> posting_blocks;
 };
 } // namespace lintdb
\ No newline at end of file
@@ -2,11 +2,13 @@
 #include <glog/logging.h>
 #include <rocksdb/slice.h>
 #include <rocksdb/utilities/transaction.h>
+#include <rocksdb/write_batch.h>
 #include <iostream>
 #include <unordered_set>
 #include "lintdb/assert.h"
 #include "lintdb/constants.h"
 #include "lintdb/exception.h"
+#include "lintdb/invlists/BulkIndexWriter.h"
 #include "lintdb/invlists/ForwardIndexIterator.h"
 #include "lintdb/invlists/KeyBuilder.h"
 #include "lintdb/schema/DocEncoder.h"
@@ -23,22 +25,24 @@ RocksdbForwardIndex::RocksdbForwardIndex(
 void RocksdbForwardIndex::remove(
         const uint64_t tenant,
         std::vector<idx_t> ids) {
+    // the stored document and its mapping are the only per document keys.
+    // Everything else is keyed by field and removed by the inverted list.
+    rocksdb::WriteBatch batch;
     for (idx_t id : ids) {
-        // it's easier to skip the inverted index column families.
-        if (id == kIndexColumnIndex || id == kMappingColumnIndex) {
-            continue;
-        }
-        // delete from all of the forward indices.
-        for (size_t i = 1; i < column_families.size(); i++) {
-            // ignore the default cf at position 0 since we don't use it.
-            KeyBuilder kb;
-            std::string serialized_key = kb.add(tenant).add(id).build();
-            rocksdb::WriteOptions wo;
-            std::string value;
-            rocksdb::Status status = db_->Delete(
-                    wo, column_families[i], rocksdb::Slice(serialized_key));
+        std::string key = create_forward_index_id(tenant, id);
+        for (auto column_index : {kDocColumnIndex, kMappingColumnIndex}) {
+            auto status = batch.Delete(
+                    column_families[column_index], rocksdb::Slice(key));
+            LINTDB_THROW_IF_NOT_FMT(
+                    status.ok(), "%s", status.ToString().c_str());
         }
     }
+    if (batch.Count() == 0) {
+        return;
+    }
+    rocksdb::WriteOptions wo;
+    auto status = db_->Write(wo, &batch);
+    LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
 }
 
 std::vector<std::map<uint8_t, SupportedTypes>> RocksdbForwardIndex::
@@ -93,32 +97,25 @@ std::vector<std::map<uint8_t, SupportedTypes>> RocksdbForwardIndex::
 
 void RocksdbForwardIndex::merge(
         rocksdb::DB* db,
-        std::vector<rocksdb::ColumnFamilyHandle*>& cfs) {
+        std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+        BulkIndexWriter& writer) {
     // very weak check to make sure the column families are the same.
     LINTDB_THROW_IF_NOT(cfs.size() == column_families.size());
 
-#pragma omp for
+    // ignore the default cf at position 0 since we don't use it.
     for (size_t i = 1; i < cfs.size(); i++) {
         // it's easier to skip the inverted index column families.
         // the forward index uses the rest.
-        if (i == kIndexColumnIndex || i == kMappingColumnIndex) {
+        if (i == kIndexColumnIndex || i == kMappingColumnIndex ||
+            i == kPostingsColumnIndex) {
             continue;
         }
-        // ignore the default cf at position 0 since we don't use it.
-        auto cf = cfs[i];
-        rocksdb::ReadOptions ro;
-        auto it = db->NewIterator(ro, cf);
-        it->SeekToFirst();
-        rocksdb::WriteOptions wo;
-        while (it->Valid()) {
-            auto key = it->key();
-            auto value = it->value();
-            auto status = db_->Put(wo, column_families[i], key, value);
-            assert(status.ok());
-            it->Next();
-        }
-
-        delete it;
+        // keys are copied as they are, so the writer streams them straight
+        // into SST files.
+        writer.add_sorted(
+                i,
+                std::unique_ptr<rocksdb::Iterator>(
+                        db->NewIterator(rocksdb::ReadOptions(), cfs[i])));
     }
 }
 
@@ -24,8 +24,10 @@ struct RocksdbForwardIndex : public ForwardIndex {
 
     void remove(const uint64_t tenant, std::vector<idx_t> ids) override;
 
-    void merge(rocksdb::DB* db, std::vector<rocksdb::ColumnFamilyHandle*>& cfs)
-            override;
+    void merge(
+            rocksdb::DB* db,
+            std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+            BulkIndexWriter& writer) override;
 
     std::vector<std::map<uint8_t, SupportedTypes>> get_metadata(
             const uint64_t tenant,
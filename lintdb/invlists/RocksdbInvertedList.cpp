@@ -2,11 +2,14 @@
 #include <glog/logging.h>
 #include <rocksdb/slice.h>
 #include <rocksdb/utilities/transaction.h>
+#include <rocksdb/write_batch.h>
+#include <algorithm>
 #include <iostream>
 #include "InvertedIterator.h"
 #include "lintdb/assert.h"
 #include "lintdb/constants.h"
 #include "lintdb/exception.h"
+#include "lintdb/invlists/BulkIndexWriter.h"
 #include "lintdb/invlists/ContextIterator.h"
 #include "lintdb/invlists/RocksdbForwardIndex.h"
 #include "lintdb/schema/DocEncoder.h"
@@ -16,8 +19,12 @@ namespace lintdb {
 RocksdbInvertedList::RocksdbInvertedList(
         std::shared_ptr<rocksdb::DB> db,
         std::vector<rocksdb::ColumnFamilyHandle*>& column_families,
-        const Version& version)
-        : version(version), db_(db), column_families(column_families) {}
+        const Version& version,
+        PostingFormat posting_format)
+        : version(version),
+          posting_format(posting_format),
+          db_(db),
+          column_families(column_families) {}
 
 void RocksdbInvertedList::remove(
         const uint64_t tenant,
@@ -25,73 +32,109 @@ void RocksdbInvertedList::remove(
         const uint8_t field,
         const DataType data_type,
         const std::vector<FieldType> field_types) {
+    // only indexed fields have mappings to read.
+    std::vector<std::vector<idx_t>> mappings;
+    for (auto field_type : field_types) {
+        if (field_type == FieldType::Indexed ||
+            field_type == FieldType::Colbert) {
+            mappings = get_mappings(tenant, ids);
+            break;
+        }
+    }
+
+    // every key is deleted in one batch, so a remove is a single write.
+    rocksdb::WriteBatch batch;
+    auto delete_key = [&](column_index_t column_index, const std::string& key) {
+        auto status = batch.Delete(
+                column_families[column_index], rocksdb::Slice(key));
+        LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+    };
+
     for (auto field_type : field_types) {
         switch (field_type) {
             case FieldType::Indexed: {
-                for (idx_t id : ids) {
-                    LOG(INFO) << "deleting from index: " << id;
-                    auto id_map = this->get_mapping(tenant, id);
-                    // delete from the inverse index.
-                    rocksdb::ReadOptions ro;
-                    for (auto idx : id_map) {
-                        std::string key = create_index_id(
-                                tenant, field, data_type, idx, id);
-                        rocksdb::WriteOptions wo;
-                        rocksdb::Status status = db_->Delete(
-                                wo,
-                                column_families[kIndexColumnIndex],
-                                rocksdb::Slice(key));
-                        assert(status.ok());
+                for (size_t i = 0; i < ids.size(); i++) {
+                    for (auto idx : mappings[i]) {
+                        delete_key(
+                                kIndexColumnIndex,
+                                create_index_id(
+                                        tenant, field, data_type, idx, ids[i]));
                     }
                 }
                 break;
             }
             case FieldType::Context: {
                 for (idx_t id : ids) {
-                    std::string key = create_context_id(tenant, field, id);
-                    rocksdb::WriteOptions wo;
-                    rocksdb::Status status = db_->Delete(
-                            wo,
-                            column_families[kCodesColumnIndex],
-                            rocksdb::Slice(key));
-                    assert(status.ok());
+                    delete_key(
+                            kCodesColumnIndex,
+                            create_context_id(tenant, field, id));
                 }
                 break;
             }
             case FieldType::Colbert: {
-                for (idx_t id : ids) {
-                    auto id_map = this->get_mapping(tenant, id);
-                    // delete from the inverse index.
-                    rocksdb::ReadOptions ro;
-                    for (auto idx : id_map) {
-                        LOG(INFO) << "deleting from index: " << idx;
+                for (size_t i = 0; i < ids.size(); i++) {
+                    const idx_t id = ids[i];
+                    for (auto idx : mappings[i]) {
+                        if (posting_format == PostingFormat::BLOCKS) {
+                            auto status = batch.Merge(
+                                    column_families[kPostingsColumnIndex],
+                                    create_posting_block_key(
+                                            tenant, field, idx, id),
+                                    encode_posting_operand({}, {id}));
+                            LINTDB_THROW_IF_NOT_FMT(
+                                    status.ok(),
+                                    "%s",
+                                    status.ToString().c_str());
+                            continue;
+                        }
                         // colbert fields are always tensors, and tensors are
                         // always quantized in the index.
-                        std::string key = create_index_id(
-                                tenant,
-                                field,
-                                DataType::QUANTIZED_TENSOR,
-                                idx,
-                                id);
-                        rocksdb::WriteOptions wo;
-                        rocksdb::Status status = db_->Delete(
-                                wo,
-                                column_families[kIndexColumnIndex],
-                                rocksdb::Slice(key));
-                        assert(status.ok());
+                        delete_key(
+                                kIndexColumnIndex,
+                                create_index_id(
+                                        tenant,
+                                        field,
+                                        DataType::QUANTIZED_TENSOR,
+                                        idx,
+                                        id));
                     }
 
                     std::string key = create_context_id(tenant, field, id);
-                    rocksdb::WriteOptions wo;
-                    rocksdb::Status status = db_->Delete(
-                            wo,
-                            column_families[kCodesColumnIndex],
-                            rocksdb::Slice(key));
-                    assert(status.ok());
+                    delete_key(kCodesColumnIndex, key);
+                    delete_key(kResidualsColumnIndex, key);
                 }
             }
         }
     }
+
+    if (batch.Count() == 0) {
+        return;
+    }
+    rocksdb::WriteOptions wo;
+    auto status = db_->Write(wo, &batch);
+    LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+}
+
+std::vector<std::vector<idx_t>> RocksdbInvertedList::get_mappings(
+        const uint64_t tenant,
+        const std::vector<idx_t>& ids) const {
+    std::vector<std::string> keys;
+    keys.reserve(ids.size());
+    for (const auto id : ids) {
+        keys.push_back(create_forward_index_id(tenant, id));
+    }
+
+    std::vector<std::string> values;
+    multi_get(kMappingColumnIndex, keys, values);
+
+    // a document without a mapping has nothing in the index to delete.
+    std::vector<std::vector<idx_t>> mappings(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (!values[i].empty()) {
+            mappings[i] = DocEncoder::decode_inverted_mapping_data(values[i]);
+        }
+    }
+    return mappings;
 }
 
 std::vector<idx_t> RocksdbInvertedList::get_mapping(
@@ -116,42 +159,80 @@ std::vector<idx_t> RocksdbInvertedList::get_mapping(
     }
 }
 
-// merge uses the index and mapping column families.
+namespace {
+// tenant (8 bytes), field (1 byte), data type (1 byte), centroid (8 bytes).
+const size_t kPostingPrefixSize = 10 + sizeof(idx_t);
+
+std::vector<std::string> context_keys(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids) {
+    std::vector<std::string> keys;
+    keys.reserve(doc_ids.size());
+    for (const auto doc_id : doc_ids) {
+        keys.push_back(create_context_id(tenant, field_id, doc_id));
+    }
+    return keys;
+}
+} // namespace
+
+// merge uses the index, postings, and mapping column families.
 void RocksdbInvertedList::merge(
         rocksdb::DB* db,
-        std::vector<rocksdb::ColumnFamilyHandle*>& cfs) {
+        std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+        BulkIndexWriter& writer) {
     // very weak check to make sure the column families are the same.
     LINTDB_THROW_IF_NOT(cfs.size() == column_families.size());
 
-    auto cf = cfs[kIndexColumnIndex];
+    // both indexes store postings in the same format, so their keys are
+    // copied as they are.
     rocksdb::ReadOptions ro;
-    auto it = db->NewIterator(ro, cf);
-    it->SeekToFirst();
-    rocksdb::WriteOptions wo;
-    while (it->Valid()) {
-        auto key = it->key();
-        auto value = it->value();
-        auto status =
-                db_->Put(wo, column_families[kIndexColumnIndex], key, value);
-        assert(status.ok());
-        it->Next();
+    writer.add_sorted(
+            kMappingColumnIndex,
+            std::unique_ptr<rocksdb::Iterator>(
+                    db->NewIterator(ro, cfs[kMappingColumnIndex])));
+    writer.add_sorted(
+            kIndexColumnIndex,
+            std::unique_ptr<rocksdb::Iterator>(
+                    db->NewIterator(ro, cfs[kIndexColumnIndex])));
+
+    if (posting_format == PostingFormat::BLOCKS) {
+        merge_postings(db, cfs, writer);
     }
+}
+
+void RocksdbInvertedList::merge_postings(
+        rocksdb::DB* db,
+        std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+        BulkIndexWriter& writer) {
+    rocksdb::ReadOptions ro;
+    std::unique_ptr<rocksdb::Iterator> block_it(
+            db->NewIterator(ro, cfs[kPostingsColumnIndex]));
+    for (block_it->SeekToFirst(); block_it->Valid(); block_it->Next()) {
+        auto value = block_it->value();
+        std::vector<idx_t> doc_ids;
+        decode_posting_blocks(value.data(), value.size(), doc_ids);
 
-    auto map_cf = cfs[kMappingColumnIndex];
-    auto map_it = db->NewIterator(ro, map_cf);
-    map_it->SeekToFirst();
-    while (map_it->Valid()) {
-        auto key = map_it->key();
-        auto value = map_it->value();
-        auto status =
-                db_->Put(wo, column_families[kMappingColumnIndex], key, value);
-        assert(status.ok());
-        map_it->Next();
+        // an operand adds the ids to any list we already have.
+        writer.put(
+                kPostingsColumnIndex,
+                block_it->key().ToString(),
+                encode_posting_operand(doc_ids, {}));
     }
 }
 
 std::unique_ptr<Iterator> RocksdbInvertedList::get_iterator(
         const std::string& prefix) const {
+    if (posting_format == PostingFormat::BLOCKS &&
+        prefix.size() == kPostingPrefixSize &&
+        DataType(uint8_t(prefix[9])) == DataType::QUANTIZED_TENSOR) {
+        auto it = std::make_unique<BlockPostingIterator>(
+                db_, column_families[kPostingsColumnIndex], prefix);
+        if (it->is_valid()) {
+            return it;
+        }
+        // indexed tensor fields still use per-document keys.
+    }
     return std::make_unique<RocksDBIterator>(
             db_, column_families[kIndexColumnIndex], prefix);
 }
@@ -162,4 +243,104 @@ std::unique_ptr<ContextIterator> RocksdbInvertedList::get_context_iterator(
     return std::make_unique<ContextIterator>(
             db_, column_families[kCodesColumnIndex], tenant, field_id);
 }
-} // namespace lintdb
\ No newline at end of file
+
+void RocksdbInvertedList::get_contexts(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        std::vector<std::string>& values) const {
+    multi_get(kCodesColumnIndex, tenant, field_id, doc_ids, values);
+}
+
+void RocksdbInvertedList::get_residuals(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        std::vector<std::string>& values) const {
+    multi_get(kResidualsColumnIndex, tenant, field_id, doc_ids, values);
+}
+
+void RocksdbInvertedList::visit_contexts(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        const ValueVisitor& visit) const {
+    multi_get(
+            kCodesColumnIndex,
+            context_keys(tenant, field_id, doc_ids),
+            visit);
+}
+
+void RocksdbInvertedList::visit_residuals(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        const ValueVisitor& visit) const {
+    multi_get(
+            kResidualsColumnIndex,
+            context_keys(tenant, field_id, doc_ids),
+            visit);
+}
+
+void RocksdbInvertedList::multi_get(
+        column_index_t column_index,
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        std::vector<std::string>& values) const {
+    multi_get(column_index, context_keys(tenant, field_id, doc_ids), values);
+}
+
+void RocksdbInvertedList::multi_get(
+        column_index_t column_index,
+        const std::vector<std::string>& keys,
+        std::vector<std::string>& values) const {
+    values.assign(keys.size(), std::string());
+    multi_get(column_index, keys, [&values](size_t i, std::string_view value) {
+        values[i].assign(value.data(), value.size());
+    });
+}
+
+void RocksdbInvertedList::multi_get(
+        column_index_t column_index,
+        const std::vector<std::string>& key_strings,
+        const ValueVisitor& visit) const {
+    const size_t num_keys = key_strings.size();
+    if (num_keys == 0) {
+        return;
+    }
+
+    // rocksdb slices don't own their data, so the caller keeps the keys.
+    std::vector<rocksdb::Slice> keys(key_strings.begin(), key_strings.end());
+
+    // MultiGet batches the block lookups, and async_io lets rocksdb read the
+    // data blocks of different keys in parallel.
+    rocksdb::ReadOptions ro;
+    ro.async_io = true;
+    std::vector<rocksdb::PinnableSlice> pinned(num_keys);
+    std::vector<rocksdb::Status> statuses(num_keys);
+    db_->MultiGet(
+            ro,
+            column_families[column_index],
+            num_keys,
+            keys.data(),
+            pinned.data(),
+            statuses.data(),
+            std::is_sorted(key_strings.begin(), key_strings.end()));
+
+    // the pinned slices point into the block cache, so values are visited
+    // without a copy.
+    for (size_t i = 0; i < num_keys; i++) {
+        if (statuses[i].ok()) {
+            visit(i, std::string_view(pinned[i].data(), pinned[i].size()));
+            pinned[i].Reset();
+        } else {
+            if (!statuses[i].IsNotFound()) {
+                LOG(WARNING)
+                        << "failed to read key: " << statuses[i].ToString();
+            }
+            visit(i, std::string_view());
+        }
+    }
+}
+} // namespace lintdb
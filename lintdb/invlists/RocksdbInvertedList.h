@@ -13,6 +13,7 @@
 #include "lintdb/invlists/ContextIterator.h"
 #include "lintdb/invlists/InvertedList.h"
 #include "lintdb/invlists/Iterator.h"
+#include "lintdb/invlists/PostingBlocks.h"
 #include "lintdb/version.h"
 
 namespace lintdb {
@@ -23,12 +24,16 @@ namespace lintdb {
  *
  * This inverted list is only capable of telling us what documents are
  * associated with what centroids.
+ *
+ * With PostingFormat::BLOCKS, ColBERT posting lists live in the postings
+ * column family as block encoded lists instead of one key per document.
  */
 struct RocksdbInvertedList : public InvertedList {
     RocksdbInvertedList(
             std::shared_ptr<rocksdb::DB> db,
             std::vector<rocksdb::ColumnFamilyHandle*>& column_families,
-            const Version& version);
+            const Version& version,
+            PostingFormat posting_format = PostingFormat::KEYS);
 
     void remove(
             const uint64_t tenant,
@@ -36,8 +41,10 @@ struct RocksdbInvertedList : public InvertedList {
             const uint8_t field,
             const DataType data_type,
             const std::vector<FieldType> field_types) override;
-    void merge(rocksdb::DB* db, std::vector<rocksdb::ColumnFamilyHandle*>& cfs)
-            override;
+    void merge(
+            rocksdb::DB* db,
+            std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+            BulkIndexWriter& writer) override;
 
     std::vector<idx_t> get_mapping(const uint64_t tenant, idx_t id)
             const override;
@@ -49,8 +56,61 @@ struct RocksdbInvertedList : public InvertedList {
             const uint64_t tenant,
             const uint8_t field_id) const override;
 
+    void get_contexts(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            std::vector<std::string>& values) const override;
+
+    void get_residuals(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            std::vector<std::string>& values) const override;
+
+    void visit_contexts(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            const ValueVisitor& visit) const override;
+
+    void visit_residuals(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            const ValueVisitor& visit) const override;
+
    protected:
+    /// reads the per-document values of a field from a column family.
+    void multi_get(
+            column_index_t column_index,
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            std::vector<std::string>& values) const;
+    /// reads the values of keys from a column family. Missing keys are empty.
+    void multi_get(
+            column_index_t column_index,
+            const std::vector<std::string>& keys,
+            std::vector<std::string>& values) const;
+    /// visits the values of keys in a column family. Missing keys are empty.
+    void multi_get(
+            column_index_t column_index,
+            const std::vector<std::string>& keys,
+            const ValueVisitor& visit) const;
+    /// reads the mappings of many documents with one MultiGet.
+    std::vector<std::vector<idx_t>> get_mappings(
+            const uint64_t tenant,
+            const std::vector<idx_t>& ids) const;
+
+    /// adds the other index's block lists to ours.
+    void merge_postings(
+            rocksdb::DB* db,
+            std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+            BulkIndexWriter& writer);
+
     Version version;
+    PostingFormat posting_format;
     std::shared_ptr<rocksdb::DB> db_;
     std::vector<rocksdb::ColumnFamilyHandle*>& column_families;
 };
@@ -0,0 +1,600 @@
+#include "lintdb/invlists/Segment.h"
+#include <fcntl.h>
+#include <glog/logging.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include "lintdb/assert.h"
+#include "lintdb/constants.h"
+#include "lintdb/exception.h"
+#include "lintdb/invlists/PostingBlocks.h"
+#include "lintdb/invlists/Tombstones.h"
+#include "lintdb/utils/endian.h"
+
+namespace lintdb {
+namespace {
+const uint32_t kTableMagic = 0x4c544254;    // "LTBT"
+const uint32_t kPostingsMagic = 0x4c545053; // "LTPS"
+const uint32_t kSegmentVersion = 2;
+// marks a posting list whose postings have no values.
+const uint64_t kNoValues = std::numeric_limits<uint64_t>::max();
+
+const char* kPostingsFile = "postings.bin";
+const char* kCodesFile = "codes.bin";
+const char* kResidualsFile = "residuals.bin";
+const char* kMappingFile = "mapping.bin";
+const char* kForwardFile = "forward.bin";
+
+// headers are a multiple of 8 bytes, so the offset arrays that follow them
+// are aligned within the mapping.
+struct TableHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    uint64_t key_bytes;
+    uint64_t value_bytes;
+};
+
+struct PostingsHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t num_lists;
+    uint64_t num_postings;
+    uint64_t num_value_offsets;
+    uint64_t prefix_bytes;
+    uint64_t value_bytes;
+};
+
+// every posting key ends with the doc id.
+const size_t kDocIdSize = sizeof(idx_t);
+
+std::string_view view(const rocksdb::Slice& slice) {
+    return std::string_view(slice.data(), slice.size());
+}
+
+/// key starts with the tenant. Deleted documents aren't exported.
+bool is_deleted(
+        const Tombstones* tombstones,
+        std::string_view key,
+        idx_t doc_id) {
+    if (!tombstones) {
+        return false;
+    }
+    return tombstones->is_deleted(load_bigendian<uint64_t>(key.data()), doc_id);
+}
+
+template <typename T>
+void write_array(std::ofstream& out, const std::vector<T>& data) {
+    out.write(
+            reinterpret_cast<const char*>(data.data()),
+            data.size() * sizeof(T));
+}
+
+/**
+ * SpillFile streams one section of a segment file to a temporary file, so the
+ * section doesn't have to be held in memory. The file is removed with the
+ * object.
+ */
+class SpillFile {
+   public:
+    explicit SpillFile(const std::string& path)
+            : path(path), out(path, std::ios::binary | std::ios::trunc) {
+        LINTDB_THROW_IF_NOT_MSG(out.is_open(), "could not write segment");
+    }
+    ~SpillFile() {
+        out.close();
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+
+    void write(const void* data, size_t size) {
+        out.write(static_cast<const char*>(data), size);
+        bytes += size;
+    }
+    uint64_t size() const {
+        return bytes;
+    }
+
+    /// copy_to appends the section to dest.
+    void copy_to(std::ofstream& dest) {
+        out.close();
+        LINTDB_THROW_IF_NOT_MSG(!out.fail(), "could not write segment");
+        // streaming an empty file sets failbit on dest.
+        if (bytes == 0) {
+            return;
+        }
+        std::ifstream in(path, std::ios::binary);
+        dest << in.rdbuf();
+    }
+
+   private:
+    std::string path;
+    std::ofstream out;
+    uint64_t bytes = 0;
+};
+
+void write_offset(SpillFile& file, uint64_t offset) {
+    file.write(&offset, sizeof(offset));
+}
+
+/// TableBuilder streams the keys of a table, which must be added in order, to
+/// path.
+class TableBuilder {
+   public:
+    explicit TableBuilder(const std::string& path)
+            : path(path),
+              key_offsets(path + ".key_offsets"),
+              value_offsets(path + ".value_offsets"),
+              keys(path + ".keys"),
+              values(path + ".values") {
+        write_offset(key_offsets, 0);
+        write_offset(value_offsets, 0);
+    }
+
+    void add(std::string_view key, std::string_view value) {
+        LINTDB_THROW_IF_NOT_MSG(
+                count == 0 || last_key < key,
+                "segment keys must be added in order");
+        last_key.assign(key);
+        keys.write(key.data(), key.size());
+        values.write(value.data(), value.size());
+        write_offset(key_offsets, keys.size());
+        write_offset(value_offsets, values.size());
+        count++;
+    }
+
+    /// finish writes the table file from the offsets and the spilled
+    /// sections.
+    void finish() {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        LINTDB_THROW_IF_NOT_MSG(out.is_open(), "could not write segment");
+
+        TableHeader header{
+                kTableMagic,
+                kSegmentVersion,
+                count,
+                keys.size(),
+                values.size()};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        key_offsets.copy_to(out);
+        value_offsets.copy_to(out);
+        keys.copy_to(out);
+        values.copy_to(out);
+        LINTDB_THROW_IF_NOT_MSG(out.good(), "could not write segment");
+    }
+
+   private:
+    std::string path;
+    uint64_t count = 0;
+    std::string last_key;
+    SpillFile key_offsets;
+    SpillFile value_offsets;
+    SpillFile keys;
+    SpillFile values;
+};
+
+/**
+ * PostingsBuilder streams postings, which must be added sorted by prefix and
+ * then doc id, to path.
+ *
+ * Only lists that have a value get value offsets. ColBERT postings never
+ * have one, so their lists cost just their doc ids. Everything that grows
+ * with the number of postings is spilled; only per list offsets are kept.
+ */
+class PostingsBuilder {
+   public:
+    explicit PostingsBuilder(const std::string& path)
+            : path(path),
+              prefixes(path + ".prefixes"),
+              doc_ids(path + ".doc_ids"),
+              value_offsets(path + ".value_offsets"),
+              values(path + ".values") {}
+
+    void add(std::string_view prefix, idx_t doc_id, std::string_view value) {
+        const bool is_empty = list_offsets.size() == 1;
+        if (is_empty || last_prefix != prefix) {
+            LINTDB_THROW_IF_NOT_MSG(
+                    is_empty || last_prefix < prefix,
+                    "segment postings must be added in order");
+            last_prefix.assign(prefix);
+            prefixes.write(prefix.data(), prefix.size());
+            prefix_offsets.push_back(prefixes.size());
+            list_offsets.push_back(num_postings);
+            value_starts.push_back(kNoValues);
+        } else {
+            LINTDB_THROW_IF_NOT_MSG(
+                    last_doc_id < doc_id,
+                    "segment postings must be added in order");
+        }
+        last_doc_id = doc_id;
+        doc_ids.write(&doc_id, sizeof(doc_id));
+
+        if (value_starts.back() == kNoValues && !value.empty()) {
+            // the list's earlier postings are empty, so their offsets all
+            // point at the start of its first value.
+            value_starts.back() = num_value_offsets;
+            const size_t earlier = list_offsets.back() -
+                    list_offsets[list_offsets.size() - 2];
+            for (size_t i = 0; i <= earlier; i++) {
+                write_offset(value_offsets, values.size());
+            }
+            num_value_offsets += earlier + 1;
+        }
+        if (value_starts.back() != kNoValues) {
+            values.write(value.data(), value.size());
+            write_offset(value_offsets, values.size());
+            num_value_offsets++;
+        }
+        list_offsets.back() = ++num_postings;
+    }
+
+    /// finish writes the postings file from the offsets and the spilled
+    /// sections.
+    void finish() {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        LINTDB_THROW_IF_NOT_MSG(out.is_open(), "could not write segment");
+
+        PostingsHeader header{
+                kPostingsMagic,
+                kSegmentVersion,
+                prefix_offsets.size() - 1,
+                num_postings,
+                num_value_offsets,
+                prefixes.size(),
+                values.size()};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        write_array(out, prefix_offsets);
+        write_array(out, list_offsets);
+        write_array(out, value_starts);
+        doc_ids.copy_to(out);
+        value_offsets.copy_to(out);
+        prefixes.copy_to(out);
+        values.copy_to(out);
+        LINTDB_THROW_IF_NOT_MSG(out.good(), "could not write segment");
+    }
+
+   private:
+    std::string path;
+    std::vector<uint64_t> prefix_offsets{0};
+    std::vector<uint64_t> list_offsets{0};
+    /// where each list's value offsets start, or kNoValues.
+    std::vector<uint64_t> value_starts;
+    uint64_t num_postings = 0;
+    uint64_t num_value_offsets = 0;
+    std::string last_prefix;
+    idx_t last_doc_id = 0;
+    SpillFile prefixes;
+    SpillFile doc_ids;
+    SpillFile value_offsets;
+    SpillFile values;
+};
+
+/// keys of tables start with the tenant and end with the doc id.
+void write_table(
+        rocksdb::DB* db,
+        rocksdb::ColumnFamilyHandle* cf,
+        const std::string& path,
+        const Tombstones* tombstones) {
+    TableBuilder builder(path);
+    std::unique_ptr<rocksdb::Iterator> it(
+            db->NewIterator(rocksdb::ReadOptions(), cf));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        auto key = view(it->key());
+        if (is_deleted(
+                    tombstones,
+                    key,
+                    load_bigendian<idx_t>(
+                            key.data() + key.size() - kDocIdSize))) {
+            continue;
+        }
+        builder.add(key, view(it->value()));
+    }
+    LINTDB_THROW_IF_NOT_MSG(it->status().ok(), "could not read index");
+    builder.finish();
+}
+
+/**
+ * BlockListCursor walks the block encoded lists of the postings column
+ * family as individual postings. Block list keys are the posting prefix
+ * followed by a doc id range, and ranges are in doc id order.
+ */
+class BlockListCursor {
+   public:
+    BlockListCursor(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* cf)
+            : it(db->NewIterator(rocksdb::ReadOptions(), cf)) {
+        it->SeekToFirst();
+        load();
+    }
+
+    bool is_valid() const {
+        return pos < doc_ids.size();
+    }
+    std::string_view prefix() const {
+        return prefix_;
+    }
+    idx_t doc_id() const {
+        return doc_ids[pos];
+    }
+    void next() {
+        pos++;
+        if (pos == doc_ids.size()) {
+            it->Next();
+            load();
+        }
+    }
+
+   private:
+    // decodes the current key, skipping keys whose lists are empty.
+    void load() {
+        doc_ids.clear();
+        pos = 0;
+        for (; it->Valid(); it->Next()) {
+            auto key = it->key();
+            prefix_.assign(key.data(), key.size() - kDocIdSize);
+            decode_posting_blocks(
+                    it->value().data(), it->value().size(), doc_ids);
+            if (!doc_ids.empty()) {
+                return;
+            }
+        }
+    }
+
+    std::unique_ptr<rocksdb::Iterator> it;
+    std::string prefix_;
+    std::vector<idx_t> doc_ids;
+    size_t pos = 0;
+};
+
+void write_postings(
+        rocksdb::DB* db,
+        std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+        const std::string& path,
+        const Tombstones* tombstones) {
+    PostingsBuilder builder(path);
+
+    std::unique_ptr<rocksdb::Iterator> it(
+            db->NewIterator(rocksdb::ReadOptions(), cfs[kIndexColumnIndex]));
+    it->SeekToFirst();
+    BlockListCursor blocks(db, cfs[kPostingsColumnIndex]);
+
+    // both column families are sorted by (prefix, doc id), so a two way
+    // merge keeps the postings in order. A document in both keeps the index
+    // posting, which can have a value.
+    while (it->Valid() || blocks.is_valid()) {
+        std::string_view key_prefix;
+        idx_t key_doc_id = 0;
+        if (it->Valid()) {
+            auto key = view(it->key());
+            key_prefix = key.substr(0, key.size() - kDocIdSize);
+            key_doc_id = load_bigendian<idx_t>(
+                    key.data() + key.size() - kDocIdSize);
+        }
+
+        bool use_block = false;
+        if (blocks.is_valid()) {
+            use_block = !it->Valid() ||
+                    std::make_pair(blocks.prefix(), blocks.doc_id()) <
+                            std::make_pair(key_prefix, key_doc_id);
+        }
+
+        if (use_block) {
+            if (!is_deleted(tombstones, blocks.prefix(), blocks.doc_id())) {
+                builder.add(blocks.prefix(), blocks.doc_id(), "");
+            }
+            blocks.next();
+            continue;
+        }
+        if (!is_deleted(tombstones, key_prefix, key_doc_id)) {
+            builder.add(key_prefix, key_doc_id, view(it->value()));
+        }
+        if (blocks.is_valid() && blocks.prefix() == key_prefix &&
+            blocks.doc_id() == key_doc_id) {
+            blocks.next();
+        }
+        it->Next();
+    }
+    LINTDB_THROW_IF_NOT_MSG(it->status().ok(), "could not read index");
+    builder.finish();
+}
+
+template <typename Header>
+const Header& read_header(const MappedFile& file, uint32_t magic) {
+    LINTDB_THROW_IF_NOT_MSG(
+            file.size() >= sizeof(Header), "segment file is truncated");
+    const Header& header = *reinterpret_cast<const Header*>(file.data());
+    LINTDB_THROW_IF_NOT_MSG(
+            header.magic == magic, "segment file has the wrong format");
+    LINTDB_THROW_IF_NOT_FMT(
+            header.version == kSegmentVersion,
+            "unsupported segment version %u",
+            header.version);
+    return header;
+}
+} // namespace
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw LintDBException("Could not open file: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw LintDBException("Could not read file: " + path);
+    }
+    size_ = st.st_size;
+
+    void* ptr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping keeps its own reference to the file.
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        throw LintDBException("Could not map file: " + path);
+    }
+    data_ = static_cast<const char*>(ptr);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+SegmentTable::SegmentTable(const std::string& path) : file(path) {
+    const auto& header = read_header<TableHeader>(file, kTableMagic);
+    count = header.count;
+
+    const size_t offsets_size = (count + 1) * sizeof(uint64_t);
+    LINTDB_THROW_IF_NOT_MSG(
+            file.size() ==
+                    sizeof(header) + 2 * offsets_size + header.key_bytes +
+                            header.value_bytes,
+            "segment file is truncated");
+
+    const char* ptr = file.data() + sizeof(header);
+    key_offsets = reinterpret_cast<const uint64_t*>(ptr);
+    value_offsets = reinterpret_cast<const uint64_t*>(ptr + offsets_size);
+    keys = ptr + 2 * offsets_size;
+    values = keys + header.key_bytes;
+}
+
+std::string_view SegmentTable::key(size_t i) const {
+    return std::string_view(
+            keys + key_offsets[i], key_offsets[i + 1] - key_offsets[i]);
+}
+
+std::string_view SegmentTable::value(size_t i) const {
+    return std::string_view(
+            values + value_offsets[i], value_offsets[i + 1] - value_offsets[i]);
+}
+
+size_t SegmentTable::lower_bound(std::string_view target) const {
+    size_t lo = 0;
+    size_t hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (key(mid) < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool SegmentTable::find(std::string_view target, std::string_view& value)
+        const {
+    size_t i = lower_bound(target);
+    if (i == count || key(i) != target) {
+        return false;
+    }
+    value = this->value(i);
+    return true;
+}
+
+SegmentPostings::SegmentPostings(const std::string& path) : file(path) {
+    const auto& header = read_header<PostingsHeader>(file, kPostingsMagic);
+    num_lists = header.num_lists;
+    num_postings = header.num_postings;
+
+    const size_t list_offsets_size = (num_lists + 1) * sizeof(uint64_t);
+    const size_t value_starts_size = num_lists * sizeof(uint64_t);
+    const size_t doc_ids_size = num_postings * sizeof(idx_t);
+    const size_t value_offsets_size =
+            header.num_value_offsets * sizeof(uint64_t);
+    LINTDB_THROW_IF_NOT_MSG(
+            file.size() ==
+                    sizeof(header) + 2 * list_offsets_size +
+                            value_starts_size + doc_ids_size +
+                            value_offsets_size + header.prefix_bytes +
+                            header.value_bytes,
+            "segment file is truncated");
+
+    const char* ptr = file.data() + sizeof(header);
+    prefix_offsets = reinterpret_cast<const uint64_t*>(ptr);
+    ptr += list_offsets_size;
+    list_offsets = reinterpret_cast<const uint64_t*>(ptr);
+    ptr += list_offsets_size;
+    value_starts = reinterpret_cast<const uint64_t*>(ptr);
+    ptr += value_starts_size;
+    doc_ids_ = reinterpret_cast<const idx_t*>(ptr);
+    ptr += doc_ids_size;
+    value_offsets = reinterpret_cast<const uint64_t*>(ptr);
+    ptr += value_offsets_size;
+    prefixes = ptr;
+    values = prefixes + header.prefix_bytes;
+}
+
+std::string_view SegmentPostings::prefix(size_t list) const {
+    return std::string_view(
+            prefixes + prefix_offsets[list],
+            prefix_offsets[list + 1] - prefix_offsets[list]);
+}
+
+bool SegmentPostings::find(
+        std::string_view target,
+        size_t& list,
+        size_t& begin,
+        size_t& end) const {
+    size_t lo = 0;
+    size_t hi = num_lists;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (prefix(mid) < target) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == num_lists || prefix(lo) != target) {
+        return false;
+    }
+    list = lo;
+    begin = list_offsets[lo];
+    end = list_offsets[lo + 1];
+    return true;
+}
+
+std::string_view SegmentPostings::value(size_t list, size_t posting) const {
+    if (value_starts[list] == kNoValues) {
+        return std::string_view();
+    }
+    const uint64_t* offsets =
+            value_offsets + value_starts[list] + posting - list_offsets[list];
+    return std::string_view(values + offsets[0], offsets[1] - offsets[0]);
+}
+
+Segment::Segment(const std::string& dir)
+        : postings(dir + "/" + kPostingsFile),
+          codes(dir + "/" + kCodesFile),
+          residuals(dir + "/" + kResidualsFile),
+          mapping(dir + "/" + kMappingFile),
+          forward(dir + "/" + kForwardFile) {}
+
+void write_segment(
+        rocksdb::DB* db,
+        std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+        const std::string& dir,
+        const Tombstones* tombstones) {
+    LINTDB_THROW_IF_NOT(cfs.size() > kPostingsColumnIndex);
+    std::filesystem::create_directories(dir);
+
+    LOG(INFO) << "writing segment to: " << dir;
+    write_postings(db, cfs, dir + "/" + kPostingsFile, tombstones);
+    write_table(db, cfs[kCodesColumnIndex], dir + "/" + kCodesFile, tombstones);
+    write_table(
+            db,
+            cfs[kResidualsColumnIndex],
+            dir + "/" + kResidualsFile,
+            tombstones);
+    write_table(
+            db, cfs[kMappingColumnIndex], dir + "/" + kMappingFile, tombstones);
+    write_table(db, cfs[kDocColumnIndex], dir + "/" + kForwardFile, tombstones);
+}
+
+} // namespace lintdb
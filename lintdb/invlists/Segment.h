@@ -0,0 +1,151 @@
+#ifndef LINTDB_INVLISTS_SEGMENT_H
+#define LINTDB_INVLISTS_SEGMENT_H
+
+#include <rocksdb/db.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "lintdb/api.h"
+
+namespace lintdb {
+class Tombstones;
+
+/// segments are exported into this directory of the index path.
+static const std::string kSegmentDirectory = "segment";
+
+/**
+ * MappedFile maps a whole file read-only. The mapping lives as long as the
+ * object.
+ */
+class MappedFile {
+   public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {
+        return data_;
+    }
+    size_t size() const {
+        return size_;
+    }
+
+   private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+/**
+ * SegmentTable is an immutable table of sorted keys and their values, e.g.
+ * the codes or the forward store of a segment.
+ *
+ * Layout: a header, key offsets (count + 1), value offsets (count + 1), then
+ * every key and every value back to back. Keys and values are returned as
+ * views into the mapping.
+ */
+class SegmentTable {
+   public:
+    explicit SegmentTable(const std::string& path);
+
+    size_t size() const {
+        return count;
+    }
+    std::string_view key(size_t i) const;
+    std::string_view value(size_t i) const;
+
+    /// lower_bound returns the position of the first key >= key.
+    size_t lower_bound(std::string_view key) const;
+    /// find returns false if the table doesn't have key.
+    bool find(std::string_view key, std::string_view& value) const;
+
+   private:
+    MappedFile file;
+    size_t count;
+    const uint64_t* key_offsets;
+    const uint64_t* value_offsets;
+    const char* keys;
+    const char* values;
+};
+
+/**
+ * SegmentPostings stores every posting list of a segment in compressed
+ * sparse row form.
+ *
+ * A list is identified by its prefix, which is the index key without the doc
+ * id, e.g. (tenant, field, type, centroid). Lists are sorted by prefix, and
+ * list i owns postings [list_offsets[i], list_offsets[i + 1]). Postings hold
+ * a doc id and an optional value.
+ *
+ * Most lists, e.g. every ColBERT list, have no values and store only doc
+ * ids. A list with values has value offsets (its length + 1) starting at
+ * value_starts[i]; value_starts[i] is UINT64_MAX for a list without.
+ */
+class SegmentPostings {
+   public:
+    explicit SegmentPostings(const std::string& path);
+
+    /// find returns false if there isn't a list for prefix.
+    bool find(
+            std::string_view prefix,
+            size_t& list,
+            size_t& begin,
+            size_t& end) const;
+
+    /// doc ids of every posting. A list's doc ids are sorted.
+    const idx_t* doc_ids() const {
+        return doc_ids_;
+    }
+    /// value of a posting in list. It's empty if the list has no values.
+    std::string_view value(size_t list, size_t posting) const;
+
+   private:
+    std::string_view prefix(size_t list) const;
+
+    MappedFile file;
+    size_t num_lists;
+    size_t num_postings;
+    const uint64_t* prefix_offsets;
+    const uint64_t* list_offsets;
+    const uint64_t* value_starts;
+    const idx_t* doc_ids_;
+    const uint64_t* value_offsets;
+    const char* prefixes;
+    const char* values;
+};
+
+/**
+ * Segment is an immutable, memory mapped copy of an index. It's written once
+ * by `write_segment` and only ever read afterwards.
+ */
+struct Segment {
+    explicit Segment(const std::string& dir);
+
+    SegmentPostings postings;
+    SegmentTable codes;
+    SegmentTable residuals;
+    SegmentTable mapping;
+    SegmentTable forward;
+};
+
+/**
+ * write_segment exports the contents of an index's column families into a
+ * segment at dir.
+ *
+ * Posting lists are read from both the index and the postings column
+ * families, so either posting format can be exported. Keys and values are
+ * streamed through temporary files next to the segment, and only their
+ * offsets are held in memory. Documents with tombstones are left out.
+ */
+void write_segment(
+        rocksdb::DB* db,
+        std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+        const std::string& dir,
+        const Tombstones* tombstones = nullptr);
+
+} // namespace lintdb
+
+#endif // LINTDB_INVLISTS_SEGMENT_H
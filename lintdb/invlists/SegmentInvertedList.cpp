@@ -0,0 +1,229 @@
+#include "lintdb/invlists/SegmentInvertedList.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include "lintdb/exception.h"
+#include "lintdb/invlists/KeyBuilder.h"
+#include "lintdb/schema/DocEncoder.h"
+
+namespace lintdb {
+namespace {
+std::string_view find_value(
+        const SegmentTable& table,
+        const std::string& key) {
+    std::string_view value;
+    table.find(key, value);
+    return value;
+}
+
+void find_values(
+        const SegmentTable& table,
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        std::vector<std::string>& values) {
+    values.resize(doc_ids.size());
+    for (size_t i = 0; i < doc_ids.size(); i++) {
+        values[i] = std::string(find_value(
+                table, create_context_id(tenant, field_id, doc_ids[i])));
+    }
+}
+} // namespace
+
+SegmentPostingIterator::SegmentPostingIterator(
+        std::shared_ptr<const Segment> segment,
+        const std::string& prefix)
+        : segment(std::move(segment)), prefix(prefix) {
+    // a missing list leaves the iterator empty.
+    this->segment->postings.find(this->prefix, list, pos, end);
+}
+
+void SegmentPostingIterator::advance_to(const idx_t doc_id) {
+    const idx_t* doc_ids = segment->postings.doc_ids();
+    pos = std::lower_bound(doc_ids + pos, doc_ids + end, doc_id) - doc_ids;
+}
+
+InvertedIndexKey SegmentPostingIterator::get_key() const {
+    KeyBuilder kb;
+    std::string key =
+            kb.add(prefix).add(segment->postings.doc_ids()[pos]).build();
+    return InvertedIndexKey(key);
+}
+
+SegmentContextIterator::SegmentContextIterator(
+        std::shared_ptr<const Segment> segment,
+        const uint64_t tenant,
+        const uint8_t field)
+        : ContextIterator(tenant, field), segment(std::move(segment)) {
+    prefix = create_context_prefix(tenant, field);
+    pos = this->segment->codes.lower_bound(prefix);
+}
+
+bool SegmentContextIterator::is_valid() {
+    if (!has_read_key) {
+        if (pos >= segment->codes.size()) {
+            return false;
+        }
+        std::string key(segment->codes.key(pos));
+        if (key.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+        current_key = ContextKey(key);
+    }
+
+    has_read_key = true;
+    return true;
+}
+
+void SegmentContextIterator::advance(const idx_t doc_id) {
+    if (is_valid() && current_key.doc_id() >= doc_id) {
+        return;
+    }
+    pos = segment->codes.lower_bound(create_context_id(tenant, field, doc_id));
+    has_read_key = false;
+}
+
+void SegmentContextIterator::next() {
+    pos++;
+    has_read_key = false;
+}
+
+std::string SegmentContextIterator::get_value() const {
+    return std::string(segment->codes.value(pos));
+}
+
+SegmentInvertedList::SegmentInvertedList(std::shared_ptr<const Segment> segment)
+        : segment(std::move(segment)) {}
+
+void SegmentInvertedList::remove(
+        const uint64_t tenant,
+        std::vector<idx_t> ids,
+        const uint8_t field,
+        const DataType data_type,
+        const std::vector<FieldType> field_types) {
+    throw LintDBException("Segments are read only. Can not remove documents.");
+}
+
+void SegmentInvertedList::merge(
+        rocksdb::DB* db,
+        std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+        BulkIndexWriter& writer) {
+    throw LintDBException("Segments are read only. Can not merge indexes.");
+}
+
+std::vector<idx_t> SegmentInvertedList::get_mapping(
+        const uint64_t tenant,
+        idx_t id) const {
+    std::string_view value;
+    if (!segment->mapping.find(create_forward_index_id(tenant, id), value)) {
+        LOG(WARNING) << "Could not find mapping for doc id: " << id;
+        return {};
+    }
+    std::string data(value);
+    return DocEncoder::decode_inverted_mapping_data(data);
+}
+
+std::unique_ptr<Iterator> SegmentInvertedList::get_iterator(
+        const std::string& prefix) const {
+    return std::make_unique<SegmentPostingIterator>(segment, prefix);
+}
+
+std::unique_ptr<ContextIterator> SegmentInvertedList::get_context_iterator(
+        const uint64_t tenant,
+        const uint8_t field_id) const {
+    return std::make_unique<SegmentContextIterator>(segment, tenant, field_id);
+}
+
+void SegmentInvertedList::get_contexts(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        std::vector<std::string>& values) const {
+    find_values(segment->codes, tenant, field_id, doc_ids, values);
+}
+
+void SegmentInvertedList::get_residuals(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        std::vector<std::string>& values) const {
+    find_values(segment->residuals, tenant, field_id, doc_ids, values);
+}
+
+void SegmentInvertedList::visit_contexts(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        const ValueVisitor& visit) const {
+    for (size_t i = 0; i < doc_ids.size(); i++) {
+        visit(i, get_context_view(tenant, field_id, doc_ids[i]));
+    }
+}
+
+void SegmentInvertedList::visit_residuals(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const std::vector<idx_t>& doc_ids,
+        const ValueVisitor& visit) const {
+    for (size_t i = 0; i < doc_ids.size(); i++) {
+        visit(i, get_residuals_view(tenant, field_id, doc_ids[i]));
+    }
+}
+
+std::string_view SegmentInvertedList::get_context_view(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const idx_t doc_id) const {
+    return find_value(
+            segment->codes, create_context_id(tenant, field_id, doc_id));
+}
+
+std::string_view SegmentInvertedList::get_residuals_view(
+        const uint64_t tenant,
+        const uint8_t field_id,
+        const idx_t doc_id) const {
+    return find_value(
+            segment->residuals, create_context_id(tenant, field_id, doc_id));
+}
+
+SegmentForwardIndex::SegmentForwardIndex(std::shared_ptr<const Segment> segment)
+        : segment(std::move(segment)) {}
+
+std::vector<std::map<uint8_t, SupportedTypes>> SegmentForwardIndex::
+        get_metadata(const uint64_t tenant, const std::vector<idx_t>& ids)
+                const {
+    std::vector<std::map<uint8_t, SupportedTypes>> docs;
+    docs.reserve(ids.size());
+    for (const auto id : ids) {
+        std::string_view value;
+        if (segment->forward.find(create_forward_index_id(tenant, id), value) &&
+            !value.empty()) {
+            std::string data(value);
+            docs.push_back(DocEncoder::decode_forward_data(data));
+        } else {
+            LOG(ERROR) << "Could not find metadata for doc id: " << id;
+            docs.push_back({});
+        }
+    }
+    return docs;
+}
+
+void SegmentForwardIndex::remove(
+        const uint64_t tenant,
+        std::vector<idx_t> ids) {
+    throw LintDBException("Segments are read only. Can not remove documents.");
+}
+
+void SegmentForwardIndex::merge(
+        rocksdb::DB* db,
+        std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+        BulkIndexWriter& writer) {
+    throw LintDBException("Segments are read only. Can not merge indexes.");
+}
+
+std::unique_ptr<ForwardIndexIterator> SegmentForwardIndex::get_iterator(
+        const uint64_t tenant,
+        const idx_t inverted_list) const {
+    throw LintDBException("Segments don't support forward index iterators.");
+}
+
+} // namespace lintdb
@@ -0,0 +1,166 @@
+#ifndef LINTDB_INVLISTS_SEGMENT_INVERTED_LIST_H
+#define LINTDB_INVLISTS_SEGMENT_INVERTED_LIST_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "lintdb/api.h"
+#include "lintdb/invlists/ContextIterator.h"
+#include "lintdb/invlists/InvertedList.h"
+#include "lintdb/invlists/Iterator.h"
+#include "lintdb/invlists/Segment.h"
+
+namespace lintdb {
+/**
+ * SegmentPostingIterator iterates one posting list of a segment.
+ * advance_to is a binary search over the list's doc ids.
+ */
+struct SegmentPostingIterator : public lintdb::Iterator {
+    SegmentPostingIterator(
+            std::shared_ptr<const Segment> segment,
+            const std::string& prefix);
+
+    bool is_valid() override {
+        return pos < end;
+    }
+
+    void next() override {
+        pos++;
+    }
+
+    void advance_to(const idx_t doc_id) override;
+
+    InvertedIndexKey get_key() const override;
+
+    std::string get_value() const override {
+        return std::string(segment->postings.value(list, pos));
+    }
+
+   private:
+    std::shared_ptr<const Segment> segment;
+    std::string prefix;
+    size_t list = 0;
+    size_t pos = 0;
+    size_t end = 0;
+};
+
+/**
+ * SegmentContextIterator walks the codes of a field in a segment.
+ */
+class SegmentContextIterator : public ContextIterator {
+   public:
+    SegmentContextIterator(
+            std::shared_ptr<const Segment> segment,
+            const uint64_t tenant,
+            const uint8_t field);
+
+    bool is_valid() override;
+    void advance(const idx_t doc_id) override;
+    void next() override;
+    std::string get_value() const override;
+
+   private:
+    std::shared_ptr<const Segment> segment;
+    size_t pos;
+};
+
+/**
+ * SegmentInvertedList serves retrieval from a memory mapped segment. Lookups
+ * don't go through RocksDB, and the `*_view` methods return values without
+ * copying them out of the mapping.
+ *
+ * Segments are immutable, so remove and merge throw.
+ */
+struct SegmentInvertedList : public InvertedList {
+    explicit SegmentInvertedList(std::shared_ptr<const Segment> segment);
+
+    void remove(
+            const uint64_t tenant,
+            std::vector<idx_t> ids,
+            const uint8_t field,
+            const DataType data_type,
+            const std::vector<FieldType> field_types) override;
+    void merge(
+            rocksdb::DB* db,
+            std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+            BulkIndexWriter& writer) override;
+
+    std::vector<idx_t> get_mapping(const uint64_t tenant, idx_t id)
+            const override;
+
+    [[nodiscard]] std::unique_ptr<Iterator> get_iterator(
+            const std::string& prefix) const override;
+
+    std::unique_ptr<ContextIterator> get_context_iterator(
+            const uint64_t tenant,
+            const uint8_t field_id) const override;
+
+    void get_contexts(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            std::vector<std::string>& values) const override;
+
+    void get_residuals(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            std::vector<std::string>& values) const override;
+
+    void visit_contexts(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            const ValueVisitor& visit) const override;
+
+    void visit_residuals(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const std::vector<idx_t>& doc_ids,
+            const ValueVisitor& visit) const override;
+
+    /// returns the context of a document, or an empty view if it has none.
+    std::string_view get_context_view(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const idx_t doc_id) const;
+
+    /// returns the residuals of a document, or an empty view if it has none.
+    std::string_view get_residuals_view(
+            const uint64_t tenant,
+            const uint8_t field_id,
+            const idx_t doc_id) const;
+
+   private:
+    std::shared_ptr<const Segment> segment;
+};
+
+/**
+ * SegmentForwardIndex reads stored fields from a segment.
+ */
+struct SegmentForwardIndex : public ForwardIndex {
+    explicit SegmentForwardIndex(std::shared_ptr<const Segment> segment);
+
+    std::vector<std::map<uint8_t, SupportedTypes>> get_metadata(
+            const uint64_t tenant,
+            const std::vector<idx_t>& ids) const override;
+
+    void remove(const uint64_t tenant, std::vector<idx_t> ids) override;
+
+    void merge(
+            rocksdb::DB* db,
+            std::vector<rocksdb::ColumnFamilyHandle*>& cfs,
+            BulkIndexWriter& writer) override;
+
+    std::unique_ptr<ForwardIndexIterator> get_iterator(
+            const uint64_t tenant,
+            const idx_t inverted_list) const override;
+
+   private:
+    std::shared_ptr<const Segment> segment;
+};
+
+} // namespace lintdb
+
+#endif // LINTDB_INVLISTS_SEGMENT_INVERTED_LIST_H
@@ -0,0 +1,345 @@
+#include "lintdb/invlists/Tombstones.h"
+#include <rocksdb/write_batch.h>
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include "lintdb/assert.h"
+#include "lintdb/invlists/KeyBuilder.h"
+#include "lintdb/invlists/PostingBlocks.h"
+#include "lintdb/utils/endian.h"
+
+namespace lintdb {
+namespace {
+const size_t kTenantSize = sizeof(uint64_t);
+const size_t kDocIdSize = sizeof(idx_t);
+
+std::vector<idx_t> sorted_unique(std::vector<idx_t> ids) {
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+/// returns the sorted ids of a that aren't in b.
+std::vector<idx_t> difference(
+        const std::vector<idx_t>& a,
+        const std::vector<idx_t>& b) {
+    std::vector<idx_t> result;
+    std::set_difference(
+            a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+std::vector<idx_t> set_union(
+        const std::vector<idx_t>& a,
+        const std::vector<idx_t>& b) {
+    std::vector<idx_t> result;
+    std::set_union(
+            a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(result));
+    return result;
+}
+
+/// merges two runs into one. newer overrides older.
+DeletedDocs::Run merge_runs(
+        const DeletedDocs::Run& older,
+        const DeletedDocs::Run& newer) {
+    DeletedDocs::Run merged;
+    merged.deleted =
+            set_union(difference(older.deleted, newer.revived), newer.deleted);
+    merged.revived =
+            set_union(difference(older.revived, newer.deleted), newer.revived);
+    return merged;
+}
+
+class TombstoneFilter : public rocksdb::CompactionFilter {
+   public:
+    TombstoneFilter(
+            std::shared_ptr<const Tombstones> tombstones,
+            bool block_lists)
+            : tombstones(std::move(tombstones)), block_lists(block_lists) {}
+
+    bool Filter(
+            int level,
+            const rocksdb::Slice& key,
+            const rocksdb::Slice& existing_value,
+            std::string* new_value,
+            bool* value_changed) const override {
+        if (key.size() < kTenantSize + kDocIdSize) {
+            return false;
+        }
+        const uint64_t tenant = load_bigendian<uint64_t>(key.data());
+        auto deleted = tombstones->get(tenant);
+        if (!deleted) {
+            return false;
+        }
+        if (!block_lists) {
+            return deleted->contains(load_bigendian<idx_t>(
+                    key.data() + key.size() - kDocIdSize));
+        }
+
+        std::vector<idx_t> doc_ids;
+        decode_posting_blocks(
+                existing_value.data(), existing_value.size(), doc_ids);
+        auto live_end = std::remove_if(
+                doc_ids.begin(), doc_ids.end(), [&](const idx_t doc_id) {
+                    return deleted->contains(doc_id);
+                });
+        if (live_end == doc_ids.end()) {
+            return false;
+        }
+        if (live_end == doc_ids.begin()) {
+            return true;
+        }
+        doc_ids.erase(live_end, doc_ids.end());
+        new_value->clear();
+        encode_posting_blocks(doc_ids, *new_value);
+        *value_changed = true;
+        return false;
+    }
+
+    const char* Name() const override {
+        return "lintdb.TombstoneFilter";
+    }
+
+   private:
+    std::shared_ptr<const Tombstones> tombstones;
+    bool block_lists;
+};
+} // namespace
+
+DeletedDocs::DeletedDocs(std::vector<idx_t> doc_ids) {
+    auto run = std::make_shared<Run>();
+    run->deleted = sorted_unique(std::move(doc_ids));
+    size_ = run->deleted.size();
+    runs_.push_back(std::move(run));
+}
+
+std::shared_ptr<const DeletedDocs> DeletedDocs::with_deleted(
+        std::vector<idx_t> ids) const {
+    Run run;
+    run.deleted = sorted_unique(std::move(ids));
+    size_t added = 0;
+    for (const auto id : run.deleted) {
+        added += contains(id) ? 0 : 1;
+    }
+    return with_run(std::move(run), size_ + added);
+}
+
+std::shared_ptr<const DeletedDocs> DeletedDocs::with_revived(
+        std::vector<idx_t> ids) const {
+    Run run;
+    // only ids that are deleted change the snapshot.
+    for (const auto id : sorted_unique(std::move(ids))) {
+        if (contains(id)) {
+            run.revived.push_back(id);
+        }
+    }
+    const size_t size = size_ - run.revived.size();
+    return with_run(std::move(run), size);
+}
+
+std::shared_ptr<const DeletedDocs> DeletedDocs::with_run(Run run, size_t size)
+        const {
+    std::shared_ptr<DeletedDocs> result(new DeletedDocs());
+    result->size_ = size;
+    result->runs_ = runs_;
+    result->runs_.push_back(std::make_shared<const Run>(std::move(run)));
+
+    // runs are merged while the one below is at most twice the size of the
+    // newest, which keeps the runs' sizes growing geometrically.
+    auto& runs = result->runs_;
+    while (runs.size() > 1 &&
+           runs[runs.size() - 2]->size() <= 2 * runs.back()->size()) {
+        auto merged = std::make_shared<const Run>(
+                merge_runs(*runs[runs.size() - 2], *runs.back()));
+        runs.pop_back();
+        runs.back() = std::move(merged);
+    }
+    // the oldest run has nothing below it to revive.
+    if (!runs.front()->revived.empty()) {
+        auto oldest = std::make_shared<Run>(*runs.front());
+        oldest->revived.clear();
+        runs.front() = std::move(oldest);
+    }
+    return result;
+}
+
+bool DeletedDocs::contains(const idx_t doc_id) const {
+    for (auto run = runs_.rbegin(); run != runs_.rend(); ++run) {
+        const auto& deleted = (*run)->deleted;
+        if (std::binary_search(deleted.begin(), deleted.end(), doc_id)) {
+            return true;
+        }
+        const auto& revived = (*run)->revived;
+        if (std::binary_search(revived.begin(), revived.end(), doc_id)) {
+            return false;
+        }
+    }
+    return false;
+}
+
+std::vector<idx_t> DeletedDocs::doc_ids() const {
+    Run all;
+    for (const auto& run : runs_) {
+        all = merge_runs(all, *run);
+    }
+    return all.deleted;
+}
+
+DeletedDocsCursor::DeletedDocsCursor(std::shared_ptr<const DeletedDocs> deleted)
+        : deleted(std::move(deleted)) {
+    if (this->deleted) {
+        positions.resize(this->deleted->runs().size());
+    }
+}
+
+bool DeletedDocsCursor::is_deleted(const idx_t doc_id) {
+    if (!deleted) {
+        return false;
+    }
+    const auto& runs = deleted->runs();
+    // the newest run that has the id decides.
+    for (size_t i = runs.size(); i-- > 0;) {
+        auto& [deleted_pos, revived_pos] = positions[i];
+        const auto& deleted_ids = runs[i]->deleted;
+        while (deleted_pos < deleted_ids.size() &&
+               deleted_ids[deleted_pos] < doc_id) {
+            deleted_pos++;
+        }
+        if (deleted_pos < deleted_ids.size() &&
+            deleted_ids[deleted_pos] == doc_id) {
+            return true;
+        }
+        const auto& revived_ids = runs[i]->revived;
+        while (revived_pos < revived_ids.size() &&
+               revived_ids[revived_pos] < doc_id) {
+            revived_pos++;
+        }
+        if (revived_pos < revived_ids.size() &&
+            revived_ids[revived_pos] == doc_id) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void Tombstones::load(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* cf) {
+    std::unordered_map<uint64_t, std::vector<idx_t>> loaded;
+    std::unique_ptr<rocksdb::Iterator> it(
+            db->NewIterator(rocksdb::ReadOptions(), cf));
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+        std::string key = it->key().ToString();
+        ForwardIndexKey tombstone(key);
+        loaded[tombstone.tenant()].push_back(tombstone.doc_id());
+    }
+    LINTDB_THROW_IF_NOT_MSG(it->status().ok(), "could not read tombstones");
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    tenants.clear();
+    for (auto& [tenant, doc_ids] : loaded) {
+        tenants[tenant] =
+                std::make_shared<const DeletedDocs>(std::move(doc_ids));
+    }
+}
+
+void Tombstones::add(
+        rocksdb::DB* db,
+        rocksdb::ColumnFamilyHandle* cf,
+        const uint64_t tenant,
+        const std::vector<idx_t>& ids) {
+    if (ids.empty()) {
+        return;
+    }
+    rocksdb::WriteBatch batch;
+    for (const auto id : ids) {
+        auto status = batch.Put(cf, create_forward_index_id(tenant, id), "");
+        LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+    }
+    auto status = db->Write(rocksdb::WriteOptions(), &batch);
+    LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+
+    // snapshots are immutable, so readers keep the one they have.
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto& current = tenants[tenant];
+    if (current) {
+        current = current->with_deleted(ids);
+    } else {
+        current = std::make_shared<const DeletedDocs>(ids);
+    }
+}
+
+void Tombstones::erase(
+        rocksdb::DB* db,
+        rocksdb::ColumnFamilyHandle* cf,
+        const uint64_t tenant,
+        const std::vector<idx_t>& ids) {
+    std::vector<idx_t> erased = find(tenant, ids);
+    if (erased.empty()) {
+        return;
+    }
+    rocksdb::WriteBatch batch;
+    for (const auto id : erased) {
+        auto status = batch.Delete(cf, create_forward_index_id(tenant, id));
+        LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+    }
+    auto status = db->Write(rocksdb::WriteOptions(), &batch);
+    LINTDB_THROW_IF_NOT_FMT(status.ok(), "%s", status.ToString().c_str());
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto existing = tenants.find(tenant);
+    if (existing == tenants.end()) {
+        return;
+    }
+    auto remaining = existing->second->with_revived(erased);
+    if (remaining->size() == 0) {
+        tenants.erase(existing);
+    } else {
+        existing->second = std::move(remaining);
+    }
+}
+
+void Tombstones::drop_tenant(const uint64_t tenant) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    tenants.erase(tenant);
+}
+
+std::shared_ptr<const DeletedDocs> Tombstones::get(
+        const uint64_t tenant) const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = tenants.find(tenant);
+    return it == tenants.end() ? nullptr : it->second;
+}
+
+std::unordered_map<uint64_t, std::shared_ptr<const DeletedDocs>> Tombstones::
+        get_all() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return tenants;
+}
+
+bool Tombstones::is_deleted(const uint64_t tenant, const idx_t doc_id) const {
+    auto deleted = get(tenant);
+    return deleted && deleted->contains(doc_id);
+}
+
+std::vector<idx_t> Tombstones::find(
+        const uint64_t tenant,
+        const std::vector<idx_t>& ids) const {
+    auto deleted = get(tenant);
+    if (!deleted) {
+        return {};
+    }
+    std::vector<idx_t> found;
+    for (const auto id : sorted_unique(ids)) {
+        if (deleted->contains(id)) {
+            found.push_back(id);
+        }
+    }
+    return found;
+}
+
+std::unique_ptr<rocksdb::CompactionFilter> TombstoneFilterFactory::
+        CreateCompactionFilter(
+                const rocksdb::CompactionFilter::Context& context) {
+    return std::make_unique<TombstoneFilter>(tombstones, block_lists);
+}
+
+} // namespace lintdb
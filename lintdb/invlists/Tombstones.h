@@ -0,0 +1,177 @@
+#ifndef LINTDB_INVLISTS_TOMBSTONES_H
+#define LINTDB_INVLISTS_TOMBSTONES_H
+
+#include <rocksdb/compaction_filter.h>
+#include <rocksdb/db.h>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "lintdb/api.h"
+
+namespace lintdb {
+/**
+ * DeletedDocs is an immutable snapshot of a tenant's deleted doc ids.
+ *
+ * Changes are kept in sorted runs, like an LSM tree. Each add or erase
+ * pushes one small run on top of the runs it shares with the previous
+ * snapshot, and runs of similar size are merged. A change costs
+ * O(k log n) amortized instead of rewriting every deleted id, and there are
+ * O(log n) runs to check.
+ */
+class DeletedDocs {
+   public:
+    /// a sorted batch of changes. Newer runs override older ones.
+    struct Run {
+        std::vector<idx_t> deleted; /// ids that got a tombstone.
+        std::vector<idx_t> revived; /// ids whose tombstone was erased.
+
+        size_t size() const {
+            return deleted.size() + revived.size();
+        }
+    };
+
+    explicit DeletedDocs(std::vector<idx_t> doc_ids);
+
+    /// returns a snapshot that also has ids deleted.
+    std::shared_ptr<const DeletedDocs> with_deleted(
+            std::vector<idx_t> ids) const;
+    /// returns a snapshot without the tombstones of ids.
+    std::shared_ptr<const DeletedDocs> with_revived(
+            std::vector<idx_t> ids) const;
+
+    bool contains(const idx_t doc_id) const;
+
+    /// the number of deleted ids.
+    size_t size() const {
+        return size_;
+    }
+    /// every deleted id, sorted.
+    std::vector<idx_t> doc_ids() const;
+
+    /// the runs, oldest first.
+    const std::vector<std::shared_ptr<const Run>>& runs() const {
+        return runs_;
+    }
+
+   private:
+    DeletedDocs() = default;
+    std::shared_ptr<const DeletedDocs> with_run(Run run, size_t size) const;
+
+    std::vector<std::shared_ptr<const Run>> runs_;
+    size_t size_ = 0;
+};
+
+/**
+ * DeletedDocsCursor checks increasing doc ids against a snapshot. Each check
+ * only moves forward in every run, so walking a posting list costs one pass
+ * over both.
+ *
+ * A null snapshot means nothing is deleted.
+ */
+class DeletedDocsCursor {
+   public:
+    DeletedDocsCursor() = default;
+    explicit DeletedDocsCursor(std::shared_ptr<const DeletedDocs> deleted);
+
+    /// true when nothing is deleted, so ids don't need to be checked.
+    bool empty() const {
+        return !deleted;
+    }
+
+    /// doc_id must be at least the id of the previous call.
+    bool is_deleted(const idx_t doc_id);
+
+   private:
+    std::shared_ptr<const DeletedDocs> deleted;
+    /// the positions in each run's deleted and revived ids.
+    std::vector<std::pair<size_t, size_t>> positions;
+};
+
+/**
+ * Tombstones tracks deleted documents per tenant.
+ *
+ * A remove writes one key per document to the tombstone column family, and
+ * searches skip those documents. Their postings, codes, mappings and stored
+ * fields are dropped later by compaction, with `TombstoneFilterFactory`.
+ *
+ * Tombstones stay until the document is added again, the tenant is dropped,
+ * or `IndexIVF::compact` has purged the document's data. A document that's
+ * added again after compaction removed its mapping, but not all of its
+ * postings, can keep stray postings from its old centroids. They only add
+ * candidates; scoring reads the new codes.
+ *
+ * Reads and writes are thread safe.
+ */
+class Tombstones {
+   public:
+    /// reads every tombstone in the column family into memory.
+    void load(rocksdb::DB* db, rocksdb::ColumnFamilyHandle* cf);
+
+    /// persists tombstones for ids and adds them in memory.
+    void add(
+            rocksdb::DB* db,
+            rocksdb::ColumnFamilyHandle* cf,
+            const uint64_t tenant,
+            const std::vector<idx_t>& ids);
+
+    /// removes the tombstones of ids, if they have any.
+    void erase(
+            rocksdb::DB* db,
+            rocksdb::ColumnFamilyHandle* cf,
+            const uint64_t tenant,
+            const std::vector<idx_t>& ids);
+
+    /// forgets a tenant's tombstones in memory. The caller deletes the keys.
+    void drop_tenant(const uint64_t tenant);
+
+    /// returns the deleted docs of a tenant, or null if there are none.
+    std::shared_ptr<const DeletedDocs> get(const uint64_t tenant) const;
+
+    /// returns the deleted docs of every tenant that has any.
+    std::unordered_map<uint64_t, std::shared_ptr<const DeletedDocs>> get_all()
+            const;
+
+    bool is_deleted(const uint64_t tenant, const idx_t doc_id) const;
+
+    /// returns the ids that have tombstones.
+    std::vector<idx_t> find(
+            const uint64_t tenant,
+            const std::vector<idx_t>& ids) const;
+
+   private:
+    mutable std::shared_mutex mutex;
+    std::unordered_map<uint64_t, std::shared_ptr<const DeletedDocs>> tenants;
+};
+
+/**
+ * TombstoneFilterFactory creates compaction filters that drop the keys of
+ * deleted documents.
+ *
+ * Keys must start with the tenant. With block_lists, values are block
+ * encoded posting lists and deleted ids are removed from them. Otherwise
+ * keys end with the doc id, and the whole key is dropped.
+ */
+class TombstoneFilterFactory : public rocksdb::CompactionFilterFactory {
+   public:
+    TombstoneFilterFactory(
+            std::shared_ptr<const Tombstones> tombstones,
+            bool block_lists = false)
+            : tombstones(std::move(tombstones)), block_lists(block_lists) {}
+
+    std::unique_ptr<rocksdb::CompactionFilter> CreateCompactionFilter(
+            const rocksdb::CompactionFilter::Context& context) override;
+
+    const char* Name() const override {
+        return "lintdb.TombstoneFilterFactory";
+    }
+
+   private:
+    std::shared_ptr<const Tombstones> tombstones;
+    bool block_lists;
+};
+
+} // namespace lintdb
+
+#endif // LINTDB_INVLISTS_TOMBSTONES_H
@@ -3,6 +3,7 @@
 #include <nanobind/stl/shared_ptr.h>
 #include <nanobind/stl/string.h>
 #include <nanobind/stl/unique_ptr.h>
+#include <nanobind/stl/variant.h>
 #include <nanobind/stl/vector.h>
 #include <cstddef>
 #include <memory>
@@ -13,6 +14,7 @@
 #include "lintdb/index.h"
 #include "lintdb/quantizers/Binarizer.h"
 #include "lintdb/quantizers/CoarseQuantizer.h"
+#include "lintdb/quantizers/EmbeddingSource.h"
 #include "lintdb/quantizers/Quantizer.h"
 #include "lintdb/query/Query.h"
 #include "lintdb/query/QueryNode.h"
@@ -60,12 +62,17 @@ FieldValue TextFieldValue(std::string name, const std::string& value) {
     return FieldValue(name, value);
 }
 
-FieldValue TensorFieldValue(
-        std::string name,
-        nb::ndarray<float, nb::ndim<2>, nb::device::cpu> value) {
-    std::vector<float> vec =
-            std::vector<float>(value.data(), value.data() + value.size());
-    return FieldValue(name, vec, value.shape(0));
+using TensorArray =
+        nb::ndarray<float, nb::ndim<2>, nb::c_contig, nb::device::cpu>;
+
+FieldValue TensorFieldValue(std::string name, TensorArray value) {
+    // the value borrows the array's memory, and holds a reference to the
+    // array so it stays alive. Only C ordered float32 arrays are borrowed.
+    // nanobind converts other arrays into a float32 copy first.
+    auto owner = std::make_shared<TensorArray>(value);
+    TensorView view(
+            gsl::span<const float>(value.data(), value.size()), owner);
+    return FieldValue(std::move(name), std::move(view), value.shape(0));
 }
 
 FieldValue QuantizedTensorFieldValue(
@@ -98,6 +105,15 @@ FieldParameters create_field_parameters_from_dict(const nb::dict& params) {
         fp.num_subquantizers = nb::cast<size_t>(params["num_subquantizers"]);
     if (params.contains("nbits"))
         fp.nbits = nb::cast<size_t>(params["nbits"]);
+    if (params.contains("coarse_quantizer"))
+        fp.coarse_quantizer =
+                nb::cast<CoarseQuantizerType>(params["coarse_quantizer"]);
+    if (params.contains("hnsw_m"))
+        fp.hnsw_m = nb::cast<size_t>(params["hnsw_m"]);
+    if (params.contains("ef_search"))
+        fp.ef_search = nb::cast<size_t>(params["ef_search"]);
+    if (params.contains("clustering"))
+        fp.clustering = nb::cast<ClusteringType>(params["clustering"]);
     return fp;
 }
 
@@ -119,6 +135,16 @@ SearchOptions create_search_options_from_dict(const nb::dict& dict) {
                 nb::cast<size_t>(dict["nearest_tokens_to_fetch"]);
     if (dict.contains("colbert_field"))
         opts.colbert_field = nb::cast<std::string>(dict["colbert_field"]);
+    if (dict.contains("prune_candidates"))
+        opts.prune_candidates = nb::cast<bool>(dict["prune_candidates"]);
+    if (dict.contains("accumulate_centroid_scores"))
+        opts.accumulate_centroid_scores =
+                nb::cast<bool>(dict["accumulate_centroid_scores"]);
+    if (dict.contains("centroids_per_token"))
+        opts.centroids_per_token =
+                nb::cast<size_t>(dict["centroids_per_token"]);
+    if (dict.contains("search_batch_size"))
+        opts.search_batch_size = nb::cast<size_t>(dict["search_batch_size"]);
     return opts;
 }
 
@@ -246,7 +272,19 @@ NB_MODULE(core, m) {
             .def_rw("num_subquantizers",
                     &FieldParameters::num_subquantizers,
                     "Number of subquantizers")
-            .def_rw("nbits", &FieldParameters::nbits, "Number of bits");
+            .def_rw("nbits", &FieldParameters::nbits, "Number of bits")
+            .def_rw("coarse_quantizer",
+                    &FieldParameters::coarse_quantizer,
+                    "Index used to search centroids")
+            .def_rw("hnsw_m",
+                    &FieldParameters::hnsw_m,
+                    "Neighbors per node in the HNSW graph")
+            .def_rw("ef_search",
+                    &FieldParameters::ef_search,
+                    "HNSW search queue size")
+            .def_rw("clustering",
+                    &FieldParameters::clustering,
+                    "How centroids are trained");
 
     nb::class_<Field>(m, "__Field", "Field configuration")
             .
@@ -474,7 +512,22 @@ NB_MODULE(core, m) {
             .def_rw("num_tensors",
                     &FieldValue::num_tensors,
                     "Number of tensors.")
-            .def_rw("value", &FieldValue::value, "Field value.");
+            .def_prop_rw(
+                    "value",
+                    [](const FieldValue& self) -> nb::object {
+                        // views are copied out as a list of floats, like
+                        // tensors.
+                        if (const auto view =
+                                    std::get_if<TensorView>(&self.value)) {
+                            return nb::cast(Tensor(
+                                    view->data.begin(), view->data.end()));
+                        }
+                        return nb::cast(self.value);
+                    },
+                    [](FieldValue& self, const SupportedTypes& value) {
+                        self.value = value;
+                    },
+                    "Field value.");
 
     // Wrapper functions
     m.def("IntFieldValue", &IntFieldValue, "Create FieldValue from integer");
@@ -495,7 +548,7 @@ NB_MODULE(core, m) {
             "Document for storing multiple fields and a unique ID.")
             .
 
-            def(nb::init<idx_t, const std::vector<FieldValue>&>(),
+            def(nb::init<idx_t, std::vector<FieldValue>>(),
                 nb::arg("id"),
                 nb::arg("fields"),
 
@@ -566,6 +619,17 @@ NB_MODULE(core, m) {
                  &SearchResult::operator>,
                  "Greater than comparison operator");
 
+    nb::enum_<PostingFormat>(
+            m,
+            "PostingFormat",
+            "How ColBERT posting lists are stored.")
+            .value("KEYS",
+                   PostingFormat::KEYS,
+                   "One key per centroid and document.")
+            .value("BLOCKS",
+                   PostingFormat::BLOCKS,
+                   "Block encoded lists per centroid.");
+
     nb::class_<Configuration>(m, "Configuration", "Configuration for the index")
             .
 
@@ -575,6 +639,9 @@ NB_MODULE(core, m) {
             .def_rw("lintdb_version",
                     &Configuration::lintdb_version,
                     "LintDB version")
+            .def_rw("posting_format",
+                    &Configuration::posting_format,
+                    "How ColBERT posting lists are stored.")
             .def("__eq__",
                  &Configuration::operator==,
                  "Equality comparison operator");
@@ -585,14 +652,16 @@ NB_MODULE(core, m) {
             "IndexIVF is a multi-vector index with an inverted file structure.")
             .
 
-            def(nb::init<const std::string&, bool>(),
+            def(nb::init<const std::string&, bool, bool>(),
                 nb::arg("path"),
                 nb::arg("read_only")
 
                 = false,
+                nb::arg("use_segment") = false,
                 "Load an existing index.\n\n"
                 ":param path: The path to the index.\n"
-                ":param read_only: Whether to open the index in read-only mode.")
+                ":param read_only: Whether to open the index in read-only mode.\n"
+                ":param use_segment: Whether to search the segment written by export_segment. Requires read_only.")
             .
 
             def(nb::init<
@@ -622,6 +691,20 @@ NB_MODULE(core, m) {
                  nb::arg("docs"),
                  "Train the index with the given documents to learn quantization and compression parameters.\n\n"
                  ":param docs: The documents to use for training.")
+            .def(
+                    "train_npy",
+                    [](IndexIVF& index,
+                       const std::string& field,
+                       const std::string& path) {
+                        NpyEmbeddingSource source(path);
+                        index.train_field(field, source);
+                    },
+                    nb::arg("field"),
+                    nb::arg("path"),
+                    "Train a field from a float32 .npy file of shape (n, dim). "
+                    "The file is streamed and sampled, so it doesn't need to fit in memory.\n\n"
+                    ":param field: The field to train.\n"
+                    ":param path: The path to the .npy file.")
             .def("set_quantizer",
                  &IndexIVF::set_quantizer,
                  nb::arg("field"),
@@ -664,6 +747,17 @@ NB_MODULE(core, m) {
                  "Add a block of embeddings to the index.\n\n"
                  ":param tenant: The tenant to assign the documents to.\n"
                  ":param docs: A vector of documents to add.")
+            .def("flush",
+                 &IndexIVF::flush,
+                 "Wait for added documents to be written, and flush the "
+                 "index to disk.")
+            .def("add_bulk",
+                 &IndexIVF::add_bulk,
+                 nb::arg("tenant"),
+                 nb::arg("docs"),
+                 "Bulk load documents into the index with SST ingestion. Faster than add for initial builds.\n\n"
+                 ":param tenant: The tenant to assign the documents to.\n"
+                 ":param docs: A vector of documents to add.")
             .def("add_single",
                  &IndexIVF::add_single,
                  nb::arg("tenant"),
@@ -678,6 +772,19 @@ NB_MODULE(core, m) {
                  "Remove documents from the index by their IDs.\n\n"
                  ":param tenant: The tenant the documents belong to.\n"
                  ":param ids: The IDs of the documents to remove.")
+            .def("drop_tenant",
+                 &IndexIVF::drop_tenant,
+                 nb::arg("tenant"),
+                 "Remove every document of a tenant.\n\n"
+                 ":param tenant: The tenant to drop.")
+            .def("compact",
+                 &IndexIVF::compact,
+                 "Drop the data of removed documents and clear their "
+                 "tombstones.")
+            .def("upgrade_postings",
+                 &IndexIVF::upgrade_postings,
+                 "Rewrite tensor postings written by older versions, so "
+                 "they only hold their centroid's tokens.")
             .def("update",
                  &IndexIVF::update,
                  nb::arg("tenant"),
@@ -686,17 +793,26 @@ NB_MODULE(core, m) {
                  ":param tenant: The tenant the documents belong to.\n"
                  ":param docs: The documents to update.")
             .def("merge",
-                 &IndexIVF::merge,
+                 nb::overload_cast<const std::string&>(&IndexIVF::merge),
                  nb::arg("path"),
                  "Merge the index with another index.\n\n"
                  "This enables easier multiprocess building of indices but can have subtle issues if indices have different centroids.\n\n"
                  ":param path: The path to the other index.")
+            .def("merge",
+                 nb::overload_cast<const std::vector<std::string>&>(
+                         &IndexIVF::merge),
+                 nb::arg("paths"),
+                 "Merge many indices into this index in one pass.\n\n"
+                 ":param paths: The paths to the other indices.")
             .def("save",
                  &IndexIVF::save,
                  "Save the current state of the index. Quantization and compression will be saved within the Index's path.")
             .def("close",
                  &IndexIVF::close,
                  "Close the index, releasing any resources.")
+            .def("export_segment",
+                 &IndexIVF::export_segment,
+                 "Export the index to an immutable, memory mapped segment within the index's path.")
             .def(
                     "__del__",
                     [](IndexIVF* self) { delete self; },
@@ -718,6 +834,28 @@ NB_MODULE(core, m) {
                    QuantizerType::PRODUCT_ENCODER,
                    "Product encoder quantizer.");
 
+    nb::enum_<CoarseQuantizerType>(
+            m,
+            "CoarseQuantizerType",
+            "Enumeration of coarse quantizer types.")
+            .value("FLAT",
+                   CoarseQuantizerType::FLAT,
+                   "Brute force centroid search.")
+            .value("HNSW",
+                   CoarseQuantizerType::HNSW,
+                   "HNSW graph over the centroids.");
+
+    nb::enum_<ClusteringType>(
+            m,
+            "ClusteringType",
+            "Enumeration of ways to train centroids.")
+            .value("FLAT",
+                   ClusteringType::FLAT,
+                   "K-means over every centroid at once.")
+            .value("HIERARCHICAL",
+                   ClusteringType::HIERARCHICAL,
+                   "K-means within coarse clusters, in parallel.");
+
     // Bindings for Quantizer
     nb::class_<Quantizer>(
             m,
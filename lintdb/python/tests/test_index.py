@@ -175,5 +175,6 @@ class TestIndex(unittest.TestCase):
         self.assertEqual(float_field.data_type, DataType.FLOAT)
         self.assertEqual(text_field.data_type, DataType.TEXT)
         self.assertEqual(tensor_field.data_type, DataType.TENSOR)
+        self.assertEqual(tensor_field.value, [1.0, 2.0, 3.0, 4.0])
         self.assertEqual(quantized_tensor_field.data_type, DataType.QUANTIZED_TENSOR)
         self.assertEqual(date_field.data_type, DataType.DATETIME)
\ No newline at end of file
@@ -385,4 +385,14 @@ size_t Binarizer::code_size() {
     return dim / 8 * nbits;
 }
 
+std::unique_ptr<BinarizerDistanceTables> Binarizer::get_distance_tables(
+        const float* query_data,
+        size_t num_tokens) const {
+    if (!BinarizerDistanceTables::supports(nbits)) {
+        return nullptr;
+    }
+    return std::make_unique<BinarizerDistanceTables>(
+            query_data, num_tokens, *this);
+}
+
 } // namespace lintdb
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include "lintdb/api.h"
+#include "lintdb/quantizers/BinarizerDistanceTables.h"
 #include "lintdb/quantizers/PQDistanceTables.h"
 #include "lintdb/quantizers/Quantizer.h"
 
@@ -48,6 +49,12 @@ struct Binarizer : public Quantizer {
         return nbits;
     }
 
+    // Compute the MaxSim lookup tables for the given query embeddings.
+    // Returns nullptr if nbits isn't supported by the tables.
+    std::unique_ptr<BinarizerDistanceTables> get_distance_tables(
+            const float* query_data,
+            size_t num_tokens) const;
+
     static std::unique_ptr<Binarizer> load(std::string path);
 
     QuantizerType get_type() override;
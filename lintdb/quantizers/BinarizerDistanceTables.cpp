@@ -0,0 +1,107 @@
+#include "lintdb/quantizers/BinarizerDistanceTables.h"
+#include <algorithm>
+#include <cmath>
+#include "lintdb/assert.h"
+#include "lintdb/quantizers/Binarizer.h"
+
+namespace lintdb {
+BinarizerDistanceTables::BinarizerDistanceTables(
+        const float* query_data,
+        size_t num_query_tokens,
+        const Binarizer& binarizer)
+        : num_query_tokens(num_query_tokens),
+          code_size(binarizer.dim / 8 * binarizer.nbits) {
+    switch (binarizer.nbits) {
+        case 1:
+            build<1>(query_data, binarizer);
+            break;
+        case 2:
+            build<2>(query_data, binarizer);
+            break;
+        case 4:
+            build<4>(query_data, binarizer);
+            break;
+        default:
+            LINTDB_THROW_FMT(
+                    "distance tables don't support nbits=%zu",
+                    binarizer.nbits);
+    }
+}
+
+template <size_t NBITS>
+void BinarizerDistanceTables::build(
+        const float* query_data,
+        const Binarizer& binarizer) {
+    constexpr size_t vals_per_byte = 8 / NBITS;
+    const size_t dim = binarizer.dim;
+    const size_t nq = num_query_tokens;
+
+    // decode every byte value once, exactly as Binarizer::sa_decode does.
+    float decoded[256][vals_per_byte];
+    square_norms.assign(256, 0);
+    for (size_t b = 0; b < 256; b++) {
+        const uint8_t reversed = binarizer.reverse_bitmap[b];
+        for (size_t l = 0; l < vals_per_byte; l++) {
+            const uint8_t bucket = binarizer.decompression_lut
+                    [reversed * vals_per_byte + l];
+            decoded[b][l] = binarizer.bucket_weights[bucket];
+            square_norms[b] += decoded[b][l] * decoded[b][l];
+        }
+    }
+
+    tables.assign(code_size * 256 * nq, 0);
+    for (size_t k = 0; k < code_size; k++) {
+        for (size_t b = 0; b < 256; b++) {
+            float* row = tables.data() + (k * 256 + b) * nq;
+            for (size_t l = 0; l < vals_per_byte; l++) {
+                const float w = decoded[b][l];
+                const float* q = query_data + k * vals_per_byte + l;
+                for (size_t i = 0; i < nq; i++) {
+                    row[i] += q[i * dim] * w;
+                }
+            }
+        }
+    }
+}
+
+float BinarizerDistanceTables::maxsim(
+        const uint8_t* codes,
+        size_t num_doc_tokens,
+        bool normalize) const {
+    const size_t nq = num_query_tokens;
+    std::vector<float> max_scores(nq, 0);
+    std::vector<float> token_scores(nq);
+
+    for (size_t t = 0; t < num_doc_tokens; t++) {
+        const uint8_t* token = codes + t * code_size;
+        float* acc = token_scores.data();
+        std::fill(acc, acc + nq, 0);
+
+        float square_norm = 0;
+        for (size_t k = 0; k < code_size; k++) {
+            const float* row = tables.data() + (k * 256 + token[k]) * nq;
+#pragma omp simd
+            for (size_t i = 0; i < nq; i++) {
+                acc[i] += row[i];
+            }
+            square_norm += square_norms[token[k]];
+        }
+
+        // a zero vector can't be normalized and never raises a max score.
+        float scale = 1;
+        if (normalize) {
+            scale = square_norm > 0 ? 1 / std::sqrt(square_norm) : 0;
+        }
+        for (size_t i = 0; i < nq; i++) {
+            max_scores[i] = std::max(max_scores[i], acc[i] * scale);
+        }
+    }
+
+    float score = 0;
+    for (size_t i = 0; i < nq; i++) {
+        score += max_scores[i];
+    }
+    return score;
+}
+
+} // namespace lintdb
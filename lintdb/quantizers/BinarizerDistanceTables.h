@@ -0,0 +1,58 @@
+#ifndef LINTDB_BINARIZERDISTANCETABLES_H
+#define LINTDB_BINARIZERDISTANCETABLES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lintdb {
+struct Binarizer;
+
+/**
+ * BinarizerDistanceTables scores packed Binarizer residuals against a query
+ * without decompressing them.
+ *
+ * Every packed byte decodes to the same few bucket weights, so for each
+ * (byte position, byte value) we precompute the partial dot product with
+ * every query token. A document token's scores are then a sum of
+ * code_size table rows, and MaxSim never materializes float embeddings.
+ *
+ * Tables are specialized for nbits 1, 2 and 4. Use `supports()` before
+ * building them.
+ */
+class BinarizerDistanceTables {
+   public:
+    BinarizerDistanceTables(
+            const float* query_data,
+            size_t num_query_tokens,
+            const Binarizer& binarizer);
+
+    static bool supports(size_t nbits) {
+        return nbits == 1 || nbits == 2 || nbits == 4;
+    }
+
+    /**
+     * maxsim returns the ColBERT score of one document.
+     *
+     * @param codes packed residuals of size num_doc_tokens * code_size.
+     * @param normalize scores against unit length document tokens, matching
+     * score_document_by_residuals.
+     */
+    float maxsim(const uint8_t* codes, size_t num_doc_tokens, bool normalize)
+            const;
+
+   private:
+    template <size_t NBITS>
+    void build(const float* query_data, const Binarizer& binarizer);
+
+    size_t num_query_tokens;
+    size_t code_size;
+    /// size: (code_size, 256, num_query_tokens)
+    std::vector<float> tables;
+    /// squared norm contributed by each packed byte value.
+    std::vector<float> square_norms;
+};
+
+} // namespace lintdb
+
+#endif // LINTDB_BINARIZERDISTANCETABLES_H
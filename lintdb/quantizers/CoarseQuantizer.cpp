@@ -2,7 +2,11 @@
 #include <faiss/Clustering.h>
 #include <faiss/index_io.h>
 #include <faiss/IndexFlat.h>
+#include <faiss/IndexHNSW.h>
+#include <faiss/impl/io.h>
 #include <glog/logging.h>
+#include "lintdb/assert.h"
+#include "lintdb/exception.h"
 #include "lintdb/quantizers/impl/kmeans.h"
 
 namespace lintdb {
@@ -257,14 +261,17 @@ uint8_t CoarseQuantizer::find_nearest_centroid_index(
     return best_index;
 }
 
-FaissCoarseQuantizer::FaissCoarseQuantizer(size_t d) : d(d) {
+FaissCoarseQuantizer::FaissCoarseQuantizer(
+        size_t d,
+        ClusteringType clustering)
+        : d(d), clustering(clustering) {
     index = faiss::IndexFlatIP(d);
 }
 FaissCoarseQuantizer::FaissCoarseQuantizer(
         size_t d,
         const std::vector<float>& centroids,
         size_t k)
-        : d(d), k(k) {
+        : d(d), k(k), clustering(ClusteringType::FLAT) {
     index = faiss::IndexFlatIP(d);
     index.add(k, centroids.data());
     index.is_trained = true;
@@ -276,11 +283,19 @@ void FaissCoarseQuantizer::train(
         const float* x,
         size_t k,
         size_t num_iter) {
-    faiss::ClusteringParameters cp;
-    cp.niter = num_iter;
-
-    faiss::Clustering clus(d, k, cp);
-    clus.train(n, x, index);
+    if (clustering == ClusteringType::HIERARCHICAL) {
+        auto centroids = hierarchical_kmeans(x, n, d, k, num_iter);
+        index.reset();
+        index.add(k, centroids.data());
+        index.is_trained = true;
+    } else {
+        faiss::ClusteringParameters cp;
+        cp.niter = num_iter;
+
+        faiss::Clustering clus(d, k, cp);
+        clus.train(n, x, index);
+    }
+    this->k = k;
     is_trained_ = true;
 }
 void FaissCoarseQuantizer::save(const std::string& path) {
@@ -351,4 +366,269 @@ std::unique_ptr<FaissCoarseQuantizer> FaissCoarseQuantizer::deserialize(
     return faiss_quantizer;
 }
 
-} // namespace lintdb
\ No newline at end of file
+HNSWCoarseQuantizer::HNSWCoarseQuantizer(
+        size_t d,
+        size_t m,
+        size_t ef_search,
+        ClusteringType clustering)
+        : d(d), m(m), ef_search(ef_search), clustering(clustering) {
+    index = std::make_unique<faiss::IndexHNSWFlat>(
+            d, m, faiss::METRIC_INNER_PRODUCT);
+}
+
+HNSWCoarseQuantizer::HNSWCoarseQuantizer(
+        size_t d,
+        const std::vector<float>& centroids,
+        size_t k,
+        size_t m,
+        size_t ef_search)
+        : HNSWCoarseQuantizer(d, m, ef_search) {
+    index->add(k, centroids.data());
+    is_trained_ = true;
+}
+
+void HNSWCoarseQuantizer::train(
+        const size_t n,
+        const float* x,
+        size_t k,
+        size_t num_iter) {
+    // clustering needs exact assignments, so we train against a flat index
+    // and build the graph over the final centroids.
+    std::vector<float> centroids;
+    if (clustering == ClusteringType::HIERARCHICAL) {
+        centroids = hierarchical_kmeans(x, n, d, k, num_iter);
+    } else {
+        faiss::ClusteringParameters cp;
+        cp.niter = num_iter;
+
+        faiss::IndexFlatIP flat(d);
+        faiss::Clustering clus(d, k, cp);
+        clus.train(n, x, flat);
+        centroids = std::move(clus.centroids);
+    }
+
+    index->reset();
+    index->add(k, centroids.data());
+    is_trained_ = true;
+}
+
+void HNSWCoarseQuantizer::save(const std::string& path) {
+    serialize(path);
+}
+
+void HNSWCoarseQuantizer::assign(size_t n, const float* x, idx_t* codes) {
+    std::vector<float> distances(n);
+    search(n, x, 1, distances.data(), codes);
+}
+
+void HNSWCoarseQuantizer::sa_decode(size_t n, const idx_t* codes, float* x) {
+    for (size_t i = 0; i < n; i++) {
+        index->reconstruct(codes[i], x + i * d);
+    }
+}
+
+void HNSWCoarseQuantizer::compute_residual(
+        const float* vec,
+        float* residual,
+        idx_t centroid_id) {
+    index->reconstruct(centroid_id, residual);
+    for (size_t i = 0; i < d; i++) {
+        residual[i] = vec[i] - residual[i];
+    }
+}
+
+void HNSWCoarseQuantizer::compute_residual_n(
+        int n,
+        const float* vec,
+        float* residual,
+        idx_t* centroid_ids) {
+    for (int i = 0; i < n; i++) {
+        compute_residual(vec + i * d, residual + i * d, centroid_ids[i]);
+    }
+}
+
+void HNSWCoarseQuantizer::reconstruct(idx_t centroid_id, float* embedding) {
+    index->reconstruct(centroid_id, embedding);
+}
+
+void HNSWCoarseQuantizer::search(
+        size_t num_query_tok,
+        const float* data,
+        size_t k_top_centroids,
+        float* distances,
+        idx_t* coarse_idx) {
+    if (!is_trained()) {
+        throw std::runtime_error("Coarse quantizer is not trained.");
+    }
+
+    // the graph can't return every centroid, so dense score tables scan the
+    // centroids directly.
+    if (k_top_centroids >= static_cast<size_t>(index->ntotal)) {
+        index->storage->search(
+                num_query_tok, data, k_top_centroids, distances, coarse_idx);
+        return;
+    }
+
+    faiss::SearchParametersHNSW params;
+    params.efSearch = std::max(ef_search, k_top_centroids);
+    index->search(
+            num_query_tok,
+            data,
+            k_top_centroids,
+            distances,
+            coarse_idx,
+            &params);
+}
+
+void HNSWCoarseQuantizer::reset() {
+    index->reset();
+    is_trained_ = false;
+}
+
+void HNSWCoarseQuantizer::add(int n, float* data) {
+    index->add(n, data);
+}
+
+size_t HNSWCoarseQuantizer::code_size() {
+    return sizeof(float) * d;
+}
+
+size_t HNSWCoarseQuantizer::num_centroids() {
+    return index->ntotal;
+}
+
+size_t HNSWCoarseQuantizer::default_search_k() {
+    return std::min(ef_search, num_centroids());
+}
+
+float* HNSWCoarseQuantizer::get_xb() {
+    return static_cast<faiss::IndexFlat*>(index->storage)->get_xb();
+}
+
+namespace {
+const uint32_t kHNSWMagic = 0x534e484c; // "LHNS"
+const uint32_t kHNSWFormatVersion = 1;
+} // namespace
+
+/**
+ * The file is a small header followed by the faiss graph:
+ * magic, format version, d, m, ef_search, is_trained, graph size, graph.
+ */
+void HNSWCoarseQuantizer::serialize(const std::string& filename) const {
+    faiss::VectorIOWriter writer;
+    faiss::write_index(index.get(), &writer);
+
+    std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+        throw LintDBException("Unable to open file for writing: " + filename);
+    }
+    ofs.write(reinterpret_cast<const char*>(&kHNSWMagic), sizeof(kHNSWMagic));
+    ofs.write(
+            reinterpret_cast<const char*>(&kHNSWFormatVersion),
+            sizeof(kHNSWFormatVersion));
+    ofs.write(reinterpret_cast<const char*>(&d), sizeof(d));
+    ofs.write(reinterpret_cast<const char*>(&m), sizeof(m));
+    ofs.write(reinterpret_cast<const char*>(&ef_search), sizeof(ef_search));
+    ofs.write(
+            reinterpret_cast<const char*>(&is_trained_), sizeof(is_trained_));
+
+    size_t graph_size = writer.data.size();
+    ofs.write(reinterpret_cast<const char*>(&graph_size), sizeof(graph_size));
+    ofs.write(reinterpret_cast<const char*>(writer.data.data()), graph_size);
+    if (!ofs) {
+        throw LintDBException("Failed to write coarse quantizer: " + filename);
+    }
+}
+
+std::unique_ptr<HNSWCoarseQuantizer> HNSWCoarseQuantizer::deserialize(
+        const std::string& filename,
+        const Version& version) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs.is_open()) {
+        throw LintDBException("Unable to open file for reading: " + filename);
+    }
+
+    uint32_t magic, format_version;
+    ifs.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&format_version), sizeof(format_version));
+    if (!ifs || magic != kHNSWMagic) {
+        throw LintDBException("Not an HNSW coarse quantizer: " + filename);
+    }
+    if (format_version != kHNSWFormatVersion) {
+        throw LintDBException(
+                "Unsupported HNSW coarse quantizer version: " +
+                std::to_string(format_version));
+    }
+
+    size_t d, m, ef_search, graph_size;
+    bool is_trained;
+    ifs.read(reinterpret_cast<char*>(&d), sizeof(d));
+    ifs.read(reinterpret_cast<char*>(&m), sizeof(m));
+    ifs.read(reinterpret_cast<char*>(&ef_search), sizeof(ef_search));
+    ifs.read(reinterpret_cast<char*>(&is_trained), sizeof(is_trained));
+    ifs.read(reinterpret_cast<char*>(&graph_size), sizeof(graph_size));
+
+    faiss::VectorIOReader reader;
+    reader.data.resize(graph_size);
+    ifs.read(reinterpret_cast<char*>(reader.data.data()), graph_size);
+    if (!ifs) {
+        throw LintDBException("Truncated HNSW coarse quantizer: " + filename);
+    }
+
+    // the graph is owned before the cast, so it's freed if it isn't HNSW.
+    std::unique_ptr<faiss::Index> graph(faiss::read_index(&reader));
+    auto hnsw = dynamic_cast<faiss::IndexHNSWFlat*>(graph.get());
+    LINTDB_THROW_IF_NOT_MSG(hnsw != nullptr, "HNSW graph could not be read");
+    graph.release();
+
+    auto quantizer = std::make_unique<HNSWCoarseQuantizer>(d, m, ef_search);
+    quantizer->index.reset(hnsw);
+    quantizer->is_trained_ = is_trained;
+
+    return quantizer;
+}
+
+std::unique_ptr<ICoarseQuantizer> create_coarse_quantizer(
+        CoarseQuantizerType type,
+        const CoarseQuantizerConfig& config) {
+    switch (type) {
+        case CoarseQuantizerType::FLAT:
+            return std::make_unique<FaissCoarseQuantizer>(
+                    config.dim, config.clustering);
+        case CoarseQuantizerType::HNSW:
+            return std::make_unique<HNSWCoarseQuantizer>(
+                    config.dim,
+                    config.hnsw_m,
+                    config.ef_search,
+                    config.clustering);
+        default:
+            throw LintDBException("Coarse quantizer type not valid.");
+    }
+}
+
+std::unique_ptr<ICoarseQuantizer> load_coarse_quantizer(
+        const std::string& path,
+        CoarseQuantizerType type,
+        const CoarseQuantizerConfig& config,
+        const Version& version) {
+    switch (type) {
+        case CoarseQuantizerType::FLAT: {
+            auto quantizer = FaissCoarseQuantizer::deserialize(path, version);
+            quantizer->set_clustering(config.clustering);
+            return quantizer;
+        }
+        case CoarseQuantizerType::HNSW: {
+            auto quantizer = HNSWCoarseQuantizer::deserialize(path, version);
+            quantizer->set_clustering(config.clustering);
+            // the schema's ef_search wins over the one we saved.
+            if (config.ef_search > 0) {
+                quantizer->set_ef_search(config.ef_search);
+            }
+            return quantizer;
+        }
+        default:
+            throw LintDBException("Coarse quantizer type not valid.");
+    }
+}
+
+} // namespace lintdb
@@ -3,6 +3,7 @@
 
 #include <faiss/Clustering.h>
 #include <faiss/IndexFlat.h>
+#include <faiss/IndexHNSW.h>
 #include <algorithm>
 #include <cmath>
 #include <fstream>
@@ -60,6 +61,12 @@ class ICoarseQuantizer {
     virtual void serialize(const std::string& filename) const = 0;
     virtual bool is_trained() const = 0;
 
+    /// the number of centroids to search per query token when the search
+    /// options don't set one. Exact quantizers score every centroid.
+    virtual size_t default_search_k() {
+        return num_centroids();
+    }
+
     virtual ~ICoarseQuantizer() = default;
 };
 
@@ -120,7 +127,9 @@ class FaissCoarseQuantizer : public ICoarseQuantizer {
    public:
     bool is_trained_ = false; // Is the quantizer trained
 
-    explicit FaissCoarseQuantizer(size_t d);
+    explicit FaissCoarseQuantizer(
+            size_t d,
+            ClusteringType clustering = ClusteringType::FLAT);
     FaissCoarseQuantizer(
             size_t d,
             const std::vector<float>& centroids,
@@ -159,13 +168,116 @@ class FaissCoarseQuantizer : public ICoarseQuantizer {
         return is_trained_;
     }
 
+    /// clustering only affects training, so it isn't serialized.
+    inline void set_clustering(ClusteringType type) {
+        clustering = type;
+    }
+
    private:
     size_t d; // Dimensionality of data points
     size_t k; // Number of centroids
+    ClusteringType clustering;
     faiss::IndexFlatIP index;
 
     uint8_t find_nearest_centroid_index(gsl::span<const float> vec) const;
 };
 
+/**
+ * HNSWCoarseQuantizer searches centroids with an HNSW graph instead of brute
+ * force.
+ *
+ * This keeps assignment and centroid search fast with hundreds of thousands
+ * of centroids. Searches are approximate and controlled by ef_search.
+ * Requests for every centroid fall back to an exact scan.
+ */
+class HNSWCoarseQuantizer : public ICoarseQuantizer {
+   public:
+    HNSWCoarseQuantizer(
+            size_t d,
+            size_t m = 32,
+            size_t ef_search = 128,
+            ClusteringType clustering = ClusteringType::FLAT);
+    HNSWCoarseQuantizer(
+            size_t d,
+            const std::vector<float>& centroids,
+            size_t k,
+            size_t m = 32,
+            size_t ef_search = 128);
+
+    void train(const size_t n, const float* x, size_t k, size_t num_iter = 10)
+            override;
+    void save(const std::string& path) override;
+    void assign(size_t n, const float* x, idx_t* codes) override;
+    void sa_decode(size_t n, const idx_t* codes, float* x) override;
+    void compute_residual(const float* vec, float* residual, idx_t centroid_id)
+            override;
+    void compute_residual_n(
+            int n,
+            const float* vec,
+            float* residual,
+            idx_t* centroid_ids) override;
+    void reconstruct(idx_t centroid_id, float* embedding) override;
+    void search(
+            size_t num_query_tok,
+            const float* data,
+            size_t k_top_centroids,
+            float* distances,
+            idx_t* coarse_idx) override;
+    void reset() override;
+    void add(int n, float* data) override;
+    size_t code_size() override;
+    size_t num_centroids() override;
+    /// the graph search finds ef_search candidates per token, so that many
+    /// are scored by default.
+    size_t default_search_k() override;
+    float* get_xb() override;
+    void serialize(const std::string& filename) const override;
+    static std::unique_ptr<HNSWCoarseQuantizer> deserialize(
+            const std::string& filename,
+            const Version& version);
+
+    bool is_trained() const override {
+        return is_trained_;
+    }
+
+    inline void set_ef_search(size_t ef) {
+        ef_search = ef;
+    }
+
+    inline size_t get_ef_search() const {
+        return ef_search;
+    }
+
+    /// clustering only affects training, so it isn't serialized.
+    inline void set_clustering(ClusteringType type) {
+        clustering = type;
+    }
+
+   private:
+    size_t d;
+    size_t m; /// number of neighbors per node in the graph.
+    size_t ef_search;
+    ClusteringType clustering;
+    bool is_trained_ = false;
+    std::unique_ptr<faiss::IndexHNSWFlat> index;
+};
+
+struct CoarseQuantizerConfig {
+    size_t dim;
+    size_t hnsw_m;    // used for HNSW
+    size_t ef_search; // used for HNSW
+    ClusteringType clustering = ClusteringType::FLAT;
+};
+
+std::unique_ptr<ICoarseQuantizer> create_coarse_quantizer(
+        CoarseQuantizerType type,
+        const CoarseQuantizerConfig& config);
+
+std::unique_ptr<ICoarseQuantizer> load_coarse_quantizer(
+        const std::string& path,
+        CoarseQuantizerType type,
+        const CoarseQuantizerConfig& config,
+        const Version& version);
+
 } // namespace lintdb
 #endif // LINTDB_COARSEQUANTIZER_H
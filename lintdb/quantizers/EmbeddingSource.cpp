@@ -0,0 +1,162 @@
+#include "lintdb/quantizers/EmbeddingSource.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <regex>
+#include "lintdb/assert.h"
+#include "lintdb/exception.h"
+#include "lintdb/invlists/Segment.h"
+
+namespace lintdb {
+namespace {
+const char kNpyMagic[] = "\x93NUMPY";
+const size_t kNpyMagicSize = 6;
+
+/// reads a value of the .npy header's python dict, e.g. 'descr'.
+std::string npy_header_value(
+        const std::string& header,
+        const std::string& key) {
+    std::smatch match;
+    std::regex pattern(
+            "'" + key + "'\\s*:\\s*('[^']*'|True|False|\\([^)]*\\))");
+    if (!std::regex_search(header, match, pattern)) {
+        throw LintDBException("npy header is missing " + key);
+    }
+    return match[1];
+}
+} // namespace
+
+DocumentEmbeddingSource::DocumentEmbeddingSource(
+        const std::vector<Document>& docs,
+        const std::string& field)
+        : docs(docs), field(field) {}
+
+bool DocumentEmbeddingSource::next(gsl::span<const float>& chunk) {
+    while (pos < docs.size()) {
+        const auto& doc = docs[pos++];
+        for (const auto& value : doc.fields) {
+            if (value.name == field) {
+                chunk = value.tensor();
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+NpyEmbeddingSource::NpyEmbeddingSource(
+        const std::string& path,
+        size_t chunk_size)
+        : file(std::make_unique<MappedFile>(path)), chunk_size(chunk_size) {
+    LINTDB_THROW_IF_NOT(chunk_size > 0);
+    const char* bytes = file->data();
+    LINTDB_THROW_IF_NOT_MSG(
+            file->size() >= kNpyMagicSize + 4 &&
+                    std::memcmp(bytes, kNpyMagic, kNpyMagicSize) == 0,
+            "not a npy file");
+
+    // version 1 has a 2 byte header length, later versions have 4.
+    const uint8_t major = bytes[kNpyMagicSize];
+    size_t header_size;
+    size_t offset;
+    if (major == 1) {
+        header_size = uint8_t(bytes[8]) | (uint8_t(bytes[9]) << 8);
+        offset = 10;
+    } else {
+        LINTDB_THROW_IF_NOT_MSG(file->size() >= 12, "npy file is truncated");
+        header_size = 0;
+        for (int i = 3; i >= 0; i--) {
+            header_size = (header_size << 8) | uint8_t(bytes[8 + i]);
+        }
+        offset = 12;
+    }
+    LINTDB_THROW_IF_NOT_MSG(
+            file->size() >= offset + header_size, "npy file is truncated");
+    std::string header(bytes + offset, header_size);
+
+    LINTDB_THROW_IF_NOT_MSG(
+            npy_header_value(header, "descr") == "'<f4'",
+            "npy embeddings must be little endian float32");
+    LINTDB_THROW_IF_NOT_MSG(
+            npy_header_value(header, "fortran_order") == "False",
+            "npy embeddings must be in C order");
+
+    std::string shape = npy_header_value(header, "shape");
+    std::smatch dims;
+    LINTDB_THROW_IF_NOT_MSG(
+            std::regex_match(
+                    shape, dims, std::regex("\\((\\d+),\\s*(\\d+)\\)")),
+            "npy embeddings must have two dimensions");
+    num_embeddings = std::stoull(dims[1]);
+    dim = std::stoull(dims[2]);
+
+    offset += header_size;
+    LINTDB_THROW_IF_NOT_MSG(
+            file->size() >= offset + num_embeddings * dim * sizeof(float),
+            "npy file is truncated");
+    data = reinterpret_cast<const float*>(bytes + offset);
+}
+
+NpyEmbeddingSource::~NpyEmbeddingSource() = default;
+
+bool NpyEmbeddingSource::next(gsl::span<const float>& chunk) {
+    if (pos >= num_embeddings) {
+        return false;
+    }
+    const size_t n = std::min(chunk_size, num_embeddings - pos);
+    chunk = gsl::span<const float>(data + pos * dim, n * dim);
+    pos += n;
+    return true;
+}
+
+ReservoirSampler::ReservoirSampler(
+        size_t dim,
+        size_t capacity,
+        unsigned int seed)
+        : dim(dim), capacity(capacity), rng(seed) {
+    LINTDB_THROW_IF_NOT(dim > 0);
+}
+
+void ReservoirSampler::add(gsl::span<const float> embeddings) {
+    LINTDB_THROW_IF_NOT_MSG(
+            embeddings.size() % dim == 0,
+            "embeddings don't match the field's dimensions");
+    const size_t n = embeddings.size() / dim;
+    for (size_t i = 0; i < n; i++, seen++) {
+        const float* embedding = embeddings.data() + i * dim;
+        if (seen < capacity) {
+            sample.insert(sample.end(), embedding, embedding + dim);
+            continue;
+        }
+        // the embedding replaces a random one with probability
+        // capacity / (seen + 1).
+        std::uniform_int_distribution<size_t> dist(0, seen);
+        const size_t j = dist(rng);
+        if (j < capacity) {
+            std::copy(embedding, embedding + dim, sample.begin() + j * dim);
+        }
+    }
+}
+
+std::vector<float> ReservoirSampler::subsample(size_t n) {
+    if (n >= size()) {
+        return sample;
+    }
+    // a partial shuffle picks n distinct embeddings.
+    std::vector<size_t> ids(size());
+    std::iota(ids.begin(), ids.end(), 0);
+    for (size_t i = 0; i < n; i++) {
+        std::uniform_int_distribution<size_t> dist(i, ids.size() - 1);
+        std::swap(ids[i], ids[dist(rng)]);
+    }
+    std::vector<float> subset(n * dim);
+    for (size_t i = 0; i < n; i++) {
+        std::copy(
+                sample.begin() + ids[i] * dim,
+                sample.begin() + (ids[i] + 1) * dim,
+                subset.begin() + i * dim);
+    }
+    return subset;
+}
+
+} // namespace lintdb
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <gsl/span>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "lintdb/schema/Document.h"
+
+namespace lintdb {
+class MappedFile;
+
+/**
+ * EmbeddingSource streams the embeddings of one field for training.
+ *
+ * Each call to next returns a chunk of whole embeddings. A chunk is only
+ * valid until the following call, so sources never need to hold more than
+ * one chunk in memory.
+ */
+class EmbeddingSource {
+   public:
+    /// sets chunk to the next embeddings, and returns false when there are
+    /// none left.
+    virtual bool next(gsl::span<const float>& chunk) = 0;
+
+    /// the dimensions of each embedding, or 0 if the source doesn't know
+    /// them up front.
+    virtual size_t dimensions() const {
+        return 0;
+    }
+
+    virtual ~EmbeddingSource() = default;
+};
+
+/**
+ * DocumentEmbeddingSource yields the tensors a field has in each document.
+ * Documents without the field are skipped.
+ */
+class DocumentEmbeddingSource : public EmbeddingSource {
+   public:
+    DocumentEmbeddingSource(
+            const std::vector<Document>& docs,
+            const std::string& field);
+
+    bool next(gsl::span<const float>& chunk) override;
+
+   private:
+    const std::vector<Document>& docs;
+    const std::string field;
+    size_t pos = 0;
+};
+
+/**
+ * NpyEmbeddingSource reads a 2D float32 .npy file of shape (n, dim) through
+ * a memory mapping, so the file is paged in as it's read instead of loaded.
+ */
+class NpyEmbeddingSource : public EmbeddingSource {
+   public:
+    explicit NpyEmbeddingSource(
+            const std::string& path,
+            size_t chunk_size = 65536 /// embeddings per chunk.
+    );
+    ~NpyEmbeddingSource() override;
+
+    bool next(gsl::span<const float>& chunk) override;
+
+    size_t size() const {
+        return num_embeddings;
+    }
+    size_t dimensions() const override {
+        return dim;
+    }
+
+   private:
+    std::unique_ptr<MappedFile> file;
+    const float* data = nullptr;
+    size_t num_embeddings = 0;
+    size_t dim = 0;
+    size_t chunk_size;
+    size_t pos = 0;
+};
+
+/**
+ * ReservoirSampler keeps a uniform sample of the embeddings it's shown,
+ * without replacement, in memory that only depends on its capacity.
+ */
+class ReservoirSampler {
+   public:
+    ReservoirSampler(size_t dim, size_t capacity, unsigned int seed = 1234);
+
+    /// offers every embedding in a chunk to the sample.
+    void add(gsl::span<const float> embeddings);
+
+    /// the number of embeddings that were offered.
+    size_t num_seen() const {
+        return seen;
+    }
+    /// the number of embeddings in the sample.
+    size_t size() const {
+        return sample.size() / dim;
+    }
+    const std::vector<float>& embeddings() const {
+        return sample;
+    }
+
+    /// returns a random subset of n embeddings of the sample.
+    std::vector<float> subsample(size_t n);
+
+   private:
+    const size_t dim;
+    const size_t capacity;
+    size_t seen = 0;
+    std::vector<float> sample;
+    std::mt19937_64 rng;
+};
+
+} // namespace lintdb
@@ -16,6 +16,18 @@ enum QuantizerType {
     PRODUCT_ENCODER,
 };
 
+/// the index used to find the nearest centroids.
+enum class CoarseQuantizerType {
+    FLAT, /// brute force search over every centroid.
+    HNSW, /// a graph over the centroids. for very large centroid counts.
+};
+
+/// how coarse quantizers cluster embeddings into centroids.
+enum class ClusteringType {
+    FLAT,         /// k-means over every centroid at once.
+    HIERARCHICAL, /// k-means within a few coarse clusters, in parallel.
+};
+
 struct QuantizerConfig {
     size_t nbits;
     size_t dim;
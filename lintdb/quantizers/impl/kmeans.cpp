@@ -2,12 +2,53 @@
 #include <faiss/Clustering.h>
 #include <faiss/IndexFlat.h>
 #include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
 #include <gsl/span>
+#include <numeric>
 #include <random>
 #include <vector>
 #include "lintdb/assert.h"
 
 namespace lintdb {
+namespace {
+/**
+ * splits k centroids between clusters in proportion to their sizes. A
+ * cluster never gets more centroids than it has points.
+ */
+std::vector<size_t> allocate_centroids(
+        const std::vector<size_t>& sizes,
+        size_t n,
+        size_t k) {
+    std::vector<size_t> allocated(sizes.size());
+    std::vector<double> remainders(sizes.size());
+    size_t total = 0;
+    for (size_t i = 0; i < sizes.size(); i++) {
+        const double share = double(k) * sizes[i] / n;
+        allocated[i] = std::min(sizes[i], size_t(share));
+        remainders[i] = share - allocated[i];
+        total += allocated[i];
+    }
+
+    // the rest go to the largest remainders first. n > k, so there's always
+    // a cluster with room left.
+    std::vector<size_t> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return remainders[a] > remainders[b];
+    });
+    while (total < k) {
+        for (size_t i : order) {
+            if (total < k && allocated[i] < sizes[i]) {
+                allocated[i]++;
+                total++;
+            }
+        }
+    }
+    return allocated;
+}
+} // namespace
+
 std::vector<float> kmeans(
         const float* data,
         size_t n,
@@ -26,11 +67,83 @@ std::vector<float> kmeans(
     faiss::ClusteringParameters cp;
     cp.niter = iterations;
     cp.nredo = 1;
-    cp.verbose = true;
+    cp.verbose = false;
     faiss::Clustering clus(dim, k, cp);
 
     clus.train(n, data, index);
 
     return std::vector<float>(index.get_xb(), index.get_xb() + k * dim);
 }
-} // namespace lintdb
\ No newline at end of file
+
+std::vector<float> hierarchical_kmeans(
+        const float* data,
+        size_t n,
+        size_t dim,
+        size_t k,
+        int iterations,
+        size_t num_coarse) {
+    LINTDB_THROW_IF_NOT_MSG(
+            n > k,
+            "Number of data points must be greater than the number of clusters.");
+    if (num_coarse == 0) {
+        num_coarse = size_t(std::sqrt(double(k)));
+    }
+    num_coarse = std::max(size_t(1), std::min(num_coarse, k));
+
+    LOG(INFO) << "clustering " << n << " points in " << dim
+              << " dimensions into " << k << " clusters under " << num_coarse
+              << " coarse clusters.";
+
+    faiss::IndexFlatIP coarse(dim);
+    faiss::ClusteringParameters cp;
+    cp.niter = iterations;
+    cp.verbose = false;
+    faiss::Clustering coarse_clus(dim, num_coarse, cp);
+    coarse_clus.train(n, data, coarse);
+
+    // faiss assigns the points to coarse clusters on every thread.
+    std::vector<faiss::idx_t> labels(n);
+    coarse.assign(n, data, labels.data());
+
+    std::vector<std::vector<size_t>> members(num_coarse);
+    for (size_t i = 0; i < n; i++) {
+        members[labels[i]].push_back(i);
+    }
+    std::vector<size_t> sizes(num_coarse);
+    for (size_t c = 0; c < num_coarse; c++) {
+        sizes[c] = members[c].size();
+    }
+    const std::vector<size_t> allocated = allocate_centroids(sizes, n, k);
+    std::vector<size_t> offsets(num_coarse + 1, 0);
+    std::partial_sum(allocated.begin(), allocated.end(), offsets.begin() + 1);
+
+    std::vector<float> centroids(k * dim);
+#pragma omp parallel for schedule(dynamic)
+    for (size_t c = 0; c < num_coarse; c++) {
+        const size_t sub_k = allocated[c];
+        if (sub_k == 0) {
+            continue;
+        }
+        std::vector<float> points(sizes[c] * dim);
+        for (size_t i = 0; i < sizes[c]; i++) {
+            std::copy(
+                    data + members[c][i] * dim,
+                    data + (members[c][i] + 1) * dim,
+                    points.begin() + i * dim);
+        }
+        float* out = centroids.data() + offsets[c] * dim;
+        // a cluster with one centroid per point keeps its points.
+        if (sub_k == sizes[c]) {
+            std::copy(points.begin(), points.end(), out);
+            continue;
+        }
+
+        faiss::IndexFlatIP index(dim);
+        faiss::Clustering clus(dim, sub_k, cp);
+        clus.train(sizes[c], points.data(), index);
+        std::copy(clus.centroids.begin(), clus.centroids.end(), out);
+    }
+
+    return centroids;
+}
+} // namespace lintdb
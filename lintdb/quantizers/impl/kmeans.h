@@ -73,6 +73,23 @@ std::vector<float> kmeans(
         Metric metric,
         int iterations = 100);
 
+/**
+ * hierarchical_kmeans clusters data into k centroids in two levels.
+ *
+ * The data is first clustered into num_coarse clusters, sqrt(k) by default.
+ * Each coarse cluster then gets a share of the k centroids proportional to
+ * its size, and is clustered on its own. Coarse clusters are independent, so
+ * they're clustered in parallel, and each k-means only compares its points
+ * against its own centroids instead of all k.
+ */
+std::vector<float> hierarchical_kmeans(
+        const float* data,
+        size_t n,
+        size_t dim,
+        size_t k,
+        int iterations = 10,
+        size_t num_coarse = 0);
+
 } // namespace lintdb
 
 #endif // LINTDB_KMEANS_H
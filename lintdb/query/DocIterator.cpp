@@ -1,19 +1,47 @@
 #include "DocIterator.h"
 #include <glog/logging.h>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <unordered_map>
 #include "DocValue.h"
+#include "lintdb/assert.h"
 #include "lintdb/schema/DocEncoder.h"
 #include "lintdb/scoring/ScoredDocument.h"
+#include "lintdb/scoring/plaid.h"
 
 namespace lintdb {
 TermIterator::TermIterator(
         std::unique_ptr<Iterator> it,
         DataType type,
         UnaryScoringMethod scoring_method,
-        bool ignore_value)
-        : it_(std::move(it)), ignore_value(ignore_value), type(type), scoring_method(scoring_method) {}
+        bool ignore_value,
+        std::shared_ptr<const DeletedDocs> deleted)
+        : it_(std::move(it)),
+          ignore_value(ignore_value),
+          type(type),
+          scoring_method(scoring_method),
+          deleted_(std::move(deleted)) {
+    skip_deleted();
+}
 
 void TermIterator::advance() {
     it_->next();
+    skip_deleted();
+}
+
+void TermIterator::advance_to(const idx_t doc_id) {
+    it_->advance_to(doc_id);
+    skip_deleted();
+}
+
+void TermIterator::skip_deleted() {
+    if (deleted_.empty()) {
+        return;
+    }
+    while (it_->is_valid() && deleted_.is_deleted(doc_id())) {
+        it_->next();
+    }
 }
 
 bool TermIterator::is_valid() {
@@ -29,7 +57,7 @@ std::vector<DocValue> TermIterator::fields() const {
 
     SupportedTypes doc_value;
     if (!ignore_value) {
-        doc_value = DocEncoder::decode_supported_types(value);
+        doc_value = DocEncoder::decode_inverted_data(value);
     }
 
     DocValue result = DocValue(doc_value, field_id, type);
@@ -78,6 +106,36 @@ void ANNIterator::advance() {
     }
 }
 
+void ANNIterator::advance_to(const idx_t doc_id) {
+    if (!is_valid() || this->doc_id() >= doc_id) {
+        return;
+    }
+
+    for (auto& it : its_) {
+        if (it->is_valid() && it->doc_id() < doc_id) {
+            it->advance_to(doc_id);
+        }
+    }
+    rebuild_heap();
+}
+
+void ANNIterator::rebuild_heap() {
+    its_.erase(
+            std::remove_if(
+                    its_.begin(),
+                    its_.end(),
+                    [](const auto& it) { return !it->is_valid(); }),
+            its_.end());
+
+    for (int i = (its_.size()) - 1; i >= 0; --i) {
+        heapify(i);
+    }
+
+    if (!its_.empty()) {
+        last_doc_id_ = its_[0]->doc_id();
+    }
+}
+
 bool ANNIterator::is_valid() {
     return !its_.empty() && its_[0]->is_valid();
 }
@@ -98,14 +156,17 @@ std::vector<DocValue> ANNIterator::fields() const {
                     doc_fields.end());
         }
     }
-
-    auto context_fields = this->context_collector.get_context_values(this->doc_id());
-    for(const auto &context : context_fields) {
-        combined_fields.push_back(context);
-    }
     return combined_fields;
 }
 
+std::vector<DocValue> ANNIterator::context_fields(const idx_t doc_id) const {
+    return context_collector.get_context_values(doc_id);
+}
+
+void ANNIterator::prefetch_context(const std::vector<idx_t>& doc_ids) {
+    context_collector.prefetch(doc_ids);
+}
+
 void ANNIterator::heapify(size_t idx) {
     size_t count_ = its_.size();
     size_t min = idx;
@@ -133,6 +194,266 @@ ScoredDocument ANNIterator::score(std::vector<DocValue> fields) const {
     return ScoredDocument(score, 0, fields);
 }
 
+WANDIterator::WANDIterator(
+        std::vector<std::unique_ptr<DocIterator>> its,
+        std::vector<float> upper_bounds,
+        float base_bound,
+        ContextCollector context_collector,
+        std::shared_ptr<KnnNearestCentroids> knn,
+        EmbeddingScoringMethod scoring_method)
+        : base_bound_(base_bound),
+          threshold_(std::numeric_limits<score_t>::lowest()),
+          current_doc_id_(-1),
+          is_valid_(false),
+          context_collector(std::move(context_collector)),
+          knn_(std::move(knn)),
+          scoring_method(scoring_method) {
+    LINTDB_THROW_IF_NOT_MSG(
+            its.size() == upper_bounds.size(),
+            "each posting list needs an upper bound");
+    cursors_.reserve(its.size());
+    for (size_t i = 0; i < its.size(); i++) {
+        cursors_.push_back({std::move(its[i]), upper_bounds[i]});
+    }
+
+    find_next_candidate();
+}
+
+void WANDIterator::sort_cursors() {
+    cursors_.erase(
+            std::remove_if(
+                    cursors_.begin(),
+                    cursors_.end(),
+                    [](const Cursor& c) { return !c.it->is_valid(); }),
+            cursors_.end());
+
+    // cursors are nearly sorted after each step, so insertion sort is cheap.
+    for (size_t i = 1; i < cursors_.size(); i++) {
+        for (size_t j = i; j > 0 &&
+             cursors_[j].it->doc_id() < cursors_[j - 1].it->doc_id();
+             j--) {
+            std::swap(cursors_[j], cursors_[j - 1]);
+        }
+    }
+}
+
+void WANDIterator::find_next_candidate() {
+    while (true) {
+        sort_cursors();
+        if (cursors_.empty()) {
+            is_valid_ = false;
+            return;
+        }
+
+        // find the first cursor where the accumulated bound beats the
+        // threshold. documents before its doc id can't make the results.
+        score_t bound = base_bound_;
+        size_t pivot = cursors_.size();
+        for (size_t i = 0; i < cursors_.size(); i++) {
+            bound += cursors_[i].upper_bound;
+            if (bound > threshold_) {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == cursors_.size()) {
+            is_valid_ = false;
+            return;
+        }
+
+        idx_t pivot_doc_id = cursors_[pivot].it->doc_id();
+        if (cursors_[0].it->doc_id() == pivot_doc_id) {
+            current_doc_id_ = pivot_doc_id;
+            is_valid_ = true;
+            return;
+        }
+
+        for (size_t i = 0; i < pivot; i++) {
+            if (cursors_[i].it->doc_id() < pivot_doc_id) {
+                cursors_[i].it->advance_to(pivot_doc_id);
+            }
+        }
+    }
+}
+
+void WANDIterator::advance() {
+    if (!is_valid_) {
+        return;
+    }
+
+    for (auto& cursor : cursors_) {
+        if (cursor.it->doc_id() != current_doc_id_) {
+            break;
+        }
+        cursor.it->advance();
+    }
+    find_next_candidate();
+}
+
+void WANDIterator::advance_to(const idx_t doc_id) {
+    if (!is_valid_ || current_doc_id_ >= doc_id) {
+        return;
+    }
+
+    for (auto& cursor : cursors_) {
+        if (cursor.it->doc_id() >= doc_id) {
+            break;
+        }
+        cursor.it->advance_to(doc_id);
+    }
+    find_next_candidate();
+}
+
+bool WANDIterator::is_valid() {
+    return is_valid_;
+}
+
+void WANDIterator::set_score_threshold(const score_t threshold) {
+    threshold_ = std::max(threshold_, threshold);
+}
+
+idx_t WANDIterator::doc_id() const {
+    return current_doc_id_;
+}
+
+std::vector<DocValue> WANDIterator::fields() const {
+    std::vector<DocValue> combined_fields;
+    for (const auto& cursor : cursors_) {
+        if (cursor.it->doc_id() != current_doc_id_) {
+            break;
+        }
+        auto doc_fields = cursor.it->fields();
+        combined_fields.insert(
+                combined_fields.end(), doc_fields.begin(), doc_fields.end());
+    }
+    return combined_fields;
+}
+
+std::vector<DocValue> WANDIterator::context_fields(const idx_t doc_id) const {
+    return context_collector.get_context_values(doc_id);
+}
+
+void WANDIterator::prefetch_context(const std::vector<idx_t>& doc_ids) {
+    context_collector.prefetch(doc_ids);
+}
+
+ScoredDocument WANDIterator::score(std::vector<DocValue> fields) const {
+    score_t score = lintdb::score_embeddings(
+            this->scoring_method, fields, this->knn_);
+
+    return ScoredDocument(score, current_doc_id_, fields);
+}
+
+PlaidAccumulatorIterator::PlaidAccumulatorIterator(
+        std::vector<std::pair<idx_t, std::unique_ptr<Iterator>>> its,
+        uint8_t field_id,
+        ContextCollector context_collector,
+        std::shared_ptr<KnnNearestCentroids> knn,
+        std::shared_ptr<const DeletedDocs> deleted)
+        : pos_(0),
+          field_id(field_id),
+          context_collector(std::move(context_collector)) {
+    const size_t num_query_tokens = knn->get_num_query_tokens();
+
+    // accumulators hold num_query_tokens maxes per document, in the order we
+    // first see each document. They start where colbert_centroid_score does,
+    // so negative centroid scores count the same as in the PLAID path.
+    std::unordered_map<idx_t, size_t> doc_slots;
+    std::vector<idx_t> doc_ids;
+    std::vector<float> accumulators;
+    for (auto& list : its) {
+        const float* column = knn->get_centroid_scores(list.first);
+
+        for (auto& it = list.second; it->is_valid(); it->next()) {
+            idx_t doc_id = it->get_key().doc_id();
+            auto slot = doc_slots.find(doc_id);
+            if (slot == doc_slots.end()) {
+                slot = doc_slots.emplace(doc_id, doc_ids.size()).first;
+                doc_ids.push_back(doc_id);
+                accumulators.resize(
+                        accumulators.size() + num_query_tokens,
+                        kNoCentroidScore);
+            }
+
+            float* acc = accumulators.data() + slot->second * num_query_tokens;
+            for (size_t k = 0; k < num_query_tokens; k++) {
+                acc[k] = std::max(acc[k], column[k]);
+            }
+        }
+    }
+
+    scores_.reserve(doc_ids.size());
+    for (size_t i = 0; i < doc_ids.size(); i++) {
+        const float* acc = accumulators.data() + i * num_query_tokens;
+        float score = 0;
+        for (size_t k = 0; k < num_query_tokens; k++) {
+            score += acc[k];
+        }
+        scores_.emplace_back(doc_ids[i], score);
+    }
+    std::sort(scores_.begin(), scores_.end());
+
+    DeletedDocsCursor cursor(std::move(deleted));
+    scores_.erase(
+            std::remove_if(
+                    scores_.begin(),
+                    scores_.end(),
+                    [&](const std::pair<idx_t, float>& doc) {
+                        return cursor.is_deleted(doc.first);
+                    }),
+            scores_.end());
+}
+
+void PlaidAccumulatorIterator::advance() {
+    pos_++;
+}
+
+void PlaidAccumulatorIterator::advance_to(const idx_t doc_id) {
+    auto it = std::lower_bound(
+            scores_.begin() + pos_,
+            scores_.end(),
+            doc_id,
+            [](const std::pair<idx_t, float>& a, const idx_t b) {
+                return a.first < b;
+            });
+    pos_ = it - scores_.begin();
+}
+
+bool PlaidAccumulatorIterator::is_valid() {
+    return pos_ < scores_.size();
+}
+
+idx_t PlaidAccumulatorIterator::doc_id() const {
+    return scores_[pos_].first;
+}
+
+std::vector<DocValue> PlaidAccumulatorIterator::fields() const {
+    return {DocValue(scores_[pos_].second, field_id, DataType::FLOAT)};
+}
+
+std::vector<DocValue> PlaidAccumulatorIterator::deferred_fields(
+        const idx_t doc_id) const {
+    return context_collector.get_context_values(doc_id);
+}
+
+void PlaidAccumulatorIterator::prefetch_deferred_fields(
+        const std::vector<idx_t>& doc_ids) {
+    context_collector.prefetch(doc_ids);
+}
+
+ScoredDocument PlaidAccumulatorIterator::score(
+        std::vector<DocValue> fields) const {
+    score_t score = 0;
+    for (const auto& field : fields) {
+        if (field.type == DataType::FLOAT) {
+            score = std::get<float>(field.value);
+            break;
+        }
+    }
+
+    return ScoredDocument(score, 0, fields);
+}
+
 AndIterator::AndIterator(std::vector<std::unique_ptr<DocIterator>> iterators,
                          NaryScoringMethod scoring_method)
         : its_(std::move(iterators)), current_doc_id_(0), is_valid_(true), scoring_method(scoring_method) {
@@ -143,66 +464,66 @@ AndIterator::AndIterator(std::vector<std::unique_ptr<DocIterator>> iterators,
     }
 }
 
+/**
+ * synchronize leapfrogs the iterators onto the same document. Lagging
+ * iterators seek directly to the current candidate, so the number of seeks
+ * depends on the most selective iterator rather than the longest one.
+ */
 void AndIterator::synchronize() {
     if (its_.empty()) {
         is_valid_ = false;
         return;
     }
 
-    bool all_aligned;
-    do {
-        idx_t max_doc_id = std::numeric_limits<idx_t>::min();
-        all_aligned = true;
-
-        // Find the maximum current document ID among all iterators
-        for (const auto& it : its_) {
-            if (it->is_valid() && it->doc_id() > max_doc_id) {
-                max_doc_id = it->doc_id();
-            }
+    idx_t target = std::numeric_limits<idx_t>::min();
+    for (const auto& it : its_) {
+        if (!it->is_valid()) {
+            is_valid_ = false;
+            return;
         }
+        target = std::max(target, it->doc_id());
+    }
 
-        // Attempt to advance any iterators that are behind
-        for (auto& it : its_) {
-            while (it->is_valid() && it->doc_id() < max_doc_id) {
-                it->advance();
-                if (it->doc_id() > max_doc_id) {
-                    max_doc_id = it->doc_id();
-                    all_aligned = false;
-                    break;
-                }
-            }
-            // Check if all iterators are still valid
-            if (!it->is_valid() || it->doc_id() != max_doc_id) {
-                all_aligned = false;
-                break;
-            }
+    size_t num_aligned = 0;
+    size_t i = 0;
+    while (num_aligned < its_.size()) {
+        auto& it = its_[i];
+        it->advance_to(target);
+        if (!it->is_valid()) {
+            is_valid_ = false;
+            return;
         }
-    } while (!all_aligned &&
-             std::all_of(its_.begin(), its_.end(), [](const auto& it) {
-                 return it->is_valid();
-             }));
 
-    if (all_aligned && !its_.empty()) {
-        current_doc_id_ = its_.front()->doc_id();
-        is_valid_ = true;
-    } else {
-        is_valid_ = false;
+        if (it->doc_id() == target) {
+            num_aligned++;
+        } else {
+            // this iterator overshot, so every other iterator must catch up.
+            target = it->doc_id();
+            num_aligned = 1;
+        }
+        i = (i + 1) % its_.size();
     }
+
+    current_doc_id_ = target;
+    is_valid_ = true;
 }
 
 void AndIterator::advance() {
     if (!is_valid_)
         return;
 
-    for (auto& it : its_) {
-        if (it->is_valid()) {
-            it->advance();
-        } else {
-            is_valid_ = false;
-            return;
-        }
-    }
-    synchronize(); // Realign after advancing
+    // all iterators are aligned on the current document. Moving one of them
+    // forward is enough for synchronize to find the next match.
+    its_.front()->advance();
+    synchronize();
+}
+
+void AndIterator::advance_to(const idx_t doc_id) {
+    if (!is_valid_ || current_doc_id_ >= doc_id)
+        return;
+
+    its_.front()->advance_to(doc_id);
+    synchronize();
 }
 
 bool AndIterator::is_valid() {
@@ -223,6 +544,37 @@ std::vector<DocValue> AndIterator::fields() const {
     }
     return results;
 }
+
+std::vector<DocValue> AndIterator::context_fields(const idx_t doc_id) const {
+    std::vector<DocValue> results;
+    for (const auto& it : its_) {
+        auto context = it->context_fields(doc_id);
+        results.insert(results.end(), context.begin(), context.end());
+    }
+    return results;
+}
+
+void AndIterator::prefetch_context(const std::vector<idx_t>& doc_ids) {
+    for (auto& it : its_) {
+        it->prefetch_context(doc_ids);
+    }
+}
+
+std::vector<DocValue> AndIterator::deferred_fields(const idx_t doc_id) const {
+    std::vector<DocValue> results;
+    for (const auto& it : its_) {
+        auto deferred = it->deferred_fields(doc_id);
+        results.insert(results.end(), deferred.begin(), deferred.end());
+    }
+    return results;
+}
+
+void AndIterator::prefetch_deferred_fields(const std::vector<idx_t>& doc_ids) {
+    for (auto& it : its_) {
+        it->prefetch_deferred_fields(doc_ids);
+    }
+}
+
 ScoredDocument AndIterator::score(std::vector<DocValue> fields) const {
     std::vector<score_t> scores;
     for (const auto& it : its_) {
@@ -255,6 +607,7 @@ void OrIterator::advance() {
         heapify(0);
         if (!its_[0]->is_valid()) {
             std::swap(its_[0], its_.back());
+            finished_.push_back(std::move(its_.back()));
             its_.pop_back();
             heapify(0);
         }
@@ -266,6 +619,36 @@ void OrIterator::advance() {
     }
 }
 
+void OrIterator::advance_to(const idx_t doc_id) {
+    if (!is_valid() || this->doc_id() >= doc_id) {
+        return;
+    }
+
+    for (auto& it : its_) {
+        if (it->is_valid() && it->doc_id() < doc_id) {
+            it->advance_to(doc_id);
+        }
+    }
+    rebuild_heap();
+}
+
+void OrIterator::rebuild_heap() {
+    auto valid_end = std::partition(
+            its_.begin(), its_.end(), [](const auto& it) {
+                return it->is_valid();
+            });
+    std::move(valid_end, its_.end(), std::back_inserter(finished_));
+    its_.erase(valid_end, its_.end());
+
+    for (int i = (its_.size()) - 1; i >= 0; --i) {
+        heapify(i);
+    }
+
+    if (!its_.empty()) {
+        last_doc_id_ = its_[0]->doc_id();
+    }
+}
+
 bool OrIterator::is_valid() {
     return !its_.empty() && its_[0]->is_valid();
 }
@@ -289,6 +672,44 @@ std::vector<DocValue> OrIterator::fields() const {
     return combined_fields;
 }
 
+std::vector<DocValue> OrIterator::context_fields(const idx_t doc_id) const {
+    std::vector<DocValue> results;
+    for (const auto* its : {&its_, &finished_}) {
+        for (const auto& it : *its) {
+            auto context = it->context_fields(doc_id);
+            results.insert(results.end(), context.begin(), context.end());
+        }
+    }
+    return results;
+}
+
+void OrIterator::prefetch_context(const std::vector<idx_t>& doc_ids) {
+    for (auto* its : {&its_, &finished_}) {
+        for (auto& it : *its) {
+            it->prefetch_context(doc_ids);
+        }
+    }
+}
+
+std::vector<DocValue> OrIterator::deferred_fields(const idx_t doc_id) const {
+    std::vector<DocValue> results;
+    for (const auto* its : {&its_, &finished_}) {
+        for (const auto& it : *its) {
+            auto deferred = it->deferred_fields(doc_id);
+            results.insert(results.end(), deferred.begin(), deferred.end());
+        }
+    }
+    return results;
+}
+
+void OrIterator::prefetch_deferred_fields(const std::vector<idx_t>& doc_ids) {
+    for (auto* its : {&its_, &finished_}) {
+        for (auto& it : *its) {
+            it->prefetch_deferred_fields(doc_ids);
+        }
+    }
+}
+
 void OrIterator::heapify(size_t idx) {
     size_t count_ = its_.size();
     size_t min = idx;
@@ -311,10 +732,15 @@ void OrIterator::heapify(size_t idx) {
 }
 
 ScoredDocument OrIterator::score(std::vector<DocValue> fields) const {
+    // documents are scored in blocks after iteration, from their fields, so
+    // which children had run out then says nothing about the document.
+    // Every child scores it, including the finished ones.
     std::vector<score_t> scores;
-    for (const auto& it : its_) {
-        auto scored_doc = it->score(fields);
-        scores.push_back(scored_doc.score);
+    for (const auto* its : {&its_, &finished_}) {
+        for (const auto& it : *its) {
+            auto scored_doc = it->score(fields);
+            scores.push_back(scored_doc.score);
+        }
     }
 
     score_t score = lintdb::score(this->scoring_method, scores);
@@ -9,6 +9,7 @@
 #include "lintdb/scoring/scoring_methods.h"
 #include "lintdb/scoring/ScoredDocument.h"
 #include "lintdb/invlists/ContextIterator.h"
+#include "lintdb/invlists/Tombstones.h"
 #include "lintdb/scoring/ContextCollector.h"
 #include "lintdb/query/KnnNearestCentroids.h"
 
@@ -24,6 +25,55 @@ class DocIterator {
     virtual void advance() = 0;
     virtual bool is_valid() = 0;
 
+    /**
+     * advance_to moves to the first document with an id greater than or equal
+     * to doc_id. Iterators never move backwards.
+     *
+     * The default implementation calls advance() until we reach doc_id.
+     */
+    virtual void advance_to(const idx_t doc_id) {
+        while (is_valid() && this->doc_id() < doc_id) {
+            advance();
+        }
+    }
+
+    /**
+     * set_score_threshold tells the iterator that documents scoring at or
+     * below threshold can't make it into the results.
+     *
+     * Iterators that can bound their scores may use this to skip documents.
+     * The default implementation ignores it.
+     */
+    virtual void set_score_threshold(const score_t threshold) {}
+
+    /**
+     * deferred_fields returns fields the iterator skipped reading while
+     * iterating, such as ColBERT context. They are only needed by documents
+     * that make it to the second pass.
+     */
+    virtual std::vector<DocValue> deferred_fields(const idx_t doc_id) const {
+        return {};
+    }
+
+    /**
+     * context_fields returns the document context needed to score doc_id,
+     * such as ColBERT codes. It isn't part of fields(), so the caller can read
+     * it for a block of candidates at once with prefetch_context().
+     */
+    virtual std::vector<DocValue> context_fields(const idx_t doc_id) const {
+        return {};
+    }
+
+    /**
+     * prefetch_context reads the context of doc_ids in one batch. The next
+     * context_fields() call for each of these documents is served from
+     * memory.
+     */
+    virtual void prefetch_context(const std::vector<idx_t>& doc_ids) {}
+
+    /// prefetch_deferred_fields is prefetch_context for deferred_fields().
+    virtual void prefetch_deferred_fields(const std::vector<idx_t>& doc_ids) {}
+
     virtual idx_t doc_id() const = 0;
     virtual std::vector<DocValue> fields() const = 0;
     virtual ScoredDocument score(std::vector<DocValue> fields) const = 0;
@@ -31,6 +81,9 @@ class DocIterator {
     virtual ~DocIterator() = default;
 };
 
+/**
+ * TermIterator walks one posting list. Deleted documents are skipped.
+ */
 class TermIterator : public DocIterator {
    private:
     std::unique_ptr<Iterator> it_;
@@ -41,8 +94,10 @@ class TermIterator : public DocIterator {
             std::unique_ptr<Iterator> it,
             DataType type,
             UnaryScoringMethod scoring_method,
-            bool ignore_value = false);
+            bool ignore_value = false,
+            std::shared_ptr<const DeletedDocs> deleted = nullptr);
     void advance() override;
+    void advance_to(const idx_t doc_id) override;
     bool is_valid() override;
 
     idx_t doc_id() const override;
@@ -53,6 +108,9 @@ class TermIterator : public DocIterator {
     bool ignore_value;
     DataType type;
     UnaryScoringMethod scoring_method;
+    DeletedDocsCursor deleted_;
+
+    void skip_deleted();
 };
 
 class ANNIterator : public DocIterator {
@@ -62,8 +120,12 @@ class ANNIterator : public DocIterator {
                          std::shared_ptr<KnnNearestCentroids> knn,
                          EmbeddingScoringMethod scoring_method);
     void advance() override;
+    void advance_to(const idx_t doc_id) override;
     bool is_valid() override;
 
+    std::vector<DocValue> context_fields(const idx_t doc_id) const override;
+    void prefetch_context(const std::vector<idx_t>& doc_ids) override;
+
     idx_t doc_id() const override;
     std::vector<DocValue> fields() const override;
     ScoredDocument score(std::vector<DocValue> fields) const override;
@@ -76,6 +138,92 @@ class ANNIterator : public DocIterator {
     idx_t last_doc_id_;
     EmbeddingScoringMethod scoring_method;
     void heapify(size_t idx);
+    void rebuild_heap();
+};
+
+/**
+ * WANDIterator is an ANNIterator that skips documents whose PLAID score can't
+ * beat the current score threshold.
+ *
+ * Each posting list carries an upper bound on what its centroid adds to a
+ * document's score. Lists are kept sorted by doc id, and we pick a pivot: the
+ * first document where the summed bounds exceed the threshold. Any document
+ * before the pivot can't make it into the results, so lagging lists seek
+ * straight to the pivot instead of reading every posting.
+ */
+class WANDIterator : public DocIterator {
+   public:
+    WANDIterator(
+            std::vector<std::unique_ptr<DocIterator>> its,
+            std::vector<float> upper_bounds,
+            float base_bound,
+            ContextCollector context_collector,
+            std::shared_ptr<KnnNearestCentroids> knn,
+            EmbeddingScoringMethod scoring_method);
+    void advance() override;
+    void advance_to(const idx_t doc_id) override;
+    bool is_valid() override;
+    void set_score_threshold(const score_t threshold) override;
+    std::vector<DocValue> context_fields(const idx_t doc_id) const override;
+    void prefetch_context(const std::vector<idx_t>& doc_ids) override;
+
+    idx_t doc_id() const override;
+    std::vector<DocValue> fields() const override;
+    ScoredDocument score(std::vector<DocValue> fields) const override;
+
+   private:
+    struct Cursor {
+        std::unique_ptr<DocIterator> it;
+        float upper_bound;
+    };
+    std::vector<Cursor> cursors_; /// sorted by doc id.
+    float base_bound_;
+    score_t threshold_;
+    idx_t current_doc_id_;
+    bool is_valid_;
+    ContextCollector context_collector;
+    std::shared_ptr<KnnNearestCentroids> knn_;
+    EmbeddingScoringMethod scoring_method;
+
+    void sort_cursors();
+    void find_next_candidate();
+};
+
+/**
+ * PlaidAccumulatorIterator scores documents term-at-a-time.
+ *
+ * On construction, we walk each probed centroid's posting list once and keep,
+ * per document, the max centroid score for each query token. The sum of those
+ * maxes is the approximate PLAID score, so iterating doesn't read any
+ * document's codes. Only centroids we probe contribute to the score, and
+ * query tokens that match none of them contribute 0.
+ *
+ * ColBERT context is returned by deferred_fields() so it's only read for the
+ * documents we rerank. Deleted documents are dropped before iterating.
+ */
+class PlaidAccumulatorIterator : public DocIterator {
+   public:
+    PlaidAccumulatorIterator(
+            std::vector<std::pair<idx_t, std::unique_ptr<Iterator>>> its,
+            uint8_t field_id,
+            ContextCollector context_collector,
+            std::shared_ptr<KnnNearestCentroids> knn,
+            std::shared_ptr<const DeletedDocs> deleted = nullptr);
+    void advance() override;
+    void advance_to(const idx_t doc_id) override;
+    bool is_valid() override;
+    std::vector<DocValue> deferred_fields(const idx_t doc_id) const override;
+    void prefetch_deferred_fields(const std::vector<idx_t>& doc_ids) override;
+
+    idx_t doc_id() const override;
+    std::vector<DocValue> fields() const override;
+    ScoredDocument score(std::vector<DocValue> fields) const override;
+
+   private:
+    std::vector<std::pair<idx_t, float>> scores_; /// sorted by doc id.
+    size_t pos_;
+    uint8_t field_id;
+    ContextCollector context_collector;
 };
 
 class AndIterator : public DocIterator {
@@ -91,7 +239,12 @@ class AndIterator : public DocIterator {
     AndIterator(std::vector<std::unique_ptr<DocIterator>> iterators,
                 NaryScoringMethod scoring_method);
     void advance() override;
+    void advance_to(const idx_t doc_id) override;
     bool is_valid() override;
+    std::vector<DocValue> context_fields(const idx_t doc_id) const override;
+    void prefetch_context(const std::vector<idx_t>& doc_ids) override;
+    std::vector<DocValue> deferred_fields(const idx_t doc_id) const override;
+    void prefetch_deferred_fields(const std::vector<idx_t>& doc_ids) override;
     idx_t doc_id() const override;
     std::vector<DocValue> fields() const override;
     ScoredDocument score(std::vector<DocValue> fields) const override;
@@ -102,7 +255,12 @@ class OrIterator : public DocIterator {
     explicit OrIterator(std::vector<std::unique_ptr<DocIterator>> its,
                         NaryScoringMethod scoring_method);
     void advance() override;
+    void advance_to(const idx_t doc_id) override;
     bool is_valid() override;
+    std::vector<DocValue> context_fields(const idx_t doc_id) const override;
+    void prefetch_context(const std::vector<idx_t>& doc_ids) override;
+    std::vector<DocValue> deferred_fields(const idx_t doc_id) const override;
+    void prefetch_deferred_fields(const std::vector<idx_t>& doc_ids) override;
 
     idx_t doc_id() const override;
     std::vector<DocValue> fields() const override;
@@ -111,9 +269,13 @@ class OrIterator : public DocIterator {
    private:
     std::vector<DocValue> fields_;
     std::vector<std::unique_ptr<DocIterator>> its_;
+    /// exhausted iterators. Candidates are scored in blocks, so they can still
+    /// be asked for context and scores after they run out.
+    std::vector<std::unique_ptr<DocIterator>> finished_;
     idx_t last_doc_id_;
     NaryScoringMethod scoring_method;
     void heapify(size_t idx);
+    void rebuild_heap();
 };
 
 } // namespace lintdb
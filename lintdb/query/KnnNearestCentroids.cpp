@@ -1,5 +1,8 @@
 #include "KnnNearestCentroids.h"
 #include <glog/logging.h>
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
 #include "lintdb/quantizers/impl/kmeans.h"
 
 namespace lintdb {
@@ -15,7 +18,6 @@ void KnnNearestCentroids::calculate(
 
     distances.resize(num_query_tokens * total_centroids_to_calculate);
     coarse_idx.resize(num_query_tokens * total_centroids_to_calculate);
-    reordered_distances.resize(num_query_tokens * num_centroids);
 
     quantizer->search(
             num_query_tokens,
@@ -24,13 +26,113 @@ void KnnNearestCentroids::calculate(
             distances.data(),
             coarse_idx.data());
 
-    // We use this for ColBERT scoring.
-    for (int i = 0; i < num_query_tokens; i++) {
-        for (int j = 0; j < total_centroids_to_calculate; j++) {
-            auto current_code =
-                    coarse_idx[i * total_centroids_to_calculate + j];
-            float dis = distances[i * total_centroids_to_calculate + j];
-            reordered_distances[i * num_centroids + current_code] = dis;
+    build_centroid_scores();
+}
+
+std::vector<std::shared_ptr<KnnNearestCentroids>> KnnNearestCentroids::
+        calculate_batch(
+                const std::vector<std::vector<float>>& queries,
+                const std::vector<size_t>& num_query_tokens,
+                const std::shared_ptr<ICoarseQuantizer> quantizer,
+                const size_t total_centroids_to_calculate) {
+    LINTDB_THROW_IF_NOT(queries.size() == num_query_tokens.size());
+
+    std::vector<float> all_tokens;
+    size_t total_tokens = 0;
+    for (size_t i = 0; i < queries.size(); i++) {
+        all_tokens.insert(
+                all_tokens.end(), queries[i].begin(), queries[i].end());
+        total_tokens += num_query_tokens[i];
+    }
+
+    // one search over every token lets the quantizer batch its GEMM.
+    std::vector<float> all_distances(
+            total_tokens * total_centroids_to_calculate);
+    std::vector<idx_t> all_idx(total_tokens * total_centroids_to_calculate);
+    if (total_tokens > 0) {
+        quantizer->search(
+                total_tokens,
+                all_tokens.data(),
+                total_centroids_to_calculate,
+                all_distances.data(),
+                all_idx.data());
+    }
+
+    std::vector<std::shared_ptr<KnnNearestCentroids>> results;
+    results.reserve(queries.size());
+    size_t offset = 0;
+    for (size_t i = 0; i < queries.size(); i++) {
+        auto knn = std::make_shared<KnnNearestCentroids>();
+        knn->num_centroids = quantizer->num_centroids();
+        knn->total_centroids_to_calculate = total_centroids_to_calculate;
+        knn->query = queries[i];
+        knn->num_query_tokens = num_query_tokens[i];
+
+        size_t begin = offset * total_centroids_to_calculate;
+        size_t end = (offset + num_query_tokens[i]) *
+                total_centroids_to_calculate;
+        knn->distances.assign(
+                all_distances.begin() + begin, all_distances.begin() + end);
+        knn->coarse_idx.assign(all_idx.begin() + begin, all_idx.begin() + end);
+        knn->build_centroid_scores();
+
+        offset += num_query_tokens[i];
+        results.push_back(std::move(knn));
+    }
+
+    return results;
+}
+
+void KnnNearestCentroids::build_centroid_scores() {
+    const size_t m = total_centroids_to_calculate;
+    sparse_slots.clear();
+    floor_scores.clear();
+
+    if (!is_sparse()) {
+        centroid_scores.resize(num_centroids * num_query_tokens);
+
+        // We use this for ColBERT scoring.
+        for (int i = 0; i < num_query_tokens; i++) {
+            for (int j = 0; j < m; j++) {
+                auto current_code = coarse_idx[i * m + j];
+                if (current_code < 0) {
+                    continue;
+                }
+                float dis = distances[i * m + j];
+                centroid_scores[current_code * num_query_tokens + i] = dis;
+            }
+        }
+        return;
+    }
+
+    // scores are sorted per token, so the last one we kept is the floor.
+    floor_scores.resize(num_query_tokens);
+    for (size_t i = 0; i < num_query_tokens; i++) {
+        floor_scores[i] = m > 0 ? distances[i * m + m - 1] : 0;
+    }
+
+    centroid_scores.clear();
+    for (size_t i = 0; i < num_query_tokens; i++) {
+        for (size_t j = 0; j < m; j++) {
+            auto current_code = coarse_idx[i * m + j];
+            if (current_code < 0) {
+                continue;
+            }
+            auto slot = sparse_slots.find(current_code);
+            if (slot == sparse_slots.end()) {
+                slot = sparse_slots
+                               .emplace(
+                                       current_code,
+                                       centroid_scores.size() /
+                                               num_query_tokens)
+                               .first;
+                centroid_scores.insert(
+                        centroid_scores.end(),
+                        floor_scores.begin(),
+                        floor_scores.end());
+            }
+            centroid_scores[slot->second * num_query_tokens + i] =
+                    distances[i * m + j];
         }
     }
 }
@@ -41,17 +143,19 @@ std::vector<std::pair<float, idx_t>> KnnNearestCentroids::get_top_centroids(
     // we're finding the highest centroid scores per centroid.
     std::vector<float> high_scores(num_centroids, 0);
     for (size_t i = 0; i < num_query_tokens; i++) {
-        for (size_t j = 0; j < k_top_centroids; j++) {
-            auto centroid_of_interest = coarse_idx[i * num_centroids + j];
+        for (size_t j = 0;
+             j < std::min(k_top_centroids, total_centroids_to_calculate);
+             j++) {
+            auto centroid_of_interest =
+                    coarse_idx[i * total_centroids_to_calculate + j];
             // Note: including the centroid score threshold is not part of the
             // original colBERT model.
             // distances[i*total_centroids_to_calculate+j] >
             // centroid_score_threshold &&
 
-            if (distances[i * num_centroids + j] >
-                high_scores[centroid_of_interest]) {
-                high_scores[centroid_of_interest] =
-                        distances[i * num_centroids + j];
+            float score = distances[i * total_centroids_to_calculate + j];
+            if (score > high_scores[centroid_of_interest]) {
+                high_scores[centroid_of_interest] = score;
             }
         }
     }
@@ -82,7 +186,7 @@ std::vector<std::pair<float, idx_t>> KnnNearestCentroids::get_top_centroids(
                         centroid_scores.begin(),
                         centroid_scores.end(),
                         comparator);
-                centroid_scores.front() = std::pair<float, idx_t>(score, key);
+                centroid_scores.back() = std::pair<float, idx_t>(score, key);
                 std::push_heap(
                         centroid_scores.begin(),
                         centroid_scores.end(),
@@ -108,4 +212,50 @@ std::vector<std::pair<float, idx_t>> KnnNearestCentroids::get_top_centroids(
 
     return centroid_scores;
 }
-} // namespace lintdb
\ No newline at end of file
+float KnnNearestCentroids::get_score_bounds(
+        const std::vector<idx_t>& probed_centroids,
+        std::vector<float>& weights) const {
+    std::unordered_set<idx_t> probed(
+            probed_centroids.begin(), probed_centroids.end());
+    weights.assign(probed_centroids.size(), 0);
+
+    std::vector<const float*> probed_scores;
+    probed_scores.reserve(probed_centroids.size());
+    for (const auto code : probed_centroids) {
+        probed_scores.push_back(get_centroid_scores(code));
+    }
+
+    float base = 0;
+    for (size_t i = 0; i < num_query_tokens; i++) {
+        // the centroids for each token are sorted by score, so the first
+        // centroid we don't probe bounds every centroid we don't probe.
+        float rest = std::numeric_limits<float>::max();
+        bool found = false;
+        for (size_t j = 0; j < total_centroids_to_calculate; j++) {
+            idx_t code = coarse_idx[i * total_centroids_to_calculate + j];
+            if (probed.find(code) == probed.end()) {
+                rest = distances[i * total_centroids_to_calculate + j];
+                found = true;
+                break;
+            }
+        }
+        if (!found && is_sparse()) {
+            // centroids we didn't keep score the floor.
+            rest = floor_scores[i];
+        } else if (!found) {
+            // every centroid is probed. any value works as the base, so we
+            // use the lowest probed score.
+            for (const auto* scores : probed_scores) {
+                rest = std::min(rest, scores[i]);
+            }
+        }
+
+        base += rest;
+        for (size_t p = 0; p < probed_centroids.size(); p++) {
+            weights[p] += std::max(0.0f, probed_scores[p][i] - rest);
+        }
+    }
+
+    return base;
+}
+} // namespace lintdb
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include "lintdb/assert.h"
@@ -16,17 +17,53 @@ struct QueryTensor {
 class KnnNearestCentroids {
    public:
     KnnNearestCentroids() = default;
+    /**
+     * calculate scores the query against the coarse quantizer.
+     *
+     * If total_centroids_to_calculate is less than the number of centroids,
+     * we only keep that many centroid scores per query token.
+     */
     void calculate(
             std::vector<float>& query,
             const size_t num_query_tokens,
             const std::shared_ptr<ICoarseQuantizer> quantizer,
             const size_t total_centroids_to_calculate);
 
+    /**
+     * calculate_batch computes nearest centroids for many queries with a
+     * single search of the coarse quantizer.
+     *
+     * @param queries the query tensors, each of size (num_tokens, dim).
+     * @param num_query_tokens the number of tokens in each query.
+     * @return one KnnNearestCentroids per query, in the same order.
+     */
+    static std::vector<std::shared_ptr<KnnNearestCentroids>> calculate_batch(
+            const std::vector<std::vector<float>>& queries,
+            const std::vector<size_t>& num_query_tokens,
+            const std::shared_ptr<ICoarseQuantizer> quantizer,
+            const size_t total_centroids_to_calculate);
+
     std::vector<std::pair<float, idx_t>> get_top_centroids(
             const size_t k_top_centroids, /// k centroids per token to consider.
             const size_t n_probe /// overall number of centroids to return.
     ) const;
 
+    /**
+     * get_score_bounds computes upper bounds on how much each probed centroid
+     * can add to a document's PLAID score.
+     *
+     * For any document found in the probed lists S, its PLAID score is at most
+     * base + sum(weights[c] for c in S). This lets us skip documents that
+     * can't beat a score threshold without reading their codes.
+     *
+     * @param probed_centroids the centroids whose posting lists we search.
+     * @param weights output. one upper bound per probed centroid.
+     * @return the base bound shared by every document.
+     */
+    float get_score_bounds(
+            const std::vector<idx_t>& probed_centroids,
+            std::vector<float>& weights) const;
+
     inline std::vector<float> get_distances() const {
         return distances;
     }
@@ -34,6 +71,10 @@ class KnnNearestCentroids {
         return coarse_idx;
     }
 
+    inline size_t get_num_query_tokens() const {
+        return num_query_tokens;
+    }
+
     inline size_t get_num_centroids() const {
         return num_centroids;
     }
@@ -43,8 +84,28 @@ class KnnNearestCentroids {
         return coarse_idx[idx * total_centroids_to_calculate];
     }
 
-    inline const std::vector<float>& get_reordered_distances() const {
-        return reordered_distances;
+    /**
+     * get_centroid_scores returns a centroid's score for every query token.
+     * The num_query_tokens scores are contiguous.
+     *
+     * When we calculate fewer centroids than the quantizer has, only the top
+     * centroids per query token are kept. Every other centroid gets the floor
+     * scores: the lowest score we kept for each query token.
+     */
+    inline const float* get_centroid_scores(const idx_t centroid) const {
+        if (!is_sparse()) {
+            return centroid_scores.data() + centroid * num_query_tokens;
+        }
+        auto slot = sparse_slots.find(centroid);
+        if (slot == sparse_slots.end()) {
+            return floor_scores.data();
+        }
+        return centroid_scores.data() + slot->second * num_query_tokens;
+    }
+
+    /// whether we only keep the top centroid scores per query token.
+    inline bool is_sparse() const {
+        return total_centroids_to_calculate < num_centroids;
     }
 
     inline bool is_valid() const {
@@ -59,15 +120,21 @@ class KnnNearestCentroids {
     }
 
    private:
+    // fills centroid_scores from distances and coarse_idx.
+    void build_centroid_scores();
+
     std::vector<float> query;
-    size_t num_query_tokens;
-    size_t num_centroids;
-    size_t total_centroids_to_calculate;
+    size_t num_query_tokens = 0;
+    size_t num_centroids = 0;
+    size_t total_centroids_to_calculate = 0;
     std::vector<std::pair<float, idx_t>> top_centroids;
     std::vector<float> distances;
     std::vector<idx_t> coarse_idx;
-    std::vector<float> reordered_distances; /// distances that match the
-                                            /// centroid id position.
+    std::vector<float> centroid_scores; /// centroid-major scores. when
+                                        /// sparse, rows are in slot order.
+    std::unordered_map<idx_t, size_t> sparse_slots; /// centroid -> row.
+    std::vector<float> floor_scores; /// per token score for centroids we
+                                     /// didn't keep.
 };
 
 } // namespace lintdb
@@ -3,6 +3,7 @@
 #include <unordered_map>
 #include <variant>
 #include "lintdb/invlists/InvertedList.h"
+#include "lintdb/invlists/Tombstones.h"
 #include "lintdb/quantizers/CoarseQuantizer.h"
 #include "lintdb/quantizers/Quantizer.h"
 #include "lintdb/query/KnnNearestCentroids.h"
@@ -23,13 +24,15 @@ class QueryContext {
                     std::string,
                     std::shared_ptr<ICoarseQuantizer>>& coarse_quantizer_map,
             const std::unordered_map<std::string, std::shared_ptr<Quantizer>>&
-                    quantizer_map)
+                    quantizer_map,
+            const std::shared_ptr<const DeletedDocs> deletedDocs = nullptr)
             : colbert_context(colbert_field),
               tenant(tenant),
               db_(invertedList),
               fieldMapper_(fieldMapper),
               coarse_quantizer_map(coarse_quantizer_map),
-              quantizer_map(quantizer_map) {}
+              quantizer_map(quantizer_map),
+              deletedDocs_(deletedDocs) {}
 
     inline std::shared_ptr<FieldMapper> getFieldMapper() const {
         return fieldMapper_;
@@ -43,6 +46,11 @@ class QueryContext {
         return tenant;
     }
 
+    /// the tenant's deleted documents, or null if there are none.
+    inline std::shared_ptr<const DeletedDocs> getDeletedDocs() const {
+        return deletedDocs_;
+    }
+
     inline std::shared_ptr<ICoarseQuantizer> getCoarseQuantizer(
             const std::string& field) const {
         return coarse_quantizer_map.at(field);
@@ -78,6 +86,7 @@ class QueryContext {
             coarse_quantizer_map;
     const std::unordered_map<std::string, std::shared_ptr<Quantizer>>&
             quantizer_map;
+    const std::shared_ptr<const DeletedDocs> deletedDocs_;
     std::unordered_map<std::string, std::shared_ptr<KnnNearestCentroids>>
             knnNearestCentroidsMap;
 };
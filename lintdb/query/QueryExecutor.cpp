@@ -1,4 +1,10 @@
 #include "QueryExecutor.h"
+#include <glog/logging.h>
+#include <omp.h>
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <utility>
 #include <vector>
 #include "decode.h"
 #include "DocIterator.h"
@@ -6,6 +12,7 @@
 #include "lintdb/query/KnnNearestCentroids.h"
 #include "lintdb/scoring/ContextCollector.h"
 #include "lintdb/scoring/ScoredDocument.h"
+#include "lintdb/scoring/TopKCollector.h"
 
 namespace lintdb {
 QueryExecutor::QueryExecutor(Scorer& ranker)
@@ -18,43 +25,88 @@ std::vector<ScoredDocument> QueryExecutor::execute(
         const SearchOptions& opts) {
     std::unique_ptr<DocIterator> doc_it = query.root->process(context, opts);
 
-    std::vector<std::pair<idx_t, std::vector<DocValue>>> documents;
-    for(; doc_it->is_valid(); doc_it->advance()) {
-        std::vector<DocValue> dvs = doc_it->fields();
+    // we score candidates in blocks while iterating. Each thread keeps its own
+    // bounded heap of the best candidates, so memory is bounded by
+    // num_second_pass instead of the number of candidates.
+    const int num_threads = omp_get_max_threads();
+    std::vector<TopKCollector> collectors(
+            num_threads, TopKCollector(opts.num_second_pass));
 
-        documents.emplace_back(doc_it->doc_id(), dvs);
-    }
+    std::vector<std::pair<idx_t, std::vector<DocValue>>> block;
+    block.reserve(kCandidateBlockSize);
+
+    std::vector<idx_t> block_ids;
+    block_ids.reserve(kCandidateBlockSize);
+
+    auto score_block = [&]() {
+        // read the whole block's context in one batch instead of seeking for
+        // each candidate.
+        block_ids.clear();
+        for (const auto& doc : block) {
+            block_ids.push_back(doc.first);
+        }
+        doc_it->prefetch_context(block_ids);
+        for (auto& doc : block) {
+            auto context = doc_it->context_fields(doc.first);
+            doc.second.insert(
+                    doc.second.end(),
+                    std::make_move_iterator(context.begin()),
+                    std::make_move_iterator(context.end()));
+        }
+
+#pragma omp parallel for if (block.size() > 100)
+        for (int i = 0; i < block.size(); i++) {
+            auto& doc = block[i];
+            ScoredDocument scored = doc_it->score(std::move(doc.second));
+            scored.doc_id = doc.first;
+
+            if (opts.expected_id != -1 && doc.first == opts.expected_id) {
+                LOG(INFO) << "\tscore: " << scored.score;
+            }
 
-    std::vector<ScoredDocument> results(documents.size());
-#pragma omp parallel for if(documents.size() > 100)
-    for(int i = 0; i < documents.size(); i++) {
-        auto doc = documents[i];
-//        for (auto& dv : doc.second) {
-//            // ColBERT is a special case where we don't have a value to decode.
-//            if (dv.unread_value) {
-//                continue;
-//            }
-//            dv = decode_vectors(context, dv);
-//        }
-        ScoredDocument scored = doc_it->score(doc.second);
-        scored.doc_id = doc.first;
-
-        if (opts.expected_id != -1 && doc.first == opts.expected_id) {
-            LOG(INFO) << "\tscore: " << scored.score;
+            collectors[omp_get_thread_num()].collect(std::move(scored));
         }
+        block.clear();
 
-        results[i] = scored;
-    } // end for
+        // any full collector's k-th score is a lower bound on the final k-th
+        // score, so the iterator can skip candidates that can't beat it.
+        score_t threshold = std::numeric_limits<score_t>::lowest();
+        for (const auto& collector : collectors) {
+            threshold = std::max(threshold, collector.threshold());
+        }
+        doc_it->set_score_threshold(threshold);
+    };
 
-    std::sort(results.begin(), results.end(), std::greater<>());
+    for (; doc_it->is_valid(); doc_it->advance()) {
+        block.emplace_back(doc_it->doc_id(), doc_it->fields());
 
-    size_t num_to_rank = std::min(results.size(), opts.num_second_pass);
+        if (block.size() == kCandidateBlockSize) {
+            score_block();
+        }
+    }
+    score_block();
 
-    std::vector<ScoredDocument> top_results_ranked(num_to_rank);
-    for (size_t i = 0; i < num_to_rank; i++) {
-        top_results_ranked[i] = ranker.score(
-                context, results[i].doc_id, results[i].values);
+    for (size_t i = 1; i < collectors.size(); i++) {
+        collectors[0].merge(collectors[i]);
     }
+    std::vector<ScoredDocument> results = collectors[0].take_sorted();
+
+    // some iterators defer reading context until we know which documents
+    // survive the first pass.
+    std::vector<idx_t> result_ids;
+    result_ids.reserve(results.size());
+    for (const auto& result : results) {
+        result_ids.push_back(result.doc_id);
+    }
+    doc_it->prefetch_deferred_fields(result_ids);
+    for (auto& result : results) {
+        auto deferred = doc_it->deferred_fields(result.doc_id);
+        result.values.insert(
+                result.values.end(), deferred.begin(), deferred.end());
+    }
+
+    std::vector<ScoredDocument> top_results_ranked =
+            ranker.score_batch(context, results);
 
     std::sort(
             top_results_ranked.begin(),
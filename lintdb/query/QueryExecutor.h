@@ -11,6 +11,9 @@
 #include "lintdb/scoring/ScoredDocument.h"
 
 namespace lintdb {
+/// the number of candidates we buffer from the iterators before scoring them.
+static const size_t kCandidateBlockSize = 4096;
+
 /**
  * QueryExecutor helps manage the execution of queries.
  *
@@ -18,7 +21,8 @@ namespace lintdb {
  * 1. Optimize the query.
  * 2. Translate the query into a series of document iterators.
  * 3. Scan those iterators to retrieve the right documents.
- * 4. Score the documents.
+ * 4. Score the documents, keeping only the best num_second_pass candidates.
+ * 5. Rerank the remaining candidates.
  *
  */
 class QueryExecutor {
@@ -23,7 +23,11 @@ std::unique_ptr<DocIterator> TermQueryNode::process(
             this->value.value);
     std::unique_ptr<Iterator> it = context.getIndex()->get_iterator(prefix);
     return std::make_unique<TermIterator>(
-            std::move(it), this->value.data_type, score_method);
+            std::move(it),
+            this->value.data_type,
+            score_method,
+            false,
+            context.getDeletedDocs());
 }
 
 std::unique_ptr<DocIterator> VectorQueryNode::process(
@@ -34,17 +38,21 @@ std::unique_ptr<DocIterator> VectorQueryNode::process(
 
     std::shared_ptr<KnnNearestCentroids> nearest_centroids =
             context.getOrCreateNearestCentroids(this->value.name);
-    size_t num_centroids =
-            context.getCoarseQuantizer(this->value.name)->num_centroids();
+    auto coarse_quantizer = context.getCoarseQuantizer(this->value.name);
+    size_t num_centroids = coarse_quantizer->num_centroids();
     if (!nearest_centroids->is_valid()) {
-        Tensor query = std::get<Tensor>(this->value.value);
+        gsl::span<const float> tensor = this->value.tensor();
+        Tensor query(tensor.begin(), tensor.end());
 
         size_t num_tensors = this->value.num_tensors;
         nearest_centroids->calculate(
                 query,
                 num_tensors,
-                context.getCoarseQuantizer(this->value.name),
-                num_centroids);
+                coarse_quantizer,
+                centroids_to_calculate(
+                        opts,
+                        num_centroids,
+                        coarse_quantizer->default_search_k()));
     }
 
     size_t max_centroids = std::min(opts.k_top_centroids, num_centroids);
@@ -53,6 +61,7 @@ std::unique_ptr<DocIterator> VectorQueryNode::process(
             nearest_centroids->get_top_centroids(max_centroids, opts.n_probe);
 
     std::vector<std::unique_ptr<DocIterator>> iterators;
+    std::vector<std::pair<idx_t, std::unique_ptr<Iterator>>> posting_lists;
 
     std::vector<idx_t> invalid_centroids;
     std::vector<idx_t> valid_centroids;
@@ -69,10 +78,19 @@ std::unique_ptr<DocIterator> VectorQueryNode::process(
         }
         valid_centroids.push_back(centroid.second);
 
+        if (opts.accumulate_centroid_scores) {
+            posting_lists.emplace_back(centroid.second, std::move(it));
+            continue;
+        }
+
         auto field_types = context.getFieldMapper()->getFieldTypes(field_id);
 
         auto doc_it = std::make_unique<TermIterator>(
-                std::move(it), DataType::QUANTIZED_TENSOR, UnaryScoringMethod::ONE, true);
+                std::move(it),
+                DataType::QUANTIZED_TENSOR,
+                UnaryScoringMethod::ONE,
+                true,
+                context.getDeletedDocs());
         iterators.push_back(std::move(doc_it));
     }
     VLOG(5) << "Invalid centroids: " << invalid_centroids.size() << " out of "
@@ -97,6 +115,28 @@ std::unique_ptr<DocIterator> VectorQueryNode::process(
        context_collector.add_field(context, this->value.name);
     }
 
+    if (opts.accumulate_centroid_scores) {
+        return std::make_unique<PlaidAccumulatorIterator>(
+                std::move(posting_lists),
+                field_id,
+                std::move(context_collector),
+                std::move(nearest_centroids),
+                context.getDeletedDocs());
+    }
+
+    if (opts.prune_candidates) {
+        std::vector<float> upper_bounds;
+        float base_bound = nearest_centroids->get_score_bounds(
+                valid_centroids, upper_bounds);
+        return std::make_unique<WANDIterator>(
+                std::move(iterators),
+                std::move(upper_bounds),
+                base_bound,
+                std::move(context_collector),
+                std::move(nearest_centroids),
+                score_method);
+    }
+
     return std::make_unique<ANNIterator>(std::move(iterators), std::move(context_collector), std::move(nearest_centroids), score_method);
 }
 
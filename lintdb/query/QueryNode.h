@@ -36,6 +36,9 @@ class QueryNode {
             QueryContext& context,
             const SearchOptions& opts) = 0;
 
+    /// collects the values of every vector node in this subtree.
+    virtual void collect_vectors(std::vector<const FieldValue*>& values) const {}
+
     virtual ~QueryNode() = default;
 
    protected:
@@ -72,6 +75,10 @@ class VectorQueryNode : public QueryNode {
             QueryContext& context,
             const SearchOptions& opts) override;
 
+    void collect_vectors(std::vector<const FieldValue*>& values) const override {
+        values.push_back(&value);
+    }
+
    private:
     EmbeddingScoringMethod score_method = EmbeddingScoringMethod::PLAID;
 };
@@ -105,6 +112,12 @@ class AndQueryNode : public MultiQueryNode {
             QueryContext& context,
             const SearchOptions& opts) override;
 
+    void collect_vectors(std::vector<const FieldValue*>& values) const override {
+        for (const auto& child : children_) {
+            child->collect_vectors(values);
+        }
+    }
+
    protected:
     std::vector<std::unique_ptr<QueryNode>> children_ = {};
 };
@@ -123,6 +136,12 @@ class OrQueryNode : public MultiQueryNode {
             QueryContext& context,
             const SearchOptions& opts) override;
 
+    void collect_vectors(std::vector<const FieldValue*>& values) const override {
+        for (const auto& child : children_) {
+            child->collect_vectors(values);
+        }
+    }
+
    protected:
     std::vector<std::unique_ptr<QueryNode>> children_ = {};
 };
@@ -11,6 +11,7 @@
 #include <chrono>
 #include <gsl/span>
 #include <map>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <variant>
@@ -94,8 +95,30 @@ using QuantizedTensor = std::vector<uint8_t>;
 using Duration = std::chrono::duration<int64_t, std::milli>;
 using DateTime = std::chrono::time_point<std::chrono::system_clock, Duration>;
 
+/**
+ * TensorView borrows embeddings instead of copying them. owner, if set, keeps
+ * the memory alive. Otherwise the caller must keep it alive while the value
+ * is used.
+ *
+ * Views are only read while documents are added. Tensors are quantized before
+ * they're stored, so a view is never serialized.
+ *
+ * Views only hold float32 embeddings, the type quantizers encode. Other types
+ * must be converted to a Tensor first.
+ */
+struct TensorView {
+    gsl::span<const float> data;
+    std::shared_ptr<const void> owner;
+
+    TensorView() = default;
+    explicit TensorView(
+            gsl::span<const float> data,
+            std::shared_ptr<const void> owner = nullptr)
+            : data(data), owner(std::move(owner)) {}
+};
+
 struct ColBERTContextData {
-    std::vector<idx_t> doc_codes;
+    std::vector<colbert_code_t> doc_codes;
     std::vector<uint8_t> doc_residuals;
 };
 
@@ -114,7 +137,8 @@ using SupportedTypes = std::variant<
         ColBERTContextData, // colbert is our internal representation of colbert
                            // data. it includes the residual codes and indexes.
         float16,
-        lintdb::TensorFloat16
+        lintdb::TensorFloat16,
+        lintdb::TensorView
         >;
 
 inline Json::Value supportedTypeToJSON(const SupportedTypes& st) {
@@ -132,6 +156,12 @@ inline Json::Value supportedTypeToJSON(const SupportedTypes& st) {
             v.append(t);
         }
         return v;
+    } else if(const auto st_tensor_view = std::get_if<TensorView>(&st)) {
+        Json::Value v;
+        for (auto& t : st_tensor_view->data) {
+            v.append(t);
+        }
+        return v;
     } else if(const auto st_tensor_float16 = std::get_if<TensorFloat16>(&st)) {
         Json::Value v;
         for (auto& t : *st_tensor_float16) {
@@ -181,39 +211,57 @@ struct FieldValue {
     FieldValue() = default;
 
     FieldValue(std::string name, int v)
-            : name(name), data_type(DataType::INTEGER), value(v) {}
+            : name(std::move(name)), data_type(DataType::INTEGER), value(v) {}
     FieldValue(std::string name, float v)
-            : name(name), data_type(DataType::FLOAT), value(v) {}
-    FieldValue(std::string name, float16 v) : name(name), data_type(DataType::FLOAT16), value(v) {}
+            : name(std::move(name)), data_type(DataType::FLOAT), value(v) {}
+    FieldValue(std::string name, float16 v)
+            : name(std::move(name)), data_type(DataType::FLOAT16), value(v) {}
     FieldValue(std::string name, std::string v)
-            : name(name), data_type(DataType::TEXT), value(v) {}
+            : name(std::move(name)),
+              data_type(DataType::TEXT),
+              value(std::move(v)) {}
     FieldValue(std::string name, DateTime v)
-            : name(name), data_type(DataType::DATETIME), value(v) {}
+            : name(std::move(name)), data_type(DataType::DATETIME), value(v) {}
     FieldValue(std::string name, Tensor v)
-            : name(name),
+            : name(std::move(name)),
               data_type(DataType::TENSOR),
               num_tensors(1),
-              value(v) {}
+              value(std::move(v)) {}
     FieldValue(std::string name, Tensor v, size_t num_tensors)
-            : name(name),
+            : name(std::move(name)),
               data_type(DataType::TENSOR),
               num_tensors(num_tensors),
-              value(v) {}
+              value(std::move(v)) {}
+    /// a tensor that's borrowed instead of copied.
+    FieldValue(std::string name, TensorView v, size_t num_tensors)
+            : name(std::move(name)),
+              data_type(DataType::TENSOR),
+              num_tensors(num_tensors),
+              value(std::move(v)) {}
     FieldValue(std::string name, TensorFloat16 v)
-            : name(name),
+            : name(std::move(name)),
               data_type(DataType::TENSOR_FLOAT16),
               num_tensors(1),
-              value(v) {}
+              value(std::move(v)) {}
     FieldValue(std::string name, QuantizedTensor v, size_t num_tensors)
-            : name(name),
+            : name(std::move(name)),
               data_type(DataType::QUANTIZED_TENSOR),
               num_tensors(num_tensors),
-              value(v) {}
+              value(std::move(v)) {}
     FieldValue(std::string name, ColBERTContextData v, size_t num_tensors)
-            : name(name),
+            : name(std::move(name)),
               data_type(DataType::COLBERT),
               num_tensors(num_tensors),
-              value(v) {}
+              value(std::move(v)) {}
+
+    /// returns the floats of a TENSOR value, whether they're owned or
+    /// borrowed.
+    gsl::span<const float> tensor() const {
+        if (const auto view = std::get_if<TensorView>(&value)) {
+            return view->data;
+        }
+        return std::get<Tensor>(value);
+    }
 
     Json::Value toJson() const {
         Json::Value root;
@@ -244,8 +292,7 @@ struct FieldValue {
             }
             case DataType::TENSOR: {
                 Json::Value v;
-                auto tensor = std::get<Tensor>(value);
-                for( auto& t : tensor ) {
+                for( auto& t : tensor() ) {
                     v.append(t);
                 }
                 root["value"] = v;
@@ -341,6 +388,18 @@ struct FieldValue {
 } // namespace lintdb
 
 namespace bitsery {
+/// ColBERT codes are serialized as 8 byte values, which is how they were
+/// stored before they were narrowed in memory.
+template <typename S>
+void serialize_colbert_codes(S& s, std::vector<colbert_code_t>& codes) {
+    s.container(
+            codes, MAX_CENTROIDS_TO_STORE, [](S& p, colbert_code_t& code) {
+                idx_t stored = code;
+                p.value8b(stored);
+                code = colbert_code_t(stored);
+            });
+}
+
 template <typename S>
 void serialize(S& s, lintdb::SupportedTypes& fv) {
     s.ext(fv,
@@ -362,8 +421,11 @@ void serialize(S& s, lintdb::SupportedTypes& fv) {
                       p.ext8b(o, bitsery::ext::StdTimePoint{});
                   },
                   [](S& p, lintdb::ColBERTContextData& o) {
-                      p.container8b(o.doc_codes, MAX_CENTROIDS_TO_STORE);
+                      serialize_colbert_codes(p, o.doc_codes);
                       p.container1b(o.doc_residuals, MAX_CENTROIDS_TO_STORE);
+                  },
+                  [](S& p, lintdb::TensorView& o) {
+                      throw std::runtime_error("Tensor views can't be serialized");
                   }});
 }
 
@@ -392,11 +454,14 @@ void serialize(S& s, std::map<uint8_t, lintdb::SupportedTypes>& st) {
                                 p.ext8b(o, bitsery::ext::StdTimePoint{});
                             },
                             [](S& p, lintdb::ColBERTContextData& o) {
-                                p.container8b(
-                                        o.doc_codes, MAX_CENTROIDS_TO_STORE);
+                                serialize_colbert_codes(p, o.doc_codes);
                                 p.container1b(
                                         o.doc_residuals,
                                         MAX_CENTROIDS_TO_STORE);
+                            },
+                            [](S& p, lintdb::TensorView& o) {
+                                throw std::runtime_error(
+                                        "Tensor views can't be serialized");
                             }});
           });
 }
@@ -428,7 +493,7 @@ void serialize(S& s, lintdb::DateTime& dt) {
 
 template <typename S>
 void serialize(S& s, lintdb::ColBERTContextData data) {
-    s.container8b(data.doc_codes, MAX_CENTROIDS_TO_STORE);
+    serialize_colbert_codes(s, data.doc_codes);
     s.container1b(data.doc_residuals, MAX_CENTROIDS_TO_STORE);
 }
 } // namespace bitsery
@@ -2,14 +2,126 @@
 #include <bitsery/adapter/buffer.h>
 #include <bitsery/bitsery.h>
 #include <glog/logging.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
 #include <map>
+#include <set>
 #include <unordered_set>
 #include <variant>
 #include <vector>
+#include "lintdb/assert.h"
 #include "lintdb/invlists/KeyBuilder.h"
+#include "lintdb/invlists/PostingBlocks.h"
 #include "lintdb/schema/DataTypes.h"
 
 namespace lintdb {
+namespace {
+// values with a storage encoding start with kEncodedMarker. bitsery never
+// writes it as the first byte of a variant index or a container size, so
+// older values are still read with bitsery.
+const uint8_t kEncodedMarker = 0xFF;
+const uint8_t kEncodingVersion = 1;
+// marker, version, code width.
+const size_t kCodesHeaderSize = 3;
+// marker, version.
+const size_t kMappingHeaderSize = 2;
+
+bool has_encoding(std::string_view data) {
+    return data.size() >= 2 && uint8_t(data[0]) == kEncodedMarker;
+}
+
+void check_encoding(std::string_view data) {
+    LINTDB_THROW_IF_NOT_FMT(
+            uint8_t(data[1]) == kEncodingVersion,
+            "unknown storage encoding version: %d",
+            int(uint8_t(data[1])));
+}
+
+void write_varint(uint64_t value, std::string& out) {
+    while (value >= 0x80) {
+        out.push_back(char(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(char(value));
+}
+
+uint64_t read_varint(std::string_view data, size_t& pos) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        LINTDB_THROW_IF_NOT_MSG(pos < data.size(), "varint is truncated");
+        uint8_t byte = data[pos++];
+        value |= uint64_t(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    return value;
+}
+
+// codes are copied through T, so the format assumes a little endian host.
+template <typename T>
+void write_codes(const std::vector<colbert_code_t>& codes, std::string& out) {
+    size_t offset = out.size();
+    out.resize(offset + codes.size() * sizeof(T));
+    char* ptr = &out[offset];
+    for (size_t i = 0; i < codes.size(); i++) {
+        T code = T(codes[i]);
+        memcpy(ptr + i * sizeof(T), &code, sizeof(T));
+    }
+}
+
+template <typename T>
+void read_codes(const char* data, std::vector<colbert_code_t>& codes) {
+    for (size_t i = 0; i < codes.size(); i++) {
+        T code;
+        memcpy(&code, data + i * sizeof(T), sizeof(T));
+        codes[i] = code;
+    }
+}
+
+// a token payload holds the tokens of one document that were assigned to a
+// centroid: marker, version, data type, varint token count, varint deltas of
+// the token ids, then each token's values.
+template <typename T>
+std::string encode_token_payload(
+        DataType type,
+        const std::vector<idx_t>& token_ids,
+        const T* tensor,
+        size_t values_per_token) {
+    std::string payload;
+    payload.reserve(
+            8 + token_ids.size() * (2 + values_per_token * sizeof(T)));
+    payload.push_back(char(kEncodedMarker));
+    payload.push_back(char(kEncodingVersion));
+    payload.push_back(char(type));
+    write_varint(token_ids.size(), payload);
+    idx_t previous = 0;
+    for (const auto token_id : token_ids) {
+        write_varint(token_id - previous, payload);
+        previous = token_id;
+    }
+
+    const size_t row_size = values_per_token * sizeof(T);
+    for (const auto token_id : token_ids) {
+        payload.append(
+                reinterpret_cast<const char*>(
+                        tensor + token_id * values_per_token),
+                row_size);
+    }
+    return payload;
+}
+
+template <typename T>
+std::vector<T> read_token_values(const std::string& data, size_t pos) {
+    LINTDB_THROW_IF_NOT_MSG(
+            (data.size() - pos) % sizeof(T) == 0, "token payload is truncated");
+    std::vector<T> values((data.size() - pos) / sizeof(T));
+    memcpy(values.data(), data.data() + pos, values.size() * sizeof(T));
+    return values;
+}
+} // namespace
+
 std::vector<PostingData> DocEncoder::encode_inverted_data(
         const ProcessedData& data,
         size_t code_size) {
@@ -34,7 +146,12 @@ std::vector<PostingData> DocEncoder::encode_inverted_data(
                 centroid_to_tokens[data.centroid_ids[i]].push_back(i);
             }
 
-            Tensor tensor_arr = std::get<Tensor>(data.value.value);
+            gsl::span<const float> tensor_arr = data.value.tensor();
+            // raw tensors hold floats, not codes, so a token spans the
+            // tensor's dimensions.
+            const size_t dimensions = data.value.num_tensors == 0
+                    ? 0
+                    : tensor_arr.size() / data.value.num_tensors;
 
             for (const auto& [centroid_id, token_ids] : centroid_to_tokens) {
                 std::string key = create_index_id(
@@ -45,22 +162,12 @@ std::vector<PostingData> DocEncoder::encode_inverted_data(
                         data.doc_id);
 
                 keys.push_back(key);
-
-                Tensor centroid_data;
-                for (size_t i = 0; i < token_ids.size(); i++) {
-                    idx_t token_id = token_ids[i];
-
-                    centroid_data.insert(
-                            centroid_data.end(),
-                            tensor_arr.data() + token_id * code_size,
-                            tensor_arr.data() + (token_id + 1) * code_size);
-                }
-                Buffer buf;
-                SupportedTypes tt = tensor_arr;
-                auto written =
-                        bitsery::quickSerialization(OutputAdapter{buf}, tt);
-                auto st = std::string(buf.begin(), buf.begin() + written);
-                values.push_back(st);
+                // only the tokens assigned to this centroid are stored.
+                values.push_back(encode_token_payload(
+                        DataType::TENSOR,
+                        token_ids,
+                        tensor_arr.data(),
+                        dimensions));
             }
             break;
         }
@@ -73,7 +180,7 @@ std::vector<PostingData> DocEncoder::encode_inverted_data(
                 centroid_to_tokens[data.centroid_ids[i]].push_back(i);
             }
 
-            QuantizedTensor tensor_arr =
+            const QuantizedTensor& tensor_arr =
                     std::get<QuantizedTensor>(data.value.value);
 
             for (const auto& [centroid_id, token_ids] : centroid_to_tokens) {
@@ -85,22 +192,12 @@ std::vector<PostingData> DocEncoder::encode_inverted_data(
                         data.doc_id);
 
                 keys.push_back(key);
-
-                QuantizedTensor centroid_data;
-                for (size_t i = 0; i < token_ids.size(); i++) {
-                    idx_t token_id = token_ids[i];
-
-                    centroid_data.insert(
-                            centroid_data.end(),
-                            tensor_arr.data() + token_id * code_size,
-                            tensor_arr.data() + (token_id + 1) * code_size);
-                }
-                Buffer buf;
-                SupportedTypes tt = tensor_arr;
-                auto written =
-                        bitsery::quickSerialization(OutputAdapter{buf}, tt);
-                auto st = std::string(buf.begin(), buf.begin() + written);
-                values.push_back(st);
+                // only the tokens assigned to this centroid are stored.
+                values.push_back(encode_token_payload(
+                        DataType::QUANTIZED_TENSOR,
+                        token_ids,
+                        tensor_arr.data(),
+                        code_size));
             }
             break;
         }
@@ -235,28 +332,47 @@ std::vector<PostingData> DocEncoder::encode_inverted_data(
     return results;
 }
 
+std::vector<PostingData> DocEncoder::encode_posting_block_data(
+        const ProcessedData& data) {
+    // a document is added to each centroid's block list once, no matter how
+    // many of its tokens were assigned to the centroid.
+    std::set<idx_t> centroid_ids(
+            data.centroid_ids.begin(), data.centroid_ids.end());
+    std::string operand = encode_posting_operand({data.doc_id}, {});
+
+    std::vector<PostingData> results;
+    results.reserve(centroid_ids.size());
+    for (const auto centroid_id : centroid_ids) {
+        results.push_back(
+                {create_posting_block_key(
+                         data.tenant, data.field, centroid_id, data.doc_id),
+                 operand});
+    }
+    return results;
+}
+
 std::vector<PostingData> DocEncoder::encode_inverted_mapping_data(
         const ProcessedData& data) {
     std::vector<PostingData> results;
 
     std::string key = create_forward_index_id(data.tenant, data.doc_id);
 
-    using Buffer = std::vector<uint8_t>;
-    using OutputAdapter = bitsery::OutputBufferAdapter<Buffer>;
-
-    // create unique list of inverted index ids.
-    std::unordered_set<idx_t> inverted_mapping_ids;
-    for (const auto& id : data.centroid_ids) {
-        inverted_mapping_ids.insert(id);
+    // create a sorted, unique list of inverted index ids.
+    std::vector<idx_t> ids(data.centroid_ids);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::string st;
+    st.push_back(char(kEncodedMarker));
+    st.push_back(char(kEncodingVersion));
+    write_varint(ids.size(), st);
+    // deltas are taken as unsigned values, so negative ids still round trip.
+    uint64_t previous = 0;
+    for (const auto id : ids) {
+        write_varint(uint64_t(id) - previous, st);
+        previous = uint64_t(id);
     }
 
-    Buffer buf;
-    auto written = bitsery::quickSerialization(
-            OutputAdapter{buf},
-            std::vector<idx_t>(
-                    inverted_mapping_ids.begin(), inverted_mapping_ids.end()));
-    auto st = std::string(buf.begin(), buf.begin() + written);
-
     results.push_back({key, st});
 
     return results;
@@ -303,6 +419,106 @@ PostingData DocEncoder::encode_context_data(const ProcessedData& data) {
     return PostingData{key, st};
 }
 
+PostingData DocEncoder::encode_colbert_codes_data(
+        const ProcessedData& data,
+        size_t num_centroids) {
+    std::string key = create_context_id(data.tenant, data.field, data.doc_id);
+    const auto& codes = std::get<ColBERTContextData>(data.value.value).doc_codes;
+
+    colbert_code_t max_code = 0;
+    for (const auto code : codes) {
+        max_code = std::max(max_code, code);
+    }
+    const bool is_narrow = num_centroids <= (size_t(1) << 16) &&
+            max_code <= std::numeric_limits<uint16_t>::max();
+    const uint8_t width = is_narrow ? sizeof(uint16_t) : sizeof(uint32_t);
+
+    std::string value;
+    value.reserve(kCodesHeaderSize + 5 + codes.size() * width);
+    value.push_back(char(kEncodedMarker));
+    value.push_back(char(kEncodingVersion));
+    value.push_back(char(width));
+    write_varint(codes.size(), value);
+    if (is_narrow) {
+        write_codes<uint16_t>(codes, value);
+    } else {
+        write_codes<uint32_t>(codes, value);
+    }
+
+    return PostingData{key, value};
+}
+
+SupportedTypes DocEncoder::decode_colbert_codes_data(std::string_view data) {
+    if (!has_encoding(data)) {
+        // legacy contexts are bitsery serialized, which needs a string.
+        std::string legacy(data);
+        return decode_supported_types(legacy);
+    }
+    check_encoding(data);
+    LINTDB_THROW_IF_NOT_MSG(
+            data.size() >= kCodesHeaderSize, "colbert codes are truncated");
+
+    const uint8_t width = data[2];
+    LINTDB_THROW_IF_NOT_FMT(
+            width == sizeof(uint16_t) || width == sizeof(uint32_t),
+            "unknown colbert code width: %d",
+            int(width));
+    size_t pos = kCodesHeaderSize;
+    const size_t num_codes = read_varint(data, pos);
+    LINTDB_THROW_IF_NOT_MSG(
+            data.size() - pos >= num_codes * width,
+            "colbert codes are truncated");
+
+    ColBERTContextData colbert;
+    colbert.doc_codes.resize(num_codes);
+    if (width == sizeof(uint16_t)) {
+        read_codes<uint16_t>(data.data() + pos, colbert.doc_codes);
+    } else {
+        read_codes<uint32_t>(data.data() + pos, colbert.doc_codes);
+    }
+    return colbert;
+}
+
+PostingData DocEncoder::encode_residual_data(const ProcessedData& data) {
+    std::string key = create_context_id(data.tenant, data.field, data.doc_id);
+
+    // residuals are read back as raw bytes, so they aren't serialized.
+    const auto& residuals =
+            std::get<ColBERTContextData>(data.value.value).doc_residuals;
+    return PostingData{key, std::string(residuals.begin(), residuals.end())};
+}
+
+SupportedTypes DocEncoder::decode_inverted_data(
+        std::string& data,
+        std::vector<idx_t>* token_ids) {
+    if (!has_encoding(data)) {
+        return decode_supported_types(data);
+    }
+    check_encoding(data);
+    LINTDB_THROW_IF_NOT_MSG(data.size() >= 3, "token payload is truncated");
+
+    const DataType type = DataType(uint8_t(data[2]));
+    size_t pos = 3;
+    const size_t num_tokens = read_varint(data, pos);
+    idx_t token_id = 0;
+    for (size_t i = 0; i < num_tokens; i++) {
+        token_id += idx_t(read_varint(data, pos));
+        if (token_ids != nullptr) {
+            token_ids->push_back(token_id);
+        }
+    }
+
+    switch (type) {
+        case DataType::TENSOR:
+            return read_token_values<float>(data, pos);
+        case DataType::QUANTIZED_TENSOR:
+            return read_token_values<uint8_t>(data, pos);
+        default:
+            LINTDB_THROW_FMT(
+                    "token payloads don't support data type %d", int(type));
+    }
+}
+
 SupportedTypes DocEncoder::decode_supported_types(std::string& data) {
     using Buffer = std::string;
     using InputAdapter = bitsery::InputBufferAdapter<Buffer>;
@@ -329,6 +545,23 @@ std::map<uint8_t, SupportedTypes> DocEncoder::decode_forward_data(
 }
 
 std::vector<idx_t> DocEncoder::decode_inverted_mapping_data(std::string& data) {
+    if (has_encoding(data)) {
+        check_encoding(data);
+        size_t pos = kMappingHeaderSize;
+        const size_t num_ids = read_varint(data, pos);
+        // every id takes at least one byte.
+        LINTDB_THROW_IF_NOT_MSG(
+                data.size() - pos >= num_ids, "mapping is truncated");
+
+        std::vector<idx_t> res(num_ids);
+        uint64_t previous = 0;
+        for (size_t i = 0; i < num_ids; i++) {
+            previous += read_varint(data, pos);
+            res[i] = idx_t(previous);
+        }
+        return res;
+    }
+
     using Buffer = std::string;
     using InputAdapter = bitsery::InputBufferAdapter<Buffer>;
 
@@ -2,6 +2,7 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "lintdb/invlists/PostingData.h"
 #include "lintdb/schema/DataTypes.h"
@@ -16,16 +17,53 @@ class DocEncoder {
             const ProcessedData& data,
             size_t code_size);
 
+    /// encode_posting_block_data creates merge operands that add a ColBERT
+    /// document to the block lists of its centroids.
+    static std::vector<PostingData> encode_posting_block_data(
+            const ProcessedData& data);
+
     static PostingData encode_forward_data(
             const std::vector<ProcessedData>& data);
 
     static PostingData encode_context_data(const ProcessedData& data);
 
+    /**
+     * encode_colbert_codes_data encodes a ColBERT field's context without
+     * its residuals. PLAID scoring only needs the codes.
+     *
+     * Codes are stored as 16 or 32 bit integers, whichever fits num_centroids.
+     */
+    static PostingData encode_colbert_codes_data(
+            const ProcessedData& data,
+            size_t num_centroids);
+
+    /// decode_colbert_codes_data reads a ColBERT context written by either
+    /// encode_colbert_codes_data or encode_context_data. The view is only read
+    /// during the call.
+    static SupportedTypes decode_colbert_codes_data(std::string_view data);
+
+    /// encode_residual_data stores a ColBERT field's packed residuals under
+    /// the same key as its codes.
+    static PostingData encode_residual_data(const ProcessedData& data);
+
+    /// mappings are stored as varint deltas between the sorted centroid ids.
     static std::vector<PostingData> encode_inverted_mapping_data(
             const ProcessedData& data);
 
     static SupportedTypes decode_supported_types(std::string& data);
 
+    /**
+     * decode_inverted_data reads an inverted index value.
+     *
+     * Tensor postings hold the codes of the tokens assigned to the posting's
+     * centroid, and their token ids are appended to token_ids. Postings
+     * written before token payloads hold the whole document and have no
+     * token ids.
+     */
+    static SupportedTypes decode_inverted_data(
+            std::string& data,
+            std::vector<idx_t>* token_ids = nullptr);
+
     static std::map<uint8_t, SupportedTypes> decode_forward_data(
             std::string& data);
 
@@ -1,9 +1,11 @@
 #include "DocProcessor.h"
 #include <bitsery/adapter/buffer.h>
 #include <glog/logging.h>
+#include <algorithm>
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 #include "lintdb/invlists/PostingData.h"
 #include "lintdb/quantizers/CoarseQuantizer.h"
@@ -22,47 +24,208 @@ DocumentProcessor::DocumentProcessor(
                 std::string,
                 std::shared_ptr<ICoarseQuantizer>>& coarse_quantizer_map,
         const std::shared_ptr<FieldMapper> field_mapper,
-        std::unique_ptr<IIndexWriter> index_writer)
+        std::unique_ptr<IIndexWriter> index_writer,
+        PostingFormat posting_format)
         : schema(schema),
           field_mapper(field_mapper),
           quantizer_map(quantizer_map),
           coarse_quantizer_map(coarse_quantizer_map),
-          index_writer(std::move(index_writer)) {
+          index_writer(std::move(index_writer)),
+          posting_format(posting_format) {
     for (const auto& field : schema.fields) {
         field_map[field.name] = field;
     }
 }
 
+namespace {
+// quantizers encode tensor fields into codes.
+bool is_quantized(const DataType data_type) {
+    return data_type == DataType::TENSOR ||
+            data_type == DataType::QUANTIZED_TENSOR ||
+            data_type == DataType::TENSOR_FLOAT16;
+}
+
+/// the number of tokens in part i of a batch.
+size_t part_tokens(const TensorBatch& batch, size_t i) {
+    const size_t end = i + 1 < batch.offsets.size() ? batch.offsets[i + 1]
+                                                    : batch.num_tokens;
+    return end - batch.offsets[i];
+}
+
+/// the most floats a run of parts is copied into at once.
+const size_t kScratchFloats = size_t(1) << 22;
+
+/**
+ * for_each_run calls run(n, x, first_token) on runs of contiguous parts, so
+ * the quantizers get many documents per call.
+ *
+ * A run of more than one part is copied into a thread local scratch buffer
+ * that's reused across batches. The buffer holds at most kScratchFloats, and
+ * a part that's larger than that is read in place. A lone part is never
+ * copied.
+ */
+template <typename Run>
+void for_each_run(const TensorBatch& batch, Run run) {
+    if (batch.num_tokens == 0) {
+        return;
+    }
+    size_t num_floats = 0;
+    for (const auto& part : batch.parts) {
+        num_floats += part.size();
+    }
+    const size_t dim = num_floats / batch.num_tokens;
+
+    static thread_local std::vector<float> scratch;
+    size_t begin = 0;
+    while (begin < batch.parts.size()) {
+        size_t end = begin + 1;
+        size_t run_tokens = part_tokens(batch, begin);
+        while (end < batch.parts.size() &&
+               (run_tokens + part_tokens(batch, end)) * dim <= kScratchFloats) {
+            run_tokens += part_tokens(batch, end);
+            end++;
+        }
+
+        if (end == begin + 1) {
+            run(run_tokens, batch.parts[begin].data(), batch.offsets[begin]);
+        } else {
+            // resizing keeps the capacity, so later batches don't allocate.
+            scratch.resize(run_tokens * dim);
+            float* out = scratch.data();
+            for (size_t i = begin; i < end; i++) {
+                const auto& part = batch.parts[i];
+                out = std::copy(part.begin(), part.end(), out);
+            }
+            run(run_tokens, scratch.data(), batch.offsets[begin]);
+        }
+        begin = end;
+    }
+}
+
+bool needs_ivf(const Field& field) {
+    static std::vector<FieldType> ivf_field_types = {
+            FieldType::Colbert, FieldType::Indexed};
+    return std::find_first_of(
+                   field.field_types.begin(),
+                   field.field_types.end(),
+                   ivf_field_types.begin(),
+                   ivf_field_types.end()) != field.field_types.end();
+}
+} // namespace
+
 void DocumentProcessor::processDocument(
         const uint64_t tenant,
         const Document& document) {
+    processDocuments(tenant, gsl::span<const Document>(&document, 1));
+}
+
+void DocumentProcessor::processDocuments(
+        const uint64_t tenant,
+        gsl::span<const Document> documents) {
+    EncodingBatch batch = stackDocuments(tenant, documents);
+    assignCentroids(batch);
+    quantize(batch);
+    write(encode(batch));
+}
+
+EncodingBatch DocumentProcessor::stackDocuments(
+        const uint64_t tenant,
+        gsl::span<const Document> documents) const {
+    EncodingBatch batch;
+    batch.tenant = tenant;
+    batch.documents = documents;
+    batch.offsets.resize(documents.size());
+    for (size_t i = 0; i < documents.size(); i++) {
+        for (const auto& fv : documents[i].fields) {
+            auto field = field_map.find(fv.name);
+            if (field == field_map.end()) {
+                throw std::invalid_argument(
+                        "Field " + fv.name + " not defined in schema.");
+            }
+            validateField(field->second, fv);
+
+            if (!is_quantized(field->second.data_type)) {
+                batch.offsets[i].push_back(0);
+                continue;
+            }
+            TensorBatch& tensors = batch.tensors[fv.name];
+            batch.offsets[i].push_back(tensors.num_tokens);
+            tensors.parts.push_back(fv.tensor());
+            tensors.offsets.push_back(tensors.num_tokens);
+            tensors.num_tokens += fv.num_tensors;
+        }
+    }
+    return batch;
+}
+
+void DocumentProcessor::assignCentroids(EncodingBatch& batch) {
+    for (auto& [name, tensors] : batch.tensors) {
+        const Field& field = field_map.at(name);
+        if (needs_ivf(field)) {
+            assignIVFCentroids(field, tensors);
+        }
+    }
+}
+
+void DocumentProcessor::quantize(EncodingBatch& batch) {
+    for (auto& [name, tensors] : batch.tensors) {
+        quantizeField(field_map.at(name), tensors);
+    }
+}
+
+BatchPostingData DocumentProcessor::encode(const EncodingBatch& batch) {
+    BatchPostingData posting_data;
+    for (size_t i = 0; i < batch.documents.size(); i++) {
+        encodeDocument(
+                batch.tenant,
+                batch.documents[i],
+                batch.offsets[i],
+                batch.tensors,
+                posting_data);
+    }
+    return posting_data;
+}
+
+void DocumentProcessor::write(const BatchPostingData& posting_data) {
+    index_writer->write(posting_data);
+}
+
+void DocumentProcessor::encodeDocument(
+        const uint64_t tenant,
+        const Document& document,
+        const std::vector<size_t>& offsets,
+        const std::unordered_map<std::string, TensorBatch>& batches,
+        BatchPostingData& posting_data) {
     std::vector<ProcessedData> inverted_data;
     std::vector<ProcessedData> context_data;
     std::vector<ProcessedData> stored_data;
     std::vector<ProcessedData> colbert_data;
 
-    for (const auto& fv : document.fields) {
+    for (size_t j = 0; j < document.fields.size(); j++) {
+        const FieldValue& fv = document.fields[j];
         std::string name = fv.name;
-
-        if (field_map.find(name) == field_map.end()) {
-            throw std::invalid_argument(
-                    "Field " + name + " not defined in schema.");
-        }
-        const Field& field = field_map[name];
-        validateField(field, fv);
+        const Field& field = field_map.at(name);
 
         ProcessedData processed_data;
-        static std::vector<FieldType> ivf_field_types = {FieldType::Colbert, FieldType::Indexed};
-
-        auto needs_ivf = std::find_first_of(field.field_types.begin(), field.field_types.end(), ivf_field_types.begin(), ivf_field_types.end());
-
-        if(needs_ivf != field.field_types.end()) {
-            processed_data.centroid_ids = assignIVFCentroids(field, fv);
+        if (is_quantized(field.data_type)) {
+            const TensorBatch& batch = batches.at(name);
+            const size_t offset = offsets[j];
+            if (!batch.centroids.empty()) {
+                processed_data.centroid_ids.assign(
+                        batch.centroids.begin() + offset,
+                        batch.centroids.begin() + offset + fv.num_tensors);
+            }
+            const size_t code_size = quantizer_map.at(name)->code_size();
+            processed_data.value = FieldValue(
+                    name,
+                    QuantizedTensor(
+                            batch.codes.begin() + offset * code_size,
+                            batch.codes.begin() +
+                                    (offset + fv.num_tensors) * code_size),
+                    fv.num_tensors);
+        } else {
+            processed_data.value = fv;
         }
-
-        FieldValue quantizedValue = quantizeField(field, fv);
-
-        processed_data.value = quantizedValue;
         processed_data.doc_id = document.id;
         processed_data.tenant = tenant;
 
@@ -77,7 +240,9 @@ void DocumentProcessor::processDocument(
                     // residuals. the FieldValue we store changes from a
                     // quantized tensor to a ColBERTContextData.
                     ColBERTContextData cd;
-                    cd.doc_codes = processed_data.centroid_ids;
+                    cd.doc_codes.assign(
+                            processed_data.centroid_ids.begin(),
+                            processed_data.centroid_ids.end());
 
                     QuantizedTensor residuals = std::get<QuantizedTensor>(
                             processed_data.value.value);
@@ -101,32 +266,49 @@ void DocumentProcessor::processDocument(
         }
     }
 
-    BatchPostingData posting_data;
     // process colbert data.
     for (ProcessedData& data : colbert_data) {
-        // store all of the token codes in the context index.
+        // store all of the token codes in the context index. Residuals are
+        // only read to rerank, so they're stored separately.
         assert(data.value.data_type == DataType::COLBERT);
 
-        auto cd = DocEncoder::encode_context_data(data);
-        posting_data.context.push_back(cd);
-
-        // quantizers must exist for colbert data. either an identity quantizer
-        // or otherwise.
-        size_t code_size =
-                quantizer_map.at(field_mapper->getFieldName(data.field))
-                        ->code_size();
-
-        // for colbert fields, don't store data into the inverted index itself.
-        // we'll strip that out.
-        std::vector<PostingData> encoded_data =
-                DocEncoder::encode_inverted_data(data, code_size);
+        size_t num_centroids =
+                coarse_quantizer_map
+                        .at(field_mapper->getFieldName(data.field))
+                        ->num_centroids();
+        posting_data.context.push_back(
+                DocEncoder::encode_colbert_codes_data(data, num_centroids));
+        posting_data.residuals.push_back(
+                DocEncoder::encode_residual_data(data));
+
+        if (posting_format == PostingFormat::BLOCKS) {
+            // colbert postings don't carry a value, so they're written as
+            // merge operands on the centroid's block lists.
+            std::vector<PostingData> block_data =
+                    DocEncoder::encode_posting_block_data(data);
+            posting_data.posting_blocks.insert(
+                    posting_data.posting_blocks.end(),
+                    block_data.begin(),
+                    block_data.end());
+        } else {
+            // quantizers must exist for colbert data. either an identity
+            // quantizer or otherwise.
+            size_t code_size =
+                    quantizer_map.at(field_mapper->getFieldName(data.field))
+                            ->code_size();
 
-        posting_data.inverted.reserve(
-                posting_data.inverted.size() + encoded_data.size());
-        posting_data.inverted.insert(
-                posting_data.inverted.end(),
-                encoded_data.begin(),
-                encoded_data.end());
+            // for colbert fields, don't store data into the inverted index
+            // itself. we'll strip that out.
+            std::vector<PostingData> encoded_data =
+                    DocEncoder::encode_inverted_data(data, code_size);
+
+            posting_data.inverted.reserve(
+                    posting_data.inverted.size() + encoded_data.size());
+            posting_data.inverted.insert(
+                    posting_data.inverted.end(),
+                    encoded_data.begin(),
+                    encoded_data.end());
+        }
 
         std::vector<PostingData> mapping_data =
                 DocEncoder::encode_inverted_mapping_data(data);
@@ -174,27 +356,24 @@ void DocumentProcessor::processDocument(
         posting_data.context.push_back(cd);
     }
 
-    PostingData forward_data = DocEncoder::encode_forward_data(stored_data);
-    posting_data.forward = forward_data;
-
-    index_writer->write(posting_data);
+    posting_data.forward.push_back(
+            DocEncoder::encode_forward_data(stored_data));
 }
 
-std::vector<idx_t> DocumentProcessor::assignIVFCentroids(
+void DocumentProcessor::assignIVFCentroids(
         const Field& field,
-        const FieldValue& value) {
-    if (field.data_type == DataType::TENSOR || field.data_type == DataType::TENSOR_FLOAT16) {
+        TensorBatch& batch) {
+    if (field.data_type == DataType::TENSOR ||
+        field.data_type == DataType::TENSOR_FLOAT16) {
         std::shared_ptr<ICoarseQuantizer> encoder =
                 coarse_quantizer_map.at(field.name);
         assert(encoder->is_trained());
 
-        Tensor tensor = std::get<Tensor>(value.value);
-        std::vector<idx_t> centroids(value.num_tensors);
-        encoder->assign(value.num_tensors, tensor.data(), centroids.data());
-
-        return centroids;
+        batch.centroids.resize(batch.num_tokens);
+        for_each_run(batch, [&](size_t n, const float* x, size_t offset) {
+            encoder->assign(n, x, batch.centroids.data() + offset);
+        });
     }
-    return {};
 }
 
 void DocumentProcessor::validateField(
@@ -206,26 +385,18 @@ void DocumentProcessor::validateField(
     // Add further validation based on FieldParameters if necessary
 }
 
-FieldValue DocumentProcessor::quantizeField(
+void DocumentProcessor::quantizeField(
         const Field& field,
-        const FieldValue& value) {
-    if ((field.data_type == DataType::TENSOR ||
-        field.data_type == DataType::QUANTIZED_TENSOR ||
-         field.data_type == DataType::TENSOR_FLOAT16)) {
-        // Check if quantizer exists for the field
-        LINTDB_THROW_IF_NOT(quantizer_map.count(field.name) > 0);
-
-        std::shared_ptr<Quantizer> quantizer = quantizer_map.at(field.name);
-
-        Tensor tensor = std::get<Tensor>(value.value);
-        std::vector<residual_t> codes(
-                value.num_tensors * quantizer->code_size());
-        quantizer->sa_encode(value.num_tensors, tensor.data(), codes.data());
-
-        return {value.name, codes, value.num_tensors};
-    } else {
-        return value; // No quantization needed for other data types
-    }
+        TensorBatch& batch) {
+    // Check if quantizer exists for the field
+    LINTDB_THROW_IF_NOT(quantizer_map.count(field.name) > 0);
+
+    std::shared_ptr<Quantizer> quantizer = quantizer_map.at(field.name);
+    const size_t code_size = quantizer->code_size();
+    batch.codes.resize(batch.num_tokens * code_size);
+    for_each_run(batch, [&](size_t n, const float* x, size_t offset) {
+        quantizer->sa_encode(n, x, batch.codes.data() + offset * code_size);
+    });
 }
 
 } // namespace lintdb
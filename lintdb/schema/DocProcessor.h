@@ -1,9 +1,12 @@
 #pragma once
 
+#include <gsl/span>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include "lintdb/invlists/IndexWriter.h"
+#include "lintdb/invlists/PostingBlocks.h"
 #include "lintdb/quantizers/CoarseQuantizer.h"
 #include "lintdb/quantizers/Quantizer.h"
 #include "lintdb/schema/DataTypes.h"
@@ -13,6 +16,40 @@
 #include "lintdb/schema/Schema.h"
 
 namespace lintdb {
+/// documents are added in batches of this size. A tensor field is assigned
+/// and encoded with one call per batch, up to the scratch buffer's size, so
+/// larger batches give the quantizers more tokens per call. Smaller ones
+/// spread better over threads.
+static const size_t kDocumentBatchSize = 64;
+
+/**
+ * TensorBatch holds the tokens of one tensor field across a batch.
+ *
+ * parts borrow each document's tensor. The centroids and codes of every
+ * part are written back to back, so part i's start at token offsets[i].
+ * Assigning and encoding copy runs of parts into a reused scratch buffer,
+ * so the quantizers see the whole batch in one call.
+ */
+struct TensorBatch {
+    std::vector<gsl::span<const float>> parts;
+    std::vector<size_t> offsets;
+    size_t num_tokens = 0;
+    std::vector<idx_t> centroids;
+    std::vector<residual_t> codes;
+};
+
+/**
+ * EncodingBatch carries a batch of documents through the encoding stages.
+ * The documents aren't owned, and must outlive the batch.
+ */
+struct EncodingBatch {
+    uint64_t tenant = 0;
+    gsl::span<const Document> documents;
+    std::unordered_map<std::string, TensorBatch> tensors;
+    /// where each document's tensors start in their field's batch, in the
+    /// order of the document's fields.
+    std::vector<std::vector<size_t>> offsets;
+};
 
 class DocumentProcessor {
    public:
@@ -24,15 +61,48 @@ class DocumentProcessor {
                     std::string,
                     std::shared_ptr<ICoarseQuantizer>>& coarse_quantizer_map,
             const std::shared_ptr<FieldMapper> field_mapper,
-            std::unique_ptr<IIndexWriter> index_writer);
+            std::unique_ptr<IIndexWriter> index_writer,
+            PostingFormat posting_format = PostingFormat::KEYS);
     void processDocument(const uint64_t tenant, const Document& document);
 
+    /**
+     * processDocuments encodes a batch of documents and writes them together.
+     *
+     * The tokens of each tensor field are gathered across the batch without
+     * copying them. Each field's tokens are assigned and encoded with one
+     * call per batch, straight into the batch's centroids and codes.
+     *
+     * This runs the stages below in order. Stages are thread safe, so
+     * different batches can be in different stages at once.
+     */
+    void processDocuments(
+            const uint64_t tenant,
+            gsl::span<const Document> documents);
+
+    /// validates the documents and gathers their tensors.
+    EncodingBatch stackDocuments(
+            const uint64_t tenant,
+            gsl::span<const Document> documents) const;
+    /// assigns the centroids of fields that are indexed.
+    void assignCentroids(EncodingBatch& batch);
+    /// computes the codes of tensor fields.
+    void quantize(EncodingBatch& batch);
+    /// encodes the postings and stored fields of the documents.
+    BatchPostingData encode(const EncodingBatch& batch);
+    void write(const BatchPostingData& posting_data);
+
    private:
     static void validateField(const Field& field, const FieldValue& value);
-    FieldValue quantizeField(const Field& field, const FieldValue& value);
-    std::vector<idx_t> assignIVFCentroids(
-            const Field& field,
-            const FieldValue& value);
+    void quantizeField(const Field& field, TensorBatch& batch);
+    void assignIVFCentroids(const Field& field, TensorBatch& batch);
+    /// adds a document's data to posting_data. offsets are the positions of
+    /// its tensors in their batches.
+    void encodeDocument(
+            const uint64_t tenant,
+            const Document& document,
+            const std::vector<size_t>& offsets,
+            const std::unordered_map<std::string, TensorBatch>& batches,
+            BatchPostingData& posting_data);
 
     Schema schema;
     std::unordered_map<std::string, Field> field_map;
@@ -44,6 +114,8 @@ class DocumentProcessor {
             coarse_quantizer_map;
 
     std::unique_ptr<IIndexWriter> index_writer;
+    /// how ColBERT posting lists are written.
+    PostingFormat posting_format;
 };
 
 } // namespace lintdb
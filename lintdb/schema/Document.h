@@ -13,8 +13,8 @@ struct Document {
     std::vector<FieldValue> fields;
     idx_t id; /// the unique id of the document
 
-    Document(idx_t id, const std::vector<FieldValue>& fields)
-            : fields(fields), id(id) {}
+    Document(idx_t id, std::vector<FieldValue> fields)
+            : fields(std::move(fields)), id(id) {}
 
     Json::Value toJson() const {
         Json::Value root;
@@ -38,7 +38,7 @@ struct Document {
             fields.push_back(FieldValue::fromJson(fieldJson));
         }
 
-        return Document(id, fields);
+        return Document(id, std::move(fields));
     }
 };
 
@@ -0,0 +1,223 @@
+#include "lintdb/schema/IngestionPipeline.h"
+#include <glog/logging.h>
+#include <algorithm>
+#include <iterator>
+#include "lintdb/assert.h"
+
+namespace lintdb {
+namespace {
+void append(std::vector<PostingData>& to, std::vector<PostingData>& from) {
+    if (to.empty()) {
+        to.swap(from);
+        return;
+    }
+    to.insert(
+            to.end(),
+            std::make_move_iterator(from.begin()),
+            std::make_move_iterator(from.end()));
+}
+
+void append(BatchPostingData& to, BatchPostingData& from) {
+    append(to.inverted, from.inverted);
+    append(to.forward, from.forward);
+    append(to.context, from.context);
+    append(to.residuals, from.residuals);
+    append(to.inverted_mapping, from.inverted_mapping);
+    append(to.posting_blocks, from.posting_blocks);
+}
+} // namespace
+
+IngestionPipeline::IngestionPipeline(
+        DocumentProcessor& processor,
+        const IngestionOptions& options)
+        : processor(processor),
+          options(options),
+          stack_queue(options.queue_size),
+          assign_queue(options.queue_size),
+          encode_queue(options.queue_size),
+          write_queue(options.queue_size) {
+    LINTDB_THROW_IF_NOT(options.batch_size > 0);
+    LINTDB_THROW_IF_NOT(options.queue_size > 0);
+    LINTDB_THROW_IF_NOT(options.max_group_documents > 0);
+    LINTDB_THROW_IF_NOT(
+            options.stack_threads > 0 && options.assign_threads > 0 &&
+            options.encode_threads > 0);
+
+    for (size_t i = 0; i < options.stack_threads; i++) {
+        stack_threads.emplace_back([this] {
+            run_stage(stack_queue, &IngestionPipeline::stack);
+        });
+    }
+    for (size_t i = 0; i < options.assign_threads; i++) {
+        assign_threads.emplace_back([this] {
+            run_stage(assign_queue, &IngestionPipeline::assign);
+        });
+    }
+    for (size_t i = 0; i < options.encode_threads; i++) {
+        encode_threads.emplace_back([this] {
+            run_stage(encode_queue, &IngestionPipeline::encode);
+        });
+    }
+    writer = std::thread([this] { run_writer(); });
+}
+
+IngestionPipeline::~IngestionPipeline() {
+    // each stage drains before the next one's queue is closed, so nothing
+    // that was submitted is dropped.
+    auto stop = [](auto& queue, std::vector<std::thread>& threads) {
+        queue.close();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    };
+    stop(stack_queue, stack_threads);
+    stop(assign_queue, assign_threads);
+    stop(encode_queue, encode_threads);
+    write_queue.close();
+    writer.join();
+
+    if (error) {
+        LOG(ERROR) << "ingestion pipeline closed with an error that wasn't "
+                      "flushed";
+    }
+}
+
+void IngestionPipeline::submit(
+        const uint64_t tenant,
+        gsl::span<const Document> documents) {
+    submit(tenant, documents, nullptr);
+}
+
+void IngestionPipeline::submit(
+        const uint64_t tenant,
+        std::vector<Document>&& documents) {
+    auto owned =
+            std::make_shared<const std::vector<Document>>(std::move(documents));
+    submit(tenant, gsl::span<const Document>(*owned), owned);
+}
+
+void IngestionPipeline::submit(
+        const uint64_t tenant,
+        gsl::span<const Document> documents,
+        std::shared_ptr<const std::vector<Document>> owned) {
+    for (size_t i = 0; i < documents.size(); i += options.batch_size) {
+        auto work = std::make_unique<Work>();
+        work->owned = owned;
+        work->batch.tenant = tenant;
+        work->batch.documents = documents.subspan(
+                i, std::min(options.batch_size, documents.size() - i));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            work->sequence = next_sequence++;
+            submitted += work->batch.documents.size();
+        }
+        stack_queue.push(std::move(work));
+    }
+}
+
+void IngestionPipeline::flush() {
+    std::unique_lock<std::mutex> lock(mutex);
+    const size_t target = submitted;
+    completed_cv.wait(lock, [&] { return completed >= target; });
+    if (error) {
+        std::exception_ptr first = error;
+        error = nullptr;
+        std::rethrow_exception(first);
+    }
+}
+
+void IngestionPipeline::stack(WorkPtr work) {
+    work->batch = processor.stackDocuments(
+            work->batch.tenant, work->batch.documents);
+    assign_queue.push(std::move(work));
+}
+
+void IngestionPipeline::assign(WorkPtr work) {
+    processor.assignCentroids(work->batch);
+    encode_queue.push(std::move(work));
+}
+
+void IngestionPipeline::encode(WorkPtr work) {
+    processor.quantize(work->batch);
+    Encoded encoded;
+    encoded.posting_data = processor.encode(work->batch);
+    encoded.num_documents = work->batch.documents.size();
+    encoded.sequence = work->sequence;
+    // the centroids and codes are freed here, before waiting on the writer.
+    work.reset();
+    write_queue.push(std::move(encoded));
+}
+
+void IngestionPipeline::run_stage(
+        BoundedQueue<WorkPtr>& in,
+        void (IngestionPipeline::*step)(WorkPtr)) {
+    WorkPtr work;
+    while (in.pop(work)) {
+        const size_t num_documents = work->batch.documents.size();
+        const uint64_t sequence = work->sequence;
+        try {
+            (this->*step)(std::move(work));
+        } catch (...) {
+            complete(num_documents, std::current_exception());
+            // the writer still needs the failed batch's place in the order.
+            Encoded failed;
+            failed.sequence = sequence;
+            write_queue.push(std::move(failed));
+        }
+    }
+}
+
+void IngestionPipeline::run_writer() {
+    std::map<uint64_t, Encoded> ready;
+    uint64_t next = 0;
+    Encoded encoded;
+    while (write_queue.pop(encoded)) {
+        // group commit: whatever else is already waiting goes in the same
+        // write.
+        do {
+            ready.emplace(encoded.sequence, std::move(encoded));
+        } while (write_queue.try_pop(encoded));
+        write_ready(ready, next);
+    }
+}
+
+void IngestionPipeline::write_ready(
+        std::map<uint64_t, Encoded>& ready,
+        uint64_t& next) {
+    while (!ready.empty() && ready.begin()->first == next) {
+        BatchPostingData group;
+        size_t num_documents = 0;
+        auto it = ready.begin();
+        while (it != ready.end() && it->first == next &&
+               num_documents < options.max_group_documents) {
+            append(group, it->second.posting_data);
+            num_documents += it->second.num_documents;
+            it = ready.erase(it);
+            next++;
+        }
+
+        // groups of failed batches have nothing to write.
+        if (num_documents == 0) {
+            continue;
+        }
+        try {
+            processor.write(group);
+            complete(num_documents);
+        } catch (...) {
+            complete(num_documents, std::current_exception());
+        }
+    }
+}
+
+void IngestionPipeline::complete(
+        size_t num_documents,
+        std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    completed += num_documents;
+    if (error && !this->error) {
+        this->error = error;
+    }
+    completed_cv.notify_all();
+}
+
+} // namespace lintdb
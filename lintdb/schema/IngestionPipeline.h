@@ -0,0 +1,122 @@
+#pragma once
+
+#include <gsl/span>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "lintdb/invlists/PostingData.h"
+#include "lintdb/schema/DocProcessor.h"
+#include "lintdb/schema/Document.h"
+#include "lintdb/utils/BoundedQueue.h"
+
+namespace lintdb {
+struct IngestionOptions {
+    size_t batch_size = kDocumentBatchSize; /// documents encoded together.
+    size_t stack_threads = 1;  /// threads that validate and stack documents.
+    size_t assign_threads = 1; /// threads that assign centroids.
+    size_t encode_threads = 2; /// threads that quantize and encode postings.
+    size_t queue_size = 8;     /// batches waiting between two stages.
+    size_t max_group_documents =
+            1024; /// the most documents written in one write batch.
+};
+
+/**
+ * IngestionPipeline encodes and writes documents in stages, so computing
+ * codes for some batches overlaps writing others.
+ *
+ * Batches are gathered, assigned centroids, encoded and written, with a
+ * bounded queue between each stage. A full queue blocks the stage before it,
+ * and in the end `submit`, so memory stays bounded when writes fall behind.
+ *
+ * A single writer commits the batches it finds waiting together, in one
+ * write to the index writer, instead of one small write per batch.
+ *
+ * Batches can finish encoding out of order when there are several threads in
+ * a stage. The writer writes them in the order they were submitted, so a
+ * document that's added twice keeps the version submitted last. Batches that
+ * finish early wait in memory for the ones before them.
+ */
+class IngestionPipeline {
+   public:
+    IngestionPipeline(
+            DocumentProcessor& processor,
+            const IngestionOptions& options = IngestionOptions());
+
+    /// finishes submitted documents. Errors that weren't flushed are lost.
+    ~IngestionPipeline();
+
+    /**
+     * submit queues documents to be added. The documents must stay alive
+     * until `flush` returns.
+     */
+    void submit(const uint64_t tenant, gsl::span<const Document> documents);
+
+    /// submit queues documents to be added, taking ownership of them.
+    void submit(const uint64_t tenant, std::vector<Document>&& documents);
+
+    /**
+     * flush waits for every document submitted before the call to be
+     * written. It throws the first error the pipeline hit since the last
+     * flush. Documents of a failed batch or write aren't added.
+     */
+    void flush();
+
+   private:
+    struct Work {
+        /// keeps documents that were submitted by value alive.
+        std::shared_ptr<const std::vector<Document>> owned;
+        EncodingBatch batch;
+        uint64_t sequence = 0; /// the order the batch was submitted in.
+    };
+    using WorkPtr = std::unique_ptr<Work>;
+
+    struct Encoded {
+        BatchPostingData posting_data;
+        size_t num_documents = 0;
+        uint64_t sequence = 0;
+    };
+
+    void submit(
+            const uint64_t tenant,
+            gsl::span<const Document> documents,
+            std::shared_ptr<const std::vector<Document>> owned);
+
+    void stack(WorkPtr work);
+    void assign(WorkPtr work);
+    void encode(WorkPtr work);
+    void run_stage(
+            BoundedQueue<WorkPtr>& in,
+            void (IngestionPipeline::*step)(WorkPtr));
+    void run_writer();
+    /// writes the batches in ready that are next in order, grouped.
+    void write_ready(std::map<uint64_t, Encoded>& ready, uint64_t& next);
+
+    /// marks documents as done, with the error that stopped them, if any.
+    void complete(size_t num_documents, std::exception_ptr error = nullptr);
+
+    DocumentProcessor& processor;
+    const IngestionOptions options;
+
+    BoundedQueue<WorkPtr> stack_queue;
+    BoundedQueue<WorkPtr> assign_queue;
+    BoundedQueue<WorkPtr> encode_queue;
+    BoundedQueue<Encoded> write_queue;
+
+    std::vector<std::thread> stack_threads;
+    std::vector<std::thread> assign_threads;
+    std::vector<std::thread> encode_threads;
+    std::thread writer;
+
+    std::mutex mutex;
+    std::condition_variable completed_cv;
+    uint64_t next_sequence = 0; /// the sequence of the next batch.
+    size_t submitted = 0;       /// documents submitted.
+    size_t completed = 0; /// documents written or failed.
+    std::exception_ptr error;
+};
+
+} // namespace lintdb
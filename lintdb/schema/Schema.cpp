@@ -20,6 +20,10 @@ Json::Value Field::toJson() const {
     params["num_iterations"] = static_cast<Json::Value::UInt64>(parameters.num_iterations);
     params["num_subquantizers"] = static_cast<Json::Value::UInt64>(parameters.num_subquantizers);
     params["nbits"] = static_cast<Json::Value::UInt64>(parameters.nbits);
+    params["coarse_quantizer"] = static_cast<int>(parameters.coarse_quantizer);
+    params["hnsw_m"] = static_cast<Json::Value::UInt64>(parameters.hnsw_m);
+    params["ef_search"] = static_cast<Json::Value::UInt64>(parameters.ef_search);
+    params["clustering"] = static_cast<int>(parameters.clustering);
     json["parameters"] = params;
 
     return json;
@@ -45,6 +49,17 @@ Field Field::fromJson(const Json::Value& json) {
     field.parameters.num_iterations = params["num_iterations"].asUInt();
     field.parameters.num_subquantizers = params["num_subquantizers"].asUInt();
     field.parameters.nbits = params["nbits"].asUInt();
+    // older schemas don't have coarse quantizer parameters.
+    if (params.isMember("coarse_quantizer")) {
+        field.parameters.coarse_quantizer = static_cast<CoarseQuantizerType>(
+                params["coarse_quantizer"].asInt());
+        field.parameters.hnsw_m = params["hnsw_m"].asUInt();
+        field.parameters.ef_search = params["ef_search"].asUInt();
+    }
+    if (params.isMember("clustering")) {
+        field.parameters.clustering =
+                static_cast<ClusteringType>(params["clustering"].asInt());
+    }
 
     return field;
 }
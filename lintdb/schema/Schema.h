@@ -20,6 +20,10 @@ struct FieldParameters {
     size_t num_iterations = 10;
     size_t num_subquantizers = 0; // used for PQ quantizer
     size_t nbits = 1;             // used for PQ quantizer
+    CoarseQuantizerType coarse_quantizer = CoarseQuantizerType::FLAT;
+    size_t hnsw_m = 32;     // used for HNSW coarse quantizer
+    size_t ef_search = 128; // used for HNSW coarse quantizer
+    ClusteringType clustering = ClusteringType::FLAT; // to train centroids
 };
 
 /**
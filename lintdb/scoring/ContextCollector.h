@@ -3,6 +3,8 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include "lintdb/query/QueryContext.h"
 #include "lintdb/query/DocValue.h"
 #include "lintdb/invlists/ContextIterator.h"
@@ -41,13 +43,69 @@ class ContextCollector {
             context_data_types.push_back(DataType::COLBERT);
         }
 
-        auto it = context.getIndex()->get_context_iterator(
-                context.getTenant(), colbert_field_id);
+        index = context.getIndex();
+        tenant = context.getTenant();
+        auto it = index->get_context_iterator(tenant, colbert_field_id);
 
         context_iterators.push_back(std::move(it));
     }
 
+    /**
+     * prefetch reads the context of a block of candidates with one batched
+     * read per field, instead of a seek per document.
+     *
+     * Each call replaces the previous block. get_context_values hands a
+     * prefetched document's values over to the caller, so it should be called
+     * once per document.
+     */
+    void prefetch(const std::vector<idx_t>& doc_ids) {
+        prefetched.clear();
+        if (context_iterators.empty() || doc_ids.empty()) {
+            return;
+        }
+
+        std::vector<idx_t> sorted_ids(doc_ids);
+        std::sort(sorted_ids.begin(), sorted_ids.end());
+        sorted_ids.erase(
+                std::unique(sorted_ids.begin(), sorted_ids.end()),
+                sorted_ids.end());
+
+        std::vector<std::vector<DocValue>*> doc_values;
+        doc_values.reserve(sorted_ids.size());
+        prefetched.reserve(sorted_ids.size());
+        for (const auto doc_id : sorted_ids) {
+            doc_values.push_back(&prefetched[doc_id]);
+        }
+
+        // contexts are decoded straight from storage, without a copy.
+        for (size_t i = 0; i < context_field_ids.size(); i++) {
+            index->visit_contexts(
+                    tenant,
+                    context_field_ids[i],
+                    sorted_ids,
+                    [&](size_t j, std::string_view value) {
+                        if (value.empty()) {
+                            LOG(WARNING) << "No context found for doc_id: "
+                                         << sorted_ids[j]
+                                         << " field: " << context_fields[i];
+                            return;
+                        }
+                        doc_values[j]->emplace_back(
+                                decode(i, value),
+                                context_field_ids[i],
+                                context_data_types[i]);
+                    });
+        }
+    }
+
     std::vector<DocValue> get_context_values(const idx_t doc_id) const {
+        auto cached = prefetched.find(doc_id);
+        if (cached != prefetched.end()) {
+            std::vector<DocValue> results = std::move(cached->second);
+            prefetched.erase(cached);
+            return results;
+        }
+
         std::vector<DocValue> results;
         results.reserve(context_iterators.size());
 
@@ -57,8 +115,7 @@ class ContextCollector {
 
             if(it->is_valid() && it->get_key().doc_id() == doc_id) {
                 std::string context_str = it->get_value();
-                SupportedTypes colbert_context =
-                        DocEncoder::decode_supported_types(context_str);
+                SupportedTypes colbert_context = decode(i, context_str);
 
                 // create DocValues for the context info.
                 uint8_t colbert_field_id = context_field_ids[i];
@@ -73,10 +130,22 @@ class ContextCollector {
 
 
    private:
+    SupportedTypes decode(size_t i, std::string_view value) const {
+        if (context_data_types[i] == DataType::COLBERT) {
+            return DocEncoder::decode_colbert_codes_data(value);
+        }
+        std::string data(value);
+        return DocEncoder::decode_supported_types(data);
+    }
+
     std::vector<std::string> context_fields;
     std::vector<uint8_t> context_field_ids;
     std::vector<DataType> context_data_types;
     std::vector<std::unique_ptr<ContextIterator>> context_iterators;
+    std::shared_ptr<InvertedList> index;
+    uint64_t tenant = 0;
+    /// context read by prefetch() that hasn't been handed out yet.
+    mutable std::unordered_map<idx_t, std::vector<DocValue>> prefetched;
 
 };
 
@@ -2,11 +2,60 @@
 #include <glog/logging.h>
 #include <algorithm>
 #include "lintdb/invlists/InvertedList.h"
+#include "lintdb/quantizers/Binarizer.h"
 #include "lintdb/query/decode.h"
 #include "lintdb/schema/DocEncoder.h"
 #include "ScoredDocument.h"
 
 namespace lintdb {
+std::vector<ScoredDocument> Scorer::score_batch(
+        QueryContext& context,
+        std::vector<ScoredDocument>& docs) const {
+    std::vector<ScoredDocument> results(docs.size());
+    for (size_t i = 0; i < docs.size(); i++) {
+        results[i] = score(context, docs[i].doc_id, docs[i].values);
+    }
+    return results;
+}
+
+namespace {
+/**
+ * read_residuals fills in the residuals of ColBERT contexts that were read
+ * without them. PLAID only reads the codes, so residuals are read for the
+ * documents that reach rerank.
+ *
+ * Indexes written before residuals were stored separately already have them.
+ */
+void read_residuals(
+        QueryContext& context,
+        const std::vector<idx_t>& doc_ids,
+        const std::vector<ColBERTContextData*>& colbert) {
+    std::vector<idx_t> missing_ids;
+    std::vector<ColBERTContextData*> missing;
+    for (size_t i = 0; i < colbert.size(); i++) {
+        if (colbert[i] != nullptr && colbert[i]->doc_residuals.empty() &&
+            !colbert[i]->doc_codes.empty()) {
+            missing_ids.push_back(doc_ids[i]);
+            missing.push_back(colbert[i]);
+        }
+    }
+    if (missing.empty()) {
+        return;
+    }
+
+    uint8_t colbert_field_id =
+            context.getFieldMapper()->getFieldID(context.colbert_context);
+    // residuals are copied once, from storage into the context.
+    context.getIndex()->visit_residuals(
+            context.getTenant(),
+            colbert_field_id,
+            missing_ids,
+            [&missing](size_t i, std::string_view value) {
+                missing[i]->doc_residuals.assign(value.begin(), value.end());
+            });
+}
+} // namespace
+
 ColBERTScorer::ColBERTScorer(const lintdb::QueryContext& context) {}
 ScoredDocument ColBERTScorer::score(
         QueryContext& context,
@@ -30,13 +79,19 @@ ScoredDocument ColBERTScorer::score(
             context.getFieldMapper()->getFieldID(context.colbert_context);
     size_t dim = context.getFieldMapper()->getFieldDimensions(colbert_field_id);
 
-    SupportedTypes colbert_data = dvs[colbert_data_idx].value;
-    ColBERTContextData colbert = std::get<ColBERTContextData>(colbert_data);
+    ColBERTContextData& colbert =
+            std::get<ColBERTContextData>(dvs[colbert_data_idx].value);
+    read_residuals(context, {doc_id}, {&colbert});
 
     size_t num_tensors = colbert.doc_codes.size();
 
     std::shared_ptr<Quantizer> quantizer =
             context.getQuantizer(context.colbert_context);
+    if (colbert.doc_residuals.size() < num_tensors * quantizer->code_size()) {
+        LOG(WARNING) << "colbert residuals are truncated for doc_id: "
+                     << doc_id;
+        return {0.0, doc_id, dvs};
+    }
 
     // decompress residuals.
     Tensor decompressed(num_tensors * dim, 0);
@@ -61,6 +116,136 @@ ScoredDocument ColBERTScorer::score(
     return {score.score, doc_id, dvs};
 }
 
+std::vector<ScoredDocument> ColBERTScorer::score_batch(
+        QueryContext& context,
+        std::vector<ScoredDocument>& docs) const {
+    std::vector<ScoredDocument> results(docs.size());
+
+    uint8_t colbert_field_id =
+            context.getFieldMapper()->getFieldID(context.colbert_context);
+    size_t dim = context.getFieldMapper()->getFieldDimensions(colbert_field_id);
+    std::shared_ptr<Quantizer> quantizer =
+            context.getQuantizer(context.colbert_context);
+    const size_t code_size = quantizer->code_size();
+
+    // find each document's colbert data. documents without it score 0.
+    std::vector<ColBERTContextData*> colbert(docs.size(), nullptr);
+    std::vector<idx_t> doc_ids(docs.size());
+    for (size_t i = 0; i < docs.size(); i++) {
+        doc_ids[i] = docs[i].doc_id;
+        for (auto& dv : docs[i].values) {
+            if (dv.type == DataType::COLBERT) {
+                colbert[i] = std::get_if<ColBERTContextData>(&dv.value);
+                break;
+            }
+        }
+    }
+    read_residuals(context, doc_ids, colbert);
+
+    for (size_t i = 0; i < docs.size(); i++) {
+        results[i] = {0.0, docs[i].doc_id, docs[i].values};
+        if (colbert[i] == nullptr) {
+            LOG(WARNING) << "colbert context field not found for doc_id: "
+                         << docs[i].doc_id;
+        } else if (
+                colbert[i]->doc_residuals.size() <
+                colbert[i]->doc_codes.size() * code_size) {
+            LOG(WARNING) << "colbert residuals are truncated for doc_id: "
+                         << docs[i].doc_id;
+            colbert[i] = nullptr;
+        }
+    }
+
+    QueryTensor query =
+            context.getOrCreateNearestCentroids(context.colbert_context)
+                    ->get_query_tensor();
+    auto query_span = gsl::span<const float>(query.query);
+
+    // binarized residuals are scored straight from their packed codes.
+    if (quantizer->get_type() == QuantizerType::BINARIZER) {
+        auto binarizer = std::dynamic_pointer_cast<Binarizer>(quantizer);
+        std::unique_ptr<BinarizerDistanceTables> tables =
+                binarizer->get_distance_tables(
+                        query.query.data(), query.num_query_tokens);
+        if (tables) {
+#pragma omp parallel for schedule(dynamic)
+            for (int i = 0; i < docs.size(); i++) {
+                if (colbert[i] == nullptr) {
+                    continue;
+                }
+                results[i].score = tables->maxsim(
+                        colbert[i]->doc_residuals.data(),
+                        colbert[i]->doc_codes.size(),
+                        true);
+            }
+            return results;
+        }
+    }
+
+    // split documents into tiles of roughly kTileTokens tokens.
+    std::vector<size_t> tile_starts = {0};
+    size_t tile_tokens = 0;
+    for (size_t i = 0; i < docs.size(); i++) {
+        size_t num_tokens = colbert[i] ? colbert[i]->doc_codes.size() : 0;
+        if (tile_tokens > 0 && tile_tokens + num_tokens > kTileTokens) {
+            tile_starts.push_back(i);
+            tile_tokens = 0;
+        }
+        tile_tokens += num_tokens;
+    }
+    tile_starts.push_back(docs.size());
+
+#pragma omp parallel
+    {
+        std::vector<float> decompressed;
+        std::vector<size_t> offsets;
+        std::vector<float> scores;
+
+#pragma omp for schedule(dynamic)
+        for (int t = 0; t < tile_starts.size() - 1; t++) {
+            size_t begin = tile_starts[t];
+            size_t end = tile_starts[t + 1];
+
+            offsets.assign(1, 0);
+            for (size_t i = begin; i < end; i++) {
+                size_t num_tokens =
+                        colbert[i] ? colbert[i]->doc_codes.size() : 0;
+                offsets.push_back(offsets.back() + num_tokens);
+            }
+
+            decompressed.resize(offsets.back() * dim);
+            for (size_t i = begin; i < end; i++) {
+                if (colbert[i] == nullptr) {
+                    continue;
+                }
+                size_t num_tokens = offsets[i - begin + 1] - offsets[i - begin];
+                quantizer->sa_decode(
+                        num_tokens,
+                        colbert[i]->doc_residuals.data(),
+                        decompressed.data() + offsets[i - begin] * dim);
+            }
+
+            scores.resize(end - begin);
+            score_documents_by_residuals(
+                    query_span,
+                    query.num_query_tokens,
+                    decompressed.data(),
+                    offsets,
+                    dim,
+                    scores.data(),
+                    true);
+
+            for (size_t i = begin; i < end; i++) {
+                if (colbert[i] != nullptr) {
+                    results[i].score = scores[i - begin];
+                }
+            }
+        }
+    }
+
+    return results;
+}
+
 PlaidScorer::PlaidScorer(const QueryContext& context) {
 }
 
@@ -86,7 +271,6 @@ ScoredDocument PlaidScorer::score(
     // scores.
     auto nearest_centroids =
             context.getOrCreateNearestCentroids(context.colbert_context);
-    auto reordered_distances = nearest_centroids->get_reordered_distances();
 
     std::shared_ptr<ICoarseQuantizer> coarse_quantizer =
             context.getCoarseQuantizer(context.colbert_context);
@@ -102,12 +286,7 @@ ScoredDocument PlaidScorer::score(
     QueryTensor query =
             context.getOrCreateNearestCentroids(context.colbert_context)
                     ->get_query_tensor();
-    float score = colbert_centroid_score(
-            codes.doc_codes,
-            reordered_distances,
-            query.num_query_tokens,
-            coarse_quantizer->num_centroids(),
-            -1);
+    float score = colbert_centroid_score(codes.doc_codes, *nearest_centroids);
     // end rank phase 1.
     return {score, doc_id, fvs};
 }
@@ -32,6 +32,17 @@ class Scorer {
             QueryContext& context,
             idx_t doc_id,
             std::vector<DocValue>& fvs) const = 0;
+
+    /**
+     * score_batch scores many documents at once, returning them in the same
+     * order.
+     *
+     * Scorers can override this to share work across documents. The default
+     * calls score() for each document.
+     */
+    virtual std::vector<ScoredDocument> score_batch(
+            QueryContext& context,
+            std::vector<ScoredDocument>& docs) const;
 };
 
 class PlaidScorer : public Scorer {
@@ -45,13 +56,26 @@ class PlaidScorer : public Scorer {
 
 };
 
+/**
+ * ColBERTScorer reranks documents with the MaxSim score of their decompressed
+ * token embeddings.
+ *
+ * score_batch decodes documents into a per-thread buffer in tiles of about
+ * kTileTokens tokens, and scores each tile with one GEMM. Binarizer fields
+ * skip decoding and score the packed codes with BinarizerDistanceTables.
+ */
 class ColBERTScorer : public Scorer {
    public:
+    static const size_t kTileTokens = 8192;
+
     explicit ColBERTScorer(const QueryContext& context);
     ScoredDocument score(
             QueryContext& context,
             idx_t doc_id,
             std::vector<DocValue>& fvs) const override;
+    std::vector<ScoredDocument> score_batch(
+            QueryContext& context,
+            std::vector<ScoredDocument>& docs) const override;
     ~ColBERTScorer() override = default;
 
 };
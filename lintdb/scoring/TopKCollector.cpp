@@ -0,0 +1,42 @@
+#include "TopKCollector.h"
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace lintdb {
+TopKCollector::TopKCollector(size_t k) : k(k) {
+    heap.reserve(k);
+}
+
+void TopKCollector::collect(ScoredDocument&& doc) {
+    if (k == 0) {
+        return;
+    }
+
+    if (heap.size() < k) {
+        heap.push_back(std::move(doc));
+        std::push_heap(heap.begin(), heap.end(), std::greater<>());
+    } else if (doc.score > heap.front().score) {
+        std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+        heap.back() = std::move(doc);
+        std::push_heap(heap.begin(), heap.end(), std::greater<>());
+    }
+}
+
+void TopKCollector::merge(TopKCollector& other) {
+    for (auto& doc : other.heap) {
+        collect(std::move(doc));
+    }
+    other.heap.clear();
+}
+
+std::vector<ScoredDocument> TopKCollector::take_sorted() {
+    // sort_heap with a min-heap comparator leaves the largest scores first.
+    std::sort_heap(heap.begin(), heap.end(), std::greater<>());
+
+    std::vector<ScoredDocument> results = std::move(heap);
+    heap.clear();
+    return results;
+}
+
+} // namespace lintdb
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <vector>
+#include "lintdb/scoring/ScoredDocument.h"
+
+namespace lintdb {
+/**
+ * TopKCollector keeps the best k ScoredDocuments seen so far.
+ *
+ * Documents are held in a bounded min-heap, so memory is O(k) no matter how
+ * many candidates are collected. Collectors are not thread safe. Parallel
+ * scoring should use one collector per thread and merge them at the end.
+ */
+class TopKCollector {
+   public:
+    explicit TopKCollector(size_t k);
+
+    /// add a document. It is dropped if it can't enter the top k.
+    void collect(ScoredDocument&& doc);
+
+    /// the lowest score that can still enter the collector.
+    inline double threshold() const {
+        if (!is_full()) {
+            return std::numeric_limits<double>::lowest();
+        }
+        return heap.front().score;
+    }
+
+    inline bool is_full() const {
+        return k > 0 && heap.size() >= k;
+    }
+
+    inline size_t size() const {
+        return heap.size();
+    }
+
+    /// move all documents from other into this collector.
+    void merge(TopKCollector& other);
+
+    /// returns the collected documents sorted by descending score and empties
+    /// the collector.
+    std::vector<ScoredDocument> take_sorted();
+
+   private:
+    size_t k;
+    std::vector<ScoredDocument> heap; /// min-heap on score.
+};
+
+} // namespace lintdb
@@ -5,8 +5,9 @@
 #include <gsl/span>
 #include <iostream>
 #include <numeric>
-#include <unordered_set>
+#include <cstdint>
 #include "lintdb/api.h"
+#include "lintdb/query/KnnNearestCentroids.h"
 #include "lintdb/util.h"
 
 namespace lintdb {
@@ -35,6 +36,42 @@ extern int sgemm_(
         FINTEGER* ldc);
 }
 
+namespace {
+/**
+ * SeenCodes dedupes a document's codes without clearing memory between
+ * documents. A code is seen if its stamp matches the current epoch, so
+ * starting a new document only bumps the epoch.
+ */
+struct SeenCodes {
+    std::vector<uint32_t> stamps;
+    uint32_t epoch = 0;
+
+    void reset(size_t num_codes) {
+        if (stamps.size() < num_codes) {
+            stamps.resize(num_codes, 0);
+        }
+        if (++epoch == 0) {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            epoch = 1;
+        }
+    }
+
+    /// returns true the first time we see code in this document.
+    inline bool insert(code_t code) {
+        if (stamps[code] == epoch) {
+            return false;
+        }
+        stamps[code] = epoch;
+        return true;
+    }
+};
+
+SeenCodes& thread_seen_codes() {
+    static thread_local SeenCodes seen;
+    return seen;
+}
+} // namespace
+
 float score_documents_by_codes(
         const gsl::span<float>
                 max_scores_by_centroid, // the max score per centroid across the
@@ -44,55 +81,85 @@ float score_documents_by_codes(
         const idx_t expected_id) {
     // Initialize a vector to store the approximate scores for each document
     float doc_score = 0;
-    std::unordered_set<code_t> unique_codes;
+    SeenCodes& seen = thread_seen_codes();
+    seen.reset(max_scores_by_centroid.size());
     // Iterate over each token code.
     for (auto index : doc_codes) {
         assert(index < max_scores_by_centroid.size() && "index out of bounds");
-        if ((unique_codes.find(index) != unique_codes.end()) ||
-            (max_scores_by_centroid[index] < centroid_score_threshold)) {
+        if (max_scores_by_centroid[index] < centroid_score_threshold ||
+            !seen.insert(index)) {
             continue;
         }
 
         // we get the centroid score from query_scores. this is the max score
         // found in the query for that centroid.
         doc_score += max_scores_by_centroid[index];
-        unique_codes.insert(index);
     }
 
     return doc_score;
 }
 
-float colbert_centroid_score(
-        const std::vector<code_t>&
-                doc_codes, // of size num_doc_tokens. one code per token.
-        const std::vector<float>&
-                centroid_scores, // of size nquery_vectors x n_centroids
+namespace {
+// get_scores returns a pointer to a code's nquery_vectors scores.
+template <typename Codes, typename GetScores>
+float max_centroid_score(
+        const Codes& doc_codes,
         const size_t nquery_vectors,
         const size_t n_centroids,
-        const idx_t doc_id) {
-    std::vector<float> per_doc_approx_scores(nquery_vectors, -9999);
+        GetScores get_scores) {
+    static thread_local std::vector<float> per_doc_approx_scores;
+    per_doc_approx_scores.assign(nquery_vectors, kNoCentroidScore);
+    float* __restrict approx = per_doc_approx_scores.data();
 
-    std::unordered_set<int> seen_codes;
-    for (int j = 0; j < doc_codes.size(); j++) {
-        auto code = doc_codes[j];
+    SeenCodes& seen = thread_seen_codes();
+    seen.reset(n_centroids);
+    for (const auto code : doc_codes) {
+        if (!seen.insert(code)) {
+            continue;
+        }
 
-        if (seen_codes.find(code) == seen_codes.end()) {
-            for (int k = 0; k < nquery_vectors; k++) {
-                per_doc_approx_scores[k] = std::max(
-                        per_doc_approx_scores[k],
-                        centroid_scores[k * n_centroids + code]);
-            }
-            seen_codes.insert(code);
+        // each centroid's scores are contiguous, so this loop vectorizes.
+        const float* __restrict scores = get_scores(code);
+#pragma omp simd
+        for (size_t k = 0; k < nquery_vectors; k++) {
+            approx[k] = std::max(approx[k], scores[k]);
         }
     }
+
     float score = 0;
-    for (int k = 0; k < nquery_vectors; k++) {
-        score += per_doc_approx_scores[k];
-        per_doc_approx_scores[k] = -9999;
+#pragma omp simd reduction(+ : score)
+    for (size_t k = 0; k < nquery_vectors; k++) {
+        score += approx[k];
     }
 
     return score;
 }
+} // namespace
+
+float colbert_centroid_score(
+        const std::vector<code_t>&
+                doc_codes, // of size num_doc_tokens. one code per token.
+        const std::vector<float>&
+                centroid_major_scores, // of size n_centroids x nquery_vectors
+        const size_t nquery_vectors,
+        const size_t n_centroids,
+        const idx_t doc_id) {
+    return max_centroid_score(
+            doc_codes, nquery_vectors, n_centroids, [&](code_t code) {
+                return centroid_major_scores.data() + code * nquery_vectors;
+            });
+}
+
+float colbert_centroid_score(
+        const std::vector<colbert_code_t>& doc_codes,
+        const KnnNearestCentroids& knn,
+        const idx_t doc_id) {
+    return max_centroid_score(
+            doc_codes,
+            knn.get_num_query_tokens(),
+            knn.get_num_centroids(),
+            [&](code_t code) { return knn.get_centroid_scores(code); });
+}
 
 // below, we are summing up for every centroid. this ignores per word
 std::vector<float> max_score_by_centroid(
@@ -184,4 +251,68 @@ DocumentScore score_document_by_residuals(
     return doc;
 }
 
+void score_documents_by_residuals(
+        const gsl::span<const float> query_vectors,
+        const size_t num_query_tokens,
+        float* doc_residuals,
+        const std::vector<size_t>& doc_offsets,
+        const size_t dim,
+        float* scores,
+        bool normalize) {
+    if (doc_offsets.size() < 2) {
+        return;
+    }
+    const size_t num_docs = doc_offsets.size() - 1;
+    const size_t total_tokens = doc_offsets.back();
+
+    if (normalize) {
+        normalize_vector(doc_residuals, total_tokens, dim);
+    }
+
+    std::vector<float> output(total_tokens * num_query_tokens, 0);
+    if (total_tokens > 0) {
+        FINTEGER m = FINTEGER(total_tokens);
+        FINTEGER n = FINTEGER(num_query_tokens);
+        FINTEGER k = FINTEGER(dim);
+        float alpha = 1.0;
+        float beta = 0.0;
+        FINTEGER lda = FINTEGER(dim);
+        FINTEGER ldb = FINTEGER(dim);
+        FINTEGER out = FINTEGER(num_query_tokens);
+
+        // see score_document_by_residuals. this computes the row major
+        // (total_tokens x num_query_tokens) product.
+        sgemm_("T",
+               "N",
+               &n,
+               &m,
+               &k,
+               &alpha,
+               query_vectors.data(),
+               &lda,
+               doc_residuals,
+               &ldb,
+               &beta,
+               output.data(),
+               &out);
+    }
+
+    std::vector<float> max_scores(num_query_tokens);
+    for (size_t d = 0; d < num_docs; d++) {
+        std::fill(max_scores.begin(), max_scores.end(), 0);
+        for (size_t i = doc_offsets[d]; i < doc_offsets[d + 1]; i++) {
+            const float* row = output.data() + i * num_query_tokens;
+            for (size_t j = 0; j < num_query_tokens; j++) {
+                max_scores[j] = std::max(max_scores[j], row[j]);
+            }
+        }
+
+        float maxsim = 0;
+        for (size_t j = 0; j < num_query_tokens; j++) {
+            maxsim += max_scores[j];
+        }
+        scores[d] = maxsim;
+    }
+}
+
 } // namespace lintdb
\ No newline at end of file
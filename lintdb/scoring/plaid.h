@@ -8,6 +8,12 @@
 #include "lintdb/api.h"
 
 namespace lintdb {
+class KnnNearestCentroids;
+
+/// a query token's approximate score before any of a document's centroids
+/// has been scored.
+static const float kNoCentroidScore = -9999;
+
 /**
  * score_documents_by_codes aggregates a document score based on each token's
  * code and how well it matches the query.
@@ -29,17 +35,35 @@ std::vector<float> max_score_by_centroid(
         size_t num_tokens,
         size_t num_centroids);
 
+/**
+ * colbert_centroid_score scores a document's codes with a dense table of
+ * centroid scores.
+ *
+ * The table is centroid major: centroid c's score for query token k is at
+ * centroid_major_scores[c * nquery_vectors + k].
+ */
 float colbert_centroid_score(
         const std::vector<code_t>& doc_codes, /// codes from the document. each
                                               /// token is assigned a code.
         const std::vector<float>&
-                centroid_scores,     /// the score of those codes to the query.
+                centroid_major_scores, /// the score of those codes to the
+                                       /// query, of size (n_centroids,
+                                       /// nquery_vectors).
         const size_t nquery_vectors, /// the number of query vectors.
         const size_t n_centroids,    /// how many centroids there are. this may
                                   /// change based on how many scores we choose
                                   /// to calculate.
         const idx_t expected_id);
 
+/**
+ * colbert_centroid_score scores a document's codes with the query's centroid
+ * scores. This works with both dense and sparse centroid score tables.
+ */
+float colbert_centroid_score(
+        const std::vector<colbert_code_t>& doc_codes,
+        const KnnNearestCentroids& knn,
+        const idx_t expected_id = -1);
+
 struct DocumentScore {
     float score;
     std::vector<float> tokens;
@@ -55,6 +79,27 @@ DocumentScore score_document_by_residuals(
         const idx_t doc_id,
         bool normalize = true);
 
+/**
+ * score_documents_by_residuals scores a block of documents whose token
+ * embeddings are stored contiguously.
+ *
+ * All document tokens are scored against the query with one GEMM, and each
+ * document's MaxSim score is reduced from its segment of the output.
+ *
+ * @param doc_offsets of size num_docs + 1. document i owns tokens
+ * [doc_offsets[i], doc_offsets[i + 1]) in doc_residuals.
+ * @param scores output of size num_docs.
+ */
+void score_documents_by_residuals(
+        const gsl::span<const float>
+                query_vectors, // size: (num_query_tokens, num_dim)
+        const size_t num_query_tokens,
+        float* doc_residuals, // size: (total_doc_tokens, num_dim)
+        const std::vector<size_t>& doc_offsets,
+        const size_t dim,
+        float* scores,
+        bool normalize = true);
+
 } // namespace lintdb
 
 #endif
\ No newline at end of file
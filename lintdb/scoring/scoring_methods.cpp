@@ -21,20 +21,10 @@ score_t plaid_similarity(const std::vector<DocValue>& values, std::shared_ptr<Kn
 
     // rank phase 1: use the codes to score the document using the centroid
     // scores.
-    auto reordered_distances = knn->get_reordered_distances();
+    const ColBERTContextData& codes =
+            std::get<ColBERTContextData>(values[colbert_idx].value);
 
-    // gives us a potentially quantized vector
-    SupportedTypes colbert_context = values[colbert_idx].value;
-    ColBERTContextData codes = std::get<ColBERTContextData>(colbert_context);
-    size_t num_tensors = codes.doc_codes.size();
-
-    QueryTensor query = knn->get_query_tensor();
-    float score = colbert_centroid_score(
-            codes.doc_codes,
-            reordered_distances,
-            query.num_query_tokens,
-            knn->get_num_centroids(),
-            -1);
+    float score = colbert_centroid_score(codes.doc_codes, *knn);
 
     return score;
 }
@@ -48,8 +38,12 @@ score_t score(const UnaryScoringMethod method, const std::vector<DocValue>& valu
     return unary_scoring_methods[scoring_type](values);
 }
 
+// indexed by EmbeddingScoringMethod, which starts at 1. Both methods use the
+// centroid scores in the first pass.
 EmbeddingScoringMethodFunction embedding_scoring_methods[] = {
-        plaid_similarity,
+        nullptr,
+        plaid_similarity, // PLAID
+        plaid_similarity, // COLBERT
 };
 
 
@@ -0,0 +1,75 @@
+#ifndef LINTDB_UTILS_BOUNDED_QUEUE_H
+#define LINTDB_UTILS_BOUNDED_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace lintdb {
+/**
+ * BoundedQueue is a blocking queue with a fixed capacity. Producers wait
+ * while it's full, which pushes back on whoever feeds them.
+ *
+ * Once closed, pushes are dropped and pops drain what's left.
+ */
+template <typename T>
+class BoundedQueue {
+   public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    /// waits for space, and returns false if the queue is closed.
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(
+                lock, [&] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    /// waits for an item, and returns false once the queue is closed and
+    /// empty.
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [&] { return closed || !items.empty(); });
+        return take(item);
+    }
+
+    /// returns false instead of waiting when the queue is empty.
+    bool try_pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return take(item);
+    }
+
+    void close() {
+        std::unique_lock<std::mutex> lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+   private:
+    bool take(T& item) {
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    const size_t capacity;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<T> items;
+    bool closed = false;
+};
+
+} // namespace lintdb
+
+#endif // LINTDB_UTILS_BOUNDED_QUEUE_H
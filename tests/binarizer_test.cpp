@@ -3,6 +3,7 @@
 #include <vector>
 #define private public
 #include <cmath>
+#include <random>
 #include "lintdb/quantizers/Binarizer.h"
 #include "lintdb/utils/endian.h"
 
@@ -141,4 +142,53 @@ TEST(BinarizerTests, EncodingTest) {
     binarizer.sa_decode(1, output.data(), decoded.data());
 
     ASSERT_EQ(input, decoded);
-}
\ No newline at end of file
+}
+TEST(BinarizerTests, DistanceTablesMatchDecodedMaxSim) {
+    const size_t dim = 32;
+    const size_t num_query_tokens = 3;
+    const size_t num_doc_tokens = 5;
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<float> dist(-1.0, 1.0);
+
+    std::vector<float> query(num_query_tokens * dim);
+    for (auto& q : query) {
+        q = dist(gen);
+    }
+
+    for (size_t nbits : {1, 2, 4}) {
+        std::vector<float> residuals(num_doc_tokens * dim);
+        for (auto& r : residuals) {
+            r = dist(gen);
+        }
+        lintdb::Binarizer binarizer(nbits, dim);
+        binarizer.train(num_doc_tokens, residuals.data(), dim);
+
+        std::vector<uint8_t> codes(num_doc_tokens * binarizer.code_size());
+        binarizer.sa_encode(num_doc_tokens, residuals.data(), codes.data());
+
+        // reference: decode, normalize and take the max per query token.
+        std::vector<float> decoded(num_doc_tokens * dim);
+        binarizer.sa_decode(num_doc_tokens, codes.data(), decoded.data());
+        float expected = 0;
+        for (size_t i = 0; i < num_query_tokens; i++) {
+            float max_score = 0;
+            for (size_t t = 0; t < num_doc_tokens; t++) {
+                float dot = 0, norm = 0;
+                for (size_t j = 0; j < dim; j++) {
+                    dot += query[i * dim + j] * decoded[t * dim + j];
+                    norm += decoded[t * dim + j] * decoded[t * dim + j];
+                }
+                if (norm > 0) {
+                    max_score = std::max(max_score, dot / std::sqrt(norm));
+                }
+            }
+            expected += max_score;
+        }
+
+        auto tables =
+                binarizer.get_distance_tables(query.data(), num_query_tokens);
+        ASSERT_NE(tables, nullptr);
+        float actual = tables->maxsim(codes.data(), num_doc_tokens, true);
+        EXPECT_NEAR(expected, actual, 1e-4) << "nbits: " << nbits;
+    }
+}
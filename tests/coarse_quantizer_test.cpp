@@ -1,7 +1,9 @@
 #include <gtest/gtest.h>
 #include "lintdb/quantizers/CoarseQuantizer.h"
+#include <cmath>
 #include <iostream>
 #include <filesystem>
+#include <random>
 #include "lintdb/version.h"
 
 using namespace lintdb;
@@ -123,4 +125,110 @@ TEST_F(CoarseQuantizerTest, TestSerializeDeserialize) {
     std::cout << "cq_loaded->assign done" << std::endl;
 
     ASSERT_EQ(codes.size(), 1);
-}
\ No newline at end of file
+}
+TEST(HNSWCoarseQuantizerTest, SerializeDeserializeKeepsEfSearch) {
+    std::vector<float> centroids = {
+            1.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, 1.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, 1.0f, 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f
+    };
+    HNSWCoarseQuantizer cq(4, centroids, 4, 8, 16);
+    cq.save("hnsw_coarse_quantizer.dat");
+
+    lintdb::Version version;
+    auto loaded = HNSWCoarseQuantizer::deserialize(
+            "hnsw_coarse_quantizer.dat", version);
+    std::filesystem::remove("hnsw_coarse_quantizer.dat");
+
+    ASSERT_TRUE(loaded->is_trained());
+    ASSERT_EQ(loaded->num_centroids(), 4);
+    ASSERT_EQ(loaded->get_ef_search(), 16);
+
+    // asking for every centroid is answered exactly.
+    std::vector<float> query = {0.0f, 0.0f, 1.0f, 0.0f};
+    std::vector<float> distances(4);
+    std::vector<idx_t> ids(4);
+    loaded->search(1, query.data(), 4, distances.data(), ids.data());
+    ASSERT_EQ(ids[0], 2);
+}
+
+TEST(HNSWCoarseQuantizerTest, DefaultSearchUsesTheGraph) {
+    const size_t dim = 8;
+    const size_t k = 1000;
+    std::mt19937 gen(42);
+    std::normal_distribution<float> dist(0, 1);
+    std::vector<float> centroids(k * dim);
+    for (auto& x : centroids) {
+        x = dist(gen);
+    }
+    // unit centroids, so each one is its own nearest neighbor by inner
+    // product.
+    for (size_t i = 0; i < k; i++) {
+        float norm = 0;
+        for (size_t j = 0; j < dim; j++) {
+            norm += centroids[i * dim + j] * centroids[i * dim + j];
+        }
+        for (size_t j = 0; j < dim; j++) {
+            centroids[i * dim + j] /= std::sqrt(norm);
+        }
+    }
+    HNSWCoarseQuantizer cq(dim, centroids, k, 16, 64);
+
+    // fewer centroids than the quantizer has, so search walks the graph
+    // instead of scanning every centroid.
+    const size_t search_k = cq.default_search_k();
+    ASSERT_EQ(search_k, 64);
+    ASSERT_LT(search_k, cq.num_centroids());
+
+    const size_t num_queries = 20;
+    std::vector<float> distances(num_queries * search_k);
+    std::vector<idx_t> ids(num_queries * search_k);
+    cq.search(
+            num_queries,
+            centroids.data(),
+            search_k,
+            distances.data(),
+            ids.data());
+    for (size_t i = 0; i < num_queries; i++) {
+        EXPECT_EQ(ids[i * search_k], i);
+        EXPECT_GE(ids[i * search_k + search_k - 1], 0);
+    }
+
+    CoarseQuantizer flat(dim, centroids, k);
+    EXPECT_EQ(flat.default_search_k(), k);
+}
+
+TEST(HierarchicalKMeansTest, TrainsLoadableQuantizer) {
+    const size_t dim = 8;
+    const size_t n = 2000;
+    const size_t k = 50;
+    std::mt19937 gen(42);
+    std::normal_distribution<float> dist(0, 1);
+    std::vector<float> data(n * dim);
+    for (auto& value : data) {
+        value = dist(gen);
+    }
+
+    auto centroids = hierarchical_kmeans(data.data(), n, dim, k, 4);
+    ASSERT_EQ(centroids.size(), k * dim);
+
+    FaissCoarseQuantizer cq(dim, ClusteringType::HIERARCHICAL);
+    cq.train(n, data.data(), k, 4);
+    ASSERT_TRUE(cq.is_trained());
+    ASSERT_EQ(cq.num_centroids(), k);
+
+    // hierarchical centroids use the same format as flat ones.
+    cq.save("hierarchical_coarse_quantizer.dat");
+    lintdb::Version version;
+    auto loaded = FaissCoarseQuantizer::deserialize(
+            "hierarchical_coarse_quantizer.dat", version);
+    std::filesystem::remove("hierarchical_coarse_quantizer.dat");
+    ASSERT_EQ(loaded->num_centroids(), k);
+
+    std::vector<idx_t> codes(n);
+    std::vector<idx_t> loaded_codes(n);
+    cq.assign(n, data.data(), codes.data());
+    loaded->assign(n, data.data(), loaded_codes.data());
+    ASSERT_EQ(codes, loaded_codes);
+}
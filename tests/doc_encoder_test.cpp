@@ -61,4 +61,119 @@ TEST(DocEncoder, EncodeContextData) {
 
     EXPECT_FALSE(result.key.empty());
     EXPECT_FALSE(result.value.empty());
-}
\ No newline at end of file
+}
+TEST(DocEncoder, EncodesColbertCodesWithoutResiduals) {
+    lintdb::ProcessedData data;
+    data.tenant = 0;
+    data.field = 1;
+    data.doc_id = 1;
+    lintdb::ColBERTContextData cd;
+    cd.doc_codes = {3, 4};
+    cd.doc_residuals = {7, 8, 9, 10};
+    data.value = lintdb::FieldValue("colbert", cd, 2);
+
+    auto codes = lintdb::DocEncoder::encode_colbert_codes_data(data, 100);
+    auto residuals = lintdb::DocEncoder::encode_residual_data(data);
+
+    // both are stored under the document's context key.
+    EXPECT_EQ(codes.key, residuals.key);
+    EXPECT_EQ(residuals.value, std::string({7, 8, 9, 10}));
+
+    auto decoded = std::get<lintdb::ColBERTContextData>(
+            lintdb::DocEncoder::decode_colbert_codes_data(codes.value));
+    EXPECT_EQ(decoded.doc_codes, cd.doc_codes);
+    EXPECT_TRUE(decoded.doc_residuals.empty());
+}
+
+TEST(DocEncoder, NarrowsColbertCodesByNumCentroids) {
+    lintdb::ProcessedData data;
+    data.tenant = 0;
+    data.field = 1;
+    data.doc_id = 1;
+    lintdb::ColBERTContextData cd;
+    for (colbert_code_t i = 0; i < 120; i++) {
+        cd.doc_codes.push_back(i * 500);
+    }
+    data.value = lintdb::FieldValue("colbert", cd, cd.doc_codes.size());
+
+    auto narrow = lintdb::DocEncoder::encode_colbert_codes_data(
+            data, size_t(1) << 16);
+    auto wide = lintdb::DocEncoder::encode_colbert_codes_data(
+            data, size_t(1) << 20);
+    EXPECT_LT(narrow.value.size(), 120 * sizeof(uint16_t) + 8);
+    EXPECT_GT(wide.value.size(), 120 * sizeof(uint32_t));
+    EXPECT_LT(wide.value.size(), 120 * sizeof(uint32_t) + 8);
+
+    for (auto* encoded : {&narrow, &wide}) {
+        auto decoded = std::get<lintdb::ColBERTContextData>(
+                lintdb::DocEncoder::decode_colbert_codes_data(encoded->value));
+        EXPECT_EQ(decoded.doc_codes, cd.doc_codes);
+    }
+}
+
+TEST(DocEncoder, RoundTripsInvertedMappingData) {
+    lintdb::ProcessedData data;
+    data.tenant = 0;
+    data.field = 1;
+    data.doc_id = 1;
+    data.centroid_ids = {300, 2, 70000, 2, 5};
+
+    auto result = lintdb::DocEncoder::encode_inverted_mapping_data(data);
+    ASSERT_EQ(result.size(), 1);
+
+    auto decoded =
+            lintdb::DocEncoder::decode_inverted_mapping_data(result[0].value);
+    std::vector<idx_t> expected = {2, 5, 300, 70000};
+    EXPECT_EQ(decoded, expected);
+}
+
+TEST(DocEncoder, InvertedDataStoresOnlyTheCentroidsTokens) {
+    lintdb::ProcessedData data;
+    data.value.data_type = lintdb::DataType::QUANTIZED_TENSOR;
+    data.value.num_tensors = 3;
+    data.centroid_ids = {7, 9, 7};
+    data.tenant = 0;
+    data.field = 1;
+    data.doc_id = 1;
+    data.value.value = lintdb::QuantizedTensor{1, 2, 3, 4, 5, 6};
+
+    auto result = lintdb::DocEncoder::encode_inverted_data(data, 2);
+    ASSERT_EQ(result.size(), 2);
+
+    // postings are ordered by centroid, so centroid 7 comes first.
+    std::vector<idx_t> token_ids;
+    auto codes = std::get<lintdb::QuantizedTensor>(
+            lintdb::DocEncoder::decode_inverted_data(
+                    result[0].value, &token_ids));
+    EXPECT_EQ(codes, lintdb::QuantizedTensor({1, 2, 5, 6}));
+    EXPECT_EQ(token_ids, std::vector<idx_t>({0, 2}));
+
+    token_ids.clear();
+    codes = std::get<lintdb::QuantizedTensor>(
+            lintdb::DocEncoder::decode_inverted_data(
+                    result[1].value, &token_ids));
+    EXPECT_EQ(codes, lintdb::QuantizedTensor({3, 4}));
+    EXPECT_EQ(token_ids, std::vector<idx_t>({1}));
+}
+
+TEST(DocEncoder, InvertedDataStoresRawTensorTokens) {
+    lintdb::ProcessedData data;
+    data.value.data_type = lintdb::DataType::TENSOR;
+    data.value.num_tensors = 2;
+    data.centroid_ids = {4, 3};
+    data.tenant = 0;
+    data.field = 1;
+    data.doc_id = 1;
+    data.value.value = lintdb::Tensor{1, 2, 3, 4, 5, 6};
+
+    // the code size doesn't apply to raw tensors.
+    auto result = lintdb::DocEncoder::encode_inverted_data(data, 1);
+    ASSERT_EQ(result.size(), 2);
+
+    std::vector<idx_t> token_ids;
+    auto values = std::get<lintdb::Tensor>(
+            lintdb::DocEncoder::decode_inverted_data(
+                    result[0].value, &token_ids));
+    EXPECT_EQ(values, lintdb::Tensor({4, 5, 6}));
+    EXPECT_EQ(token_ids, std::vector<idx_t>({1}));
+}
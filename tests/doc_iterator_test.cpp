@@ -1,6 +1,7 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 #include <memory>
+#include <numeric>
 #include "lintdb/query/DocIterator.h"
 #include "lintdb/invlists/Iterator.h"
 #include "lintdb/schema/DocEncoder.h"
@@ -8,6 +9,7 @@
 #include "lintdb/query/KnnNearestCentroids.h"
 #include "lintdb/scoring/scoring_methods.h"
 #include "lintdb/scoring/ContextCollector.h"
+#include "mocks.h"
 
 using namespace lintdb;
 
@@ -44,6 +46,33 @@ private:
     std::vector<idx_t> its;
 };
 
+// SeekingVectorIterator overrides advance_to and counts how many keys it visits.
+class SeekingVectorIterator: public VectorIterator {
+public:
+    SeekingVectorIterator(std::vector<idx_t> its, size_t* steps): VectorIterator(its), ids(its), steps(steps) {}
+
+    void next() override {
+        (*steps)++;
+        VectorIterator::next();
+        pos++;
+    }
+
+    void advance_to(const idx_t doc_id) override {
+        auto it = std::lower_bound(ids.begin() + pos, ids.end(), doc_id);
+        size_t target = it - ids.begin();
+        while (pos < target) {
+            VectorIterator::next();
+            pos++;
+        }
+        (*steps)++;
+    }
+
+private:
+    std::vector<idx_t> ids;
+    size_t pos = 0;
+    size_t* steps;
+};
+
 class MockIterator : public Iterator {
 public:
     MOCK_METHOD(bool, is_valid, (), (override));
@@ -52,6 +81,35 @@ public:
     MOCK_METHOD(std::string, get_value, (), (const, override));
 };
 
+// DeferredIterator walks doc ids and defers one field per document.
+class DeferredIterator: public DocIterator {
+public:
+    DeferredIterator(std::vector<idx_t> ids, uint8_t field_id): ids(ids), field_id(field_id) {}
+
+    void advance() override { pos++; }
+    bool is_valid() override { return pos < ids.size(); }
+    idx_t doc_id() const override { return ids[pos]; }
+    std::vector<DocValue> fields() const override { return {}; }
+    ScoredDocument score(std::vector<DocValue> fields) const override {
+        return ScoredDocument(score_value, 0, fields);
+    }
+
+    std::vector<DocValue> deferred_fields(const idx_t doc_id) const override {
+        return {DocValue(SupportedTypes(int(doc_id)), field_id, DataType::INTEGER)};
+    }
+    void prefetch_deferred_fields(const std::vector<idx_t>& doc_ids) override {
+        prefetched.insert(prefetched.end(), doc_ids.begin(), doc_ids.end());
+    }
+
+    std::vector<idx_t> prefetched;
+    score_t score_value = 0;
+
+private:
+    std::vector<idx_t> ids;
+    uint8_t field_id;
+    size_t pos = 0;
+};
+
 class ANNIteratorTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -194,4 +252,227 @@ TEST_F(AndIteratorTest, SynchronizedAdvancement2) {
     EXPECT_EQ(andIt.doc_id(), 7);
     andIt.advance();
     EXPECT_FALSE(andIt.is_valid());
-}
\ No newline at end of file
+}
+
+TEST_F(AndIteratorTest, LeapfrogsUsingAdvanceTo) {
+    std::vector<idx_t> large(10000);
+    std::iota(large.begin(), large.end(), 0);
+    size_t large_steps = 0;
+    size_t small_steps = 0;
+
+    std::vector<std::unique_ptr<DocIterator>> iterators;
+    iterators.push_back(std::make_unique<TermIterator>(std::make_unique<SeekingVectorIterator>(large, &large_steps), lintdb::DataType::INTEGER, lintdb::UnaryScoringMethod::ONE));
+    iterators.push_back(std::make_unique<TermIterator>(std::make_unique<SeekingVectorIterator>(std::vector<idx_t>({10, 5000, 9000}), &small_steps), lintdb::DataType::INTEGER, lintdb::UnaryScoringMethod::ONE));
+    AndIterator andIt(std::move(iterators), lintdb::NaryScoringMethod::SUM);
+
+    std::vector<idx_t> results;
+    for (; andIt.is_valid(); andIt.advance()) {
+        results.push_back(andIt.doc_id());
+    }
+
+    EXPECT_EQ(results, std::vector<idx_t>({10, 5000, 9000}));
+    // the large list should only be touched a handful of times per match.
+    EXPECT_LT(large_steps, 20);
+}
+
+TEST_F(ANNIteratorTest, AdvanceToSkipsAcrossLists) {
+    std::vector<std::unique_ptr<DocIterator>> iterators;
+    iterators.push_back(std::make_unique<TermIterator>(std::make_unique<VectorIterator>(std::vector<idx_t>{1, 4, 9}), lintdb::DataType::TENSOR, lintdb::UnaryScoringMethod::ONE));
+    iterators.push_back(std::make_unique<TermIterator>(std::make_unique<VectorIterator>(std::vector<idx_t>{2, 3, 7}), lintdb::DataType::TENSOR, lintdb::UnaryScoringMethod::ONE));
+    std::shared_ptr<KnnNearestCentroids> knn;
+    ContextCollector context;
+    ANNIterator ann(std::move(iterators), std::move(context), knn, lintdb::EmbeddingScoringMethod::PLAID);
+
+    ann.advance_to(5);
+    EXPECT_TRUE(ann.is_valid());
+    EXPECT_EQ(ann.doc_id(), 7);
+    ann.advance();
+    EXPECT_EQ(ann.doc_id(), 9);
+    ann.advance_to(10);
+    EXPECT_FALSE(ann.is_valid());
+}
+
+TEST_F(ANNIteratorTest, WANDIteratorReturnsAllDocumentsWithoutThreshold) {
+    std::vector<std::unique_ptr<DocIterator>> iterators;
+    iterators.push_back(std::make_unique<TermIterator>(std::make_unique<VectorIterator>(std::vector<idx_t>{1, 4, 9}), lintdb::DataType::TENSOR, lintdb::UnaryScoringMethod::ONE));
+    iterators.push_back(std::make_unique<TermIterator>(std::make_unique<VectorIterator>(std::vector<idx_t>{2, 4, 7}), lintdb::DataType::TENSOR, lintdb::UnaryScoringMethod::ONE));
+    std::shared_ptr<KnnNearestCentroids> knn;
+    ContextCollector context;
+    WANDIterator wand(std::move(iterators), {1.0, 1.0}, 0, std::move(context), knn, lintdb::EmbeddingScoringMethod::PLAID);
+
+    std::vector<idx_t> doc_ids;
+    for (; wand.is_valid(); wand.advance()) {
+        doc_ids.push_back(wand.doc_id());
+    }
+    EXPECT_EQ(doc_ids, std::vector<idx_t>({1, 2, 4, 7, 9}));
+}
+
+TEST_F(ANNIteratorTest, WANDIteratorSkipsDocumentsBelowThreshold) {
+    std::vector<idx_t> common(100);
+    std::iota(common.begin(), common.end(), 1);
+    size_t common_steps = 0;
+    size_t rare_steps = 0;
+
+    std::vector<std::unique_ptr<DocIterator>> iterators;
+    iterators.push_back(std::make_unique<TermIterator>(std::make_unique<SeekingVectorIterator>(common, &common_steps), lintdb::DataType::TENSOR, lintdb::UnaryScoringMethod::ONE));
+    iterators.push_back(std::make_unique<TermIterator>(std::make_unique<SeekingVectorIterator>(std::vector<idx_t>({50, 90}), &rare_steps), lintdb::DataType::TENSOR, lintdb::UnaryScoringMethod::ONE));
+    std::shared_ptr<KnnNearestCentroids> knn;
+    ContextCollector context;
+    WANDIterator wand(std::move(iterators), {1.0, 5.0}, 0, std::move(context), knn, lintdb::EmbeddingScoringMethod::PLAID);
+
+    EXPECT_EQ(wand.doc_id(), 1);
+
+    // only documents in the rare list can score above 2.
+    wand.set_score_threshold(2.0);
+    wand.advance();
+
+    std::vector<idx_t> doc_ids;
+    for (; wand.is_valid(); wand.advance()) {
+        doc_ids.push_back(wand.doc_id());
+    }
+    EXPECT_EQ(doc_ids, std::vector<idx_t>({50, 90}));
+    EXPECT_LT(common_steps, 10);
+}
+
+TEST_F(ANNIteratorTest, PlaidAccumulatorScoresFromPostings) {
+    auto quantizer = std::make_shared<MockCoarseQuantizer>();
+    EXPECT_CALL(*quantizer, num_centroids()).WillRepeatedly(testing::Return(3));
+    // two query tokens. scores are sorted per token.
+    EXPECT_CALL(*quantizer, search(2, testing::_, 3, testing::_, testing::_))
+            .WillOnce([](size_t, const float*, size_t, float* distances, idx_t* coarse_idx) {
+                std::vector<float> d = {0.9, 0.5, 0.1, 0.8, 0.3, 0.2};
+                std::vector<idx_t> c = {0, 1, 2, 1, 2, 0};
+                std::copy(d.begin(), d.end(), distances);
+                std::copy(c.begin(), c.end(), coarse_idx);
+            });
+    std::vector<float> query(4, 0);
+    auto knn = std::make_shared<KnnNearestCentroids>();
+    knn->calculate(query, 2, quantizer, 3);
+
+    std::vector<std::pair<idx_t, std::unique_ptr<Iterator>>> lists;
+    lists.emplace_back(0, std::make_unique<VectorIterator>(std::vector<idx_t>{1, 3}));
+    lists.emplace_back(1, std::make_unique<VectorIterator>(std::vector<idx_t>{3}));
+    ContextCollector context;
+    PlaidAccumulatorIterator it(std::move(lists), 0, std::move(context), knn);
+
+    ASSERT_TRUE(it.is_valid());
+    EXPECT_EQ(it.doc_id(), 1);
+    EXPECT_NEAR(it.score(it.fields()).score, 0.9 + 0.2, 1e-5);
+    it.advance();
+    EXPECT_EQ(it.doc_id(), 3);
+    EXPECT_NEAR(it.score(it.fields()).score, 0.9 + 0.8, 1e-5);
+    it.advance();
+    EXPECT_FALSE(it.is_valid());
+}
+
+TEST_F(ANNIteratorTest, PlaidAccumulatorKeepsNegativeScores) {
+    auto quantizer = std::make_shared<MockCoarseQuantizer>();
+    EXPECT_CALL(*quantizer, num_centroids()).WillRepeatedly(testing::Return(2));
+    // the second query token only has negative centroid scores.
+    EXPECT_CALL(*quantizer, search(2, testing::_, 2, testing::_, testing::_))
+            .WillOnce([](size_t, const float*, size_t, float* distances, idx_t* coarse_idx) {
+                std::vector<float> d = {0.9, 0.5, -0.2, -0.6};
+                std::vector<idx_t> c = {0, 1, 1, 0};
+                std::copy(d.begin(), d.end(), distances);
+                std::copy(c.begin(), c.end(), coarse_idx);
+            });
+    std::vector<float> query(4, 0);
+    auto knn = std::make_shared<KnnNearestCentroids>();
+    knn->calculate(query, 2, quantizer, 2);
+
+    std::vector<std::pair<idx_t, std::unique_ptr<Iterator>>> lists;
+    lists.emplace_back(0, std::make_unique<VectorIterator>(std::vector<idx_t>{1}));
+    ContextCollector context;
+    PlaidAccumulatorIterator it(std::move(lists), 0, std::move(context), knn);
+
+    ASSERT_TRUE(it.is_valid());
+    const float expected = colbert_centroid_score({0}, *knn);
+    EXPECT_NEAR(expected, 0.9 - 0.6, 1e-5);
+    EXPECT_NEAR(it.score(it.fields()).score, expected, 1e-5);
+}
+
+TEST_F(AndIteratorTest, ForwardsDeferredFields) {
+    auto first = std::make_unique<DeferredIterator>(std::vector<idx_t>{1, 2}, 0);
+    auto second = std::make_unique<DeferredIterator>(std::vector<idx_t>{2, 3}, 1);
+    DeferredIterator* first_ptr = first.get();
+    std::vector<std::unique_ptr<DocIterator>> its;
+    its.push_back(std::move(first));
+    its.push_back(std::move(second));
+    AndIterator it(std::move(its), NaryScoringMethod::SUM);
+
+    ASSERT_TRUE(it.is_valid());
+    EXPECT_EQ(it.doc_id(), 2);
+    it.prefetch_deferred_fields({2});
+    EXPECT_EQ(first_ptr->prefetched, std::vector<idx_t>({2}));
+
+    auto deferred = it.deferred_fields(2);
+    ASSERT_EQ(deferred.size(), 2);
+    EXPECT_EQ(deferred[0].field_id, 0);
+    EXPECT_EQ(deferred[1].field_id, 1);
+}
+
+TEST(OrIteratorTest, ForwardsDeferredFieldsAfterFinishing) {
+    auto first = std::make_unique<DeferredIterator>(std::vector<idx_t>{1}, 0);
+    auto second = std::make_unique<DeferredIterator>(std::vector<idx_t>{2}, 1);
+    std::vector<std::unique_ptr<DocIterator>> its;
+    its.push_back(std::move(first));
+    its.push_back(std::move(second));
+    OrIterator it(std::move(its), NaryScoringMethod::SUM);
+
+    // deferred fields are read once every child ran out.
+    while (it.is_valid()) {
+        it.advance();
+    }
+    EXPECT_EQ(it.deferred_fields(1).size(), 2);
+}
+
+TEST(OrIteratorTest, ScoresEveryChildAfterFinishing) {
+    auto first = std::make_unique<DeferredIterator>(std::vector<idx_t>{1}, 0);
+    first->score_value = 1;
+    auto second =
+            std::make_unique<DeferredIterator>(std::vector<idx_t>{1, 2}, 1);
+    second->score_value = 2;
+    std::vector<std::unique_ptr<DocIterator>> its;
+    its.push_back(std::move(first));
+    its.push_back(std::move(second));
+    OrIterator it(std::move(its), NaryScoringMethod::SUM);
+
+    ASSERT_TRUE(it.is_valid());
+    EXPECT_EQ(it.doc_id(), 1);
+    EXPECT_FLOAT_EQ(it.score({}).score, 3);
+
+    // the first child ran out, and still scores the second document.
+    it.advance();
+    ASSERT_TRUE(it.is_valid());
+    EXPECT_EQ(it.doc_id(), 2);
+    EXPECT_FLOAT_EQ(it.score({}).score, 3);
+}
+
+TEST(KnnNearestCentroidsTest, SparseScoresFallBackToFloor) {
+    auto quantizer = std::make_shared<MockCoarseQuantizer>();
+    EXPECT_CALL(*quantizer, num_centroids()).WillRepeatedly(testing::Return(10));
+    // keep the top 2 of 10 centroids for each of two query tokens.
+    EXPECT_CALL(*quantizer, search(2, testing::_, 2, testing::_, testing::_))
+            .WillOnce([](size_t, const float*, size_t, float* distances, idx_t* coarse_idx) {
+                std::vector<float> d = {0.9, 0.4, 0.7, 0.3};
+                std::vector<idx_t> c = {5, 1, 1, 8};
+                std::copy(d.begin(), d.end(), distances);
+                std::copy(c.begin(), c.end(), coarse_idx);
+            });
+    std::vector<float> query(4, 0);
+    KnnNearestCentroids knn;
+    knn.calculate(query, 2, quantizer, 2);
+
+    EXPECT_TRUE(knn.is_sparse());
+    const float* five = knn.get_centroid_scores(5);
+    EXPECT_FLOAT_EQ(five[0], 0.9);
+    EXPECT_FLOAT_EQ(five[1], 0.3); // floor for the second token.
+    const float* one = knn.get_centroid_scores(1);
+    EXPECT_FLOAT_EQ(one[0], 0.4);
+    EXPECT_FLOAT_EQ(one[1], 0.7);
+    const float* missing = knn.get_centroid_scores(3);
+    EXPECT_FLOAT_EQ(missing[0], 0.4);
+    EXPECT_FLOAT_EQ(missing[1], 0.3);
+
+    EXPECT_FLOAT_EQ(colbert_centroid_score({5, 3}, knn), 0.9 + 0.3);
+}
@@ -126,4 +126,88 @@ TEST(DocumentProcessor, ProcessDocumentWithTensorField) {
     EXPECT_CALL(*mockQuantizer, sa_encode(_, _ , _)).Times(1);
 
     processor.processDocument(1, document);
-}
\ No newline at end of file
+}
+TEST(DocumentProcessor, ProcessDocumentsEncodesBatchesInOneCall) {
+    std::unique_ptr<MockIndexWriter> mockIndexWriter = std::make_unique<MockIndexWriter>();
+    MockIndexWriter* writer = mockIndexWriter.get();
+    auto mockQuantizer = std::make_shared<MockQuantizer>();
+    auto mockCoarseQuantizer = std::make_shared<MockCoarseQuantizer>();
+
+    std::shared_ptr<lintdb::FieldMapper> fieldMapper = std::make_shared<lintdb::FieldMapper>();
+    lintdb::Schema schema;
+    lintdb::Field field1 = {"field1", lintdb::DataType::TENSOR, {lintdb::FieldType::Indexed}, {2, "", lintdb::QuantizerType::PRODUCT_ENCODER}};
+    schema.fields.push_back(field1);
+
+    fieldMapper->addSchema(schema);
+
+    std::unordered_map<std::string, std::shared_ptr<lintdb::Quantizer>> quantizerMap = {{"field1", mockQuantizer}};
+    std::unordered_map<std::string, std::shared_ptr<lintdb::ICoarseQuantizer>> coarseQuantizerMap = {{"field1", mockCoarseQuantizer}};
+
+    lintdb::DocumentProcessor processor(schema, quantizerMap, coarseQuantizerMap, fieldMapper, std::move(mockIndexWriter));
+
+    std::vector<lintdb::Document> documents = {
+            lintdb::Document(1, {lintdb::FieldValue("field1", lintdb::Tensor{1, 2, 3, 4}, 2)}),
+            lintdb::Document(2, {lintdb::FieldValue("field1", lintdb::Tensor{5, 6}, 1)}),
+            lintdb::Document(3, {lintdb::FieldValue("field1", lintdb::Tensor{7, 8, 9, 10, 11, 12}, 3)})
+    };
+
+    EXPECT_CALL(*mockQuantizer, code_size()).WillRepeatedly(Return(1));
+    EXPECT_CALL(*mockCoarseQuantizer, is_trained()).WillRepeatedly(Return(true));
+
+    // the batch's tokens are assigned and encoded with one call each, and
+    // the results are written at each document's offset in the batch.
+    std::vector<float> assigned;
+    EXPECT_CALL(*mockCoarseQuantizer, assign(6, _, _))
+            .WillOnce([&](size_t n, const float* x, idx_t* codes) {
+                assigned.assign(x, x + n * 2);
+                for (size_t i = 0; i < n; i++) {
+                    codes[i] = x[i * 2];
+                }
+            });
+    std::vector<float> encoded;
+    EXPECT_CALL(*mockQuantizer, sa_encode(6, _, _))
+            .WillOnce([&](size_t n, const float* x, residual_t* codes) {
+                encoded.assign(x, x + n * 2);
+            });
+    EXPECT_CALL(*writer, write(_))
+            .WillOnce([](const lintdb::BatchPostingData& data) {
+                EXPECT_EQ(data.forward.size(), 3);
+                EXPECT_EQ(data.inverted_mapping.size(), 3);
+            });
+
+    processor.processDocuments(1, documents);
+
+    std::vector<float> tokens = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
+    EXPECT_EQ(assigned, tokens);
+    EXPECT_EQ(encoded, tokens);
+}
+
+TEST(DocumentProcessor, BorrowsTensorViews) {
+    std::unique_ptr<MockIndexWriter> mockIndexWriter = std::make_unique<MockIndexWriter>();
+    auto mockQuantizer = std::make_shared<MockQuantizer>();
+    auto mockCoarseQuantizer = std::make_shared<MockCoarseQuantizer>();
+
+    std::shared_ptr<lintdb::FieldMapper> fieldMapper = std::make_shared<lintdb::FieldMapper>();
+    lintdb::Schema schema;
+    lintdb::Field field1 = {"field1", lintdb::DataType::TENSOR, {lintdb::FieldType::Indexed}, {2, "", lintdb::QuantizerType::PRODUCT_ENCODER}};
+    schema.fields.push_back(field1);
+
+    fieldMapper->addSchema(schema);
+
+    std::unordered_map<std::string, std::shared_ptr<lintdb::Quantizer>> quantizerMap = {{"field1", mockQuantizer}};
+    std::unordered_map<std::string, std::shared_ptr<lintdb::ICoarseQuantizer>> coarseQuantizerMap = {{"field1", mockCoarseQuantizer}};
+
+    lintdb::DocumentProcessor processor(schema, quantizerMap, coarseQuantizerMap, fieldMapper, std::move(mockIndexWriter));
+
+    std::vector<float> embeddings = {1, 2, 3, 4};
+    lintdb::Document document(1, {lintdb::FieldValue("field1", lintdb::TensorView(embeddings), 2)});
+
+    EXPECT_CALL(*mockQuantizer, code_size()).WillRepeatedly(Return(1));
+    EXPECT_CALL(*mockCoarseQuantizer, is_trained()).WillRepeatedly(Return(true));
+
+    // the quantizers read the caller's memory directly.
+    EXPECT_CALL(*mockCoarseQuantizer, assign(2, embeddings.data(), _)).Times(1);
+    EXPECT_CALL(*mockQuantizer, sa_encode(2, embeddings.data(), _)).Times(1);
+
+    processor.processDocument(1, document);
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <set>
+#include "lintdb/quantizers/EmbeddingSource.h"
+#include "util.h"
+
+using namespace lintdb;
+
+TEST(ReservoirSamplerTest, KeepsAUniqueSample) {
+    ReservoirSampler sampler(2, 100);
+    std::vector<float> embeddings;
+    for (size_t i = 0; i < 1000; i++) {
+        embeddings.push_back(i);
+        embeddings.push_back(i);
+    }
+    // the embeddings are offered in chunks, like a stream.
+    for (size_t i = 0; i < embeddings.size(); i += 200) {
+        sampler.add(gsl::span<const float>(embeddings.data() + i, 200));
+    }
+
+    EXPECT_EQ(sampler.num_seen(), 1000);
+    ASSERT_EQ(sampler.size(), 100);
+
+    std::set<float> seen;
+    float max_seen = 0;
+    for (size_t i = 0; i < sampler.size(); i++) {
+        seen.insert(sampler.embeddings()[i * 2]);
+        max_seen = std::max(max_seen, sampler.embeddings()[i * 2]);
+    }
+    EXPECT_EQ(seen.size(), 100);
+    // later embeddings get into the sample too.
+    EXPECT_GT(max_seen, 500);
+
+    auto subset = sampler.subsample(10);
+    EXPECT_EQ(subset.size(), 20);
+    EXPECT_EQ(std::set<float>(subset.begin(), subset.end()).size(), 10);
+}
+
+TEST(ReservoirSamplerTest, KeepsEverythingBelowCapacity) {
+    ReservoirSampler sampler(1, 100);
+    std::vector<float> embeddings = {1, 2, 3};
+    sampler.add(embeddings);
+
+    EXPECT_EQ(sampler.embeddings(), embeddings);
+    EXPECT_THROW(
+            ReservoirSampler(2, 10).add(embeddings), LintDBException);
+}
+
+TEST(EmbeddingSourceTest, ReadsNpyInChunks) {
+    auto dir = create_temporary_directory();
+    std::string path = (dir / "embeddings.npy").string();
+    std::vector<float> data;
+    for (size_t i = 0; i < 10 * 4; i++) {
+        data.push_back(i);
+    }
+    write_npy(path, data, 4);
+
+    {
+        NpyEmbeddingSource source(path, 3);
+        EXPECT_EQ(source.size(), 10);
+        EXPECT_EQ(source.dimensions(), 4);
+
+        std::vector<float> read;
+        std::vector<size_t> chunk_sizes;
+        gsl::span<const float> chunk;
+        while (source.next(chunk)) {
+            chunk_sizes.push_back(chunk.size() / 4);
+            read.insert(read.end(), chunk.begin(), chunk.end());
+        }
+        EXPECT_EQ(read, data);
+        EXPECT_EQ(chunk_sizes, std::vector<size_t>({3, 3, 3, 1}));
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(EmbeddingSourceTest, SkipsDocumentsWithoutTheField) {
+    std::vector<Document> docs = {
+            Document(0, {FieldValue("colbert", Tensor{1, 2}, 1)}),
+            Document(1, {FieldValue("other", 1)}),
+            Document(2, {FieldValue("colbert", Tensor{3, 4}, 1)})};
+    DocumentEmbeddingSource source(docs, "colbert");
+
+    gsl::span<const float> chunk;
+    ASSERT_TRUE(source.next(chunk));
+    EXPECT_EQ(chunk[0], 1);
+    ASSERT_TRUE(source.next(chunk));
+    EXPECT_EQ(chunk[0], 3);
+    EXPECT_FALSE(source.next(chunk));
+}
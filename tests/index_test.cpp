@@ -2,8 +2,15 @@
 // TODO(mbarta): we introspect the invlists during tests. We can fix this with
 // better abstractions.
 #define private public
+#include <bitsery/adapter/buffer.h>
+#include <bitsery/bitsery.h>
+#include <rocksdb/db.h>
+#include <map>
+#include <random>
 #include "lintdb/SearchOptions.h"
 #include "lintdb/index.h"
+#include "lintdb/invlists/KeyBuilder.h"
+#include "lintdb/schema/DocEncoder.h"
 #include "lintdb/util.h"
 #include "util.h"
 #include "lintdb/schema/Schema.h"
@@ -152,6 +159,58 @@ TEST_P(IndexTest, TrainsCorrectly) {
     EXPECT_EQ(index.quantizer_map.size(),  1);
 }
 
+TEST_P(IndexTest, TrainsFromNpy) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema = create_colbert_schema(type);
+    lintdb::IndexIVF index(
+            temp_db.string(), schema, config);
+
+    std::vector<float> embeddings;
+    for (const auto& doc : create_colbert_documents(20, 10, 128)) {
+        auto tensor = doc.fields[0].tensor();
+        embeddings.insert(embeddings.end(), tensor.begin(), tensor.end());
+    }
+    std::string npy_path = temp_db.string() + "/embeddings.npy";
+    write_npy(npy_path, embeddings, 128);
+
+    lintdb::NpyEmbeddingSource source(npy_path, 16);
+    lintdb::TrainingOptions options;
+    // a sample smaller than the file.
+    options.max_embeddings = 100;
+    options.max_quantizer_embeddings = 50;
+    index.train_field("colbert", source, options);
+
+    EXPECT_TRUE(index.coarse_quantizer_map["colbert"]->is_trained());
+    EXPECT_EQ(index.quantizer_map.size(), 1);
+
+    lintdb::NpyEmbeddingSource unknown(npy_path);
+    EXPECT_THROW(index.train_field("unknown", unknown), lintdb::LintDBException);
+}
+
+TEST_P(IndexTest, TrainFieldRejectsMismatchedEmbeddings) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema =
+            create_colbert_schema(type, 10, {lintdb::DataType::INTEGER});
+    lintdb::IndexIVF index(temp_db.string(), schema, config);
+
+    // the colbert field has 128 dimensions.
+    std::vector<float> embeddings(100 * 64, 0.5);
+    std::string npy_path = temp_db.string() + "/embeddings.npy";
+    write_npy(npy_path, embeddings, 64);
+
+    lintdb::NpyEmbeddingSource source(npy_path);
+    EXPECT_THROW(index.train_field("colbert", source), lintdb::LintDBException);
+    EXPECT_FALSE(index.coarse_quantizer_map["colbert"]->is_trained());
+
+    // integer fields don't have quantizers to train.
+    lintdb::NpyEmbeddingSource filter(npy_path);
+    EXPECT_THROW(index.train_field("filter0", filter), lintdb::LintDBException);
+}
+
 TEST_P(IndexTest, SearchCorrectly) {
     temp_db = create_temporary_directory();
 
@@ -194,6 +253,76 @@ TEST_P(IndexTest, SearchCorrectly) {
 
 }
 
+TEST_P(IndexTest, SubmittedDocumentsAreSearchableAfterFlush) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema = create_colbert_schema(type, 10);
+    lintdb::IndexIVF index(temp_db.string(), schema, config);
+    // several encode threads can finish batches out of order.
+    index.ingestion_options.batch_size = 1;
+    index.ingestion_options.encode_threads = 4;
+
+    auto training_docs = create_colbert_documents(400, 10, 128);
+    index.train(training_docs);
+
+    index.submit(1, create_colbert_documents(5, 10, 128));
+    index.add(1, create_colbert_documents(3, 10, 128));
+    index.flush();
+
+    lintdb::FieldValue fv("colbert", std::vector<float>(1280, 1), 10);
+    lintdb::Query query(std::make_unique<lintdb::VectorQueryNode>(fv));
+    lintdb::SearchOptions opt;
+    opt.n_probe = 100;
+    opt.k_top_centroids = 10;
+
+    // ids 0-2 were submitted, then added again. Both are in the index once.
+    auto results = index.search(1, query, 10, opt);
+    std::set<idx_t> ids;
+    for (const auto& result : results) {
+        ids.insert(result.id);
+    }
+    EXPECT_EQ(ids, std::set<idx_t>({0, 1, 2, 3, 4}));
+}
+
+TEST_P(IndexTest, SearchBatchMatchesSearch) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema = create_colbert_schema(type, 10);
+    lintdb::IndexIVF index(
+            temp_db.string(), schema, config);
+
+    auto training_docs = create_colbert_documents(400, 10, 128);
+    index.train(training_docs);
+
+    auto docs = create_colbert_documents(10, 10, 128);
+    index.add(1, docs);
+
+    std::vector<lintdb::Query> queries;
+    for (size_t i = 0; i < 3; i++) {
+        lintdb::FieldValue fv("colbert", std::get<lintdb::Tensor>(docs[i].fields[0].value), 10);
+        queries.emplace_back(std::make_unique<lintdb::VectorQueryNode>(fv));
+    }
+
+    lintdb::SearchOptions opt;
+    opt.n_probe = 100;
+    opt.k_top_centroids = 10;
+    opt.search_batch_size = 2;
+
+    auto batch_results = index.search_batch(1, queries, 5, opt);
+    ASSERT_EQ(batch_results.size(), queries.size());
+
+    for (size_t i = 0; i < queries.size(); i++) {
+        auto results = index.search(1, queries[i], 5, opt);
+        ASSERT_EQ(batch_results[i].size(), results.size());
+        // documents can tie, so we compare scores by rank.
+        for (size_t j = 0; j < results.size(); j++) {
+            EXPECT_NEAR(batch_results[i][j].score, results[j].score, 1e-4);
+        }
+    }
+}
+
 TEST_P(IndexTest, SearchCorrectlyWithFilter) {
     temp_db = create_temporary_directory();
 
@@ -320,6 +449,37 @@ TEST_P(IndexTest, SearchCorrectlyWithFilter) {
     EXPECT_EQ(text_results_two.size(), 0) << "should not find any results for a non-existent text filter";
 }
 
+TEST_P(IndexTest, AccumulatesCentroidScoresUnderAnd) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema =
+            create_colbert_schema(type, 10, {lintdb::DataType::TEXT});
+    lintdb::IndexIVF index(temp_db.string(), schema, config);
+    index.train(create_colbert_documents(400, 10, 128));
+    index.add(1, create_colbert_documents(10, 10, 128, {lintdb::DataType::TEXT}));
+
+    lintdb::FieldValue fv("colbert", std::vector<float>(1280, 1), 10);
+    lintdb::FieldValue text_value("filter0", "test");
+    std::vector<std::unique_ptr<lintdb::QueryNode>> children;
+    children.push_back(std::make_unique<lintdb::VectorQueryNode>(fv));
+    children.push_back(std::make_unique<lintdb::TermQueryNode>(text_value));
+    lintdb::Query query(
+            std::make_unique<lintdb::AndQueryNode>(std::move(children)));
+
+    lintdb::SearchOptions opt;
+    opt.n_probe = 100;
+    opt.k_top_centroids = 100;
+    opt.accumulate_centroid_scores = true;
+
+    // the reranker gets the ColBERT context the accumulator deferred.
+    auto results = index.search(1, query, 10, opt);
+    ASSERT_EQ(results.size(), 10);
+    for (const auto& result : results) {
+        EXPECT_GT(result.score, 0) << "id: " << result.id;
+    }
+}
+
 TEST_P(IndexTest, LoadsCorrectly) {
     temp_db = create_temporary_directory();
 
@@ -397,6 +557,361 @@ TEST_P(IndexTest, MergeCorrectly) {
     EXPECT_EQ(results.size(), 2);
 }
 
+TEST_P(IndexTest, MergesManyIndexes) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema = create_colbert_schema(type);
+    lintdb::IndexIVF index(temp_db.string(), schema, config);
+
+    auto docs = create_colbert_documents(400, 10, 128);
+    index.train(docs);
+    index.add(1, {docs[0]});
+    index.save();
+
+    // copies share the trained quantizers, so each can add a document.
+    temp_db_two = create_temporary_directory();
+    auto temp_db_three = create_temporary_directory();
+    lintdb::IndexIVF index_two(index, temp_db_two.string());
+    index_two.add(1, {docs[1]});
+    lintdb::IndexIVF index_three(index, temp_db_three.string());
+    index_three.add(1, {docs[2]});
+    index_two.close();
+    index_three.close();
+
+    index.merge(std::vector<std::string>{
+            temp_db_two.string(), temp_db_three.string()});
+
+    auto opts = lintdb::SearchOptions();
+    opts.n_probe = 100;
+    opts.k_top_centroids = 10;
+
+    lintdb::FieldValue fv("colbert", std::vector<float>(1280, 1), 10);
+    std::unique_ptr<lintdb::VectorQueryNode> root =
+            std::make_unique<lintdb::VectorQueryNode>(fv);
+    lintdb::Query query(std::move(root));
+
+    auto results = index.search(1, query, 5, opts);
+    EXPECT_EQ(results.size(), 3);
+
+    std::filesystem::remove_all(temp_db_three);
+}
+
+TEST_P(IndexTest, MergeRejectsOverlappingDocuments) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema = create_colbert_schema(type);
+    lintdb::IndexIVF index(temp_db.string(), schema, config);
+
+    auto docs = create_colbert_documents(400, 10, 128);
+    index.train(docs);
+    index.add(1, {docs[0]});
+    index.save();
+
+    temp_db_two = create_temporary_directory();
+    auto temp_db_three = create_temporary_directory();
+    auto temp_db_four = create_temporary_directory();
+    {
+        // a document that's already in the index.
+        lintdb::IndexIVF live(index, temp_db_two.string());
+        live.add(1, {docs[0]});
+        live.close();
+        // a tombstone would hide the index's document.
+        lintdb::IndexIVF removed(index, temp_db_three.string());
+        removed.remove(1, {docs[0].id});
+        removed.close();
+        // the same document in two of the merged indexes.
+        lintdb::IndexIVF other(index, temp_db_four.string());
+        other.add(2, {docs[0]});
+        other.close();
+    }
+    EXPECT_THROW(index.merge(temp_db_two.string()), lintdb::LintDBException);
+    EXPECT_THROW(index.merge(temp_db_three.string()), lintdb::LintDBException);
+    EXPECT_THROW(
+            index.merge(std::vector<std::string>{
+                    temp_db_four.string(), temp_db_four.string()}),
+            lintdb::LintDBException);
+
+    // nothing was merged.
+    auto opts = lintdb::SearchOptions();
+    opts.n_probe = 100;
+    opts.k_top_centroids = 10;
+
+    lintdb::FieldValue fv("colbert", std::vector<float>(1280, 1), 10);
+    std::unique_ptr<lintdb::VectorQueryNode> root =
+            std::make_unique<lintdb::VectorQueryNode>(fv);
+    lintdb::Query query(std::move(root));
+    EXPECT_EQ(index.search(1, query, 5, opts).size(), 1);
+    EXPECT_EQ(index.search(2, query, 5, opts).size(), 0);
+
+    // the same id in another tenant is a different document.
+    index.merge(temp_db_four.string());
+    EXPECT_EQ(index.search(2, query, 5, opts).size(), 1);
+
+    std::filesystem::remove_all(temp_db_three);
+    std::filesystem::remove_all(temp_db_four);
+}
+
+TEST_P(IndexTest, MergeRejectsOtherPostingFormats) {
+    temp_db = create_temporary_directory();
+    temp_db_two = create_temporary_directory();
+
+    lintdb::Schema schema = create_colbert_schema(type);
+    auto docs = create_colbert_documents(400, 10, 128);
+
+    lintdb::Configuration config;
+    lintdb::IndexIVF index(temp_db.string(), schema, config);
+    index.train(docs);
+
+    lintdb::Configuration keys_config;
+    keys_config.posting_format = lintdb::PostingFormat::KEYS;
+    {
+        lintdb::IndexIVF keys_index(temp_db_two.string(), schema, keys_config);
+        keys_index.train(docs);
+        keys_index.add(1, {docs[0]});
+        keys_index.save();
+        keys_index.close();
+    }
+
+    EXPECT_THROW(index.merge(temp_db_two.string()), lintdb::LintDBException);
+}
+
+TEST_P(IndexTest, RemovesAndDropsTenants) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema = create_colbert_schema(type);
+    lintdb::IndexIVF index(temp_db.string(), schema, config);
+
+    auto docs = create_colbert_documents(400, 10, 128);
+    index.train(docs);
+    index.add(1, {docs[0], docs[1], docs[2]});
+    index.add(2, {docs[0], docs[1]});
+
+    auto opts = lintdb::SearchOptions();
+    opts.n_probe = 100;
+    opts.k_top_centroids = 10;
+
+    lintdb::FieldValue fv("colbert", std::vector<float>(1280, 1), 10);
+    std::unique_ptr<lintdb::VectorQueryNode> root =
+            std::make_unique<lintdb::VectorQueryNode>(fv);
+    lintdb::Query query(std::move(root));
+
+    index.remove(1, {docs[0].id, docs[1].id});
+    auto results = index.search(1, query, 5, opts);
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0].id, docs[2].id);
+
+    index.drop_tenant(1);
+    EXPECT_EQ(index.search(1, query, 5, opts).size(), 0);
+    // other tenants keep their documents.
+    EXPECT_EQ(index.search(2, query, 5, opts).size(), 2);
+}
+
+TEST_P(IndexTest, RemovesAreLogical) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema = create_colbert_schema(type);
+    auto docs = create_colbert_documents(400, 10, 128);
+    {
+        lintdb::IndexIVF index(temp_db.string(), schema, config);
+        index.train(docs);
+        index.add(1, {docs[0], docs[1], docs[2]});
+        index.remove(1, {docs[0].id});
+        index.save();
+        index.close();
+    }
+
+    auto opts = lintdb::SearchOptions();
+    opts.n_probe = 100;
+    opts.k_top_centroids = 10;
+
+    lintdb::FieldValue fv("colbert", std::vector<float>(1280, 1), 10);
+    std::unique_ptr<lintdb::VectorQueryNode> root =
+            std::make_unique<lintdb::VectorQueryNode>(fv);
+    lintdb::Query query(std::move(root));
+
+    // tombstones are persisted with the index.
+    lintdb::IndexIVF index(temp_db.string());
+    auto results = index.search(1, query, 5, opts);
+    ASSERT_EQ(results.size(), 2);
+    for (const auto& result : results) {
+        EXPECT_NE(result.id, docs[0].id);
+    }
+
+    // adding a removed document brings it back.
+    index.add(1, {docs[0]});
+    EXPECT_EQ(index.search(1, query, 5, opts).size(), 3);
+}
+
+TEST_P(IndexTest, CompactClearsTombstones) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema = create_colbert_schema(type);
+    lintdb::IndexIVF index(temp_db.string(), schema, config);
+
+    auto docs = create_colbert_documents(400, 10, 128);
+    index.train(docs);
+    index.add(1, {docs[0], docs[1], docs[2]});
+    index.remove(1, {docs[0].id, docs[1].id});
+
+    auto opts = lintdb::SearchOptions();
+    opts.n_probe = 100;
+    opts.k_top_centroids = 10;
+
+    lintdb::FieldValue fv("colbert", std::vector<float>(1280, 1), 10);
+    std::unique_ptr<lintdb::VectorQueryNode> root =
+            std::make_unique<lintdb::VectorQueryNode>(fv);
+    lintdb::Query query(std::move(root));
+
+    index.compact();
+    // the data is gone, so the documents stay deleted without tombstones.
+    auto results = index.search(1, query, 5, opts);
+    ASSERT_EQ(results.size(), 1);
+    EXPECT_EQ(results[0].id, docs[2].id);
+
+    // a compacted document can be added again.
+    index.add(1, {docs[0]});
+    EXPECT_EQ(index.search(1, query, 5, opts).size(), 2);
+}
+
+TEST_P(IndexTest, UpgradesWholeDocumentPostings) {
+    temp_db = create_temporary_directory();
+
+    lintdb::Configuration config;
+    lintdb::Schema schema = create_colbert_schema(type);
+    schema.fields[0].field_types = {lintdb::FieldType::Indexed};
+    lintdb::IndexIVF index(temp_db.string(), schema, config);
+
+    std::mt19937 rng(7);
+    std::normal_distribution<float> normal;
+    std::vector<lintdb::Document> docs;
+    for (idx_t i = 0; i < 40; i++) {
+        std::vector<float> vector(10 * 128);
+        for (auto& value : vector) {
+            value = normal(rng);
+        }
+        docs.emplace_back(
+                i,
+                std::vector<lintdb::FieldValue>{
+                        lintdb::FieldValue("colbert", vector, 10)});
+    }
+    index.train(docs);
+    index.add(1, {docs.begin(), docs.begin() + 5});
+    index.flush();
+
+    auto read_postings = [&]() {
+        std::map<std::string, std::string> postings;
+        auto cf = index.column_families[lintdb::kIndexColumnIndex];
+        std::unique_ptr<rocksdb::Iterator> it(
+                index.db->NewIterator(rocksdb::ReadOptions(), cf));
+        for (it->SeekToFirst(); it->Valid(); it->Next()) {
+            postings[it->key().ToString()] = it->value().ToString();
+        }
+        return postings;
+    };
+    const auto expected = read_postings();
+    ASSERT_FALSE(expected.empty());
+    auto doc_id_of = [](std::string key) {
+        return lintdb::InvertedIndexKey(key).doc_id();
+    };
+
+    // rebuild each document's codes, and write them whole to every one of its
+    // postings, like older versions did.
+    const size_t code_size = index.quantizer_map["colbert"]->code_size();
+    std::map<idx_t, lintdb::QuantizedTensor> doc_codes;
+    for (auto [key, value] : expected) {
+        std::vector<idx_t> token_ids;
+        auto codes = std::get<lintdb::QuantizedTensor>(
+                lintdb::DocEncoder::decode_inverted_data(value, &token_ids));
+        auto& doc = doc_codes[doc_id_of(key)];
+        doc.resize(10 * code_size);
+        for (size_t i = 0; i < token_ids.size(); i++) {
+            std::copy(
+                    codes.begin() + i * code_size,
+                    codes.begin() + (i + 1) * code_size,
+                    doc.begin() + token_ids[i] * code_size);
+        }
+    }
+    rocksdb::WriteBatch batch;
+    for (auto [key, value] : expected) {
+        lintdb::SupportedTypes whole =
+                doc_codes[doc_id_of(key)];
+        std::vector<uint8_t> buf;
+        auto written = bitsery::quickSerialization(
+                bitsery::OutputBufferAdapter<std::vector<uint8_t>>{buf},
+                whole);
+        batch.Put(
+                index.column_families[lintdb::kIndexColumnIndex],
+                key,
+                std::string(buf.begin(), buf.begin() + written));
+    }
+    ASSERT_TRUE(index.db->Write(rocksdb::WriteOptions(), &batch).ok());
+
+    index.upgrade_postings();
+    auto upgraded = read_postings();
+
+    // every token is in exactly one of its document's postings.
+    std::map<idx_t, std::vector<idx_t>> doc_tokens;
+    for (auto [key, value] : upgraded) {
+        EXPECT_EQ(expected.count(key), 1);
+        std::vector<idx_t> token_ids;
+        lintdb::DocEncoder::decode_inverted_data(value, &token_ids);
+        ASSERT_FALSE(token_ids.empty());
+        auto& tokens = doc_tokens[doc_id_of(key)];
+        tokens.insert(tokens.end(), token_ids.begin(), token_ids.end());
+    }
+    ASSERT_EQ(doc_tokens.size(), 5);
+    for (auto& [doc_id, tokens] : doc_tokens) {
+        std::sort(tokens.begin(), tokens.end());
+        EXPECT_EQ(tokens, std::vector<idx_t>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+    }
+    // without quantization, tokens decode exactly and land where they were.
+    if (type == lintdb::QuantizerType::NONE) {
+        EXPECT_EQ(upgraded, expected);
+    }
+}
+
+TEST(IndexCompatibilityTest, OpensAndMergesOldIndexes) {
+    // this index was written before the postings and tombstones column
+    // families existed. It's copied, since opening it read-write adds them.
+    auto old_db = create_temporary_directory();
+    std::filesystem::copy(
+            "data/colbert_test.db",
+            old_db,
+            std::filesystem::copy_options::recursive |
+                    std::filesystem::copy_options::overwrite_existing);
+
+    auto opts = lintdb::SearchOptions();
+    opts.k_top_centroids = 32;
+    lintdb::FieldValue fv("colbert", std::vector<float>(32 * 128, 0.1), 32);
+    std::unique_ptr<lintdb::VectorQueryNode> root =
+            std::make_unique<lintdb::VectorQueryNode>(fv);
+    lintdb::Query query(std::move(root));
+
+    lintdb::IndexIVF old_index(old_db.string(), true);
+    auto expected = old_index.search(0, query, 5, opts);
+    ASSERT_FALSE(expected.empty());
+
+    auto merged_db = create_temporary_directory();
+    {
+        lintdb::IndexIVF merged(old_index, merged_db.string());
+        merged.merge(old_db.string());
+
+        auto results = merged.search(0, query, 5, opts);
+        ASSERT_EQ(results.size(), expected.size());
+        for (size_t i = 0; i < results.size(); i++) {
+            EXPECT_EQ(results[i].id, expected[i].id);
+        }
+    }
+    old_index.close();
+    std::filesystem::remove_all(old_db);
+    std::filesystem::remove_all(merged_db);
+}
+
 INSTANTIATE_TEST_SUITE_P(
         IndexTest,
         IndexTest,
@@ -0,0 +1,124 @@
+#include <gtest/gtest.h>
+#include <gmock/gmock.h>
+#include <chrono>
+#include <thread>
+#include "lintdb/schema/DocProcessor.h"
+#include "lintdb/schema/IngestionPipeline.h"
+#include "lintdb/schema/Schema.h"
+#include "mocks.h"
+
+using namespace lintdb;
+using ::testing::_;
+
+namespace {
+Schema createStoredSchema() {
+    Schema schema;
+    Field field = {"intField", DataType::INTEGER, {FieldType::Stored}, {0, "", QuantizerType::NONE}};
+    schema.fields.push_back(field);
+    return schema;
+}
+
+std::vector<Document> createDocuments(size_t num_docs) {
+    std::vector<Document> documents;
+    for (size_t i = 0; i < num_docs; i++) {
+        documents.push_back(Document(i, {FieldValue("intField", int(i))}));
+    }
+    return documents;
+}
+} // namespace
+
+TEST(IngestionPipeline, GroupsWrites) {
+    auto mockIndexWriter = std::make_unique<MockIndexWriter>();
+    MockIndexWriter* writer = mockIndexWriter.get();
+    auto fieldMapper = std::make_shared<FieldMapper>();
+    auto schema = createStoredSchema();
+    fieldMapper->addSchema(schema);
+    std::unordered_map<std::string, std::shared_ptr<Quantizer>> quantizerMap;
+    std::unordered_map<std::string, std::shared_ptr<ICoarseQuantizer>> coarseQuantizerMap;
+    DocumentProcessor processor(schema, quantizerMap, coarseQuantizerMap, fieldMapper, std::move(mockIndexWriter));
+
+    size_t num_writes = 0;
+    size_t num_written = 0;
+    EXPECT_CALL(*writer, write(_))
+            .WillRepeatedly([&](const BatchPostingData& data) {
+                // a slow first write lets the other batches queue up behind it.
+                if (num_writes++ == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                }
+                num_written += data.forward.size();
+            });
+
+    IngestionOptions options;
+    options.batch_size = 1;
+    options.queue_size = 32;
+    IngestionPipeline pipeline(processor, options);
+    pipeline.submit(0, createDocuments(20));
+    pipeline.flush();
+
+    EXPECT_EQ(num_written, 20);
+    EXPECT_LT(num_writes, 20);
+}
+
+TEST(IngestionPipeline, FlushThrowsErrors) {
+    auto mockIndexWriter = std::make_unique<MockIndexWriter>();
+    MockIndexWriter* writer = mockIndexWriter.get();
+    auto fieldMapper = std::make_shared<FieldMapper>();
+    auto schema = createStoredSchema();
+    fieldMapper->addSchema(schema);
+    std::unordered_map<std::string, std::shared_ptr<Quantizer>> quantizerMap;
+    std::unordered_map<std::string, std::shared_ptr<ICoarseQuantizer>> coarseQuantizerMap;
+    DocumentProcessor processor(schema, quantizerMap, coarseQuantizerMap, fieldMapper, std::move(mockIndexWriter));
+
+    size_t num_written = 0;
+    EXPECT_CALL(*writer, write(_))
+            .WillRepeatedly([&](const BatchPostingData& data) {
+                num_written += data.forward.size();
+            });
+
+    IngestionOptions options;
+    options.batch_size = 2;
+    IngestionPipeline pipeline(processor, options);
+
+    auto documents = createDocuments(4);
+    documents.push_back(Document(4, {FieldValue("invalid_field", 1)}));
+    pipeline.submit(0, gsl::span<const Document>(documents));
+    EXPECT_THROW(pipeline.flush(), std::invalid_argument);
+    // only the batch with the invalid document is dropped.
+    EXPECT_EQ(num_written, 4);
+
+    // errors are only thrown once.
+    pipeline.submit(0, createDocuments(2));
+    pipeline.flush();
+    EXPECT_EQ(num_written, 6);
+}
+
+TEST(IngestionPipeline, WritesBatchesInOrder) {
+    auto mockIndexWriter = std::make_unique<MockIndexWriter>();
+    MockIndexWriter* writer = mockIndexWriter.get();
+    auto fieldMapper = std::make_shared<FieldMapper>();
+    auto schema = createStoredSchema();
+    fieldMapper->addSchema(schema);
+    std::unordered_map<std::string, std::shared_ptr<Quantizer>> quantizerMap;
+    std::unordered_map<std::string, std::shared_ptr<ICoarseQuantizer>> coarseQuantizerMap;
+    DocumentProcessor processor(schema, quantizerMap, coarseQuantizerMap, fieldMapper, std::move(mockIndexWriter));
+
+    std::vector<std::string> keys;
+    EXPECT_CALL(*writer, write(_))
+            .WillRepeatedly([&](const BatchPostingData& data) {
+                for (const auto& forward : data.forward) {
+                    keys.push_back(forward.key);
+                }
+            });
+
+    // batches are encoded by several threads, and can finish in any order.
+    IngestionOptions options;
+    options.batch_size = 1;
+    options.encode_threads = 4;
+    IngestionPipeline pipeline(processor, options);
+    pipeline.submit(0, createDocuments(500));
+    pipeline.flush();
+
+    ASSERT_EQ(keys.size(), 500);
+    // forward keys sort by doc id, which is the order they were submitted in.
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
@@ -6,9 +6,14 @@
 #include <iostream>
 #include <map>
 #include <memory>
+#include <set>
 #include <vector>
 #include "lintdb/cf.h"
 #include "lintdb/index.h"
+#include "lintdb/invlists/BulkIndexWriter.h"
+#include "lintdb/invlists/Segment.h"
+#include "lintdb/invlists/SegmentInvertedList.h"
+#include "lintdb/invlists/Tombstones.h"
 #include "lintdb/version.h"
 #include "util.h"
 #include "lintdb/invlists/KeyBuilder.h"
@@ -101,4 +106,381 @@ TEST_F(InvertedListTest, StoresCodesCorrectly) {
     it3->next();
     EXPECT_FALSE(it3->is_valid());
 
-}
\ No newline at end of file
+}
+TEST_F(InvertedListTest, ReadsContextsInBatch) {
+    lintdb::RocksdbInvertedList invlist(db, column_families, version);
+
+    rocksdb::WriteOptions wo;
+    for (idx_t doc_id : {3, 4, 7}) {
+        auto key = lintdb::create_context_id(0, 1, doc_id);
+        this->db->Put(
+                wo,
+                column_families[lintdb::kCodesColumnIndex],
+                key,
+                "context" + std::to_string(doc_id));
+    }
+
+    std::vector<std::string> values;
+    invlist.get_contexts(0, 1, {3, 5, 7}, values);
+
+    ASSERT_EQ(values.size(), 3);
+    EXPECT_EQ(values[0], "context3");
+    EXPECT_TRUE(values[1].empty());
+    EXPECT_EQ(values[2], "context7");
+
+    // the context iterator steps to adjacent documents and seeks past gaps.
+    auto it = invlist.get_context_iterator(0, 1);
+    it->advance(4);
+    ASSERT_TRUE(it->is_valid());
+    EXPECT_EQ(it->get_key().doc_id(), 4);
+    it->advance(6);
+    ASSERT_TRUE(it->is_valid());
+    EXPECT_EQ(it->get_key().doc_id(), 7);
+}
+
+TEST_F(InvertedListTest, IteratesBlockPostings) {
+    lintdb::RocksdbInvertedList invlist(
+            db, column_families, version, lintdb::PostingFormat::BLOCKS);
+
+    // doc ids span two block keys and several blocks.
+    std::vector<idx_t> doc_ids;
+    for (idx_t i = 0; i < 300; i++) {
+        doc_ids.push_back(i * 3);
+    }
+    const idx_t far_doc_id = idx_t(3) << lintdb::kPostingRangeBits;
+    doc_ids.push_back(far_doc_id);
+
+    rocksdb::WriteOptions wo;
+    for (const auto doc_id : doc_ids) {
+        this->db->Merge(
+                wo,
+                column_families[lintdb::kPostingsColumnIndex],
+                lintdb::create_posting_block_key(0, 1, 2, doc_id),
+                lintdb::encode_posting_operand({doc_id}, {}));
+    }
+    // removes are merge operands too.
+    this->db->Merge(
+            wo,
+            column_families[lintdb::kPostingsColumnIndex],
+            lintdb::create_posting_block_key(0, 1, 2, 6),
+            lintdb::encode_posting_operand({}, {6}));
+
+    std::string prefix = lintdb::create_index_prefix(
+            0, 1, lintdb::DataType::QUANTIZED_TENSOR, 2);
+    auto it = invlist.get_iterator(prefix);
+
+    std::vector<idx_t> expected = {0, 3, 9};
+    for (const auto doc_id : expected) {
+        ASSERT_TRUE(it->is_valid());
+        EXPECT_EQ(it->get_key().doc_id(), doc_id);
+        EXPECT_EQ(it->get_key().tenant(), 0);
+        EXPECT_EQ(it->get_value(), "");
+        it->next();
+    }
+
+    // advancing skips whole blocks, and missing ids land on the next one.
+    it->advance_to(500);
+    ASSERT_TRUE(it->is_valid());
+    EXPECT_EQ(it->get_key().doc_id(), 501);
+
+    it->advance_to(897);
+    ASSERT_TRUE(it->is_valid());
+    EXPECT_EQ(it->get_key().doc_id(), 897);
+
+    it->advance_to(898);
+    ASSERT_TRUE(it->is_valid());
+    EXPECT_EQ(it->get_key().doc_id(), far_doc_id);
+
+    it->next();
+    EXPECT_FALSE(it->is_valid());
+
+    // centroids without block lists fall back to per-document keys.
+    this->db->Put(
+            wo,
+            column_families[lintdb::kIndexColumnIndex],
+            lintdb::create_index_id(
+                    0, 1, lintdb::DataType::QUANTIZED_TENSOR, 5, 42),
+            "value");
+    auto legacy = invlist.get_iterator(lintdb::create_index_prefix(
+            0, 1, lintdb::DataType::QUANTIZED_TENSOR, 5));
+    ASSERT_TRUE(legacy->is_valid());
+    EXPECT_EQ(legacy->get_key().doc_id(), 42);
+}
+
+TEST_F(InvertedListTest, ServesExportedSegments) {
+    rocksdb::WriteOptions wo;
+    // centroid 2 has postings in both posting formats.
+    for (const idx_t doc_id : {10, 30}) {
+        this->db->Put(
+                wo,
+                column_families[lintdb::kIndexColumnIndex],
+                lintdb::create_index_id(
+                        0, 1, lintdb::DataType::QUANTIZED_TENSOR, 2, doc_id),
+                "value");
+    }
+    this->db->Merge(
+            wo,
+            column_families[lintdb::kPostingsColumnIndex],
+            lintdb::create_posting_block_key(0, 1, 2, 0),
+            lintdb::encode_posting_operand({20, 30, 40}, {}));
+    this->db->Put(
+            wo,
+            column_families[lintdb::kIndexColumnIndex],
+            lintdb::create_index_id(
+                    0, 1, lintdb::DataType::QUANTIZED_TENSOR, 3, 50),
+            "");
+    for (const idx_t doc_id : {10, 20}) {
+        this->db->Put(
+                wo,
+                column_families[lintdb::kCodesColumnIndex],
+                lintdb::create_context_id(0, 1, doc_id),
+                "codes" + std::to_string(doc_id));
+    }
+
+    std::string segment_path = temp_db.string() + "/segment";
+    lintdb::write_segment(db.get(), column_families, segment_path);
+    auto segment = std::make_shared<const lintdb::Segment>(segment_path);
+    lintdb::SegmentInvertedList invlist(segment);
+
+    auto it = invlist.get_iterator(lintdb::create_index_prefix(
+            0, 1, lintdb::DataType::QUANTIZED_TENSOR, 2));
+    std::vector<std::pair<idx_t, std::string>> expected = {
+            {10, "value"}, {20, ""}, {30, "value"}, {40, ""}};
+    for (const auto& [doc_id, value] : expected) {
+        ASSERT_TRUE(it->is_valid());
+        EXPECT_EQ(it->get_key().doc_id(), doc_id);
+        EXPECT_EQ(it->get_key().tenant(), 0);
+        EXPECT_EQ(it->get_value(), value);
+        it->next();
+    }
+    EXPECT_FALSE(it->is_valid());
+
+    it = invlist.get_iterator(lintdb::create_index_prefix(
+            0, 1, lintdb::DataType::QUANTIZED_TENSOR, 2));
+    it->advance_to(25);
+    ASSERT_TRUE(it->is_valid());
+    EXPECT_EQ(it->get_key().doc_id(), 30);
+
+    auto missing = invlist.get_iterator(lintdb::create_index_prefix(
+            0, 1, lintdb::DataType::QUANTIZED_TENSOR, 4));
+    EXPECT_FALSE(missing->is_valid());
+
+    std::vector<std::string> values;
+    invlist.get_contexts(0, 1, {10, 15, 20}, values);
+    EXPECT_EQ(values, std::vector<std::string>({"codes10", "", "codes20"}));
+    EXPECT_EQ(invlist.get_context_view(0, 1, 20), "codes20");
+
+    // visited values point into the segment's mapping.
+    std::vector<std::string_view> views(3);
+    invlist.visit_contexts(
+            0, 1, {10, 15, 20}, [&views](size_t i, std::string_view value) {
+                views[i] = value;
+            });
+    EXPECT_EQ(views[0], "codes10");
+    EXPECT_TRUE(views[1].empty());
+    EXPECT_EQ(views[2].data(), invlist.get_context_view(0, 1, 20).data());
+
+    auto contexts = invlist.get_context_iterator(0, 1);
+    contexts->advance(15);
+    ASSERT_TRUE(contexts->is_valid());
+    EXPECT_EQ(contexts->get_key().doc_id(), 20);
+    EXPECT_EQ(contexts->get_value(), "codes20");
+    contexts->next();
+    EXPECT_FALSE(contexts->is_valid());
+}
+
+TEST_F(InvertedListTest, SegmentsOnlyStoreValueOffsetsForValues) {
+    rocksdb::WriteOptions wo;
+    // centroid 2 is a ColBERT list without values. Centroid 3 gets a value
+    // after an empty posting.
+    std::vector<idx_t> doc_ids;
+    for (idx_t i = 0; i < 100; i++) {
+        doc_ids.push_back(i);
+    }
+    this->db->Merge(
+            wo,
+            column_families[lintdb::kPostingsColumnIndex],
+            lintdb::create_posting_block_key(0, 1, 2, 0),
+            lintdb::encode_posting_operand(doc_ids, {}));
+    this->db->Merge(
+            wo,
+            column_families[lintdb::kPostingsColumnIndex],
+            lintdb::create_posting_block_key(0, 1, 3, 0),
+            lintdb::encode_posting_operand({5}, {}));
+    this->db->Put(
+            wo,
+            column_families[lintdb::kIndexColumnIndex],
+            lintdb::create_index_id(
+                    0, 1, lintdb::DataType::QUANTIZED_TENSOR, 3, 7),
+            "late");
+
+    std::string segment_path = temp_db.string() + "/segment";
+    lintdb::write_segment(db.get(), column_families, segment_path);
+    auto segment = std::make_shared<const lintdb::Segment>(segment_path);
+    lintdb::SegmentInvertedList invlist(segment);
+
+    const std::string colbert_prefix = lintdb::create_index_prefix(
+            0, 1, lintdb::DataType::QUANTIZED_TENSOR, 2);
+    auto it = invlist.get_iterator(colbert_prefix);
+    for (const auto doc_id : doc_ids) {
+        ASSERT_TRUE(it->is_valid());
+        EXPECT_EQ(it->get_key().doc_id(), doc_id);
+        EXPECT_EQ(it->get_value(), "");
+        it->next();
+    }
+    EXPECT_FALSE(it->is_valid());
+
+    it = invlist.get_iterator(lintdb::create_index_prefix(
+            0, 1, lintdb::DataType::QUANTIZED_TENSOR, 3));
+    ASSERT_TRUE(it->is_valid());
+    EXPECT_EQ(it->get_key().doc_id(), 5);
+    EXPECT_EQ(it->get_value(), "");
+    it->next();
+    ASSERT_TRUE(it->is_valid());
+    EXPECT_EQ(it->get_key().doc_id(), 7);
+    EXPECT_EQ(it->get_value(), "late");
+
+    // only centroid 3's two postings have value offsets.
+    const size_t header_size = 48;
+    const size_t expected_size = header_size + 2 * 3 * sizeof(uint64_t) +
+            2 * sizeof(uint64_t) + 102 * sizeof(idx_t) +
+            3 * sizeof(uint64_t) + 2 * colbert_prefix.size() + 4;
+    EXPECT_EQ(
+            std::filesystem::file_size(segment_path + "/postings.bin"),
+            expected_size);
+}
+
+TEST_F(InvertedListTest, IngestsBulkWrites) {
+    std::string bulk_path = temp_db.string() + "/_bulk";
+    {
+        // a tiny buffer spills every write to its own run.
+        lintdb::BulkIndexWriter writer(db, column_families, bulk_path, 1);
+        for (const idx_t doc_id : {3, 1, 2}) {
+            lintdb::BatchPostingData batch;
+            auto key = lintdb::create_index_id(
+                    0, 1, lintdb::DataType::QUANTIZED_TENSOR, 2, doc_id);
+            batch.inverted.push_back({key, "value"});
+            batch.posting_blocks.push_back(
+                    {lintdb::create_posting_block_key(0, 1, 5, doc_id),
+                     lintdb::encode_posting_operand({doc_id}, {})});
+            batch.forward.push_back(
+                    {lintdb::create_forward_index_id(0, doc_id), ""});
+            writer.write(batch);
+        }
+        writer.finish();
+    }
+    EXPECT_FALSE(std::filesystem::exists(bulk_path));
+
+    lintdb::RocksdbInvertedList invlist(
+            db, column_families, version, lintdb::PostingFormat::BLOCKS);
+    for (const idx_t centroid : {2, 5}) {
+        auto it = invlist.get_iterator(lintdb::create_index_prefix(
+                0, 1, lintdb::DataType::QUANTIZED_TENSOR, centroid));
+        for (const idx_t doc_id : {1, 2, 3}) {
+            ASSERT_TRUE(it->is_valid());
+            EXPECT_EQ(it->get_key().doc_id(), doc_id);
+            it->next();
+        }
+        EXPECT_FALSE(it->is_valid());
+    }
+}
+
+TEST_F(InvertedListTest, CompactionDropsTombstonedDocs) {
+    auto tombstones = std::make_shared<lintdb::Tombstones>();
+    tombstones->add(
+            db.get(),
+            column_families[lintdb::kTombstoneColumnIndex],
+            0,
+            {2, 4});
+
+    // tombstones are read back from the database.
+    lintdb::Tombstones loaded;
+    loaded.load(db.get(), column_families[lintdb::kTombstoneColumnIndex]);
+    EXPECT_TRUE(loaded.is_deleted(0, 2));
+    EXPECT_FALSE(loaded.is_deleted(0, 3));
+    EXPECT_FALSE(loaded.is_deleted(1, 2));
+
+    rocksdb::CompactionFilter::Context context;
+    std::string new_value;
+    bool value_changed = false;
+
+    auto filter = lintdb::TombstoneFilterFactory(tombstones)
+                          .CreateCompactionFilter(context);
+    for (const idx_t doc_id : {2, 3}) {
+        auto key = lintdb::create_context_id(0, 1, doc_id);
+        EXPECT_EQ(
+                filter->Filter(0, key, "codes", &new_value, &value_changed),
+                doc_id == 2);
+    }
+    // other tenants keep their documents.
+    EXPECT_FALSE(filter->Filter(
+            0,
+            lintdb::create_forward_index_id(1, 2),
+            "",
+            &new_value,
+            &value_changed));
+
+    // block lists keep their live documents.
+    std::string blocks;
+    lintdb::encode_posting_blocks({1, 2, 3, 4}, blocks);
+    auto block_filter = lintdb::TombstoneFilterFactory(tombstones, true)
+                                .CreateCompactionFilter(context);
+    EXPECT_FALSE(block_filter->Filter(
+            0,
+            lintdb::create_posting_block_key(0, 1, 5, 1),
+            blocks,
+            &new_value,
+            &value_changed));
+    ASSERT_TRUE(value_changed);
+    std::vector<idx_t> doc_ids;
+    lintdb::decode_posting_blocks(new_value.data(), new_value.size(), doc_ids);
+    EXPECT_EQ(doc_ids, std::vector<idx_t>({1, 3}));
+
+    lintdb::DeletedDocsCursor cursor(tombstones->get(0));
+    std::vector<idx_t> live;
+    for (const idx_t doc_id : {1, 2, 3, 4, 5}) {
+        if (!cursor.is_deleted(doc_id)) {
+            live.push_back(doc_id);
+        }
+    }
+    EXPECT_EQ(live, std::vector<idx_t>({1, 3, 5}));
+}
+
+TEST_F(InvertedListTest, TombstonesChangeIncrementally) {
+    lintdb::Tombstones tombstones;
+    auto cf = column_families[lintdb::kTombstoneColumnIndex];
+    std::set<idx_t> expected;
+    for (idx_t i = 0; i < 1000; i++) {
+        tombstones.add(db.get(), cf, 0, {i * 2});
+        expected.insert(i * 2);
+        // every third change revives an earlier document.
+        if (i % 3 == 0) {
+            tombstones.erase(db.get(), cf, 0, {i});
+            expected.erase(i);
+        }
+    }
+
+    auto deleted = tombstones.get(0);
+    ASSERT_TRUE(deleted);
+    EXPECT_EQ(deleted->size(), expected.size());
+    EXPECT_EQ(
+            deleted->doc_ids(),
+            std::vector<idx_t>(expected.begin(), expected.end()));
+    // runs are merged, so there are only a few to check.
+    EXPECT_LE(deleted->runs().size(), 20);
+
+    lintdb::DeletedDocsCursor cursor(deleted);
+    for (idx_t doc_id = 0; doc_id < 2000; doc_id++) {
+        const bool is_deleted = expected.count(doc_id) > 0;
+        EXPECT_EQ(deleted->contains(doc_id), is_deleted);
+        EXPECT_EQ(cursor.is_deleted(doc_id), is_deleted);
+    }
+
+    // erasing every tombstone removes the tenant.
+    tombstones.erase(
+            db.get(),
+            cf,
+            0,
+            std::vector<idx_t>(expected.begin(), expected.end()));
+    EXPECT_FALSE(tombstones.get(0));
+}
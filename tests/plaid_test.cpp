@@ -135,7 +135,7 @@ TEST(PlaidTests, CodeScoresSameAsColBERT) {
     std::vector<idx_t> coarse_idx(100 * 5, 0);
     for (size_t i = 0; i < 5; i++) {
         for (size_t j = 0; j < 100; j++) {
-            centroid_scores[i * 100 + j] = (rand() / RAND_MAX + 1.);
+            centroid_scores[j * 5 + i] = (rand() / RAND_MAX + 1.);
             coarse_idx[i * 100 + j] = i;
         }
     }
@@ -240,4 +240,69 @@ TEST(PlaidTests, ResidualScoresTheSame) {
             false);
 
     EXPECT_FLOAT_EQ(actual.score, colbert_score);
-}
\ No newline at end of file
+}
+TEST(PlaidTests, BatchedResidualScoresMatchSingleDocument) {
+    const size_t dim = 4;
+    const size_t num_query_tokens = 3;
+    std::vector<float> query = {
+            1, 0, 0, 0, 0, 1, 0, 0, 0.5, 0.5, 0.5, 0.5};
+    // three documents with 2, 1, and 3 tokens.
+    std::vector<size_t> offsets = {0, 2, 3, 6};
+    std::vector<float> docs(offsets.back() * dim);
+    for (size_t i = 0; i < docs.size(); i++) {
+        docs[i] = float((i * 7) % 5) - 1.5;
+    }
+
+    std::vector<float> batch = docs;
+    std::vector<float> scores(offsets.size() - 1);
+    lintdb::score_documents_by_residuals(
+            query, num_query_tokens, batch.data(), offsets, dim, scores.data());
+
+    for (size_t d = 0; d < offsets.size() - 1; d++) {
+        std::vector<float> single(
+                docs.begin() + offsets[d] * dim,
+                docs.begin() + offsets[d + 1] * dim);
+        auto expected = lintdb::score_document_by_residuals(
+                query,
+                num_query_tokens,
+                single.data(),
+                offsets[d + 1] - offsets[d],
+                dim,
+                -1);
+        EXPECT_NEAR(scores[d], expected.score, 1e-5);
+    }
+}
+
+TEST(PlaidTests, CentroidScoreResetsBetweenDocuments) {
+    std::vector<float> centroid_scores = {
+            0.1, 0.9, // centroid 0
+            0.8, 0.2, // centroid 1
+            0.5, 0.5, // centroid 2
+    };
+
+    auto first = lintdb::colbert_centroid_score(
+            {0, 0, 1, 1}, centroid_scores, 2, 3, -1);
+    EXPECT_FLOAT_EQ(first, 0.8 + 0.9);
+
+    // codes seen by a previous document are scored again by the next one.
+    auto second = lintdb::colbert_centroid_score(
+            {1, 0, 2}, centroid_scores, 2, 3, -1);
+    EXPECT_FLOAT_EQ(second, 0.8 + 0.9);
+}
+
+TEST(PlaidTests, CodeScoreCountsEachCentroidOnce) {
+    std::vector<float> max_scores = {0.1, 0.8, 0.5};
+    gsl::span<float> scores(max_scores);
+
+    // the score is a sum, so a repeated code would be counted twice.
+    EXPECT_FLOAT_EQ(
+            lintdb::score_documents_by_codes(scores, {1, 1, 2, 1}, 0),
+            0.8 + 0.5);
+    // a code below the threshold doesn't count.
+    EXPECT_FLOAT_EQ(
+            lintdb::score_documents_by_codes(scores, {0, 1}, 0.2), 0.8);
+    // codes seen by a previous document count for the next one.
+    EXPECT_FLOAT_EQ(
+            lintdb::score_documents_by_codes(scores, {2, 1, 0}, 0),
+            0.1 + 0.8 + 0.5);
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <rocksdb/merge_operator.h>
+#include <rocksdb/slice.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "lintdb/invlists/PostingBlocks.h"
+
+TEST(PostingBlocksTest, RoundTripsBlocks) {
+    // small deltas, wide deltas, and more than one block.
+    std::vector<idx_t> doc_ids;
+    for (idx_t i = 0; i < 200; i++) {
+        doc_ids.push_back(i * 7);
+    }
+    doc_ids.push_back(idx_t(1) << 40);
+    doc_ids.push_back((idx_t(1) << 40) + 1);
+    doc_ids.push_back(idx_t(1) << 62);
+
+    std::string encoded;
+    lintdb::encode_posting_blocks(doc_ids, encoded);
+
+    std::vector<idx_t> decoded;
+    lintdb::decode_posting_blocks(encoded.data(), encoded.size(), decoded);
+    EXPECT_EQ(decoded, doc_ids);
+
+    // deltas of 7 pack into 3 bits, so a full block is much smaller than its
+    // raw ids.
+    std::string small;
+    lintdb::encode_posting_blocks(
+            std::vector<idx_t>(doc_ids.begin(), doc_ids.begin() + 128), small);
+    EXPECT_LT(small.size(), 128 * sizeof(idx_t) / 8);
+
+    lintdb::PostingBlockReader reader(encoded.data(), encoded.size());
+    ASSERT_TRUE(reader.has_block());
+    EXPECT_EQ(reader.first_doc_id(), 0);
+    EXPECT_EQ(reader.last_doc_id(), 127 * 7);
+    reader.skip_block();
+    ASSERT_TRUE(reader.has_block());
+    EXPECT_EQ(reader.first_doc_id(), 128 * 7);
+
+    std::vector<idx_t> block;
+    reader.read_block(block);
+    EXPECT_EQ(block.size(), doc_ids.size() - lintdb::kPostingBlockSize);
+    EXPECT_FALSE(reader.has_block());
+}
+
+TEST(PostingBlocksTest, MergesAddsAndRemoves) {
+    lintdb::PostingListMergeOperator op;
+
+    std::string existing;
+    lintdb::encode_posting_blocks({1, 2, 3}, existing);
+    rocksdb::Slice existing_slice(existing);
+
+    std::string add = lintdb::encode_posting_operand({5, 4}, {});
+    std::string remove = lintdb::encode_posting_operand({}, {2, 5});
+    std::string readd = lintdb::encode_posting_operand({5}, {});
+
+    // adjacent operands fold into one.
+    std::deque<rocksdb::Slice> partial = {
+            rocksdb::Slice(remove), rocksdb::Slice(readd)};
+    std::string folded;
+    ASSERT_TRUE(op.PartialMergeMulti(
+            rocksdb::Slice(), partial, &folded, nullptr));
+
+    std::vector<rocksdb::Slice> operands = {
+            rocksdb::Slice(add), rocksdb::Slice(folded)};
+    rocksdb::Slice key;
+    rocksdb::MergeOperator::MergeOperationInput in{
+            key, &existing_slice, operands, nullptr};
+    std::string new_value;
+    rocksdb::Slice existing_operand;
+    rocksdb::MergeOperator::MergeOperationOutput out{
+            new_value, existing_operand};
+    ASSERT_TRUE(op.FullMergeV2(in, &out));
+
+    std::vector<idx_t> decoded;
+    lintdb::decode_posting_blocks(new_value.data(), new_value.size(), decoded);
+    std::vector<idx_t> expected = {1, 3, 4, 5};
+    EXPECT_EQ(decoded, expected);
+}
@@ -0,0 +1,47 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "lintdb/scoring/TopKCollector.h"
+
+using namespace lintdb;
+
+TEST(TopKCollectorTest, KeepsHighestScores) {
+    TopKCollector collector(3);
+    std::vector<float> scores = {0.5, 3.0, 1.0, 4.0, 2.0, 0.1};
+    for (size_t i = 0; i < scores.size(); i++) {
+        collector.collect(ScoredDocument(scores[i], i, {}));
+    }
+
+    EXPECT_TRUE(collector.is_full());
+    EXPECT_FLOAT_EQ(collector.threshold(), 2.0);
+
+    auto results = collector.take_sorted();
+    ASSERT_EQ(results.size(), 3);
+    EXPECT_EQ(results[0].doc_id, 3);
+    EXPECT_EQ(results[1].doc_id, 1);
+    EXPECT_EQ(results[2].doc_id, 4);
+    EXPECT_EQ(collector.size(), 0);
+}
+
+TEST(TopKCollectorTest, MergesPartialHeaps) {
+    TopKCollector first(2);
+    TopKCollector second(2);
+    first.collect(ScoredDocument(1.0, 1, {}));
+    first.collect(ScoredDocument(5.0, 2, {}));
+    second.collect(ScoredDocument(3.0, 3, {}));
+    second.collect(ScoredDocument(0.5, 4, {}));
+
+    first.merge(second);
+    EXPECT_EQ(second.size(), 0);
+
+    auto results = first.take_sorted();
+    ASSERT_EQ(results.size(), 2);
+    EXPECT_EQ(results[0].doc_id, 2);
+    EXPECT_EQ(results[1].doc_id, 3);
+}
+
+TEST(TopKCollectorTest, ZeroCapacityCollectsNothing) {
+    TopKCollector collector(0);
+    collector.collect(ScoredDocument(1.0, 1, {}));
+    EXPECT_EQ(collector.size(), 0);
+    EXPECT_TRUE(collector.take_sorted().empty());
+}
@@ -4,6 +4,8 @@
 #include <iostream>
 #include <random>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include <filesystem>
 
@@ -30,3 +32,28 @@ inline std::filesystem::path create_temporary_directory(
     }
     return path;
 }
+
+/// writes a version 1 .npy file of float32 embeddings with shape (n, dim).
+inline void write_npy(
+        const std::string& path,
+        const std::vector<float>& data,
+        size_t dim) {
+    std::string header = "{'descr': '<f4', 'fortran_order': False, 'shape': (" +
+            std::to_string(data.size() / dim) + ", " + std::to_string(dim) +
+            "), }";
+    // the data starts on a 64 byte boundary, and the header ends in a newline.
+    while ((10 + header.size() + 1) % 64 != 0) {
+        header += ' ';
+    }
+    header += '\n';
+
+    std::ofstream out(path, std::ios::binary);
+    out.write("\x93NUMPY\x01\x00", 8);
+    uint16_t header_size = header.size();
+    out.put(char(header_size & 0xff));
+    out.put(char(header_size >> 8));
+    out.write(header.data(), header.size());
+    out.write(
+            reinterpret_cast<const char*>(data.data()),
+            data.size() * sizeof(float));
+}